@@ -8,6 +8,10 @@ int write(int fd, const void * buffer, unsigned size);
 int close(int fd);
 int seek(int fd, int offset, int mode);
 int chdir(const char * filename);
+int unlink(const char * pathname);
+int mkdir(const char * pathname, int mode);
+int mount(const char * dev_name, const char * dir_name, int rw_flag);
+int umount(const char * dev_name);
 char * getcwd(char * buf, int size);
 typedef int pid_t;				/* 用于进程号和进程组号 */
 typedef unsigned short uid_t;	/* 用于用户号(用户标识号) */
@@ -36,5 +40,110 @@ struct stat {
 	time_t	st_ctime;	/* 最后节点修改时间. */
 };
 int fstat(int fd, struct stat * buf);
+struct iovec {
+	void * iov_base;	/* 缓冲区起始地址 */
+	unsigned iov_len;	/* 缓冲区长度 */
+};
+int readv(int fd, const struct iovec * iov, int iovcnt);
+int writev(int fd, const struct iovec * iov, int iovcnt);
+int pread(int fd, void * buffer, unsigned size, int offset);
+int pwrite(int fd, const void * buffer, unsigned size, int offset);
+#define LIO_READ	0
+#define LIO_WRITE	1
+struct aiocb {
+	int aio_fildes;				/* 文件句柄 */
+	int aio_lio_opcode;			/* LIO_READ 或 LIO_WRITE */
+	off_t aio_offset;			/* 文件中的读写位置 */
+	void * aio_buf;				/* 用户缓冲区 */
+	unsigned aio_nbytes;		/* 读写字节数, 最多 16KB */
+	unsigned long aio_data;		/* 完成时在 aio_event 中原样返回 */
+};
+struct aio_event {
+	unsigned long data;			/* 对应控制块的 aio_data */
+	long res;					/* 读写的字节数或出错码 */
+};
+int aio_submit(int nr, struct aiocb * list);
+int aio_getevents(int min_nr, int nr, struct aio_event * events);
+
+int fork(void);
+int execve(const char * filename, char ** argv, char ** envp);
+int waitpid(int pid, int * status, int options);
+void exit(int exit_code);
+#define F_SETFL			4
+#define O_NONBLOCK		04000
+#define F_SETPIPE_SZ	1031
+#define F_GETPIPE_SZ	1032
+int fcntl(int fd, int cmd, int arg);
+int sync(void);
+#define HZ			100			/* 时钟频率, times() 的计时单位是 1/HZ 秒 */
+struct tms {
+	long tms_utime;				/* 用户态 CPU 时间 */
+	long tms_stime;				/* 内核态 CPU 时间 */
+	long tms_cutime;			/* 已终止子进程的用户态 CPU 时间 */
+	long tms_cstime;			/* 已终止子进程的内核态 CPU 时间 */
+};
+int times(struct tms * buf);
+#define S_IFCHR		0020000
+#define S_IFBLK		0060000
+int mknod(const char * filename, int mode, int dev);
+int ioctl(int fd, int cmd, void * arg);
+#define RDSETSIZE	0x5201		/* 设置虚拟盘大小(KB), 最大 4096 */
+#define RDGETSIZE	0x5202		/* 取虚拟盘大小(KB) */
+#define TCGETS		0x5401
+#define TCSETS		0x5402
+#define NCCS		17
+#define VTIME		5
+#define VMIN		6
+struct termios {
+	unsigned long c_iflag;		/* 输入模式标志 */
+	unsigned long c_oflag;		/* 输出模式标志 */
+	unsigned long c_cflag;		/* 控制模式标志 */
+	unsigned long c_lflag;		/* 本地模式标志 */
+	unsigned char c_line;		/* 线路规程 */
+	unsigned char c_cc[NCCS];	/* 控制字符数组 */
+};
+#define INLCR		0000100		/* c_iflag */
+#define IGNCR		0000200
+#define ICRNL		0000400
+#define IUCLC		0001000
+#define IXON		0002000
+#define OPOST		0000001		/* c_oflag */
+#define CBAUD		0000017		/* c_cflag */
+#define B9600		0000015
+#define B38400		0000017
+#define CSIZE		0000060
+#define CS8			0000060
+#define CREAD		0000200
+#define PARENB		0000400
+#define CLOCAL		0004000
+#define ISIG		0000001		/* c_lflag */
+#define ICANON		0000002
+#define ECHO		0000010
+int pipe(int * fildes);
+int splice(int fd_in, int fd_out, int count);
+struct timeval {
+	long tv_sec;		/* 秒 */
+	long tv_usec;		/* 微秒 */
+};
+int gettimeofday(struct timeval * tv, void * tz);
+typedef unsigned long fd_set;	/* 每个描述符一位, 最多 32 个 */
+#define FD_ZERO(set)		(*(set) = 0)
+#define FD_SET(fd, set)		(*(set) |= 1UL << (fd))
+#define FD_ISSET(fd, set)	(*(set) & (1UL << (fd)))
+int select(int nfds, fd_set * readfds, fd_set * writefds, fd_set * exceptfds, struct timeval * timeout);
+#define EPOLLIN			0x001
+#define EPOLLOUT		0x004
+#define EPOLLERR		0x008
+#define EPOLLHUP		0x010
+#define EPOLL_CTL_ADD	1
+#define EPOLL_CTL_DEL	2
+#define EPOLL_CTL_MOD	3
+struct epoll_event {
+	unsigned long events;
+	unsigned long data;
+};
+int epoll_create(int size);
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event * event);
+int epoll_wait(int epfd, struct epoll_event * events, int maxevents, int timeout);
 
 #endif                          /* end of __MINI_UNISTD_H__ */
\ No newline at end of file
@@ -82,6 +82,337 @@ int fstat(int fd, struct stat * buf) {
     return ret;
 }
 
+int readv(int fd, const struct iovec * iov, int iovcnt) {
+    int ret = 0;
+    /* syscall __NR_readv = 93: sys_readv() */
+    asm("movl $93, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "movl %3, %%edx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (fd), "m" (iov), "m" (iovcnt));
+    return ret;
+}
+
+int writev(int fd, const struct iovec * iov, int iovcnt) {
+    int ret = 0;
+    /* syscall __NR_writev = 94: sys_writev() */
+    asm("movl $94, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "movl %3, %%edx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (fd), "m" (iov), "m" (iovcnt));
+    return ret;
+}
+
+/* pread/pwrite take 4 arguments, so like select() the kernel gets a pointer to them */
+int pread(int fd, void * buffer, unsigned size, int offset) {
+    int ret = 0;
+    int * args = &fd;
+    /* syscall __NR_pread = 95: sys_pread() */
+    asm("movl $95, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (args));
+    return ret;
+}
+
+int pwrite(int fd, const void * buffer, unsigned size, int offset) {
+    int ret = 0;
+    int * args = &fd;
+    /* syscall __NR_pwrite = 96: sys_pwrite() */
+    asm("movl $96, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (args));
+    return ret;
+}
+
+int aio_submit(int nr, struct aiocb * list) {
+    int ret;
+    /* syscall __NR_aio_submit = 91: sys_aio_submit() */
+    asm("movl $91, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (nr), "m" (list));
+    return ret;
+}
+
+int aio_getevents(int min_nr, int nr, struct aio_event * events) {
+    int ret;
+    /* syscall __NR_aio_getevents = 92: sys_aio_getevents() */
+    asm("movl $92, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "movl %3, %%edx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (min_nr), "m" (nr), "m" (events));
+    return ret;
+}
+
+int unlink(const char * pathname) {
+    int ret;
+    /* syscall __NR_unlink = 10: sys_unlink() */
+    asm("movl $10, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (pathname));
+    return ret;
+}
+
+int mkdir(const char * pathname, int mode) {
+    int ret;
+    /* syscall __NR_mkdir = 39: sys_mkdir() */
+    asm("movl $39, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (pathname), "m" (mode));
+    return ret;
+}
+
+/* dev_name is a block device file, or a file system type name such as "tmpfs" */
+int mount(const char * dev_name, const char * dir_name, int rw_flag) {
+    int ret;
+    /* syscall __NR_mount = 21: sys_mount() */
+    asm("movl $21, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "movl %3, %%edx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (dev_name), "m" (dir_name), "m" (rw_flag));
+    return ret;
+}
+
+/* a tmpfs is unmounted by the name of its mount point */
+int umount(const char * dev_name) {
+    int ret;
+    /* syscall __NR_umount = 22: sys_umount() */
+    asm("movl $22, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (dev_name));
+    return ret;
+}
+
+int fork(void) {
+    int ret;
+    /* syscall __NR_fork = 2: sys_fork() */
+    asm("movl $2, %%eax     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret));
+    return ret;
+}
+
+int execve(const char * filename, char ** argv, char ** envp) {
+    int ret;
+    /* syscall __NR_execve = 11: sys_execve() */
+    asm("movl $11, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "movl %3, %%edx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (filename), "m" (argv), "m" (envp));
+    return ret;
+}
+
+int waitpid(int pid, int * status, int options) {
+    int ret;
+    /* syscall __NR_waitpid = 7: sys_waitpid() */
+    asm("movl $7, %%eax     \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "movl %3, %%edx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (pid), "m" (status), "m" (options));
+    return ret;
+}
+
+int fcntl(int fd, int cmd, int arg) {
+    int ret;
+    /* syscall __NR_fcntl = 55: sys_fcntl() */
+    asm("movl $55, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "movl %3, %%edx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (fd), "m" (cmd), "m" (arg));
+    return ret;
+}
+
+int times(struct tms * buf) {
+    int ret;
+    /* syscall __NR_times = 43: sys_times(), returns the tick count */
+    asm("movl $43, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (buf));
+    return ret;
+}
+
+int sync(void) {
+    int ret;
+    /* syscall __NR_sync = 36: sys_sync() */
+    asm("movl $36, %%eax    \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret));
+    return ret;
+}
+
+int mknod(const char * filename, int mode, int dev) {
+    int ret;
+    /* syscall __NR_mknod = 14: sys_mknod() */
+    asm("movl $14, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "movl %3, %%edx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (filename), "m" (mode), "m" (dev));
+    return ret;
+}
+
+int ioctl(int fd, int cmd, void * arg) {
+    int ret;
+    /* syscall __NR_ioctl = 54: sys_ioctl() */
+    asm("movl $54, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "movl %3, %%edx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (fd), "m" (cmd), "m" (arg));
+    return ret;
+}
+
+int pipe(int * fildes) {
+    int ret;
+    /* syscall __NR_pipe = 42: sys_pipe() */
+    asm("movl $42, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (fildes));
+    return ret;
+}
+
+/* the kernel keeps time in 10 ms ticks, so tv_usec moves in steps of 10000 */
+int gettimeofday(struct timeval * tv, void * tz) {
+    int ret;
+    /* syscall __NR_gettimeofday = 78: sys_gettimeofday() */
+    asm("movl $78, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (tv), "m" (tz));
+    return ret;
+}
+
+/* one of fd_in and fd_out must be a pipe and the other a regular file */
+int splice(int fd_in, int fd_out, int count) {
+    int ret;
+    /* syscall __NR_splice = 87: sys_splice() */
+    asm("movl $87, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "movl %2, %%ecx     \n\t"
+        "movl %3, %%edx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (fd_in), "m" (fd_out), "m" (count));
+    return ret;
+}
+
+/* select() takes 5 arguments, so the kernel gets a pointer to them */
+int select(int nfds, fd_set * readfds, fd_set * writefds, fd_set * exceptfds, struct timeval * timeout) {
+    int ret;
+    int * args = &nfds;
+    /* syscall __NR_select = 82: sys_select() */
+    asm("movl $82, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (args));
+    return ret;
+}
+
+int epoll_create(int size) {
+    int ret;
+    /* syscall __NR_epoll_create = 88: sys_epoll_create() */
+    asm("movl $88, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (size));
+    return ret;
+}
+
+/* epoll_ctl/epoll_wait take 4 arguments, so like select() the kernel gets a pointer to them */
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event * event) {
+    int ret;
+    int * args = &epfd;
+    /* syscall __NR_epoll_ctl = 89: sys_epoll_ctl() */
+    asm("movl $89, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (args));
+    return ret;
+}
+
+int epoll_wait(int epfd, struct epoll_event * events, int maxevents, int timeout) {
+    int ret;
+    int * args = &epfd;
+    /* syscall __NR_epoll_wait = 90: sys_epoll_wait() */
+    asm("movl $90, %%eax    \n\t"
+        "movl %1, %%ebx     \n\t"
+        "int $0x80          \n\t"
+        "movl %%eax, %0     \n\t"
+        : "=m" (ret)
+        : "m" (args));
+    return ret;
+}
+
 int chdir(const char * filename) {
     int ret;
     /* syscall __NR_chdir = 12: sys_chdir */
@@ -0,0 +1,135 @@
+#include "minicrt.h"
+
+/*
+ * aio_read [file]: random 4 KB reads from a large file (default
+ * aio_read.dat, created and removed here), first one at a time with
+ * pread() and then with up to DEPTH requests in flight through
+ * aio_submit()/aio_getevents(). With several requests queued the disk
+ * driver can order them by block number instead of seeking back and
+ * forth for each one. The two passes read disjoint chunks (even and odd
+ * chunk numbers), so neither finds the other's blocks in the buffer
+ * cache; FILE_KB is well above the cache size.
+ */
+
+#define FILE_KB     8192
+#define REQ_SIZE    4096
+#define NR_CHUNKS   (FILE_KB * 1024 / REQ_SIZE)
+#define REQS        256
+#define DEPTH       8
+
+static char bufs[DEPTH][REQ_SIZE];
+static struct aiocb list[DEPTH];
+static struct aio_event events[DEPTH];
+static unsigned long seed = 1;
+
+static int elapsed_ms(struct timeval * t0, struct timeval * t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1000 + (t1->tv_usec - t0->tv_usec) / 1000;
+}
+
+/* offset of a random chunk whose number has the given parity */
+static int pick(int parity) {
+    seed = seed * 1103515245 + 12345;
+    return ((seed >> 8) % (NR_CHUNKS / 2) * 2 + parity) * REQ_SIZE;
+}
+
+static void report(const char * how, struct timeval * t0, struct timeval * t1) {
+    int ms = elapsed_ms(t0, t1);
+
+    if (!ms) {
+        ms = 1;
+    }
+    printf("%s: %d reads of %d bytes in %d ms, %d reads/s\n", how, REQS, REQ_SIZE, ms, REQS * 1000 / ms);
+}
+
+static int bench_pread(int fd) {
+    struct timeval t0, t1;
+    int i, ret;
+
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < REQS; i++) {
+        if ((ret = pread(fd, bufs[0], REQ_SIZE, pick(0))) != REQ_SIZE) {
+            printf("pread failed (%d)\n", ret);
+            return -1;
+        }
+    }
+    gettimeofday(&t1, NULL);
+    report("pread", &t0, &t1);
+    return 0;
+}
+
+static int bench_aio(int fd) {
+    struct timeval t0, t1;
+    int free_slot[DEPTH];
+    int nfree = DEPTH, submitted = 0, done = 0;
+    int i, nr, ret;
+
+    for (i = 0; i < DEPTH; i++) {
+        free_slot[i] = i;
+    }
+    gettimeofday(&t0, NULL);
+    while (done < REQS) {
+        /* fill every free buffer with a new request and submit them as one batch */
+        for (nr = 0; nfree && submitted + nr < REQS; nr++) {
+            i = free_slot[--nfree];
+            list[nr].aio_fildes = fd;
+            list[nr].aio_lio_opcode = LIO_READ;
+            list[nr].aio_offset = pick(1);
+            list[nr].aio_buf = bufs[i];
+            list[nr].aio_nbytes = REQ_SIZE;
+            list[nr].aio_data = i;
+        }
+        if (nr) {
+            if ((ret = aio_submit(nr, list)) < 0) {
+                printf("aio_submit failed (%d)\n", ret);
+                return -1;
+            }
+            /* requests the kernel had no room for go back to the free list */
+            for (i = ret; i < nr; i++) {
+                free_slot[nfree++] = list[i].aio_data;
+            }
+            submitted += ret;
+        }
+        if ((ret = aio_getevents(1, DEPTH, events)) <= 0) {
+            printf("aio_getevents failed (%d)\n", ret);
+            return -1;
+        }
+        for (i = 0; i < ret; i++) {
+            if (events[i].res != REQ_SIZE) {
+                printf("aio read failed (%d)\n", events[i].res);
+                return -1;
+            }
+            free_slot[nfree++] = events[i].data;
+        }
+        done += ret;
+    }
+    gettimeofday(&t1, NULL);
+    report("aio, depth 8", &t0, &t1);
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    char * path = "aio_read.dat";
+    int i, fd, ret;
+
+    if (argc > 1) {
+        path = argv[1];
+    }
+    if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+        printf("open %s failed (%d)\n", path, fd);
+        return 1;
+    }
+    for (i = 0; i < NR_CHUNKS; i++) {
+        bufs[0][0] = i;
+        if (write(fd, bufs[0], REQ_SIZE) != REQ_SIZE) {
+            printf("cannot create %s\n", path);
+            close(fd);
+            unlink(path);
+            return 1;
+        }
+    }
+    sync();
+    ret = bench_pread(fd) || bench_aio(fd);
+    close(fd);
+    unlink(path);
+    return ret;
+}
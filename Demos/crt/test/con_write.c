@@ -0,0 +1,73 @@
+#include "minicrt.h"
+
+/*
+ * con_write: console output throughput. Writes TOTAL_KB of text to
+ * standard output, which must be a virtual console, in CHUNK-byte
+ * write() calls, and prints the results once the screen has settled.
+ * "long lines" is almost all printable runs, the case con_write()
+ * copies into video memory in bulk; "escapes" puts an ANSI attribute
+ * change every eight characters, so it mostly exercises the per-character
+ * state machine and serves as the baseline.
+ */
+
+#define TOTAL_KB    256
+#define CHUNK       4096
+
+static char buf[CHUNK];
+
+static int elapsed_ms(struct timeval * t0, struct timeval * t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1000 + (t1->tv_usec - t0->tv_usec) / 1000;
+}
+
+/* fill buf with 79-character lines of letters */
+static void long_lines(void) {
+    int i;
+
+    for (i = 0; i < CHUNK; i++) {
+        buf[i] = (i % 80 == 79) ? '\n' : 'a' + i % 26;
+    }
+}
+
+/* fill buf with "\033[1mabcd\033[0mefgh" groups, every fourth one ending in a newline */
+static void escapes(void) {
+    static char group[] = "\033[1mabcd\033[0mefgh";
+    int i, j = 0, n = 0;
+
+    for (i = 0; i < CHUNK; i++) {
+        buf[i] = group[j];
+        if (!group[++j]) {
+            j = 0;
+            if (++n % 4 == 0) {
+                buf[i] = '\n';
+            }
+        }
+    }
+}
+
+static int run(void) {
+    struct timeval t0, t1;
+    int n;
+
+    gettimeofday(&t0, NULL);
+    for (n = 0; n < TOTAL_KB * 1024; n += CHUNK) {
+        write(1, buf, CHUNK);
+    }
+    gettimeofday(&t1, NULL);
+    if (!(n = elapsed_ms(&t0, &t1))) {
+        n = 1;
+    }
+    return n;
+}
+
+int main(int argc, char * argv[]) {
+    int ms_long, ms_esc;
+
+    long_lines();
+    ms_long = run();
+    escapes();
+    ms_esc = run();
+    printf("\033[0m\n");
+    printf("long lines: %d KB in %d ms, %d KB/s\n", TOTAL_KB, ms_long, TOTAL_KB * 1000 / ms_long);
+    printf("escapes:    %d KB in %d ms, %d KB/s\n", TOTAL_KB, ms_esc, TOTAL_KB * 1000 / ms_esc);
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "minicrt.h"
+
+/*
+ * epoll_idle: cost of waiting for one busy pipe among many idle
+ * descriptors. Each round writes a byte into the pipe, waits for it with
+ * select() or epoll_wait(), and reads it back. select() checks every
+ * descriptor in the set on each call, while epoll_wait() only looks at
+ * the ready list, so its time per round should stay flat as idle
+ * descriptors are added.
+ *
+ * The idle descriptors are separate opens of the controlling terminal,
+ * which stays quiet as long as nobody types. fd_set is a single long and
+ * select() computes its mask with a shift by nfds, so select() is only
+ * run on descriptors below 31; epoll goes on to MAX_IDLE.
+ */
+
+#define ROUNDS      2000
+#define MAX_IDLE    512
+#define SELECT_FDS  31
+
+static int idle[MAX_IDLE];
+static int steps[] = { 0, 8, 16, 24, 128, 256, MAX_IDLE };
+
+static int elapsed_ms(struct timeval * t0, struct timeval * t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1000 + (t1->tv_usec - t0->tv_usec) / 1000;
+}
+
+static int bench_select(int * p, int nidle) {
+    struct timeval t0, t1;
+    fd_set set;
+    int i, n, nfds = p[0] + 1;
+    char c = 'x';
+
+    for (i = 0; i < nidle; i++) {
+        if (idle[i] >= nfds) {
+            nfds = idle[i] + 1;
+        }
+    }
+    gettimeofday(&t0, NULL);
+    for (n = 0; n < ROUNDS; n++) {
+        write(p[1], &c, 1);
+        FD_ZERO(&set);
+        FD_SET(p[0], &set);
+        for (i = 0; i < nidle; i++) {
+            FD_SET(idle[i], &set);
+        }
+        if (select(nfds, &set, NULL, NULL, NULL) != 1 || !FD_ISSET(p[0], &set)) {
+            printf("select: unexpected result in round %d\n", n);
+            return -1;
+        }
+        read(p[0], &c, 1);
+    }
+    gettimeofday(&t1, NULL);
+    return elapsed_ms(&t0, &t1);
+}
+
+static int bench_epoll(int * p, int nidle) {
+    struct timeval t0, t1;
+    struct epoll_event ev;
+    int i, n, ret, epfd;
+    char c = 'x';
+
+    if ((epfd = epoll_create(1)) < 0) {
+        printf("epoll_create failed (%d)\n", epfd);
+        return -1;
+    }
+    ev.events = EPOLLIN;
+    ev.data = p[0];
+    if ((ret = epoll_ctl(epfd, EPOLL_CTL_ADD, p[0], &ev)) < 0) {
+        printf("epoll_ctl pipe failed (%d)\n", ret);
+        close(epfd);
+        return -1;
+    }
+    for (i = 0; i < nidle; i++) {
+        ev.data = idle[i];
+        if ((ret = epoll_ctl(epfd, EPOLL_CTL_ADD, idle[i], &ev)) < 0) {
+            printf("epoll_ctl idle %d failed (%d)\n", i, ret);
+            close(epfd);
+            return -1;
+        }
+    }
+    gettimeofday(&t0, NULL);
+    for (n = 0; n < ROUNDS; n++) {
+        write(p[1], &c, 1);
+        if (epoll_wait(epfd, &ev, 1, -1) != 1 || ev.data != p[0]) {
+            printf("epoll_wait: unexpected result in round %d\n", n);
+            close(epfd);
+            return -1;
+        }
+        read(p[0], &c, 1);
+    }
+    gettimeofday(&t1, NULL);
+    close(epfd);
+    return elapsed_ms(&t0, &t1);
+}
+
+int main(int argc, char * argv[]) {
+    int p[2];
+    int i, k, nopen, ms;
+
+    if ((i = pipe(p)) < 0) {
+        printf("pipe failed (%d)\n", i);
+        return 1;
+    }
+    for (nopen = 0; nopen < MAX_IDLE; nopen++) {
+        if ((idle[nopen] = open("/dev/tty", O_RDONLY, 0)) < 0) {
+            break;
+        }
+    }
+    printf("%d rounds, %d idle descriptors open\n", ROUNDS, nopen);
+    for (k = 0; k < sizeof(steps) / sizeof(steps[0]) && steps[k] <= nopen; k++) {
+        if (!steps[k] || idle[steps[k] - 1] < SELECT_FDS) {
+            if ((ms = bench_select(p, steps[k])) < 0) {
+                return 1;
+            }
+            printf("select     %d idle: %d ms, %d us/round\n", steps[k], ms, ms * 1000 / ROUNDS);
+        }
+        if ((ms = bench_epoll(p, steps[k])) < 0) {
+            return 1;
+        }
+        printf("epoll_wait %d idle: %d ms, %d us/round\n", steps[k], ms, ms * 1000 / ROUNDS);
+    }
+    for (i = 0; i < nopen; i++) {
+        close(idle[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "minicrt.h"
+
+/*
+ * exec_lat: latency of the fork/exec/wait cycle a shell goes through
+ * for every command. Three loops of ROUNDS each:
+ *   fork+exit        the child exits at once (baseline without exec),
+ *   fork+exec        the child execs this program with "-x", which exits,
+ *   fork+exec #!     the child execs a script whose #! line names this
+ *                    program with "-x", so exec also runs the script path.
+ * Repeated execs of the same file reuse the a.out header cached in its
+ * inode, and argv/envp are copied in bulk; an extra argument string of
+ * ARG_LEN bytes and a few environment strings make that copy visible.
+ * argv[0] must be a path to this program (e.g. ./exec_lat), since it is
+ * used to exec it again.
+ */
+
+#define ROUNDS      200
+#define ARG_LEN     1000
+#define SCRIPT      "exec_lat.sh"
+
+static char long_arg[ARG_LEN + 1];
+static char * envp[] = { "HOME=/usr/root", "PATH=/bin:/usr/bin", "TERM=con80x25", NULL };
+
+static int elapsed_ms(struct timeval * t0, struct timeval * t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1000 + (t1->tv_usec - t0->tv_usec) / 1000;
+}
+
+/* run ROUNDS fork/(exec)/wait cycles; path == NULL means the child just exits */
+static int bench(const char * how, char * path, char ** argv) {
+    struct timeval t0, t1;
+    int i, pid, status, ms;
+
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < ROUNDS; i++) {
+        if (!(pid = fork())) {
+            if (path) {
+                execve(path, argv, envp);
+            }
+            exit(path ? 127 : 0);
+        }
+        if (pid < 0) {
+            printf("%s: fork failed (%d)\n", how, pid);
+            return -1;
+        }
+        waitpid(pid, &status, 0);
+        if (status) {
+            printf("%s: child failed (status %x)\n", how, status);
+            return -1;
+        }
+    }
+    gettimeofday(&t1, NULL);
+    ms = elapsed_ms(&t0, &t1);
+    printf("%s: %d rounds in %d ms, %d us each\n", how, ROUNDS, ms, ms * 1000 / ROUNDS);
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    char * child_argv[4];
+    char line[MAX_PATH + 8];
+    int i, fd, ret;
+
+    if (argc > 1 && !strcmp(argv[1], "-x")) {
+        return 0;
+    }
+    if (strlen(argv[0]) > MAX_PATH) {
+        printf("path of the program too long\n");
+        return 1;
+    }
+    for (i = 0; i < ARG_LEN; i++) {
+        long_arg[i] = 'a' + i % 26;
+    }
+    /* the script: "#!<argv[0]> -x" */
+    strcpy("#!", line);
+    strcpy(argv[0], line + 2);
+    strcpy(" -x\n", line + strlen(line));
+    if ((fd = open(SCRIPT, O_WRONLY | O_CREAT | O_TRUNC, 0755)) < 0) {
+        printf("cannot create %s (%d)\n", SCRIPT, fd);
+        return 1;
+    }
+    write(fd, line, strlen(line));
+    close(fd);
+
+    child_argv[0] = argv[0];
+    child_argv[1] = "-x";
+    child_argv[2] = long_arg;
+    child_argv[3] = NULL;
+    ret = bench("fork+exit   ", NULL, NULL) || bench("fork+exec   ", argv[0], child_argv);
+    if (!ret) {
+        child_argv[0] = SCRIPT;
+        child_argv[1] = long_arg;
+        child_argv[2] = NULL;
+        ret = bench("fork+exec #!", SCRIPT, child_argv);
+    }
+    unlink(SCRIPT);
+    return ret ? 1 : 0;
+}
@@ -0,0 +1,62 @@
+#include "minicrt.h"
+
+/*
+ * fd_load [floppy [dir]]: how long it takes to load a floppy image.
+ * Mounts the disk (default /dev/fd1, e.g. a minix image given to QEMU
+ * with -fdb) on dir (default /mnt) and unmounts it again, then reads the
+ * whole disk block by block in 1 KB reads, the same pattern rd_load()
+ * uses for the root image. Whole-track reads into the track cache
+ * should bring the sequential read close to one rotation per track.
+ * Run it right after inserting the disk, so that neither the buffer
+ * cache nor the track cache already holds its blocks. rd_load() itself
+ * prints its load time at boot.
+ */
+
+#define MAX_KB      2880
+
+static char buf[1024];
+
+static int elapsed_ms(struct timeval * t0, struct timeval * t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1000 + (t1->tv_usec - t0->tv_usec) / 1000;
+}
+
+int main(int argc, char * argv[]) {
+    struct timeval t0, t1;
+    char * dev = "/dev/fd1";
+    char * dir = "/mnt";
+    int fd, kb = 0, ret, ms;
+
+    if (argc > 1) {
+        dev = argv[1];
+    }
+    if (argc > 2) {
+        dir = argv[2];
+    }
+    /* mount first: it reads the super block and bitmaps while the disk is still cold */
+    gettimeofday(&t0, NULL);
+    if ((ret = mount(dev, dir, 0)) < 0) {
+        printf("mount %s on %s failed (%d)\n", dev, dir, ret);
+        return 1;
+    }
+    gettimeofday(&t1, NULL);
+    printf("mount %s: %d ms\n", dev, elapsed_ms(&t0, &t1));
+    if ((ret = umount(dev)) < 0) {
+        printf("umount %s failed (%d)\n", dev, ret);
+        return 1;
+    }
+    if ((fd = open(dev, O_RDONLY, 0)) < 0) {
+        printf("open %s failed (%d)\n", dev, fd);
+        return 1;
+    }
+    gettimeofday(&t0, NULL);
+    while (kb < MAX_KB && read(fd, buf, sizeof(buf)) == sizeof(buf)) {
+        kb++;
+    }
+    gettimeofday(&t1, NULL);
+    close(fd);
+    if (!(ms = elapsed_ms(&t0, &t1))) {
+        ms = 1;
+    }
+    printf("read %s: %d KB in %d ms, %d KB/s\n", dev, kb, ms, kb * 1000 / ms);
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "minicrt.h"
+
+/*
+ * hd_read [blkdev]: sequential read throughput of a hard disk through
+ * the block device file (default /dev/hd0, the whole first disk; it is
+ * only read), and the CPU time the transfer costs. TOTAL_KB is larger
+ * than the buffer cache, so nearly every block comes from the disk.
+ * Reads of CHUNK bytes give the driver runs of consecutive blocks that
+ * it can move with READ MULTIPLE or bus-master DMA; the run is repeated
+ * with 1 KB reads for comparison.
+ *
+ * times() only charges the reader for what happens while it is the
+ * current task, but the PIO copy runs in the disk interrupt, mostly
+ * while the reader sleeps. So a child spins in a loop during each run,
+ * and its loop rate is compared with the rate it gets on an idle
+ * system: the share it loses is the CPU the disk path takes.
+ */
+
+#define TOTAL_KB    16384
+#define CHUNK       16384
+#define SPIN        65536
+
+static char buf[CHUNK];
+static int chunks[] = { CHUNK, 1024 };
+static int idle_rate;       /* spinner loops per second on an idle system */
+
+static int elapsed_ms(struct timeval * t0, struct timeval * t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1000 + (t1->tv_usec - t0->tv_usec) / 1000;
+}
+
+/* spin until a byte arrives on ctl (non-blocking), then send loops per second on res */
+static void spinner(int ctl, int res) {
+    struct timeval t0, t1;
+    volatile int spin;
+    int i, loops = 0, ms;
+    char c;
+
+    gettimeofday(&t0, NULL);
+    do {
+        for (i = 0; i < SPIN; i++) {
+            spin = i;
+        }
+        loops++;
+    } while (read(ctl, &c, 1) != 1);
+    gettimeofday(&t1, NULL);
+    if (!(ms = elapsed_ms(&t0, &t1))) {
+        ms = 1;
+    }
+    loops = loops * 1000 / ms;
+    write(res, &loops, sizeof(loops));
+    exit(0);
+}
+
+/* start a spinner; p[0..1] is its control pipe, p[2..3] its result pipe */
+static int start_spinner(int * p) {
+    int pid;
+
+    if (pipe(p) < 0 || pipe(p + 2) < 0) {
+        return -1;
+    }
+    fcntl(p[0], F_SETFL, O_NONBLOCK);
+    if (!(pid = fork())) {
+        spinner(p[0], p[3]);
+    }
+    return pid;
+}
+
+/* stop the spinner and return its loops per second */
+static int stop_spinner(int * p, int pid) {
+    int status, rate = 0;
+
+    write(p[1], "x", 1);
+    read(p[2], &rate, sizeof(rate));
+    waitpid(pid, &status, 0);
+    close(p[0]);
+    close(p[1]);
+    close(p[2]);
+    close(p[3]);
+    return rate;
+}
+
+static int bench(const char * dev, int chunk) {
+    struct timeval t0, t1;
+    struct tms tm0, tm1;
+    int p[4], fd, pid, n, ret, ms, rate;
+
+    if ((fd = open(dev, O_RDONLY, 0)) < 0) {
+        printf("open %s failed (%d)\n", dev, fd);
+        return -1;
+    }
+    if ((pid = start_spinner(p)) < 0) {
+        printf("cannot start the spinner\n");
+        close(fd);
+        return -1;
+    }
+    times(&tm0);
+    gettimeofday(&t0, NULL);
+    for (n = 0; n < TOTAL_KB * 1024; n += chunk) {
+        if ((ret = read(fd, buf, chunk)) != chunk) {
+            printf("read failed at %d (%d)\n", n, ret);
+            break;
+        }
+    }
+    gettimeofday(&t1, NULL);
+    times(&tm1);
+    rate = stop_spinner(p, pid);
+    close(fd);
+    if (n < TOTAL_KB * 1024) {
+        return -1;
+    }
+    if (!(ms = elapsed_ms(&t0, &t1))) {
+        ms = 1;
+    }
+    printf("%s, %d-byte reads: %d KB in %d ms, %d KB/s\n", dev, chunk, TOTAL_KB, ms, TOTAL_KB * 1000 / ms);
+    printf("    reader CPU: user %d ms, system %d ms; CPU left to a spinning process: %d%%\n",
+        (tm1.tms_utime - tm0.tms_utime) * 1000 / HZ, (tm1.tms_stime - tm0.tms_stime) * 1000 / HZ,
+        idle_rate ? rate * 100 / idle_rate : 0);
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    struct timeval tv;
+    char * dev = "/dev/hd0";
+    int p[4], i, pid;
+
+    if (argc > 1) {
+        dev = argv[1];
+    }
+    /* calibrate: let the spinner run alone for 2 seconds while we sleep in select() */
+    if ((pid = start_spinner(p)) < 0) {
+        printf("cannot start the spinner\n");
+        return 1;
+    }
+    tv.tv_sec = 2;
+    tv.tv_usec = 0;
+    select(0, NULL, NULL, NULL, &tv);
+    idle_rate = stop_spinner(p, pid);
+    for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        if (bench(dev, chunks[i]) < 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
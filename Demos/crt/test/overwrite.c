@@ -0,0 +1,74 @@
+#include "minicrt.h"
+
+/*
+ * overwrite [file]: throughput of overwriting a large existing file
+ * (default overwrite.dat in the current directory). The file is first
+ * written out and synced, then rewritten in place with several chunk
+ * sizes. Chunks that are a multiple of the 1 KB block size cover whole
+ * blocks, so file_write() fills them with getblk() and never reads the
+ * old data; 512-byte chunks only cover half a block each and still have
+ * to read the block first. FILE_KB is larger than the buffer cache, so
+ * most of those reads go to the disk. Each pass includes its sync().
+ */
+
+#define FILE_KB     8192
+#define MAX_CHUNK   16384
+
+static char buf[MAX_CHUNK];
+static int chunks[] = { 512, 1024, 4096, MAX_CHUNK };
+
+static int elapsed_ms(struct timeval * t0, struct timeval * t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1000 + (t1->tv_usec - t0->tv_usec) / 1000;
+}
+
+/* write FILE_KB into fd from offset 0 in pieces of chunk bytes; returns ms or -1 */
+static int fill(int fd, int chunk) {
+    struct timeval t0, t1;
+    int n, ret;
+
+    gettimeofday(&t0, NULL);
+    seek(fd, 0, 0);
+    for (n = 0; n < FILE_KB * 1024; n += chunk) {
+        if ((ret = write(fd, buf, chunk)) != chunk) {
+            printf("write failed at %d (%d)\n", n, ret);
+            return -1;
+        }
+    }
+    sync();
+    gettimeofday(&t1, NULL);
+    return elapsed_ms(&t0, &t1);
+}
+
+int main(int argc, char * argv[]) {
+    char * path = "overwrite.dat";
+    int i, fd, ms;
+
+    if (argc > 1) {
+        path = argv[1];
+    }
+    for (i = 0; i < sizeof(buf); i++) {
+        buf[i] = i;
+    }
+    if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+        printf("open %s failed (%d)\n", path, fd);
+        return 1;
+    }
+    if ((ms = fill(fd, MAX_CHUNK)) < 0) {
+        close(fd);
+        return 1;
+    }
+    printf("create    %d KB: %d ms\n", FILE_KB, ms);
+    for (i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        if ((ms = fill(fd, chunks[i])) < 0) {
+            close(fd);
+            return 1;
+        }
+        if (!ms) {
+            ms = 1;
+        }
+        printf("overwrite %d KB in %d-byte writes: %d ms, %d KB/s\n", FILE_KB, chunks[i], ms, FILE_KB * 1000 / ms);
+    }
+    close(fd);
+    unlink(path);
+    return 0;
+}
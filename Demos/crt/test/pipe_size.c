@@ -0,0 +1,86 @@
+#include "minicrt.h"
+
+/*
+ * pipe_size: throughput of a two-process pipeline (writer | reader)
+ * with the default one-page pipe and with the pipe resized to 64 KB by
+ * fcntl(F_SETPIPE_SZ). Both sides move CHUNK bytes per call, like cat.
+ * With a 4 KB buffer the writer blocks after every chunk and the two
+ * processes switch once per chunk; with 64 KB the writer gets many
+ * chunks ahead before it has to wait.
+ */
+
+#define TOTAL_KB    16384
+#define CHUNK       4096
+
+static char buf[CHUNK];
+static int sizes[] = { 4096, 65536 };
+
+static int elapsed_ms(struct timeval * t0, struct timeval * t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1000 + (t1->tv_usec - t0->tv_usec) / 1000;
+}
+
+static void reader(int fd) {
+    int n, total = 0;
+
+    while ((n = read(fd, buf, CHUNK)) > 0) {
+        total += n;
+    }
+    exit(total == TOTAL_KB * 1024 ? 0 : 1);
+}
+
+static int bench(int size) {
+    struct timeval t0, t1;
+    int p[2], pid, status, n, ret, ms;
+
+    if ((ret = pipe(p)) < 0) {
+        printf("pipe failed (%d)\n", ret);
+        return -1;
+    }
+    if ((ret = fcntl(p[1], F_SETPIPE_SZ, size)) < 0) {
+        printf("F_SETPIPE_SZ %d failed (%d)\n", size, ret);
+        close(p[0]);
+        close(p[1]);
+        return -1;
+    }
+    size = fcntl(p[1], F_GETPIPE_SZ, 0);
+    gettimeofday(&t0, NULL);
+    if (!(pid = fork())) {
+        close(p[1]);
+        reader(p[0]);
+    }
+    close(p[0]);
+    if (pid < 0) {
+        printf("fork failed (%d)\n", pid);
+        close(p[1]);
+        return -1;
+    }
+    for (n = 0; n < TOTAL_KB * 1024; n += CHUNK) {
+        if ((ret = write(p[1], buf, CHUNK)) != CHUNK) {
+            printf("write failed at %d (%d)\n", n, ret);
+            break;
+        }
+    }
+    close(p[1]);
+    waitpid(pid, &status, 0);
+    gettimeofday(&t1, NULL);
+    if (n < TOTAL_KB * 1024 || status) {
+        printf("%d-byte pipe: transfer incomplete\n", size);
+        return -1;
+    }
+    if (!(ms = elapsed_ms(&t0, &t1))) {
+        ms = 1;
+    }
+    printf("%d-byte pipe: %d KB in %d ms, %d KB/s\n", size, TOTAL_KB, ms, TOTAL_KB * 1000 / ms);
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    int i;
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (bench(sizes[i]) < 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "minicrt.h"
+
+/*
+ * pty_speed: throughput through the first pseudo terminal pair. The
+ * parent writes TOTAL_KB into the master side and a child reads it from
+ * the slave side, once with the slave in raw mode, where copy_to_cooked()
+ * moves whole runs from read_q to secondary, and once in canonical mode
+ * without echo, where every character goes through the line discipline.
+ * The device nodes (major 4, minors 128 and 192) are made in the current
+ * directory and removed afterwards, since a root image need not have them.
+ */
+
+#define TOTAL_KB    1024
+#define CHUNK       1024
+#define PTY_MASTER  "ptym0"
+#define PTY_SLAVE   "ptys0"
+
+static char buf[CHUNK];
+
+static int elapsed_ms(struct timeval * t0, struct timeval * t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1000 + (t1->tv_usec - t0->tv_usec) / 1000;
+}
+
+static void reader(int fd) {
+    int n, total = 0;
+
+    while (total < TOTAL_KB * 1024 && (n = read(fd, buf, CHUNK)) > 0) {
+        total += n;
+    }
+    exit(total == TOTAL_KB * 1024 ? 0 : 1);
+}
+
+static int bench(const char * how, int master, int slave) {
+    struct timeval t0, t1;
+    int pid, status, n, ret, ms;
+
+    gettimeofday(&t0, NULL);
+    if (!(pid = fork())) {
+        close(master);
+        reader(slave);
+    }
+    if (pid < 0) {
+        printf("fork failed (%d)\n", pid);
+        return -1;
+    }
+    for (n = 0; n < TOTAL_KB * 1024; n += CHUNK) {
+        if ((ret = write(master, buf, CHUNK)) != CHUNK) {
+            printf("%s: write failed at %d (%d)\n", how, n, ret);
+            break;
+        }
+    }
+    waitpid(pid, &status, 0);
+    gettimeofday(&t1, NULL);
+    if (n < TOTAL_KB * 1024 || status) {
+        printf("%s: transfer incomplete\n", how);
+        return -1;
+    }
+    if (!(ms = elapsed_ms(&t0, &t1))) {
+        ms = 1;
+    }
+    printf("%s: %d KB in %d ms, %d KB/s\n", how, TOTAL_KB, ms, TOTAL_KB * 1000 / ms);
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    struct termios tio;
+    int i, master = -1, slave = -1, ret = 1;
+
+    /* 63 letters and a newline per line, so canonical mode sees whole lines */
+    for (i = 0; i < CHUNK; i++) {
+        buf[i] = (i % 64 == 63) ? '\n' : 'a' + i % 26;
+    }
+    mknod(PTY_MASTER, S_IFCHR | 0600, (4 << 8) | 128);
+    mknod(PTY_SLAVE, S_IFCHR | 0600, (4 << 8) | 192);
+    if ((master = open(PTY_MASTER, O_RDWR, 0)) < 0 || (slave = open(PTY_SLAVE, O_RDWR, 0)) < 0) {
+        printf("cannot open the pty pair (%d, %d)\n", master, slave);
+        goto out;
+    }
+    ioctl(slave, TCGETS, &tio);
+    tio.c_iflag &= ~(ICRNL | INLCR | IGNCR | IUCLC | IXON);
+    tio.c_oflag &= ~OPOST;
+    tio.c_lflag &= ~(ICANON | ISIG | ECHO);
+    ioctl(slave, TCSETS, &tio);
+    if (bench("raw", master, slave) < 0) {
+        goto out;
+    }
+    tio.c_lflag |= ICANON;
+    ioctl(slave, TCSETS, &tio);
+    if (bench("canonical", master, slave) < 0) {
+        goto out;
+    }
+    ret = 0;
+out:
+    if (master >= 0) {
+        close(master);
+    }
+    if (slave >= 0) {
+        close(slave);
+    }
+    unlink(PTY_MASTER);
+    unlink(PTY_SLAVE);
+    return ret;
+}
@@ -0,0 +1,115 @@
+#include "minicrt.h"
+
+/*
+ * ram_resize: exercise a runtime-sized ram disk. Uses ram disk 2
+ * (major 1, minor 2; minor 1 may hold the root file system) through a
+ * node made in the current directory:
+ *   - grow it to BIG_KB with RDSETSIZE and check RDGETSIZE,
+ *   - fill it through the block device and read everything back,
+ *   - shrink it to SMALL_KB: the first SMALL_KB must survive, and a
+ *     read past the new end must fail,
+ *   - grow it again: the re-added part must read back as zeros, since
+ *     its pages were freed by the shrink,
+ *   - set the size to 0, which frees all of its memory.
+ * Must be run as root.
+ */
+
+#define RAM_NODE    "ram2"
+#define BIG_KB      1024
+#define SMALL_KB    256
+
+static char buf[1024];
+
+/* expected byte at offset pos of block blk; never 0 so that zeros stand out */
+#define PATTERN(blk, pos)   ((char) (((blk) * 7 + (pos)) % 255 + 1))
+
+static int set_size(int fd, int kb) {
+    long size = -1;
+    int ret;
+
+    if ((ret = ioctl(fd, RDSETSIZE, (void *) kb)) < 0) {
+        printf("RDSETSIZE %d failed (%d)\n", kb, ret);
+        return -1;
+    }
+    if ((ret = ioctl(fd, RDGETSIZE, &size)) < 0 || size != kb) {
+        printf("RDGETSIZE returned %d (%d), expected %d\n", size, ret, kb);
+        return -1;
+    }
+    return 0;
+}
+
+/* check blocks from..to-1; zero != 0 means they must be all zeros */
+static int check(int fd, int from, int to, int zero) {
+    int blk, i;
+
+    seek(fd, from * 1024, 0);
+    for (blk = from; blk < to; blk++) {
+        if (read(fd, buf, sizeof(buf)) != sizeof(buf)) {
+            printf("read of block %d failed\n", blk);
+            return -1;
+        }
+        for (i = 0; i < sizeof(buf); i++) {
+            if (buf[i] != (zero ? 0 : PATTERN(blk, i))) {
+                printf("block %d byte %d: wrong data\n", blk, i);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int run(int fd) {
+    int blk, i;
+
+    if (set_size(fd, BIG_KB) < 0) {
+        return -1;
+    }
+    seek(fd, 0, 0);
+    for (blk = 0; blk < BIG_KB; blk++) {
+        for (i = 0; i < sizeof(buf); i++) {
+            buf[i] = PATTERN(blk, i);
+        }
+        if (write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+            printf("write of block %d failed\n", blk);
+            return -1;
+        }
+    }
+    if (check(fd, 0, BIG_KB, 0) < 0) {
+        return -1;
+    }
+    printf("grown to %d KB, written and read back\n", BIG_KB);
+
+    if (set_size(fd, SMALL_KB) < 0 || check(fd, 0, SMALL_KB, 0) < 0) {
+        return -1;
+    }
+    seek(fd, SMALL_KB * 1024, 0);
+    if (read(fd, buf, sizeof(buf)) >= 0) {
+        printf("read past the end of a %d KB ram disk succeeded\n", SMALL_KB);
+        return -1;
+    }
+    printf("shrunk to %d KB, contents kept, end enforced\n", SMALL_KB);
+
+    if (set_size(fd, BIG_KB) < 0 || check(fd, 0, SMALL_KB, 0) < 0 || check(fd, SMALL_KB, BIG_KB, 1) < 0) {
+        return -1;
+    }
+    printf("grown to %d KB again, new part reads as zeros\n", BIG_KB);
+    return set_size(fd, 0);
+}
+
+int main(int argc, char * argv[]) {
+    int fd, ret;
+
+    mknod(RAM_NODE, S_IFBLK | 0600, (1 << 8) | 2);
+    if ((fd = open(RAM_NODE, O_RDWR, 0)) < 0) {
+        printf("open %s failed (%d)\n", RAM_NODE, fd);
+        unlink(RAM_NODE);
+        return 1;
+    }
+    ret = run(fd);
+    close(fd);
+    unlink(RAM_NODE);
+    if (!ret) {
+        printf("ram disk resize: ok\n");
+    }
+    return ret ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+#include "minicrt.h"
+
+/*
+ * rwpaths [blkdev]: read()/write() throughput for each data path that
+ * copies between user space and the kernel: a pipe, a regular file, a
+ * block device (default /dev/hd1, only read) and the terminal.
+ * The file and block device are read back while their blocks are in
+ * the buffer cache, so those figures measure the copy, not the disk.
+ * The terminal figure is bounded by the console and includes scrolling.
+ */
+
+#define CHUNK       4096
+#define PIPE_CHUNK  2048        /* fits a one-page pipe in a single process */
+#define DATA_KB     1024
+#define REPEAT      8
+#define TTY_KB      32
+
+static char buf[CHUNK];
+
+static int elapsed_ms(struct timeval * t0, struct timeval * t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1000 + (t1->tv_usec - t0->tv_usec) / 1000;
+}
+
+static void report(const char * what, int kb, struct timeval * t0, struct timeval * t1) {
+    int ms = elapsed_ms(t0, t1);
+
+    if (!ms) {
+        ms = 1;
+    }
+    printf("%s: %d KB in %d ms, %d KB/s\n", what, kb, ms, kb * 1000 / ms);
+}
+
+static int bench_pipe(void) {
+    struct timeval t0, t1;
+    int p[2], n, ret;
+
+    if ((ret = pipe(p)) < 0) {
+        printf("pipe failed (%d)\n", ret);
+        return -1;
+    }
+    gettimeofday(&t0, NULL);
+    for (n = 0; n < DATA_KB * REPEAT * 1024; n += PIPE_CHUNK) {
+        if (write(p[1], buf, PIPE_CHUNK) != PIPE_CHUNK || read(p[0], buf, PIPE_CHUNK) != PIPE_CHUNK) {
+            printf("pipe transfer failed at %d\n", n);
+            close(p[0]);
+            close(p[1]);
+            return -1;
+        }
+    }
+    gettimeofday(&t1, NULL);
+    close(p[0]);
+    close(p[1]);
+    report("pipe write+read", DATA_KB * REPEAT, &t0, &t1);
+    return 0;
+}
+
+/* read DATA_KB from the start of fd REPEAT times */
+static int read_back(int fd, const char * what) {
+    struct timeval t0, t1;
+    int i, n, ret;
+
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < REPEAT; i++) {
+        seek(fd, 0, 0);
+        for (n = 0; n < DATA_KB * 1024; n += CHUNK) {
+            if ((ret = read(fd, buf, CHUNK)) != CHUNK) {
+                printf("%s: read failed at %d (%d)\n", what, n, ret);
+                return -1;
+            }
+        }
+    }
+    gettimeofday(&t1, NULL);
+    report(what, DATA_KB * REPEAT, &t0, &t1);
+    return 0;
+}
+
+static int bench_file(void) {
+    struct timeval t0, t1;
+    char * path = "rwpaths.dat";
+    int i, n, fd, ret;
+
+    if ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+        printf("open %s failed (%d)\n", path, fd);
+        return -1;
+    }
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < REPEAT; i++) {
+        seek(fd, 0, 0);
+        for (n = 0; n < DATA_KB * 1024; n += CHUNK) {
+            if ((ret = write(fd, buf, CHUNK)) != CHUNK) {
+                printf("file: write failed at %d (%d)\n", n, ret);
+                close(fd);
+                unlink(path);
+                return -1;
+            }
+        }
+    }
+    gettimeofday(&t1, NULL);
+    report("file write (cached)", DATA_KB * REPEAT, &t0, &t1);
+    ret = read_back(fd, "file read (cached)");
+    close(fd);
+    unlink(path);
+    return ret;
+}
+
+static int bench_blkdev(const char * dev) {
+    int fd, ret;
+
+    if ((fd = open(dev, O_RDONLY, 0)) < 0) {
+        printf("open %s failed (%d)\n", dev, fd);
+        return -1;
+    }
+    /* the first pass pulls the blocks into the buffer cache */
+    if ((ret = read_back(fd, "block device read (first pass from disk)")) == 0) {
+        ret = read_back(fd, "block device read (cached)");
+    }
+    close(fd);
+    return ret;
+}
+
+static int bench_tty(void) {
+    struct timeval t0, t1;
+    int i, n, fd;
+
+    if ((fd = open("/dev/tty", O_WRONLY, 0)) < 0) {
+        printf("open /dev/tty failed (%d)\n", fd);
+        return -1;
+    }
+    for (i = 0; i < CHUNK; i++) {
+        buf[i] = (i % 64 == 63) ? '\n' : 'a' + i % 26;
+    }
+    gettimeofday(&t0, NULL);
+    for (n = 0; n < TTY_KB * 1024; n += CHUNK) {
+        write(fd, buf, CHUNK);
+    }
+    gettimeofday(&t1, NULL);
+    close(fd);
+    report("tty write", TTY_KB, &t0, &t1);
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    char * dev = "/dev/hd1";
+    int i, ret = 0;
+
+    if (argc > 1) {
+        dev = argv[1];
+    }
+    for (i = 0; i < CHUNK; i++) {
+        buf[i] = i;
+    }
+    ret |= bench_pipe();
+    ret |= bench_file();
+    ret |= bench_blkdev(dev);
+    ret |= bench_tty();
+    return ret ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+#include "minicrt.h"
+
+/*
+ * serial_loop: send TOTAL_KB from COM1 to COM2 at 38400 bps and check
+ * what arrives. The two ports have to be wired to each other; under
+ * QEMU, `make serial-loop` in the top directory starts the system with
+ * COM1 and COM2 joined by a pair of UDP sockets. The device nodes
+ * (major 4, minors 64 and 65) are made in the current directory and
+ * removed afterwards.
+ *
+ * Both ports are put in raw mode, 8N1, without modem control. The reader
+ * gives up after 2 seconds without data, so lost characters show up as a
+ * short count instead of a hang. At 38400 bps one character takes 10
+ * bits, so the line limit is 3840 bytes/s.
+ */
+
+#define TOTAL_KB    32
+#define CHUNK       1024
+#define COM1        "ttyS0"
+#define COM2        "ttyS1"
+
+static char buf[CHUNK];
+
+static int elapsed_ms(struct timeval * t0, struct timeval * t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1000 + (t1->tv_usec - t0->tv_usec) / 1000;
+}
+
+static void set_raw(int fd) {
+    struct termios tio;
+
+    ioctl(fd, TCGETS, &tio);
+    tio.c_iflag = 0;
+    tio.c_oflag &= ~OPOST;
+    tio.c_lflag &= ~(ICANON | ISIG | ECHO);
+    tio.c_cflag = B38400 | CS8 | CREAD | CLOCAL;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 20;
+    ioctl(fd, TCSETS, &tio);
+}
+
+/* count the bytes that arrive and how many differ from what was sent */
+static void reader(int fd) {
+    int i, n, total = 0, bad = 0;
+
+    while (total < TOTAL_KB * 1024 && (n = read(fd, buf, CHUNK)) > 0) {
+        for (i = 0; i < n; i++) {
+            if ((unsigned char) buf[i] != (total + i) % 251) {
+                bad++;
+            }
+        }
+        total += n;
+    }
+    printf("received %d of %d bytes, %d wrong\n", total, TOTAL_KB * 1024, bad);
+    exit(total == TOTAL_KB * 1024 && !bad ? 0 : 1);
+}
+
+int main(int argc, char * argv[]) {
+    struct timeval t0, t1;
+    int tx = -1, rx = -1, pid, status, i, n, ms, ret = 1;
+
+    mknod(COM1, S_IFCHR | 0600, (4 << 8) | 64);
+    mknod(COM2, S_IFCHR | 0600, (4 << 8) | 65);
+    if ((tx = open(COM1, O_RDWR, 0)) < 0 || (rx = open(COM2, O_RDWR, 0)) < 0) {
+        printf("cannot open the serial ports (%d, %d)\n", tx, rx);
+        goto out;
+    }
+    set_raw(tx);
+    set_raw(rx);
+    gettimeofday(&t0, NULL);
+    if (!(pid = fork())) {
+        reader(rx);
+    }
+    if (pid < 0) {
+        printf("fork failed (%d)\n", pid);
+        goto out;
+    }
+    for (n = 0; n < TOTAL_KB * 1024; n += CHUNK) {
+        for (i = 0; i < CHUNK; i++) {
+            buf[i] = (n + i) % 251;
+        }
+        write(tx, buf, CHUNK);
+    }
+    waitpid(pid, &status, 0);
+    gettimeofday(&t1, NULL);
+    if (!(ms = elapsed_ms(&t0, &t1))) {
+        ms = 1;
+    }
+    printf("%d KB in %d ms, %d bytes/s (line limit 3840)\n", TOTAL_KB, ms, TOTAL_KB * 1024 * 1000 / ms);
+    ret = status ? 1 : 0;
+out:
+    if (tx >= 0) {
+        close(tx);
+    }
+    if (rx >= 0) {
+        close(rx);
+    }
+    unlink(COM1);
+    unlink(COM2);
+    return ret;
+}
@@ -0,0 +1,123 @@
+#include "minicrt.h"
+
+/*
+ * splice_copy: copy a file to another file through a pipe, once with
+ * read()/write() and once with splice(), and compare the time. The
+ * read()/write() copy moves every byte through user space twice, while
+ * splice() moves it between buffer-cache blocks and pipe pages inside
+ * the kernel. The source is written just before, so it is in the buffer
+ * cache and both copies measure the copying rather than the disk.
+ */
+
+#define FILE_KB     2048
+#define CHUNK       16384
+#define PIPE_SIZE   65536
+
+static char buf[CHUNK];
+static char cmp[CHUNK];
+
+static int elapsed_ms(struct timeval * t0, struct timeval * t1) {
+    return (t1->tv_sec - t0->tv_sec) * 1000 + (t1->tv_usec - t0->tv_usec) / 1000;
+}
+
+/* src -> pipe -> dst through a user buffer; returns bytes copied */
+static int copy_rw(int src, int * p, int dst) {
+    int n, total = 0;
+
+    while ((n = read(src, buf, CHUNK)) > 0) {
+        if (write(p[1], buf, n) != n || read(p[0], buf, n) != n || write(dst, buf, n) != n) {
+            return -1;
+        }
+        total += n;
+    }
+    return n < 0 ? n : total;
+}
+
+/* src -> pipe -> dst inside the kernel; returns bytes copied */
+static int copy_splice(int src, int * p, int dst) {
+    int n, m, total = 0;
+
+    while ((n = splice(src, p[1], CHUNK)) > 0) {
+        while (n > 0) {
+            if ((m = splice(p[0], dst, n)) <= 0) {
+                return -1;
+            }
+            n -= m;
+            total += m;
+        }
+    }
+    return n < 0 ? n : total;
+}
+
+/* check that dst holds the same bytes as src */
+static int same(int src, int dst) {
+    int i, n;
+
+    seek(src, 0, 0);
+    seek(dst, 0, 0);
+    while ((n = read(src, buf, CHUNK)) > 0) {
+        if (read(dst, cmp, n) != n) {
+            return 0;
+        }
+        for (i = 0; i < n; i++) {
+            if (buf[i] != cmp[i]) {
+                return 0;
+            }
+        }
+    }
+    return read(dst, cmp, 1) == 0;
+}
+
+static int bench(const char * how, int (* copy)(int, int *, int), int src, int * p) {
+    struct timeval t0, t1;
+    int dst, ret, ms;
+
+    if ((dst = open("splice.dst", O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+        printf("open splice.dst failed (%d)\n", dst);
+        return -1;
+    }
+    seek(src, 0, 0);
+    gettimeofday(&t0, NULL);
+    ret = copy(src, p, dst);
+    gettimeofday(&t1, NULL);
+    if (ret != FILE_KB * 1024 || !same(src, dst)) {
+        printf("%s: copy failed (%d)\n", how, ret);
+        close(dst);
+        return -1;
+    }
+    close(dst);
+    if (!(ms = elapsed_ms(&t0, &t1))) {
+        ms = 1;
+    }
+    printf("%s: %d KB in %d ms, %d KB/s\n", how, FILE_KB, ms, FILE_KB * 1000 / ms);
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    int p[2], src, i, ret = 1;
+
+    for (i = 0; i < CHUNK; i++) {
+        buf[i] = i * 7;
+    }
+    if ((src = open("splice.src", O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+        printf("open splice.src failed (%d)\n", src);
+        return 1;
+    }
+    for (i = 0; i < FILE_KB * 1024 / CHUNK; i++) {
+        buf[0] = i;
+        write(src, buf, CHUNK);
+    }
+    if (pipe(p) < 0 || fcntl(p[1], F_SETPIPE_SZ, PIPE_SIZE) < 0) {
+        printf("cannot set up a %d-byte pipe\n", PIPE_SIZE);
+    } else {
+        if (!bench("read/write", copy_rw, src, p) && !bench("splice", copy_splice, src, p)) {
+            ret = 0;
+        }
+        close(p[0]);
+        close(p[1]);
+    }
+    close(src);
+    unlink("splice.src");
+    unlink("splice.dst");
+    return ret;
+}
@@ -0,0 +1,54 @@
+#include "minicrt.h"
+
+/*
+ * tmpfs_umount [dir]: mount a tmpfs on dir (default /mnt), fill a file,
+ * and unmount it again, many times over. Every umount must hand the
+ * tmpfs pages back to the kernel; if they leak, a 16 MB machine runs
+ * out of memory long before the last cycle and mount() or write() fails.
+ */
+
+#define CYCLES      100
+#define FILE_SIZE   (512 * 1024)
+
+static char buf[4096];
+
+int main(int argc, char * argv[]) {
+    char * dir = "/mnt";
+    char path[MAX_PATH];
+    int i, n, fd, ret;
+
+    if (argc > 1) {
+        dir = argv[1];
+    }
+    strcpy(dir, path);
+    strcpy("/data", path + strlen(path));
+    for (i = 0; i < sizeof(buf); i++) {
+        buf[i] = i;
+    }
+    for (i = 0; i < CYCLES; i++) {
+        if ((ret = mount("tmpfs", dir, 0)) < 0) {
+            printf("cycle %d: mount failed (%d)\n", i, ret);
+            return 1;
+        }
+        if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+            printf("cycle %d: open failed (%d)\n", i, fd);
+            umount(dir);
+            return 1;
+        }
+        for (n = 0; n < FILE_SIZE; n += sizeof(buf)) {
+            if ((ret = write(fd, buf, sizeof(buf))) != sizeof(buf)) {
+                printf("cycle %d: write failed at %d (%d)\n", i, n, ret);
+                close(fd);
+                umount(dir);
+                return 1;
+            }
+        }
+        close(fd);
+        if ((ret = umount(dir)) < 0) {
+            printf("cycle %d: umount failed (%d)\n", i, ret);
+            return 1;
+        }
+    }
+    printf("%d mount/write/umount cycles of %d KB: ok\n", CYCLES, FILE_SIZE / 1024);
+    return 0;
+}
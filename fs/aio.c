@@ -0,0 +1,317 @@
+/*
+ *  linux/fs/aio.c
+ */
+
+/*
+ * aio.c implements asynchronous reads and writes of regular files. A
+ * batch of requests is submitted to the block devices without waiting,
+ * and the completions are collected later.
+ */
+/*
+ * 普通文件的异步 I/O.
+ *
+ * read()/write() 对每个不在高速缓冲中的数据块都要在 bread() 中睡眠等待, 一个进程同一时刻只能有一个磁盘请求.
+ * 这里的 aio_submit() 只为一组请求申请缓冲块, 并用 ll_rw_block() 向设备提交读写请求, 不等待它们完成;
+ * aio_getevents() 检查请求涉及的缓冲块是否都已解锁, 对完成的读请求才把数据复制到用户缓冲区.
+ * 需要等待时就在最早提交的请求中第一个仍被锁定的缓冲块的等待队列 b_wait 上睡眠.
+ * 这样单个进程也可以让多个磁盘请求同时在途, 并让电梯算法对它们排序.
+ *
+ * 提交时仍可能短暂睡眠: 映射间接块, 写请求中读入只写一部分的首尾数据块, 以及请求项或缓冲块用完时.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/aio.h>
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <asm/segment.h>
+#include <asm/system.h>
+
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+#define NR_AIO			16				// 系统中同时存在的异步请求数.
+#define AIO_MAX_BLOCKS	16				// 一个请求最多涉及的数据块数, 更长的请求被截短(与 read() 一样返回较少的字节数).
+
+// 异步请求项. task 为 NULL 表示空闲项.
+struct aio_req {
+	struct task_struct * task;			// 提交请求的进程. 只有该进程能取走请求的完成事件.
+	unsigned long seq;					// 提交序号, 等待时先等最早提交的请求.
+	struct m_inode * inode;				// 文件 i 节点(请求持有一个引用, 关闭文件不影响在途请求).
+	int opcode;							// LIO_READ 或 LIO_WRITE.
+	off_t pos;							// 文件中的读写位置.
+	char * buf;							// 用户缓冲区.
+	int count;							// 读写字节数(已截短).
+	unsigned long data;					// 用户数据.
+	int res;							// 提交时已经确定的出错码, 0 表示结果由缓冲块状态决定.
+	int nr;								// 涉及的数据块数.
+	struct buffer_head * bh[AIO_MAX_BLOCKS];	// 各数据块的缓冲块, NULL 表示读文件空洞(读出 0).
+};
+
+static struct aio_req aio_table[NR_AIO];
+static unsigned long aio_seq = 0;
+
+// 判断请求涉及的缓冲块是否都已解锁(即设备读写已经完成).
+static int aio_done(struct aio_req * req) {
+	int i;
+
+	for (i = 0; i < req->nr; i++) {
+		if (req->bh[i] && req->bh[i]->b_lock) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// 释放请求占用的缓冲块和 i 节点, 并释放请求项.
+static void aio_free(struct aio_req * req) {
+	int i;
+
+	for (i = 0; i < req->nr; i++) {
+		brelse(req->bh[i]);
+	}
+	iput(req->inode);
+	req->task = NULL;
+}
+
+// 设置读请求: 把读取范围截短到文件长度以内, 映射数据块, 对没有有效数据且没有正在读写的缓冲块提交读请求.
+static void aio_setup_read(struct aio_req * req) {
+	struct m_inode * inode = req->inode;
+	int zones[AIO_MAX_BLOCKS];
+	struct buffer_head * bh;
+	int i, nr;
+
+	if (req->count > inode->i_size - req->pos) {
+		req->count = inode->i_size - req->pos;
+	}
+	if (req->count <= 0) {
+		req->count = 0;
+		return;
+	}
+	nr = (req->pos % BLOCK_SIZE + req->count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	nr = bmap_blocks(inode, req->pos / BLOCK_SIZE, nr, zones);
+	if (nr * BLOCK_SIZE - req->pos % BLOCK_SIZE < req->count) {		// 只映射了一部分数据块, 则只读这一部分.
+		req->count = nr ? nr * BLOCK_SIZE - req->pos % BLOCK_SIZE : 0;
+	}
+	for (i = 0; i < nr; i++) {
+		bh = NULL;
+		if (zones[i]) {
+			bh = getblk(inode->i_dev, zones[i]);
+			if (!bh->b_uptodate && !bh->b_lock) {
+				ll_rw_block(READ, bh);
+			}
+		}
+		req->bh[req->nr++] = bh;
+	}
+}
+
+// 设置写请求: 映射(必要时创建)数据块, 把用户数据复制到缓冲块中, 然后立即提交写请求.
+// 整块覆盖的数据块不需要先读入; 只写一部分的首尾块要先用 bread() 读入原有数据.
+static void aio_setup_write(struct aio_req * req, struct file * filp) {
+	struct m_inode * inode = req->inode;
+	int zones[AIO_MAX_BLOCKS];
+	struct buffer_head * bh;
+	int i, nr, off, c, left, started;
+	char * buf = req->buf;
+
+	started = journal_start(inode->i_dev);
+	inode->i_exec = 0;								// 清除缓存的执行文件头部(fs/exec.c).
+	if (filp->f_flags & O_APPEND) {
+		req->pos = inode->i_size;
+	}
+	nr = (req->pos % BLOCK_SIZE + req->count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	nr = create_blocks(inode, req->pos / BLOCK_SIZE, nr, zones);
+	if (!nr) {
+		req->res = -ENOSPC;
+		journal_stop(started);
+		return;
+	}
+	off = req->pos % BLOCK_SIZE;
+	left = req->count;
+	for (i = 0; i < nr && left > 0; i++, off = 0) {
+		c = MIN(BLOCK_SIZE - off, left);
+		if (!off && c == BLOCK_SIZE) {
+			bh = getblk(inode->i_dev, zones[i]);
+			bh->b_uptodate = 1;
+		} else if (!(bh = bread(inode->i_dev, zones[i]))) {
+			break;
+		}
+		copy_from_user(bh->b_data + off, buf, c);
+		bh->b_dirt = 1;
+		ll_rw_block(WRITE, bh);
+		req->bh[req->nr++] = bh;
+		buf += c;
+		left -= c;
+	}
+	req->count -= left;
+	if (!req->count) {
+		req->res = -EIO;
+	} else if (req->pos + req->count > inode->i_size) {
+		inode->i_size = req->pos + req->count;
+	}
+	inode->i_mtime = inode->i_ctime = CURRENT_TIME;
+	inode->i_dirt = 1;
+	inode->i_exec = 0;								// 复制用户数据时可能睡眠, 修改完成后再清除一次.
+	journal_stop(started);
+}
+
+// 提交一个异步请求. 参数 cb 是用户空间中的控制块. 成功返回 0, 否则返回出错码.
+static int aio_submit_one(struct aiocb * cb) {
+	struct aio_req * req;
+	struct file * filp;
+	unsigned int fd;
+	int opcode;
+
+	fd = get_fs_long((unsigned long *) &cb->aio_fildes);
+	opcode = get_fs_long((unsigned long *) &cb->aio_lio_opcode);
+	if (fd >= current->max_fds || !(filp = current->filp[fd])) {
+		return -EBADF;
+	}
+	if (!filp->f_inode || !S_ISREG(filp->f_inode->i_mode) || (opcode != LIO_READ && opcode != LIO_WRITE)) {
+		return -EINVAL;
+	}
+	for (req = aio_table; req < aio_table + NR_AIO; req++) {
+		if (!req->task) {
+			break;
+		}
+	}
+	if (req >= aio_table + NR_AIO) {
+		return -EAGAIN;
+	}
+	req->task = current;
+	req->seq = aio_seq++;
+	req->inode = filp->f_inode;
+	req->inode->i_count++;
+	req->opcode = opcode;
+	req->pos = get_fs_long((unsigned long *) &cb->aio_offset);
+	req->buf = (char *) get_fs_long((unsigned long *) &cb->aio_buf);
+	req->count = get_fs_long((unsigned long *) &cb->aio_nbytes);
+	req->data = get_fs_long((unsigned long *) &cb->aio_data);
+	req->res = 0;
+	req->nr = 0;
+	if (req->pos < 0 || req->count < 0) {
+		req->res = -EINVAL;
+		return 0;
+	}
+	if (req->pos % BLOCK_SIZE + req->count > AIO_MAX_BLOCKS * BLOCK_SIZE) {
+		req->count = AIO_MAX_BLOCKS * BLOCK_SIZE - req->pos % BLOCK_SIZE;
+	}
+	if (opcode == LIO_READ) {
+		aio_setup_read(req);
+	} else if (req->count) {
+		aio_setup_write(req, filp);
+	}
+	return 0;
+}
+
+// 完成一个请求: 确定结果, 对读请求把数据复制到用户缓冲区, 把完成事件写到用户空间 ev 处, 最后释放请求项.
+static void aio_complete(struct aio_req * req, struct aio_event * ev) {
+	struct buffer_head * bh;
+	int i, off, c, left, res;
+	char * buf;
+
+	if (!(res = req->res)) {
+		res = req->count;
+		for (i = 0; i < req->nr; i++) {
+			if (req->bh[i] && !req->bh[i]->b_uptodate) {
+				res = -EIO;
+			}
+		}
+	}
+	// 用户缓冲区在取事件时(进程上下文中)才检查写保护. 若在提交时就检查, 提交后进程 fork() 又会使这些页面重新变为
+	// 与子进程共享的写保护页面, 内核态直接写入时不会引起写时复制, 数据会写进子进程的页面.
+	if (res > 0 && req->opcode == LIO_READ) {
+		verify_area(req->buf, req->count);
+		buf = req->buf;
+		left = req->count;
+		off = req->pos % BLOCK_SIZE;
+		for (i = 0; i < req->nr && left > 0; i++, off = 0) {
+			c = MIN(BLOCK_SIZE - off, left);
+			if (bh = req->bh[i]) {
+				copy_to_user(buf, bh->b_data + off, c);
+			} else {
+				clear_user(buf, c);
+			}
+			buf += c;
+			left -= c;
+		}
+		req->inode->i_atime = CURRENT_TIME;
+	}
+	put_fs_long(req->data, &ev->data);
+	put_fs_long(res, (unsigned long *) &ev->res);
+	aio_free(req);
+}
+
+// 提交一组异步 I/O 请求的系统调用. 参数 list 指向用户空间中 nr 个 aiocb 控制块.
+// 返回成功提交的请求数. 若第 1 个请求就无法提交, 则返回其出错码.
+int sys_aio_submit(int nr, struct aiocb * list) {
+	int i, error;
+
+	if (nr <= 0) {
+		return -EINVAL;
+	}
+	for (i = 0; i < nr; i++) {
+		if (error = aio_submit_one(list + i)) {
+			return i ? i : error;
+		}
+	}
+	return nr;
+}
+
+// 取已完成异步请求事件的系统调用. 最多取 nr 个事件存放到用户空间 events 处.
+// 若已完成的请求少于 min_nr 个, 则睡眠等待, 直到取够 min_nr 个, 本进程已没有在途的请求, 或收到信号.
+// 返回取得的事件数. 在没有取得任何事件时收到信号则返回 -EINTR.
+int sys_aio_getevents(int min_nr, int nr, struct aio_event * events) {
+	struct aio_req * req, * oldest;
+	struct buffer_head * bh;
+	int i, got = 0;
+
+	if (nr <= 0 || min_nr < 0 || min_nr > nr) {
+		return -EINVAL;
+	}
+	verify_area(events, nr * sizeof(struct aio_event));
+	while (1) {
+		oldest = NULL;
+		for (req = aio_table; req < aio_table + NR_AIO; req++) {
+			if (req->task != current) {
+				continue;
+			}
+			if (aio_done(req)) {
+				aio_complete(req, events + got);
+				if (++got >= nr) {
+					return got;
+				}
+			} else if (!oldest || req->seq < oldest->seq) {
+				oldest = req;
+			}
+		}
+		if (got >= min_nr || !oldest) {
+			return got;
+		}
+		if (current->signal & ~current->blocked) {
+			return got ? got : -EINTR;
+		}
+		// 在最早请求中第一个仍被锁定的缓冲块上睡眠. 关中断检查 b_lock, 以免在检查之后睡眠之前缓冲块被解锁而丢失唤醒.
+		cli();
+		for (i = 0; i < oldest->nr; i++) {
+			if ((bh = oldest->bh[i]) && bh->b_lock) {
+				interruptible_sleep_on(&bh->b_wait);
+				break;
+			}
+		}
+		sti();
+	}
+}
+
+// 丢弃当前进程的全部异步请求(等待在途的设备读写完成后释放缓冲块). 在进程退出或执行新程序时调用,
+// 因为此后原来的用户缓冲区已不存在.
+void aio_release(void) {
+	struct aio_req * req;
+
+	for (req = aio_table; req < aio_table + NR_AIO; req++) {
+		if (req->task == current) {
+			aio_free(req);
+		}
+	}
+}
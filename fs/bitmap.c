@@ -61,12 +61,37 @@ __asm__("cld\n\t"               		/* 清方向位 */\
 	__res; \
 })
 
+// 丢弃区段 block 在高速缓冲区中的数据块(内部函数).
+// 对该区段中的每个数据块, 从 hash 表中寻找该块数据. 若找到了则判断其有效性, 并清已修改和更新标志, 释放该数据块. 
+// 如果某个数据块还有其他人在使用, 则返回 0, 表示该区段暂时不能释放. 否则返回 1.
+static int forget_zone(struct super_block * sb, int dev, int block) {
+	struct buffer_head * bh;
+	int i;
+
+	for (i = 0; i < (1 << sb->s_log_zone_size); i++) {
+		bh = get_hash_table(dev, (block << sb->s_log_zone_size) + i);
+		if (bh) {
+			if (bh->b_count > 1) {          						// 如果引用次数大于 1, 则调用 brelse(). 
+				brelse(bh);             							// b_count -- 后退出, 该块还有人用. 
+				return 0;
+			}
+			bh->b_dirt = 0;                   						// 否则复位已修改和已更新标志. 
+			bh->b_uptodate = 0;
+			bh->b_meta = 0;
+			bh->b_data = bh->b_buf;									// 直接指向内存中数据块的缓冲块恢复使用自己的数据块, 该块的页面可能被释放.
+			if (bh->b_count) {               						// 若此时 b_count 为 1, 则调用 brelse() 释放之. 
+				brelse(bh);
+			}
+		}
+	}
+	return 1;
+}
+
 // 释放设备 dev 上数据区中的逻辑块 block. 
 // 复位指定逻辑块 block 对应的逻辑块位图位. 成功则返回 1, 否则返回 0.
-// 参数: dev 是设备号, block 是逻辑块号(盘块号). 
+// 参数: dev 是设备号, block 是逻辑块号(区段号). 一个区段含有 2^s_log_zone_size 个数据块.
 int free_block(int dev, int block) {
 	struct super_block * sb;
-	struct buffer_head * bh;
 
 	// 首先取设备 dev 上文件系统的超级块信息, 根据其中数据区开始逻辑块号和文件系统中逻辑块总数信息判断参数 block 的有效性. 
 	// 如果指定设备超级块不存在, 则出错停机. 若逻辑块号小于盘上数据区第 1 个逻辑块号或者大于设备上总逻辑块数, 也出错停机. 
@@ -76,19 +101,14 @@ int free_block(int dev, int block) {
 	if (block < sb->s_firstdatazone || block >= sb->s_nzones) {
 		panic("trying to free block not in datazone");
 	}
-	bh = get_hash_table(dev, block);
-	// 然后从 hash 表中寻找该块数据. 若找到了则判断其有效性, 并清已修改和更新标志, 释放该数据块. 
-	// 该段代码的主要用途是如果该逻辑块目前存在于高速缓冲区中, 就释放对应的缓冲块. 
-	if (bh) {
-		if (bh->b_count > 1) {          							// 如果引用次数大于 1, 则调用 brelse(). 
-			brelse(bh);             								// b_count -- 后退出, 该块还有人用. 
-			return 0;
-		}
-		bh->b_dirt = 0;                   							// 否则复位已修改和已更新标志. 
-		bh->b_uptodate = 0;
-		if (bh->b_count) {               							// 若此时 b_count 为 1, 则调用 brelse() 释放之. 
-			brelse(bh);
-		}
+	// 如果该逻辑块目前存在于高速缓冲区中, 就释放对应的缓冲块. 
+	if (!forget_zone(sb, dev, block)) {
+		return 0;
+	}
+	// tmpfs 没有逻辑块位图, 由其超级块操作函数释放该块.
+	if (sb->s_op) {
+		sb->s_op->free_block(sb, block);
+		return 1;
 	}
 	// 接着我们复位 block 在逻辑块位图中的位(置 0). 先计算 block 在数据区开始算起的数据逻辑块号(从 1 开始计数). 
 	// 然后对逻辑块(区块)位图进行操作, 复位对应的位. 如果对应位原来就是 0, 则出错停机. 由于 1 个缓冲块有 1024 字节, 即 8192 位, 
@@ -103,6 +123,55 @@ int free_block(int dev, int block) {
 	return 1;
 }
 
+// 成批释放设备 dev 上数据区中的逻辑块.
+// 参数: dev 是设备号; zones 是逻辑块号(区段号)数组, 例如 inode 的 i_zone[] 或间接块的内容; nr 是数组项数.
+// 数组中为 0 的项被忽略, 成功释放的项被清零, 因正被使用而不能释放的项保持不变.
+// 与逐个调用 free_block() 相比, 这里只取一次超级块并只检查一次参数范围, 
+// 而且逻辑块位图所在的每个缓冲块在整批处理结束时只置一次已修改标志.
+// 返回未能释放的逻辑块数, 为 0 表示全部释放成功.
+int free_blocks(int dev, unsigned short * zones, int nr) {
+	struct super_block * sb;
+	int i, block, busy;
+	unsigned char zmap_dirt;										// 被修改过的逻辑块位图缓冲块, 每位对应一块(共 8 块).
+
+	if (!(sb = get_super(dev))) {
+		panic("trying to free blocks on nonexistent device");
+	}
+	busy = 0;
+	zmap_dirt = 0;
+	for (i = 0; i < nr; i++) {
+		if (!(block = zones[i])) {
+			continue;
+		}
+		if (block < sb->s_firstdatazone || block >= sb->s_nzones) {
+			panic("trying to free block not in datazone");
+		}
+		if (!forget_zone(sb, dev, block)) {
+			busy++;
+			continue;
+		}
+		if (sb->s_op) {
+			sb->s_op->free_block(sb, block);
+			zones[i] = 0;
+			continue;
+		}
+		block -= sb->s_firstdatazone - 1;
+		if (clear_bit(block & 8191, sb->s_zmap[block / 8192]->b_data)) {
+			printk("block (%04x:%d)", dev, block + sb->s_firstdatazone - 1);
+			printk("free_blocks: bit already cleared\n");
+		}
+		zmap_dirt |= 1 << (block / 8192);
+		zones[i] = 0;
+	}
+	// 最后置所有被修改过的逻辑块位图缓冲块的已修改标志.
+	for (i = 0; i < Z_MAP_SLOTS; i++) {
+		if (zmap_dirt & (1 << i)) {
+			sb->s_zmap[i]->b_dirt = 1;
+		}
+	}
+	return busy;
+}
+
 // 向设备申请一个逻辑块(盘块, 区块).
 // 函数首先取得设备的超级块, 并在超级块中的逻辑块位图中寻找第一个 0 值位(代表一个空闲逻辑块). 
 // 然后置位对应逻辑块在逻辑位图中的位. 接着为该逻辑块在缓冲区中取得一块对应缓冲块. 最后将该缓冲块清零, 并设置其已更新标志和已修改标志. 
@@ -116,6 +185,10 @@ int new_block(int dev) {
 	if (!(sb = get_super(dev))) {
 		panic("trying to get new block from nonexistant device");
 	}
+	// tmpfs 的逻辑块由其超级块操作函数分配, 分配到的块已经清零, 不需要经过高速缓冲.
+	if (sb->s_op) {
+		return sb->s_op->new_block(sb);
+	}
 	// 然后扫描文件系统的 8 块逻辑块位图, 查找空闲逻辑块. 
 	j = 8192;
 	for (i = 0; i < 8; i++) {
@@ -141,20 +214,22 @@ int new_block(int dev) {
 	if (j >= sb->s_nzones) {
 		return 0;
 	}
-	// 然后在高速缓冲区中为该设备上指定的逻辑块号取得一个缓冲块, 并返回缓冲块头指针.
-	if (!(bh = getblk(dev, j))) {
-		panic("new_block: cannot get block");
-	}
+	// 然后对该区段(逻辑块)中的每个数据块, 在高速缓冲区中取得一个缓冲块.
 	// 因为刚取得的逻辑块其引用次数一定为 1(getblk() 中会设置), 因此若不为 1 则出错停机. 
 	// 最后将新逻辑块的数据缓冲区清空, 并设置已更新和已修改标志. 然后释放对应缓冲块, 返回逻辑块号.
-	if (bh->b_count != 1) {
-		panic("new block: count is != 1");
+	for (i = 0; i < (1 << sb->s_log_zone_size); i++) {
+		if (!(bh = getblk(dev, (j << sb->s_log_zone_size) + i))) {
+			panic("new_block: cannot get block");
+		}
+		if (bh->b_count != 1) {
+			panic("new block: count is != 1");
+		}
+		// 之所以申请后又释放, 主要目的是设置更新标志和脏标志, 让其它进程使用的时候需要进行相应处理.
+		clear_block(bh->b_data);
+		bh->b_uptodate = 1;
+		bh->b_dirt = 1;
+		brelse(bh);
 	}
-	// 之所以申请后又释放, 主要目的是设置更新标志和脏标志, 让其它进程使用的时候需要进行相应处理.
-	clear_block(bh->b_data);
-	bh->b_uptodate = 1;
-	bh->b_dirt = 1;
-	brelse(bh);
 	return j;
 }
 
@@ -193,6 +268,12 @@ void free_inode(struct m_inode * inode) {
 	if (inode->i_num < 1 || inode->i_num > sb->s_ninodes) {
 		panic("trying to free inode 0 or nonexistant inode");
 	}
+	// tmpfs 没有 inode 位图, 由其超级块操作函数释放该 inode 号.
+	if (sb->s_op) {
+		sb->s_op->free_inode(sb, inode->i_num);
+		memset(inode, 0, sizeof(*inode));
+		return;
+	}
 	if (!(bh = sb->s_imap[inode->i_num >> 13])) {
 		panic("nonexistent imap in superblock");
 	}
@@ -223,31 +304,41 @@ struct m_inode * new_inode(int dev) {
 	if (!(sb = get_super(dev))) {
 		panic("new_inode with unknown device");
 	}
-	j = 8192;
-	for (i = 0; i < 8; i++) {
-		if (bh = sb->s_imap[i]) {
-			if ((j = find_first_zero(bh->b_data)) < 8192) {
-				break;
+	// tmpfs 没有 inode 位图, 由其超级块操作函数分配 inode 号. 
+	if (sb->s_op) {
+		if (!(j = sb->s_op->new_inode(sb))) {
+			iput(inode);
+			return NULL;
+		}
+	} else {
+		j = 8192;
+		for (i = 0; i < 8; i++) {
+			if (bh = sb->s_imap[i]) {
+				if ((j = find_first_zero(bh->b_data)) < 8192) {
+					break;
+				}
 			}
 		}
+		if (!bh || j >= 8192 || j + i * 8192 > sb->s_ninodes) {
+			iput(inode);
+			return NULL;
+		}
+		// 现在我们已经找到了还未使用的 inode 号 j. 于是置位 inode  j 对应的 inode 位图相应比特位(如果已经置位, 则出错). 
+		// 然后置 inode 位图所在缓冲块已修改标志. 最后初始化该 inode 结构(i_ctime 是 inode 内容改变时间). 
+		if (set_bit(j, bh->b_data)) {
+			panic("new_inode: bit already set");
+		}
+		bh->b_dirt = 1;
+		j += i * 8192;
 	}
-	if (!bh || j >= 8192 || j + i * 8192 > sb->s_ninodes) {
-		iput(inode);
-		return NULL;
-	}
-	// 现在我们已经找到了还未使用的 inode 号 j. 于是置位 inode  j 对应的 inode 位图相应比特位(如果已经置位, 则出错). 
-	// 然后置 inode 位图所在缓冲块已修改标志. 最后初始化该 inode 结构(i_ctime 是 inode 内容改变时间). 
-	if (set_bit(j, bh->b_data)) {
-		panic("new_inode: bit already set");
-	}
-	bh->b_dirt = 1;
 	inode->i_count = 1;               										// 引用计数. 
 	inode->i_nlinks = 1;              										// 文件目录项链接数. 
 	inode->i_dev = dev;               										// i节点所在的设备号. 
 	inode->i_uid = current->euid;     										// inode 所属用户 id. 
 	inode->i_gid = current->egid;     										// 组 id. 
 	inode->i_dirt = 1;                										// 已修改标志置位. 
-	inode->i_num = j + i * 8192;      										// 对应设备中的 inode 号. 
+	inode->i_num = j;      													// 对应设备中的 inode 号. 
+	inode->i_op = sb->s_iop;												// inode 操作函数表. 
 	inode->i_mtime = inode->i_atime = inode->i_ctime = CURRENT_TIME;        // 设置时间. 
 	return inode;                   										// 返回该 inode 指针. 
 }
@@ -53,7 +53,10 @@ int block_write(int dev, long * pos, char * buf, int count) {
 			chars = count;
 		}
 		if (chars == BLOCK_SIZE) {
-			bh = getblk(dev, block);
+			// 整块写时不必读盘, 但需置缓冲块更新标志. 否则该块随后被 bread() 时会从设备重新读入, 覆盖掉这里写入的数据.
+			if (bh = getblk(dev, block)) {
+				bh->b_uptodate = 1;
+			}
 		} else {
 			bh = breada(dev, block, block + 1, block + 2, -1);
 		}
@@ -71,9 +74,8 @@ int block_write(int dev, long * pos, char * buf, int count) {
 		*pos += chars;
 		written += chars;               						// 累计写入字节数. 
 		count -= chars;
-		while (chars-- > 0) {
-			*(p++) = get_fs_byte(buf++);
-		}
+		copy_from_user(p, buf, chars);
+		buf += chars;
 		bh->b_dirt = 1;
 		brelse(bh);
 	}
@@ -128,9 +130,8 @@ int block_read(int dev, unsigned long * pos, char * buf, int count)
 		*pos += chars;
 		read += chars;                  						// 累计读入字节数. 
 		count -= chars;
-		while (chars-- > 0) {
-			put_fs_byte(*(p++), buf++);
-		}
+		copy_to_user(buf, p, chars);
+		buf += chars;
 		brelse(bh);
 	}
 	return read;                            					// 返回已读取的字节数, 正常退出. 
@@ -80,11 +80,13 @@ int sys_sync(void) {
 
 	// 首先调用 i 节点同步函数, 把内在 i 节点表中所有修改过的 i 节点写入高速缓冲中. 然后扫描所有高速缓冲区, 
 	// 对已被修改的缓冲块产生写盘请求, 将缓冲中数据写入盘中, 做到高速缓冲中的数据与设备中的同步.
+	// 使用日志的文件系统上的元数据块则由 journal_sync() 经日志写盘, 下面的循环不再直接写它们.
 	sync_inodes();							/* write out inodes into buffers */
+	journal_sync();
 	bh = start_buffer;      				// bh 指向缓冲开始处.
 	for (i = 0; i < NR_BUFFERS; i++, bh++) {
 		wait_on_buffer(bh);             	// 等待缓冲区解锁(如果已上锁的话).
-		if (bh->b_dirt) {
+		if (bh->b_dirt && !journal_owns(bh)) {
 			ll_rw_block(WRITE, bh);  		// 产生写设备块请求.
 		}
 	}
@@ -107,12 +109,14 @@ int sync_dev(int dev) {
 	for (i = 0; i < NR_BUFFERS; i++, bh++) {
 		if (bh->b_dev != dev) continue;         	// 不是设备 dev 的缓冲块则继续.
 		wait_on_buffer(bh);             			// 等待缓冲区解锁(如果已上锁的话).
-		if (bh->b_dev == dev && bh->b_dirt) {
+		if (bh->b_dev == dev && bh->b_dirt && !journal_owns(bh)) {
 			ll_rw_block(WRITE, bh);
 		}
 	}
 	// 再将 i 节点数据写入高速缓冲. 让 i 节点表 inode_table 中的 inode 与缓冲中的信息同步。
+	// 若该设备使用日志, 则元数据块只能经由日志写盘, 上面和下面的循环都跳过它们.
 	sync_inodes();
+	journal_commit(dev, 0);
 	// 然后在高速缓冲中的数据更新之后, 再把它们与设备中的数据同步. 这里采用两遍同步操作是为了提高内核执行效率. 
 	// 第一遍缓冲区同步操作可以让内核中许多 "脏块" 变干净, 使得 i 节点的同步操作能够高效执行. 
 	// 本次缓冲区同步操作则把那些由于 i 节点同步操作而又变脏的缓冲块与设备中数据同步.
@@ -120,7 +124,7 @@ int sync_dev(int dev) {
 	for (i = 0; i < NR_BUFFERS; i++, bh++) {
 		if (bh->b_dev != dev) continue;
 		wait_on_buffer(bh);
-		if (bh->b_dev == dev && bh->b_dirt) {
+		if (bh->b_dev == dev && bh->b_dirt && !journal_owns(bh)) {
 			ll_rw_block(WRITE, bh);
 		}
 	}
@@ -139,7 +143,8 @@ void invalidate_buffers(int dev) {
 		wait_on_buffer(bh);             // 等待该缓冲区解锁(如果已被上锁).
 		// 由于进程执行过睡眠等待, 所以需要再判断一下缓冲区是否是指定设备的.
 		if (bh->b_dev == dev) {
-			bh->b_uptodate = bh->b_dirt = 0;
+			bh->b_uptodate = bh->b_dirt = bh->b_meta = 0;
+			bh->b_data = bh->b_buf;			// 直接指向内存中数据块的缓冲块恢复使用自己的数据块, 那些页面可能即将被释放.
 		}
 	}
 }
@@ -320,12 +325,24 @@ struct buffer_head * get_hash_table(int dev, int block) {
 #define BADNESS(bh) (((bh)->b_dirt << 1) + (bh)->b_lock)
 
 
+// 取内存中的块设备(无名设备上的 tmpfs 和虚拟盘)上数据块在内存中的地址, 其它设备返回 NULL.
+static inline char * mem_block(int dev, int block) {
+	switch (MAJOR(dev)) {
+		case 0:
+			return tmpfs_block(dev, block);
+		case 1:
+			return rd_block(dev, block);
+	}
+	return NULL;
+}
+
 // 取高速缓冲区中指定的缓冲块.
 // 利用 hash_table 检查指定(设备号和块号)的块是否已经在高速缓冲区中(已缓存). 
 // 如果指定块已经在高速缓冲区中, 则返回对应缓冲块头指针; 
 // 如果不在, 就需要在高速缓冲区中设置一个对应设备号和块号的新缓冲块. 返回相应缓冲区头指针.
 struct buffer_head * getblk(int dev, int block) {
 	struct buffer_head * tmp, * bh;
+	char * p;
 
 repeat:
 	if (bh = get_hash_table(dev, block)) {			// 如果已经缓存过该数据块, 则直接返回对应的缓冲块指针.
@@ -384,6 +401,14 @@ repeat:
 	if (find_buffer(dev, block)) {
 		goto repeat;
 	}
+	// 虚拟盘和 tmpfs 的数据块本来就在内存中, 先取得它的地址. 虚拟盘的数据页还没有分配时要申请页面, 可能睡眠, 
+	// 因此必须在把缓冲块放入 hash 队列之前取得, 并且睡眠后要重新检查上述条件: 
+	// 否则其他进程可能在此期间找到这个还指向 b_buf 的缓冲块并向其中读数据. 
+	// 重复寻找时页面已经分配好了, 不会再睡眠.
+	p = mem_block(dev, block);
+	if (bh->b_count || bh->b_dirt || bh->b_lock || find_buffer(dev, block)) {
+		goto repeat;
+	}
 	/* OK, FINALLY we know that this buffer is the only one of it's kind, */
 	/* and that it's unused (b_count=0), unlocked (b_lock=0), and clean */
 	/* OK, 最终我们知道该缓冲块是指定参数的唯一一块, 而且目前还没有被占用(b_count = 0), */
@@ -392,12 +417,21 @@ repeat:
 	bh->b_count = 1;
 	bh->b_dirt = 0;
 	bh->b_uptodate = 0;
+	bh->b_meta = 0;
+	bh->b_data = bh->b_buf;
 	// 从 hash 队列和空闲块链表中移除该缓冲头, 让该缓冲区用于指定设备和其上的指定块. 
 	// 然后根据此新设备号和块号重新插入空闲链表(链表尾)和 hash 队列新位置处(链表头). 并最终返回缓冲头指针.
 	remove_from_queues(bh);
 	bh->b_dev = dev;
 	bh->b_blocknr = block;
 	insert_into_queues(bh);
+	// 虚拟盘和 tmpfs 的数据块本来就在内存中, 于是让缓冲块直接指向它, 数据已经有效, 读写时也不必在两者之间复制. 
+	// 取不到(超出虚拟盘容量, 内存不够或 tmpfs 中没有分配该块)则仍使用缓冲块自己的数据块, 
+	// 由虚拟盘请求处理函数或 tmpfs_rw_block() 复制.
+	if (p) {
+		bh->b_data = p;
+		bh->b_uptodate = 1;
+	}
 	return bh;
 }
 
@@ -449,6 +483,28 @@ struct buffer_head * bread(int dev, int block) {
 	return NULL;
 }
 
+// 不等待地读取数据块(用于以 O_NONBLOCK 方式读普通文件).
+// 若该块已在高速缓冲中并且数据有效, 则与 bread() 一样返回缓冲块指针. 
+// 若该块正在读写(已上锁), 则直接返回 NULL; 否则只向设备提交读请求, 不等待完成就放弃对缓冲块的引用并返回 NULL, 
+// 以后再读时该块就已在高速缓冲中了. 放弃引用时不能调用 brelse(), 因为它会等待缓冲块解锁.
+struct buffer_head * bread_nowait(int dev, int block) {
+	struct buffer_head * bh;
+
+	if ((bh = find_buffer(dev, block)) && bh->b_lock) {
+		return NULL;
+	}
+	bh = getblk(dev, block);
+	if (bh->b_uptodate) {
+		return bh;
+	}
+	if (!bh->b_lock) {
+		ll_rw_block(READ, bh);
+	}
+	bh->b_count--;
+	wake_up(&buffer_wait);
+	return NULL;
+}
+
 // 复制内存块.
 // 从 from 地址复制一块(1024 字节)数据到 to 位置.
 // (重写的是先将 edi, esi 寄存器入栈保存起来, 拷贝完毕后再还原, 避免 edi, esi 寄存器的污染)
@@ -582,10 +638,12 @@ void buffer_init(long buffer_end) {					// buffer_end = 4MB.
 	// 与此同时在缓冲区起始端建立描述该缓冲块的结构(数组) buffer_head, 并将这些 buffer_head 组成双向链表(空闲块).
 	// h 是指向缓冲头结构的指针, 而 h+1 是指向内存地址连续的下一个缓冲头地址, 也可以说是指向 h 缓冲头的末端 + 1byte. 
 	// 为了保证有足够长度的内存来存储一个缓冲头结构, 需要 b 所指向的内存块地址 >= h 缓冲头的末端, 即要求 >= h+1.
-	// 注意: 缓冲头的第一项指向缓冲区的末端. 参见 P635 图 12-16. 缓冲块头与数据块一一对应, 对应关系不会改变.
+	// 注意: 缓冲头的第一项指向缓冲区的末端. 参见 P635 图 12-16. 缓冲块头与数据块一一对应, 对应关系不会改变
+	// (用于虚拟盘时 b_data 暂时指向虚拟盘页面, 但 b_buf 始终是这里分配的数据块).
 	while ((b -= BLOCK_SIZE) >= ((void *) (h + 1))) { 	// BLOCK_SIZE = 1024Byte
 		h->b_dev = 0;								// 使用该缓冲块的设备号.
 		h->b_dirt = 0;								// 脏标志, 即缓冲块修改标志.
+		h->b_meta = 0;								// 元数据块标志.
 		h->b_count = 0;								// 缓冲块引用计数.
 		h->b_lock = 0;								// 缓冲块锁定标志.
 		h->b_uptodate = 0;							// 缓冲块更新标志(或称数据有效标志).
@@ -593,6 +651,7 @@ void buffer_init(long buffer_end) {					// buffer_end = 4MB.
 		h->b_next = NULL;							// 指向具有相同 hash 值的下一个缓冲头.
 		h->b_prev = NULL;							// 指向具有相同 hash 值的前一个缓冲头.
 		h->b_data = (char *) b;						// 指向对应缓冲数据块(1024 字节).
+		h->b_buf = (char *) b;
 		h->b_prev_free = h - 1;						// 指向空闲链表中前一项.
 		h->b_next_free = h + 1;						// 指向空闲链表中下一项.
 		h++;										// h 指向下一个缓冲头位置.
@@ -42,6 +42,9 @@
 extern int sys_exit(int exit_code);
 extern int sys_close(int fd);
 
+// 各 inode 缓存的执行文件头部, 与 pipe_pages[] 一样以 inode 在 inode_table[] 中的序号为下标. 只有 i_exec 置位时才有效.
+static struct exec exec_headers[NR_INODE];
+
 /*
  * MAX_ARG_PAGES defines the number of pages allocated for arguments
  * and envelope for the new program. 32 should suffice, this gives
@@ -123,12 +126,12 @@ static unsigned long * create_tables(char * p, int argc, int envc)
 	// 再将参数指针和环境变量指针分别放入前面空出来的相应位置, 最后分别放置一个 NULL 指针.
 	while (argc-- > 0) {
 		put_fs_long((unsigned long) p, argv++); 	// 最开始时 p 指向参数与环境变量空间中的参数处.
-		while (get_fs_byte(p++)) /* nothing */ ;	// p 指针指向下一个参数串.
+		p += strlen_fs(p);							// p 指针指向下一个参数串.
 	}
 	put_fs_long(0, argv); 							// 栈中放置一个 NULL.
 	while (envc-- > 0) {
 		put_fs_long((unsigned long) p, envp++); 	// 最开始时 p 指向参数与环境变量空间中的环境变量处.
-		while (get_fs_byte(p++)) /* nothing */ ;	// p 指针指向下一个参数串.
+		p += strlen_fs(p);							// p 指针指向下一个参数串.
 	}
 	put_fs_long(0, envp); 							// 栈中放置一个 NULL.
 	return sp;										// 此时栈指针(栈顶)指向栈中的参数个数(argc)的位置, 返回构造的当前新栈指针.
@@ -200,7 +203,7 @@ static unsigned long copy_strings(int argc, char ** argv, unsigned long * page,
 		unsigned long p, int from_kmem)
 {
 	char * tmp, * pag;
-	int len, offset = 0;
+	int len, chunk;
 	unsigned long old_fs, new_fs;
 
 	if (!p) 										// p == 0 表示参数和环境空间没有内存了.
@@ -224,40 +227,34 @@ static unsigned long copy_strings(int argc, char ** argv, unsigned long * page,
 		if (from_kmem == 1)							// 若参数字符串指针在内核空间, 字符串在用户空间, 则让 fs 再指回用户空间, 下面要读取字符串了.
 			set_fs(old_fs);
 		// 如果 from_kmem == 0(参数字符串及其指针均在进程内存空间中), 那么 fs 仍然指向进程局部数据段.
-		// 从用户空间读取当前参数字符串, 并计算其长度 len. 此后 tmp 指向该字符串末端. 
-		len = 0;									/* remember zero-padding */
-		do {										/* 我们知道串是以 NULL 字节结尾的 */
-			len++;
-		} while (get_fs_byte(tmp++)); 				// 循环结束后 tmp 指向当前参数字符串的末尾.
+		// 用 strlen_fs() 计算当前参数字符串的长度 len(包括结尾的 NULL 字符), 然后让 tmp 指向该字符串末端. 
+		len = strlen_fs(tmp);						/* remember zero-padding */
+		tmp += len;
 		// 如果环境和参数空间不够再放下这个字符串, 则还原 fs, 并返回 0.
-		if (p - len < 0) {							/* this shouldn't happen - 128kB */
+		if (p < len) {								/* this shouldn't happen - 128kB */
 			set_fs(old_fs);							/* 不会发生 -- 因为有 128KB 的空间 */
 			return 0;
 		}
-		// 然后逐个字符把字符串复制到参数和环境空间中.
-		// 从最后一个页面(*page[PAGE_SIZE])末尾向页面头开始写, 也即先写字符串的最后一个字符. 
-		// 在循环复制字符串的字符过程中, 我们首先要判断参数和环境空间中相应位置处是否已经有内存页面. 
-		// 如果还没有就先为其申请 1 页内存页面. 偏移量 offset 被用作当前在一个页面中的指针. 
-		// 因为刚开始执行本函数时, 偏移量 offset 被初始化为 0, 
-		// 所以(offset - 1 < 0)肯定成立而使得 offset 重新被设置为当前 p 指针在页面范围内的偏移值.
+		// 然后从字符串末尾开始, 每次把落在同一个页面中的一段用 copy_from_user() 成块地复制到参数和环境空间中.
+		// chunk 是本次复制的字节数: 不超过剩余长度, 也不超过 p 之前在当前页面中的字节数. 
+		// 如果参数和环境空间中相应位置处还没有内存页面, 就先为其申请 1 页内存页面.
 		while (len) {
-			--p; --tmp; --len;
-			if (--offset < 0) { 					// 当前指针如果小于 0, 那么重置该指针.
-				offset = p % PAGE_SIZE; 			// 设置 offset 为页内偏移量.
-				// 若参数字符串和其指针都在内核空间则 fs 指回用户空间(有可能要调用 get_free_page(), 所以需要先将 fs 改回去).
-				if (from_kmem == 2)
-					set_fs(old_fs);
-				// 如果当前参数指针 p 所在的参数和环境页面地址 page[p/PAGE_SIZE] == 0, 
-				// 则表示这个内存页面不存在, 则需要申请一页空闲内存页, 并将该页面地址填入地址列表 page[] 中, 
-				if (!(pag = (char *) page[p / PAGE_SIZE]) && 		
-				    !(pag = (char *) (page[p / PAGE_SIZE] = get_free_page())))
-					return 0;
-				if (from_kmem == 2)					// 然后再将 fs 改回来, 指向内核空间.
-					set_fs(new_fs);
-
-			}
-			// 然后从 fs 段中复制字符串的 1 字节到参数和环境内存页面 pag 的 offset 处.
-			*(pag + offset) = get_fs_byte(tmp);
+			chunk = (p - 1) % PAGE_SIZE + 1;
+			if (chunk > len)
+				chunk = len;
+			p -= chunk; tmp -= chunk; len -= chunk;
+			// 若参数字符串和其指针都在内核空间则 fs 指回用户空间(有可能要调用 get_free_page(), 所以需要先将 fs 改回去).
+			if (from_kmem == 2)
+				set_fs(old_fs);
+			// 如果当前参数指针 p 所在的参数和环境页面地址 page[p/PAGE_SIZE] == 0, 
+			// 则表示这个内存页面不存在, 则需要申请一页空闲内存页, 并将该页面地址填入地址列表 page[] 中, 
+			if (!(pag = (char *) page[p / PAGE_SIZE]) && 		
+			    !(pag = (char *) (page[p / PAGE_SIZE] = get_free_page())))
+				return 0;
+			if (from_kmem == 2)					// 然后再将 fs 改回来, 指向内核空间.
+				set_fs(new_fs);
+			// 然后从 fs 段中复制这一段字符串到参数和环境内存页面 pag 的相应偏移处.
+			copy_from_user(pag + p % PAGE_SIZE, tmp, chunk);
 		}
 	}
 	// 如果字符串和字符串数组在内核空间, 则恢复 fs 段寄存器原值. 
@@ -345,26 +342,6 @@ int do_execve(unsigned long * eip, long tmp, char * filename,
 	int sh_bang = 0;											// 控制是否需要执行脚本程序. 置位表示禁止再次执行脚本处理代码. 用于执行脚本时递归调用的逻辑判断.
 	unsigned long p = PAGE_SIZE * MAX_ARG_PAGES - 4;			// p 指向参数和环境空间的最后一个长字(4k * 32 - 4).
 
-	// 在内核中打印要执行的文件的名字.
-	char s, filename1[128]; 									// 函数内的变量都是在栈中(当前进程的内核态堆栈中).
-	int index = 0;
-	// 将用户数据空间中的 filename 复制到内核的数据段(filename1)中.
-	while (1) {
-		// 此时代码运行在内核态, 所以数据段寄存器 ds 指向的是内核的数据段, 这时访问 filename 地址处的内存拿到的不是用户态进程内存里的数据.
-		// 不过目前当前进程 0-640KB 这部分映射关系是复制的内核页表的(看下 TASK(0->1) 的 fork 过程便知), 
-		// 所以现在当前进程的 fs 在 0-640KB 的逻辑空间也是指向内核数据段(物理地址的 0-640KB), 
-		// 后面的 free_page_table 会替换掉 0-640KB 这个映射关系.
-		// 参照: sys_call.s # sys_fork -> copy_process() -> copy_mem() -> copy_page_table() (kernel/fork.c)
-		s = get_fs_byte(filename + index); 		// 复制用户数据段中的数据到内核的数据段中.
-		if (s) {
-			*(filename1 + index) = s; 			// 拷贝内核数据段中的 filename 到用户进程内核栈 filename1 (当前进程的内核态栈)中.
-			index++;
-		} else {
-			break;
-		}
-	}
-	*(filename1 + index + 1) = '\0'; 							// 填充字符串结束符.
-
 	// 在正式设置可执行文件的运行环境之前, 让我们先干些杂事. 
 	// 参数 eip[1] 是调用进程的代码段寄存器 CS 值(特权级变化导致堆栈切换时压入内核态堆栈的内容, 见 CLK 图 4-29, p123), 
 	// CS 段选择符必须是当前任务的代码段选择符(0x000f), 若不是, 那么 CS 只可能是内核代码段的选择符 0x0008. 
@@ -414,13 +391,19 @@ restart_interp:											// 脚本文件处理完后, 使用这个标号重启
 	}
 	// 程序执行到这里, 说明当前进程有权运行这个可执行文件.
 	// 所以我们需要取出执行文件头部数据并根据其中的信息来分析设置运行环境, 或者运行另一个 shell 程序来执行脚本程序. 
-	// 首先读取执行文件第 1 块数据到高速缓冲块中. 并复制缓冲块数据到 ex 中. 
-	if (!(bh = bread(inode->i_dev, inode->i_zone[0]))) { 			// 读取文件的第一个数据块.
-		retval = -EACCES;
-		goto exec_error2;
+	// 如果 inode 中已经缓存了执行文件头部(上次执行该文件时保存的), 就直接使用它, 不必再读文件的第 1 块数据(bh 为 NULL). 
+	// 否则读取执行文件第 1 块数据到高速缓冲块中. 并复制缓冲块数据到 ex 中. 
+	if (inode->i_exec) {
+		ex = exec_headers[inode - inode_table];
+		bh = NULL;
+	} else {
+		if (!(bh = bread(inode->i_dev, bmap(inode, 0)))) { 			// 读取文件的第一个数据块.
+			retval = -EACCES;
+			goto exec_error2;
+		}
+		// 读取可执行文件头信息.
+		ex = *((struct exec *) bh->b_data);							/* read exec-header */
 	}
-	// 读取可执行文件头信息.
-	ex = *((struct exec *) bh->b_data);								/* read exec-header */
 	/* 
 	  如果执行文件是脚本文件(以 '#!' 开头), 我们需要读取脚本文件中的内容, 获取其解释程序(比如 /bin/sh)及后面的参数(如果有的话),
 	  然后将这些参数和脚本文件名放到执行文件(此时是解释程序)的命令行参数和环境变量空间中(page[]). 
@@ -430,7 +413,8 @@ restart_interp:											// 脚本文件处理完后, 使用这个标号重启
 	*/
 	// 处理完脚本文件之后需要设置一个禁止再次执行下面的脚本处理的标志 sh_bang.
 	// 在后面的代码中该标志也用来表示我们已经设置好执行文件的命令行参数, 不要重复设置.
-	if ((bh->b_data[0] == '#') && (bh->b_data[1] == '!') && (!sh_bang)) { 	// 如果是脚本文件, 并且还没有处理过这个脚本.
+	// 只有能执行的 a.out 文件的头部才会被缓存, 因此使用缓存的头部时不会是脚本文件.
+	if (bh && (bh->b_data[0] == '#') && (bh->b_data[1] == '!') && (!sh_bang)) { 	// 如果是脚本文件, 并且还没有处理过这个脚本.
 		/*
 		 * This section does the #! interpretation.
 		 * Sorta complicated, but hopefully it will work.  -TYT
@@ -531,7 +515,7 @@ restart_interp:											// 脚本文件处理完后, 使用这个标号重启
 		set_fs(old_fs); 										// 恢复 fs 指向进程的局部数据段(0x17).
 		goto restart_interp;
     }
-	// 此时缓冲块中的执行文件头结构已经复制到了 ex 中. 于是先释放该缓冲块, 并开始对 ex 中的执行头信息进行判断处理. 
+	// 此时缓冲块中的执行文件头结构已经复制到了 ex 中. 于是先释放该缓冲块(使用缓存的头部时 bh 为 NULL, brelse() 直接返回), 并开始对 ex 中的执行头信息进行判断处理. 
 	// 对于 Linux0.12 内核来说, 它仅支持 ZMAGIC 执行格式, 并且执行文件代码都从逻辑地址 0 开始执行, 
 	// 因此不支持含有代码或数据重定位信息的执行文件. 当然, 如果执行文件实在太大或者执行文件残缺不全, 那么我们也不能运行它. 
 	// 因此对于下列情况将不执行程序: 如果执行文件不是需求页可执行文件(ZMAGIC), 或者代码和数据重定位部分长度不等于 0, 
@@ -549,6 +533,12 @@ restart_interp:											// 脚本文件处理完后, 使用这个标号重启
 		retval = -ENOEXEC;
 		goto exec_error2;
 	}
+	// 执行文件头部检查通过, 把它缓存到 inode 中, 下次执行该文件(或以它为解释程序的脚本)时就不必再读盘. 
+	// 文件被写或被截断时会清除 i_exec 标志; inode 被重新使用时整个结构被清零, 该标志也随之清除.
+	if (!inode->i_exec) {
+		exec_headers[inode - inode_table] = ex;
+		inode->i_exec = 1;
+	}
 	// 如果 sh_bang 标志没有设置(即要执行的不是脚本文件指定的解释程序), 则复制指定个数的命令行参数和环境字符串到参数和环境空间中. 
 	// 若 sh_bang 标志已经设置, 则表明将运行脚本解释程序, 此时环境变量页面已经复制完成, 无需再复制. 
 	// 同样, 若 sh_bang 没有置位而需要复制的话, 那么此时指针 p 随着复制信息增加而逐渐向小地址方向移动,
@@ -596,13 +586,14 @@ restart_interp:											// 脚本文件处理完后, 使用这个标号重启
 			current->sigaction[i].sa_handler = NULL;
 		}
 	}
+	// 原程序的用户缓冲区即将不存在, 因此丢弃还未取走的异步 I/O 请求. 
 	// 再根据设定的执行时关闭文件句柄(close_on_exec)位图标志, 关闭对应的文件并复位该标志.
-	for (i = 0; i < NR_OPEN; i++) {
-		if ((current->close_on_exec >> i) & 1) {
+	aio_release();
+	for (i = 0; i < current->max_fds; i++) {
+		if (FD_BIT_ISSET(i, current->close_on_exec)) {
 			sys_close(i);
 		}
 	}
-	current->close_on_exec = 0;
 	// ** 然后根据当前进程指定的基地址和限长, 释放原程序的代码段和数据段所对应的内存页表指定的物理内存页面及页表本身. 
 	// 释放完后新执行文件并没有占用 0-640KB 对应的物理页面, 因此在处理器真正运行新执行文件代码时(访问 0x0)就会引起缺页异常中断, 
 	// 此时内存管理程序即会执行缺页处理页为新执行文件申请内存页面和设置相关页表项, 并且把相关执行文件页面读入内存中. **
@@ -14,32 +14,26 @@
 // #include <sys/stat.h>
 
 extern int sys_close(int fd);
+extern int pipe_resize(struct m_inode * inode, int size);	// 调整管道缓冲区大小(fs/pipe.c).
 
 // 复制文件句柄(文件描述符).
 // 参数: fd - 要复制的文件句柄, arg - 指定新文件句柄的最小数值.
 // 返回新文件句柄或出错码.
 static int dupfd(unsigned int fd, unsigned int arg) {
 	// 首先检查函数参数的有效性. 
-	// 如果文件句柄值大于一个程序最多打开文件数 NR_OPEN, 或者要复制的句柄文件结构不存在, 则返回出错码并退出. 
+	// 如果文件句柄值超出进程描述符表的容量, 或者要复制的句柄文件结构不存在, 则返回出错码并退出. 
 	// 如果指定的新句柄值 arg 大于最多打开文件数, 也返回出错码并退出. 
 	// 文件句柄就是文件在当前进程的文件列表中的索引号.
-	if (fd >= NR_OPEN || !current->filp[fd])
+	if (fd >= current->max_fds || !current->filp[fd])
 		return -EBADF;
 	if (arg >= NR_OPEN)
 		return -EINVAL;
-	// 然后在当前进程的文件列表中寻找索引号等于或大于 arg 但还没有被使用的文件项. 
-	while (arg < NR_OPEN)
-		if (current->filp[arg])  							// 如果非空闲项, 则查找下一个.
-			arg++;
-		else
-			break;
-	// 如果没有找到空闲项, 则返回出错码.
-	if (arg >= NR_OPEN)
-		return -EMFILE;
-	// 如果找到空闲文件项, 则在执行时关闭标志位图 close_on_exec 中复位(0)新的句柄位. 
-	// 即在运行 exec() 类函数时, 不会关闭通过 dup() 创建的句柄. 
-	current->close_on_exec &= ~(1 << arg); 					// 将 arg 对应的位复位, 表示这个句柄在运行 exec() 类函数时不会被关闭.
-	// 并令新文件项指针指向原文件句柄 fd 指针指向的文件(在系统文件表 file_table[] 中), 并且将该文件引用数 +1. 最后返回新的文件句柄 arg.
+	// 然后寻找索引号等于或大于 arg 但还没有被使用的描述符(必要时扩展描述符表). 
+	// get_unused_fd() 同时在执行时关闭标志位图 close_on_exec 中复位(0)新的句柄位, 
+	// 即在运行 exec() 类函数时, 不会关闭通过 dup() 创建的句柄. 如果没有找到空闲项, 则返回出错码.
+	if ((int)(arg = get_unused_fd(arg)) < 0)
+		return arg;
+	// 并令新文件项指针指向原文件句柄 fd 指针指向的文件(在系统文件表中), 并且将该文件引用数 +1. 最后返回新的文件句柄 arg.
 	(current->filp[arg] = current->filp[fd])->f_count++;	// 复制文件指针, 并增加文件引用计数值.
 	return arg;
 }
@@ -73,20 +67,20 @@ int sys_fcntl(unsigned int fd, unsigned int cmd, unsigned long arg) {
 	struct file * filp;
 
 	// 首先检查给出的文件句柄有效性. 然后根据不同命令 cmd 进行分别处理. 
-	// 如果文件句柄值大于一个进程最多打开文件数 NR_OPEN, 或者该句柄的文件结构指针为空, 则返回出错码并退出.
-	if (fd >= NR_OPEN || !(filp = current->filp[fd])) {
+	// 如果文件句柄值超出进程描述符表的容量, 或者该句柄的文件结构指针为空, 则返回出错码并退出.
+	if (fd >= current->max_fds || !(filp = current->filp[fd])) {
 		return -EBADF;
 	}
 	switch (cmd) {
 		case F_DUPFD:   										// 复制文件句柄.
 			return dupfd(fd,arg);
 		case F_GETFD:   										// 取文件句柄的执行时关闭标志.
-			return (current->close_on_exec >> fd) & 1;
+			return FD_BIT_ISSET(fd, current->close_on_exec);
 		case F_SETFD:   										// 设置执行时关闭标志. arg 位 0 置位是设置, 否则关闭.
 			if (arg & 1) {
-				current->close_on_exec |= (1 << fd);
+				FD_BIT_SET(fd, current->close_on_exec);
 			} else {
-				current->close_on_exec &= ~(1 << fd);
+				FD_BIT_CLR(fd, current->close_on_exec);
 			}
 			return 0;
 		case F_GETFL:   										// 取文件状态标志和访问模式.
@@ -95,6 +89,16 @@ int sys_fcntl(unsigned int fd, unsigned int cmd, unsigned long arg) {
 			filp->f_flags &= ~(O_APPEND | O_NONBLOCK);
 			filp->f_flags |= arg & (O_APPEND | O_NONBLOCK);
 			return 0;
+		case F_SETPIPE_SZ:										// 调整管道缓冲区大小(fs/pipe.c).
+			if (!filp->f_inode->i_pipe) {
+				return -EINVAL;
+			}
+			return pipe_resize(filp->f_inode, arg);
+		case F_GETPIPE_SZ:										// 取管道缓冲区大小.
+			if (!filp->f_inode->i_pipe) {
+				return -EINVAL;
+			}
+			return PIPE_BUF_SIZE(*filp->f_inode);
 		case F_GETLK:	
 		case F_SETLK:	
 		case F_SETLKW:  		// 未实现.
@@ -4,6 +4,7 @@
  *  (C) 1991  Linus Torvalds
  */
 
+#include <string.h>
 #include <errno.h>              								// 错误号头文件. 包含系统中各种出错号. 
 #include <fcntl.h>
 
@@ -14,12 +15,32 @@
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))    					// 取 a, b 中的最小值.
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))    					// 取 a, b 中的最大值.
 
-// 文件读函数 - 根据 inode 和文件结构, 读取文件中数据. 
-// 由 inode 我们可以知道设备号, 由 filp 结构可以知道文件中当前读写指针位置. 
-// buf 指定用户空间中缓冲区的位置, count 是需要读取的字节数. 
+// 读写文件时每次调用 bmap_blocks()/create_blocks() 最多映射的数据块数.
+#define NR_BMAP 16
+
+// 文件读写函数(read_write.c 和 pipe.c 调用). 经由 inode 操作函数表转给文件所在文件系统的读写函数.
+// 写文件时清除 inode 中缓存的执行文件头部标志(fs/exec.c). 写操作中途可能睡眠, 这期间 execve() 可能又读入并缓存了
+// 部分修改过的头部, 所以写完后还要再清除一次.
+int file_read(struct m_inode * inode, struct file * filp, char * buf, int count, off_t * pos) {
+	return inode->i_op->read(inode, filp, buf, count, pos);
+}
+
+int file_write(struct m_inode * inode, struct file * filp, char * buf, int count, off_t * pos) {
+	int retval;
+
+	inode->i_exec = 0;
+	retval = inode->i_op->write(inode, filp, buf, count, pos);
+	inode->i_exec = 0;
+	return retval;
+}
+
+// MINIX 文件系统的文件读函数 - 根据 inode 和文件结构, 读取文件中数据. 
+// 由 inode 我们可以知道设备号, 由 filp 结构可以知道文件的打开标志. 
+// buf 指定用户空间中缓冲区的位置, count 是需要读取的字节数. pos 指向读写位置(通常是 &filp->f_pos, pread() 时是临时变量), 读后前移.
 // 返回值是实际读取的字节数, 或出错号(小于 0). 
-int file_read(struct m_inode * inode, struct file * filp, char * buf, int count) {
+int minix_file_read(struct m_inode * inode, struct file * filp, char * buf, int count, off_t * pos) {
 	int left, chars, nr;
+	int zones[NR_BMAP], nzones, zi;
 	struct buffer_head * bh;
 
 	// 首先判断参数的有效性. 若需要读取的字节计数 count 小于等于零, 则返回 0.
@@ -27,39 +48,61 @@ int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
 		return 0;
 	}
 	// 循环读取, 直到数据全部读出或遇到问题. 在读循环操作过程中, 我们根据 inode 和文件表结构信息, 
-	// 并利用 bmap() 得到当前读写位置在设备上对应的逻辑块号 nr. 若 nr 不为 0, 则从 inode 指定的设备上读取该逻辑块. 
+	// 并利用 bmap_blocks() 一次得到从当前读写位置开始的若干个数据块在设备上对应的逻辑块号, 存放在 zones[] 中. 
+	// 若逻辑块号 nr 不为 0, 则从 inode 指定的设备上读取该逻辑块. 
 	// 如果读操作失败则退出循环. 若 nr 为 0, 表示指定的数据块不存在, 置缓冲块指针为 NULL. 
+	nzones = zi = 0;
 	while (left) {
-		// 根据文件的读写偏移位置得到当前读写位置对应的逻辑块号 i_zone[x].
-		if (nr = bmap(inode, (filp->f_pos) / BLOCK_SIZE)) {		// (filp->f_pos / BLOCK_SIZE) 得到文件逻辑块号索引, 即 i_zone[x] 中的 x.
-			// 得到该逻辑块号对应的高速缓冲区.
-			if (!(bh = bread(inode->i_dev, nr))) {
+		// 当 zones[] 中的块号已用完时, 根据文件的读写偏移位置映射接下来的(最多 NR_BMAP 个)数据块.
+		if (zi >= nzones) {
+			nzones = (*pos % BLOCK_SIZE + left + BLOCK_SIZE - 1) / BLOCK_SIZE;
+			nzones = bmap_blocks(inode, *pos / BLOCK_SIZE, MIN(nzones, NR_BMAP), zones);
+			zi = 0;
+			if (!nzones) {
 				break;
 			}
+		}
+		if (nr = zones[zi]) {
+			// 得到该逻辑块号对应的高速缓冲区. 以 O_NONBLOCK 方式打开的文件不等待磁盘: 
+			// 数据块不在高速缓冲中时只提交读请求, 然后返回已读到的字节数, 一个字节都没读到则返回 -EAGAIN.
+			if (filp->f_flags & O_NONBLOCK) {
+				if (!(bh = bread_nowait(inode->i_dev, nr))) {
+					if (count == left) {
+						return -EAGAIN;
+					}
+					break;
+				}
+			} else if (!(bh = bread(inode->i_dev, nr))) {
+				break;
+			}
+			// 读块时(以及前面复制到用户空间时)可能睡眠, 这期间文件可能被截断或重写, zones[] 中的块可能已被释放并另作他用.
+			// 因此读到数据块后重新映射当前块, 若块号已经改变, 就放弃这批映射结果, 从当前位置重新映射.
+			if (bmap_blocks(inode, *pos / BLOCK_SIZE, 1, zones + zi) != 1 || zones[zi] != nr) {
+				brelse(bh);
+				nzones = 0;
+				continue;
+			}
 		} else {
 			bh = NULL;
 		}
+		zi++;
 		// 接着我们计算文件读写指针在数据块中的偏移值 nr, 则在该数据块中我们希望读取的字节数为(BLOCK_SIZE - nr). 
 		// 然后和现在还需读取的字节数 left 作比较, 其中小值即为本次操作需读取的字节数 chars. 
 		// 如果(BLOCK_SIZE - nr) > left, 则说明该块是需要读取的最后一块数据, 反之还需要读取下一块数据. 
 		// 之后调整读写文件指针. 指针前移此次将读取的字节数 chars. 剩余字节数 left 相应减去 chars. 
-		nr = filp->f_pos % BLOCK_SIZE;
+		nr = *pos % BLOCK_SIZE;
 		chars = MIN(BLOCK_SIZE - nr, left);
-		filp->f_pos += chars;
+		*pos += chars;
 		left -= chars;
 		// 若上面从设备上读到了数据, 则将 p 指向缓冲块中开始读取数据的位置, 并且复制 chars 字节到用户缓冲区 buf 中. 
 		// 否则往用户缓冲区中填入 chars 个字节的 0 值. 
 		if (bh) {
-			char * p = nr + bh->b_data;
-			while (chars-- > 0) {
-				put_fs_byte(*(p++), buf++);
-			}
+			copy_to_user(buf, nr + bh->b_data, chars);
 			brelse(bh);
 		} else {
-			while (chars-- > 0) {
-				put_fs_byte(0, buf++);
-			}
+			clear_user(buf, chars);
 		}
+		buf += chars;
 	}
 	// 修改该 inode 的访问时间为当前时间. 返回读取的字节数, 若读取字节数为 0, 则返回出错号. 
 	// CURRENT_TIME 是定义在 include/linux/sched.h 上的宏, 用于计算 UNIX 时间. 
@@ -68,12 +111,14 @@ int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
 	return (count - left) ? (count - left) : -ERROR;
 }
 
-// 文件写函数 - 根据 inode 和文件结构信息, 将用户数据写入文件中. 
-// 由 inode 我们可以知道设备号, 而由 file 结构可以知道文件中当前读写指针位置. buf 指定用户态中缓冲区的位置, count 为需要写入的字节数. 
+// MINIX 文件系统的文件写函数 - 根据 inode 和文件结构信息, 将用户数据写入文件中. 
+// 由 inode 我们可以知道设备号, 而由 file 结构可以知道文件的打开标志. buf 指定用户态中缓冲区的位置, count 为需要写入的字节数. 
+// ppos 指向读写位置(通常是 &filp->f_pos, pwrite() 时是临时变量), 写后前移(O_APPEND 方式不使用也不移动它).
 // 返回值是实际写入的字节数, 或出错号(小于 0).
-int file_write(struct m_inode * inode, struct file * filp, char * buf, int count) {
+int minix_file_write(struct m_inode * inode, struct file * filp, char * buf, int count, off_t * ppos) {
 	off_t pos;
 	int block, c;
+	int zones[NR_BMAP], nzones, zi, n, fresh;
 	struct buffer_head * bh;
 	char * p;
 	int i = 0;
@@ -87,17 +132,51 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
 	if (filp->f_flags & O_APPEND) {
 		pos = inode->i_size;
 	} else {
-		pos = filp->f_pos;
+		pos = *ppos;
 	}
 	// 然后在已写入字节数 i(刚开始时为 0) 小于指定写入字节数 count 时, 循环执行以下操作. 
 	// 在循环操作过程中, 我们先取文件数据块号(pos/BLOCK_SIZE)在设备上对应的逻辑块号 block. 
-	// 如果对应的逻辑块不存在就创建一块. 如果得到的逻辑块号 = 0, 则表示创建失败, 于是退出循环. 
-	// 否则我们根据该逻辑块号读取设备上的相应逻辑块, 若出错也退出循环. 
+	// 这些块号由 bmap_blocks() 每次成批映射若干块并存放在 zones[] 中. 
+	// 遇到不存在的块(空洞或文件尾之后)时, 才用 create_blocks() 为从这里开始的连续若干个不存在的块分配逻辑块, 
+	// 而不是预先为整批都分配. 新分配的块内容全为 0, 不必从设备读入, 写它们不会出错; 
+	// 因此中途因读块出错而退出循环时, 不会在新的文件尾之后留下已分配却没有写入的块. 
+	// 如果一块也没有分配成功(设备已满), 则退出循环. 
+	// 对已存在的块, 如果本次写操作会覆盖整个数据块(写位置处于块起始处并且剩余写入字节数不少于一块), 那么块中原有数据
+	// 将被全部覆盖, 没有必要先从设备上读入该块, 因此直接用 getblk() 申请缓冲块即可, 省去一次读盘操作. 
+	// 否则就读入该块, 若出错则退出循环.
+	nzones = zi = fresh = 0;
 	while (i < count) {
-		if (!(block = create_block(inode, pos / BLOCK_SIZE))) {
-			break;
+		if (zi >= nzones) {
+			nzones = (pos % BLOCK_SIZE + count - i + BLOCK_SIZE - 1) / BLOCK_SIZE;
+			nzones = bmap_blocks(inode, pos / BLOCK_SIZE, MIN(nzones, NR_BMAP), zones);
+			zi = fresh = 0;
+			if (!nzones) {
+				break;
+			}
+		}
+		if (!zones[zi]) {
+			n = zi;
+			while (n < nzones && !zones[n]) {
+				n++;
+			}
+			if (!(fresh = create_blocks(inode, pos / BLOCK_SIZE, n - zi, zones + zi))) {
+				break;
+			}
 		}
-		if (!(bh = bread(inode->i_dev, block))) {
+		block = zones[zi++];
+		if (fresh) {
+			fresh--;
+			bh = getblk(inode->i_dev, block);
+			if (!bh->b_uptodate) {
+				memset(bh->b_data, 0, BLOCK_SIZE);
+				bh->b_uptodate = 1;
+			}
+		} else if (!(pos % BLOCK_SIZE) && count - i >= BLOCK_SIZE) {
+			bh = getblk(inode->i_dev, block);
+			// 缓冲块中的数据马上会被整块覆盖, 这里先置更新标志, 以免复制用户数据时(可能因缺页而睡眠)
+			// 其他进程用 bread() 读该块而把设备上的旧数据读入, 覆盖掉已复制的内容.
+			bh->b_uptodate = 1;
+		} else if (!(bh = bread(inode->i_dev, block))) {
 			break;
 		}
 		// 此时缓冲块指针 bh 正指向刚读入的文件数据块. 现在再求出文件当前读写指针在该数据块中的偏移值 c, 
@@ -121,9 +200,8 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
 			inode->i_dirt = 1;
 		}
 		i += c;
-		while (c-- > 0) {
-			*(p++) = get_fs_byte(buf++);
-		}
+		copy_from_user(p, buf, c);
+		buf += c;
 		brelse(bh);
     }
 	// 当数据已经全部写入文件或者在写操作过程中发生问题时就会退出循环. 此时我们更改文件修改时间为当前时间, 并调整文件读写指针. 
@@ -131,7 +209,7 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
 	// 最后返回写入的字节数, 若写入字节数为 0, 则返回出错号 -1. 
 	inode->i_mtime = CURRENT_TIME;
 	if (!(filp->f_flags & O_APPEND)) {
-		filp->f_pos = pos;
+		*ppos = pos;
 		inode->i_ctime = CURRENT_TIME;
 	}
 	return (i ? i : -1);
@@ -4,6 +4,197 @@
  *  (C) 1991  Linus Torvalds
  */
 
-#include <linux/fs.h>		        // 文件系统头文件, 定义文件表结构(file_, buffer_head, m_inode 等).
+#include <errno.h>
+#include <string.h>
+#include <linux/sched.h>		        // 调度程序头文件, 定义任务结构 task_struct. 含文件系统头文件 fs.h.
+#include <linux/kernel.h>				// 内核头文件. 含有 malloc() 和 free_s() 的原型.
+#include <linux/mm.h>					// 内存管理头文件. 含有 get_free_page() 的原型.
 
-struct file file_table[NR_FILE];	// 系统中打开的文件表数组(64 项).
+// 系统文件表不再是固定的 64 项数组, 而是由按页分配的文件结构组成的双向循环链表.
+// 需要时(get_empty_filp() 找不到空闲项)再分配一页, 总数最多 NR_FILE 项.
+// 分配出去的文件结构被移到链表尾部, 因此空闲项集中在链表前部, 扫描通常很快就能结束.
+struct file * first_file = NULL;		// 系统文件表链表头.
+int nr_files = 0;						// 系统文件表中现有的文件结构数.
+
+// 取长字 word 中第 1 个 0 值位的位偏移值. word 中必须有 0 值位.
+#define ffz(word) ({ \
+	unsigned long __res; \
+	__asm__("bsfl %1, %0" : "=r" (__res) : "r" (~(word))); \
+	__res; \
+})
+
+// 把文件结构 f 移到链表尾部(即 first_file 之前). 若 f 就是链表头, 则只需让链表头后移一项.
+static void put_last_used(struct file * f) {
+	if (f == first_file) {
+		first_file = f->f_next;
+		return;
+	}
+	f->f_prev->f_next = f->f_next;
+	f->f_next->f_prev = f->f_prev;
+	f->f_next = first_file;
+	f->f_prev = first_file->f_prev;
+	first_file->f_prev->f_next = f;
+	first_file->f_prev = f;
+}
+
+// 新分配一页文件结构, 并把它们插入链表头部. 成功返回 1, 内存不够或已达到 NR_FILE 项则返回 0.
+static int grow_files(void) {
+	struct file * f;
+	int i;
+
+	i = PAGE_SIZE / sizeof(struct file);
+	if (nr_files + i > NR_FILE) {
+		return 0;
+	}
+	if (!(f = (struct file *) get_free_page())) {		// 取得的页面已清零, 各项引用计数为 0.
+		return 0;
+	}
+	nr_files += i;
+	if (!first_file) {
+		f->f_next = f->f_prev = first_file = f;
+		f++, i--;
+	}
+	for (; i; i--, f++) {
+		f->f_next = first_file;
+		f->f_prev = first_file->f_prev;
+		first_file->f_prev->f_next = f;
+		first_file->f_prev = f;
+		first_file = f;
+	}
+	return 1;
+}
+
+// 从系统文件表中取一个空闲文件结构(引用计数为 0 的项).
+// 返回的文件结构已经初始化, 且引用计数置为 1. 系统文件表已满则返回 NULL.
+// 调用者出错时只需把 f_count 置 0 即可释放它.
+struct file * get_empty_filp(void) {
+	struct file * f;
+	int i;
+
+	do {
+		for (f = first_file, i = 0; i < nr_files; i++, f = f->f_next) {
+			if (!f->f_count) {
+				put_last_used(f);
+				f->f_count = 1;
+				f->f_mode = 0;
+				f->f_flags = 0;
+				f->f_inode = NULL;
+				f->f_pos = 0;
+				return f;
+			}
+		}
+	} while (grow_files());
+	return NULL;
+}
+
+// 把当前进程的描述符表扩展到至少能容纳描述符 nr(内部函数).
+// 表的容量按 2 倍增长, 新表和新位图由 malloc() 分配, 旧表内容复制过去后释放(内嵌的表除外).
+// 两个位图放在同一块内存中, close_on_exec 紧跟在 open_fds 之后. 成功返回 0, 否则返回出错码.
+static int expand_fdtable(unsigned int nr) {
+	struct file ** new_filp;
+	unsigned long * new_fds;
+	int size = current->max_fds;
+
+	while (size <= nr) {
+		size <<= 1;
+	}
+	if (size > NR_OPEN) {
+		size = NR_OPEN;
+	}
+	if (!(new_filp = (struct file **) malloc(size * sizeof(struct file *)))) {
+		return -ENOMEM;
+	}
+	if (!(new_fds = (unsigned long *) malloc(size / 4))) {
+		free_s(new_filp, size * sizeof(struct file *));
+		return -ENOMEM;
+	}
+	memset(new_filp, 0, size * sizeof(struct file *));
+	memset(new_fds, 0, size / 4);
+	memcpy(new_filp, current->filp, current->max_fds * sizeof(struct file *));
+	memcpy(new_fds, current->open_fds, current->max_fds / 8);
+	memcpy(new_fds + size / 32, current->close_on_exec, current->max_fds / 8);
+	if (current->filp != current->fd_array) {
+		free_s(current->filp, current->max_fds * sizeof(struct file *));
+		free_s(current->open_fds, current->max_fds / 4);
+	}
+	current->filp = new_filp;
+	current->open_fds = new_fds;
+	current->close_on_exec = new_fds + size / 32;
+	current->max_fds = size;
+	return 0;
+}
+
+// 为当前进程分配一个不小于 start 的最小空闲描述符, 并在已分配位图中占用它, 同时复位其执行时关闭标志.
+// 位图按长字扫描: 跳过全满的长字, 在第一个含空位的长字中用 bsfl 指令直接找出最低的 0 值位.
+// 若表中已无空位, 则扩展描述符表. 描述符值不能超过 rlim[RLIMIT_NOFILE] 和 NR_OPEN.
+// 返回描述符值, 出错返回出错码(负值). 调用者应在随后设置 filp[fd], 或出错时调用 put_unused_fd().
+int get_unused_fd(unsigned int start) {
+	unsigned long limit, word;
+	unsigned int fd;
+
+	limit = current->rlim[RLIMIT_NOFILE].rlim_cur;
+	if (limit > NR_OPEN) {
+		limit = NR_OPEN;
+	}
+	for (fd = start; fd < current->max_fds; fd = (fd | 31) + 1) {
+		word = current->open_fds[fd >> 5] | ((1UL << (fd & 31)) - 1);	// 屏蔽掉 start 之前的位.
+		if (~word) {
+			fd = (fd & ~31) + ffz(word);
+			break;
+		}
+	}
+	if (fd >= limit) {
+		return -EMFILE;
+	}
+	if (fd >= current->max_fds && expand_fdtable(fd)) {
+		return -EMFILE;
+	}
+	FD_BIT_SET(fd, current->open_fds);
+	FD_BIT_CLR(fd, current->close_on_exec);
+	return fd;
+}
+
+// 释放当前进程的描述符 fd: 清空其文件结构指针, 并复位已分配位图和执行时关闭位图中的对应位.
+void put_unused_fd(unsigned int fd) {
+	current->filp[fd] = NULL;
+	FD_BIT_CLR(fd, current->open_fds);
+	FD_BIT_CLR(fd, current->close_on_exec);
+}
+
+// fork 时为子进程 p 建立描述符表. 此时 p 的任务结构是父进程的复制品, 其指针仍指向父进程的表.
+// 若父进程还在使用内嵌表, 则子进程改用自己的内嵌表(内容已随任务结构复制); 否则复制一份扩展表.
+// 成功返回 0, 内存不够返回 -ENOMEM.
+int dup_fdtable(struct task_struct * p) {
+	if (current->filp == current->fd_array) {
+		p->filp = p->fd_array;
+		p->open_fds = &p->open_fds_init;
+		p->close_on_exec = &p->close_on_exec_init;
+		return 0;
+	}
+	if (!(p->filp = (struct file **) malloc(p->max_fds * sizeof(struct file *)))) {
+		return -ENOMEM;
+	}
+	if (!(p->open_fds = (unsigned long *) malloc(p->max_fds / 4))) {
+		free_s(p->filp, p->max_fds * sizeof(struct file *));
+		return -ENOMEM;
+	}
+	memcpy(p->filp, current->filp, p->max_fds * sizeof(struct file *));
+	memcpy(p->open_fds, current->open_fds, p->max_fds / 4);
+	p->close_on_exec = p->open_fds + p->max_fds / 32;
+	return 0;
+}
+
+// 释放进程 p 扩展过的描述符表, 并恢复使用内嵌表. 调用前进程的描述符应已全部关闭.
+void free_fdtable(struct task_struct * p) {
+	if (p->filp == p->fd_array) {
+		return;
+	}
+	free_s(p->filp, p->max_fds * sizeof(struct file *));
+	free_s(p->open_fds, p->max_fds / 4);
+	p->max_fds = NR_OPEN_DEFAULT;
+	p->filp = p->fd_array;
+	p->open_fds = &p->open_fds_init;
+	p->close_on_exec = &p->close_on_exec_init;
+	memset(p->fd_array, 0, sizeof(p->fd_array));
+	p->open_fds_init = p->close_on_exec_init = 0;
+}
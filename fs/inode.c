@@ -68,6 +68,7 @@ void invalidate_inodes(int dev) {
 			if (inode->i_count) {    								// 若其引用数不为 0, 则显示出错警告. 
 				printk("inode in use on removed disk\n\r");
 			}
+			free_ind_cache(inode);									// 释放缓存的间接块.
 			inode->i_dev = inode->i_dirt = 0;       				// 释放 inode(置设备号为 0). 
 		}
 	}
@@ -91,143 +92,230 @@ void sync_inodes(void) {
 	}
 }
 
-// 文件数据块映射到盘块的处理操作. (block 位图处理函数, bmap - block map)
-// 参数: inode - 文件的 inode 指针; block - 文件的数据块号; create - 创建块标志. 
-// 该函数把指定的文件数据块 block 对应到设备上逻辑块上, 并返回逻辑块号.
-// 如果创建标志置位, 则在设备上对应逻辑块不存在时就申请新磁盘块, 返回文件数据块 block 对应在设备上的逻辑块号(盘块号).
-static int _bmap(struct m_inode * inode, int block, int create) {
-	struct buffer_head * bh;
+// 同步设备 dev 上的所有 inode. 
+// 与 sync_inodes() 相同, 但只处理指定设备的 inode. 日志提交在等待事务句柄结束之后调用它, 
+// 使得提交的元数据中包含这些系统调用修改过的 inode. 
+void sync_dev_inodes(int dev) {
 	int i;
+	struct m_inode * inode;
 
-	// 首先判断参数文件数据块号 block 的有效性. 如果块号小于 0, 则停机. 
-	if (block < 0) {
-		panic("_bmap: block < 0");
+	inode = 0 + inode_table;
+	for (i = 0; i < NR_INODE; i++, inode++) {
+		if (inode->i_dev != dev) {
+			continue;
+		}
+		wait_on_inode(inode);
+		if (inode->i_dev == dev && inode->i_dirt && !inode->i_pipe) {
+			write_inode(inode);
+		}
 	}
-	// 如果块号大于直接块数(7) + 间接块数(512) + 二次间接块数(512 * 512), 则超出文件系统表示范围, 停机.
-	if (block >= 7 + 512 + 512 * 512) {
-		panic("_bmap: block > (7 + 512 + 512 * 512)");
+}
+
+// 释放 inode 中缓存的间接块.
+// 为了避免顺序访问大文件时每个数据块都要重新 bread() 一次间接块, inode 中会保留最近使用的那个间接块(存放数据块号的
+// 一次间接块或二次间接块的二级块)的缓冲块引用(i_ind_bh), 并记录该间接块所映射的第一个文件区段号(i_ind_base).
+// 该引用会占用缓冲块的一个引用计数, 因此在 inode 不再被使用或者文件被截断时必须调用本函数释放.
+void free_ind_cache(struct m_inode * inode) {
+	struct buffer_head * bh;
+
+	// 先清除 inode 中的缓存信息再释放缓冲块, 因为 brelse() 可能会睡眠.
+	if (bh = inode->i_ind_bh) {
+		inode->i_ind_bh = NULL;
+		brelse(bh);
 	}
-	// 然后根据文件块号的大小值和是否设置了创建标志分别进行处理. 如果该块号小于 7, 则使用直接块表示. 
-	if (block < 7) { 												// 直接块.
-		// 如果该块不存在, 并且有创建标志, 则向设备申请一个数据块. 并将该块号添加到 inode 的数据块列表中.
-		// 然后设置 inode 改变时间, 置 inode 已修改标志. 
-		if (create && !inode->i_zone[block]) { 						
-			if (inode->i_zone[block] = new_block(inode->i_dev)) { 	// 函数 new_block() 定义在 fs/bitmap.c 中.
-				inode->i_ctime = CURRENT_TIME;
+}
+
+// 取文件区段(zone) zone 所在的间接块(内部函数).
+// 参数: inode - 文件的 inode 指针; zone - 文件的区段号(>= 7); shift - 区段长度(以数据块计)的对数; create - 创建块标志.
+// 返回存放 zone 区段号的间接块的缓冲块(调用者用完后需 brelse()), 若间接块不存在或创建失败则返回 NULL.
+// 间接块本身也占用一个区段, 但只使用该区段的第一个数据块(512 项).
+// 如果所需的间接块正好是 inode 中缓存的那一块, 就直接使用它, 无需再查找一次间接块或二次间接块的一级块.
+static struct buffer_head * get_ind_block(struct m_inode * inode, int zone, int shift, int create) {
+	struct buffer_head * bh, * old;
+	int base, nr;
+
+	// 先计算出该间接块映射的第一个文件区段号 base. 一次间接块从第 7 个区段开始, 二次间接块的每个二级块映射 512 个区段.
+	if (zone < 7 + 512) {
+		base = 7;
+	} else {
+		base = 7 + 512 + ((zone - 7 - 512) & ~511);
+	}
+	// 若缓存的间接块就是所需的块, 并且其数据仍然有效, 则增加引用计数后直接返回.
+	// 由于 inode 持有该缓冲块的引用, 它不会被 getblk() 挪作它用, 所以其设备号和块号不会改变.
+	bh = inode->i_ind_bh;
+	if (bh && inode->i_ind_base == base && bh->b_uptodate) {
+		bh->b_count++;
+		return bh;
+	}
+	// 否则取得间接块的区段号 nr. 对于一次间接块, 就是 i_zone[7]; 对于二次间接块, 需要读取 i_zone[8] 指向的一级块,
+	// 并取其中第 (zone - 7 - 512) / 512 项. 如果设置了创建标志而相应的区段不存在, 则申请一个新区段.
+	if (base == 7) {
+		if (create && !inode->i_zone[7]) {
+			if (inode->i_zone[7] = new_block(inode->i_dev)) {
 				inode->i_dirt = 1;
+				inode->i_ctime = CURRENT_TIME;
 			}
 		}
-		// 最后返回逻辑块号. 
-		return inode->i_zone[block];
-	}
-	// 如果该块号 >= 7, 且小于 7 + 512, 则说明使用的是一次间接块. 下面对一次间接块进行处理. 
-	// 如果是创建, 并且该 inode 中对应间接块字段 i_zone[7] 是 0, 表明文件是首次使用间接块,
-	// 则需申请一磁盘块用于存放间接块信息, 并将此实际磁盘块号填入间接块字段中. 然后设置 inode 已修改标志和修改时间. 
-	// 如果创建时申请磁盘块失败, 则此时 inode 间接块字段 i_zone[7] 为 0, 则返回 0. 
-	// 或者不是创建, 但 i_zone[7] 原来就为 0, 表明 inode 中没有间接块, 于是映射磁盘块失败, 返回 0 退出.
-	block -= 7;
-	if (block < 512) {
-		// 如果创建标志置位, 同时索引 7 这个位置没有绑定到对应的逻辑块, 则申请一个逻辑块
-		if (create && !inode->i_zone[7]) {
-			if (inode->i_zone[7] = new_block(inode->i_dev)) {
+		nr = inode->i_zone[7];
+	} else {
+		if (create && !inode->i_zone[8]) {
+			if (inode->i_zone[8] = new_block(inode->i_dev)) {
 				inode->i_dirt = 1;
 				inode->i_ctime = CURRENT_TIME;
 			}
 		}
-		if (!inode->i_zone[7]) {
-			return 0;
+		if (!inode->i_zone[8]) {
+			return NULL;
 		}
-		// 现在读取设备上该 inode 的一次间接块. 并取该间接块上第 block 项中的逻辑块号(盘块号)i. 
-		// 每一项占 2 个字节. 如果是创建并且间接块的第 block 项中的逻辑块号为 0 的话, 则申请一磁盘块,
-		// 并让间接块中的第 block 项等于该新逻辑块块号, 然后置位间接块的已修改标志. 
-		// 如果不是创建, 则 i 就是需要映射(寻找)的逻辑块号.
-		if (!(bh = bread(inode->i_dev, inode->i_zone[7]))) {
-			return 0;
+		if (!(bh = bread(inode->i_dev, inode->i_zone[8] << shift))) {
+			return NULL;
 		}
-		i = ((unsigned short *)(bh->b_data))[block];
-		if (create && !i) {
-			if (i = new_block(inode->i_dev)) {
-				((unsigned short *) (bh->b_data))[block] = i;
+		nr = ((unsigned short *)bh->b_data)[(base - 7 - 512) >> 9];
+		if (create && !nr) {
+			if (nr = new_block(inode->i_dev)) {
+				((unsigned short *)(bh->b_data))[(base - 7 - 512) >> 9] = nr;
 				bh->b_dirt = 1;
+				bh->b_meta = 1;
 			}
 		}
-		// 最后释放该间接块占用的缓冲块, 并返回磁盘上新申请或原有的对应 block 的逻辑块块号.
 		brelse(bh);
-		return i;
-	}
-	// 若程序运行到此, 则表明数据块属于二次间接块. 其处理过程与一次间接块类似. 
-	// 下面是对二次间接块的处理. 首先将 block 再减去间接块所容纳的块数(512). 
-	// 然后根据是否设置了创建标志进行创建或寻找处理. 
-	// 如果是新创建并且 inode 的二次间接块字段为 0, 则需申请一磁盘块用于存放二次间接块的一级块信息, 
-	// 并将此实际磁盘块号填入二次间接块字段中. 之后, 置 inode 已修改编制和修改时间. 
-	// 同样地, 如果创建时申请磁盘块失败, 则此时 inode 二次间接块字段 i_zone[8] 为 0, 则返回 0.
-	// 或者不是创建, 但 i_zone[8] 原来变为 0, 表明 inode 中没有间接块, 于是映射磁盘块失败, 返回 0 退出.
-	block -= 512;
-	if (create && !inode->i_zone[8]) {
-		if (inode->i_zone[8] = new_block(inode->i_dev)) {
-			inode->i_dirt = 1;
-			inode->i_ctime = CURRENT_TIME;
-		}
 	}
-	if (!inode->i_zone[8]) {
-		return 0;
+	if (!nr || !(bh = bread(inode->i_dev, nr << shift))) {
+		return NULL;
 	}
-	// 现在读取设备上该 inode 的二次间接块. 并取该二次间接块的一级块上第(block / 512)项中的逻辑块号 i. 
-	// 如果是创建并且二次间接块的一级块上第(block / 512)项中的逻辑块号为 0 的话, 
-	// 则需申请一磁盘块(逻辑块)作为二次间接块的二级块 i, 并让二次间接块的一级块中第(block / 512)项等于该二级块的块号 i. 
-	// 然后置位二次间接块的一级块已修改标志. 并释放二次间接块的一级块. 如果不是创建, 则i就是需要映射(寻找)的逻辑块号.
-	if (!(bh = bread(inode->i_dev, inode->i_zone[8]))) {
-		return 0;
+	// 把新读入的间接块缓存到 inode 中(多占用一个引用计数), 并释放原来缓存的间接块.
+	bh->b_count++;
+	old = inode->i_ind_bh;
+	inode->i_ind_bh = bh;
+	inode->i_ind_base = base;
+	brelse(old);
+	return bh;
+}
+
+// MINIX 文件系统的文件数据块映射到盘块的处理操作(inode 操作函数 bmap). (block 位图处理函数, bmap - block map)
+// 参数: inode - 文件的 inode 指针; block - 起始文件数据块号; count - 要映射的块数; zones - 存放结果的数组; create - 创建块标志.
+// 该函数把从 block 开始的连续 count 个文件数据块对应到设备上的逻辑块, 并把逻辑块号依次存入 zones[] 中. 
+// 如果创建标志置位, 则在设备上对应逻辑块不存在时就申请新磁盘块. 
+// 一个间接块中的多个块号只需读取一次间接块即可全部取出. 返回实际映射的块数, 若创建时申请磁盘块失败则返回值小于 count.
+// 不创建时, 不存在的块(文件空洞)对应的逻辑块号为 0.
+// inode 的 i_zone[] 和间接块中存放的是区段(zone)号. 一个区段由 2^s_log_zone_size 个连续的数据块组成, 
+// 区段 z 中第 k 个数据块的块号是 (z << s_log_zone_size) + k. 对于区段大小等于块大小的文件系统, 区段号就是块号.
+int minix_bmap(struct m_inode * inode, int block, int count, int * zones, int create) {
+	struct super_block * sb;
+	struct buffer_head * bh;
+	int n, i, idx, zone, shift, mask, max;
+
+	// 首先判断参数文件数据块号 block 的有效性. 如果块号小于 0, 则停机. 
+	// 如果块号大于直接区段数(7) + 间接区段数(512) + 二次间接区段数(512 * 512) 所能容纳的块数, 则超出文件系统表示范围, 停机.
+	if (block < 0) {
+		panic("_bmap: block < 0");
 	}
-	i = ((unsigned short *)bh->b_data)[block >> 9];
-	if (create && !i) {
-		if (i = new_block(inode->i_dev)) {
-			((unsigned short *) (bh->b_data))[block >> 9] = i;
-			bh->b_dirt=1;
+	if (!(sb = get_super(inode->i_dev))) {
+		panic("_bmap: trying to map block without super block");
+	}
+	shift = sb->s_log_zone_size;
+	mask = (1 << shift) - 1;
+	max = (7 + 512 + 512 * 512) << shift;
+	if (block >= max) {
+		panic("_bmap: block > (7 + 512 + 512 * 512) zones");
+	}
+	if (block + count > max) {
+		count = max - block;
+	}
+	n = 0;
+	// 对于小于 7 的区段号, 使用直接块表示. 如果该区段不存在, 并且有创建标志, 则向设备申请一个区段. 
+	// 并将该区段号添加到 inode 的数据块列表中, 然后设置 inode 改变时间, 置 inode 已修改标志. 
+	// 然后把该区段中属于映射范围的各数据块的块号依次存入 zones[] 中.
+	while (n < count && (zone = block >> shift) < 7) {
+		if (create && !inode->i_zone[zone]) {
+			if (inode->i_zone[zone] = new_block(inode->i_dev)) {	// 函数 new_block() 定义在 fs/bitmap.c 中.
+				inode->i_ctime = CURRENT_TIME;
+				inode->i_dirt = 1;
+			} else {
+				return n;
+			}
 		}
-	}
-	brelse(bh);
-	// 如果二次间接块的二级块块号为 0, 表示申请磁盘失败或者原来对应块号就为 0, 则返回 0 退出.
-	// 否则就从设备上读取二次间接块的二级块, 
-	// 并取该二级块上第 block 项中的逻辑块号(与上 511 是为了限定 block 值不超过 511).
-	if (!i) {
-		return 0;
-	}
-	if (!(bh = bread(inode->i_dev, i))) {
-		return 0;
-	}
-	i = ((unsigned short *)bh->b_data)[block & 511];
-	// 如果是创建并且二级块的第 block 项中逻辑块号为 0 的话, 则申请一磁盘块(逻辑块), 作为最终存放数据信息的块. 
-	// 并让二级块中的第 block 项等于该新逻辑块块号(i). 然后置位二级块的已修改标志.
-	if (create && !i) {
-		if (i = new_block(inode->i_dev)) {
-			((unsigned short *)(bh->b_data))[block & 511] = i;
-			bh->b_dirt = 1;
+		i = inode->i_zone[zone];
+		do {
+			zones[n++] = i ? (i << shift) + (block & mask) : 0;
+		} while (n < count && (++block & mask));
+	}
+	// 其余的区段都通过间接块映射. 每次取得一个间接块后, 连续取出其中属于本次映射范围的所有区段号. 
+	// 如果间接块不存在(且不创建), 则该间接块映射的所有块都是空洞, 块号为 0.
+	while (n < count) {
+		zone = block >> shift;
+		if (zone < 7 + 512) {
+			idx = zone - 7;
+		} else {
+			idx = (zone - 7 - 512) & 511;
+		}
+		if (!(bh = get_ind_block(inode, zone, shift, create)) && create) {
+			return n;
+		}
+		for (; n < count && idx < 512; idx++) {
+			i = bh ? ((unsigned short *)bh->b_data)[idx] : 0;
+			if (create && !i) {
+				if (!(i = new_block(inode->i_dev))) {
+					brelse(bh);
+					return n;
+				}
+				((unsigned short *)(bh->b_data))[idx] = i;
+				bh->b_dirt = 1;
+				bh->b_meta = 1;
+			}
+			do {
+				zones[n++] = i ? (i << shift) + (block & mask) : 0;
+			} while (n < count && (++block & mask));
 		}
+		brelse(bh);
 	}
-	// 最后释放该二次间接块的二级块, 返回磁盘上新申请的或原有的对应 block 的逻辑块块号.
-	brelse(bh);
-	return i;
+	return n;
 }
 
+// 以下 4 个函数经由 inode 操作函数表调用文件所在文件系统的块映射函数(MINIX 文件系统为 minix_bmap()).
+
 // 取文件数据块 block 在设备上对应的逻辑块号.
 // 参数: inode - 文件的内存 inode 指针; block - 文件中的数据块号.
 // 若操作成功则返回对应的逻辑块号, 否则返回 0.
 int bmap(struct m_inode * inode, int block) {
-	return _bmap(inode, block, 0);
+	int nr;
+
+	if (inode->i_op->bmap(inode, block, 1, &nr, 0) != 1) {
+		return 0;
+	}
+	return nr;
 }
 
 // 取文件数据块 block 在设备上对应的逻辑块号. 如果对应的逻辑块不存在就创建一块. 并返回设备上对应的逻辑块号. 
 // 参数: inode - 文件对应的 inode 指针; block - 文件中的数据块号. 
 // 若操作成功则返回对应的逻辑块号, 否则返回 0.
 int create_block(struct m_inode * inode, int block) {
-	return _bmap(inode, block, 1);
+	int nr;
+
+	if (inode->i_op->bmap(inode, block, 1, &nr, 1) != 1) {
+		return 0;
+	}
+	return nr;
+}
+
+// 取从文件数据块 block 开始的连续 count 个数据块在设备上对应的逻辑块号, 存入 zones[] 中. 
+// 返回映射的块数. 文件空洞对应的逻辑块号为 0.
+int bmap_blocks(struct m_inode * inode, int block, int count, int * zones) {
+	return inode->i_op->bmap(inode, block, count, zones, 0);
+}
+
+// 取从文件数据块 block 开始的连续 count 个数据块在设备上对应的逻辑块号, 不存在的逻辑块就创建. 
+// 返回成功映射的块数, 若申请磁盘块失败则返回值小于 count.
+int create_blocks(struct m_inode * inode, int block, int count, int * zones) {
+	return inode->i_op->bmap(inode, block, count, zones, 1);
 }
 
 // 放回(放置)一个 inode (并将 inode 元数据写入设备). 主要是把 inode 的引用计数 -1.
 // 若是管道 inode, 则唤醒等待的进程.若是块设备文件 inode 则刷新设备. 
 // 如果 inode 的链接计数(i_nlinks)为 0, 则释放该 inode 占用的所有磁盘逻辑块, 并释放该 inode.
 void iput(struct m_inode * inode) {
+	int started;
+
 	// 首先判断参数给出的 inode 的有效性, 并等待 inode 节点解锁(如果已经上锁的话). 
 	// 如果 inode 的引用计数为 0, 表示该 inode 已经是空闲的. 
 	// 内核再要求对其进行放回操作, 说明内核中其他代码有问题. 于是显示错误信息并停机.
@@ -238,19 +326,28 @@ void iput(struct m_inode * inode) {
 	}
 	// 如果是管道 inode, 则唤醒等待该管道的进程, 引用次数减 1, 如果还有引用则返回. 
 	// 否则释放管道占用的内存页面, 并复位该节点的引用计数值, 已修改标志和管道标志, 并返回. 
-	// 对于管道节点, inode -> i_size存放着内存页地址. 参见 get_pipe_inode().
+	// 管道缓冲区的页面地址存放在 pipe_pages[][] 表中. 参见 get_pipe_inode() 和 fs/pipe.c.
 	if (inode->i_pipe) {
 		wake_up(&inode->i_wait);
 		wake_up(&inode->i_wait2);
 		if (--inode->i_count) {
 			return;
 		}
-		free_page(inode->i_size);
+		free_pipe_pages(inode);
 		inode->i_count = 0;
 		inode->i_dirt = 0;
 		inode->i_pipe = 0;
 		return;
 	}
+	// 如果是 epoll 对象的 inode, 则在最后一个引用被放回时释放该 epoll 对象.
+	if (inode->i_epoll) {
+		if (--inode->i_count) {
+			return;
+		}
+		ep_release(inode);
+		inode->i_epoll = 0;
+		return;
+	}
 	// 如果 inode 对应的设备号 = 0, 则将此节点的引用计数递减 1, 返回. 例如用于管道操作的 inode, 其 inode 的设备号为 0.
 	if (!inode->i_dev) {
 		inode->i_count--;
@@ -271,11 +368,14 @@ repeat:
 		return;
 	}
 	// 当前引用计数为 1.
+	// 删除文件要修改位图和 inode, 所以在一个元数据日志事务句柄中进行.
 	if (!inode->i_nlinks) {
+		started = journal_start(inode->i_dev);
 		// 释放该 inode 对应的所有逻辑块.
 		truncate(inode);
 		// 从该设备的超级块中删除该 inode.
 		free_inode(inode);      								// bitmap.c
+		journal_stop(started);
 		return;
 	}
 	// 如果该 inode 已作过修改, 则回写更新该 inode, 并等待该 inode 解锁. 
@@ -286,6 +386,11 @@ repeat:
 		wait_on_inode(inode);									/* 因为我们睡眠了, 所以要重复判断 */
 		goto repeat;
 	}
+	// 该 inode 即将不再被使用, 释放其缓存的间接块. 释放时可能会睡眠, 因此也需要重复进行上述判断.
+	if (inode->i_ind_bh) {
+		free_ind_cache(inode);
+		goto repeat;
+	}
 	// 程序若能执行到此, 说明该 inode 的引用计数值 i_count 是 1, 链接数不为零, 并且内容没有被修改过. 
 	// 因此此时只要把 inode 引用计数递减 1, 返回. 此时该 inode 的 i_count = 0, 表示已释放.
 	inode->i_count--;
@@ -350,20 +455,23 @@ struct m_inode * get_pipe_inode(void) {
 	struct m_inode * inode;
 
 	// 首先从内存 inode 表中取得一个空闲 inode. 如果找不到空闲 inode 则返回 NULL. 
-	// 然后为该 inode 申请一页内存, 并让节点的 i_size 字段指向该页面. 
+	// 然后为该 inode 申请一页内存作为管道缓冲区的第 1 页, 其余页面在写管道时按需分配. 
 	// 如果已没有空闲内存, 则释放该 inode, 并返回 NULL. 
 	if (!(inode = get_empty_inode())) {
 		return NULL;
 	}
-	if (!(inode->i_size = get_free_page())) {         			// 节点的 i_size 字段指向缓冲区. 
+	if (!(PIPE_PAGE(*inode, 0) = get_free_page())) {
 		inode->i_count = 0;
 		return NULL;
 	}
-	// 然后设置该 inode 的引用计数为 2, 并复位管道头尾指针. 
-	// inode 逻辑块号数组 i_zone[] 的 i_zone[0] 和 i_zone[1] 中分别用来存放管道头和管道尾指针. 
+	// 然后设置该 inode 的引用计数为 2, 并复位管道头尾指针和数据长度. 
+	// inode 逻辑块号数组 i_zone[] 的 i_zone[0] 和 i_zone[1] 中分别用来存放管道头和管道尾指针, i_zone[2] 中是缓冲区页数. 
 	// 最后设置 inode 是管道 inode 标志并返回该 inode 号. 
 	inode->i_count = 2;											/* sum of readers/writers */    /* 读/写两者总计 */
 	PIPE_HEAD(*inode) = PIPE_TAIL(*inode) = 0;      			// 复位管道头尾指针. 
+	PIPE_SIZE(*inode) = 0;
+	PIPE_PAGES(*inode) = 1;
+	PIPE_BUSY(*inode) = 0;
 	inode->i_pipe = 1;                              			// 置节点为管道使用标志. 
 	return inode;
 }
@@ -472,15 +580,21 @@ static void read_inode(struct m_inode * inode) {
 	// 因此在上面计算 inode 号对应的 inode 结构所在盘块时需要减 1, 即: B = (inode 号 - 1) / 每块含有 inode 结构数. 
 	// 例如, 节点号 32 的 inode 结构应该在 B = (32 - 1) / 32 = 0 的块上. 
 	// 这里我们从设备上读取该 inode 所在逻辑块, 并复制指定 inode 内容到 inode 指针所指位置处.
-	block = 2 + sb->s_imap_blocks + sb->s_zmap_blocks + ((inode->i_num - 1) / INODES_PER_BLOCK);
-	// 将 inode 信息所在的逻辑块读取到高速缓存中.
-	if (!(bh = bread(inode->i_dev, block))) {
-		panic("unable to read i-node block");
+	// 不在磁盘上保存 inode 的文件系统(tmpfs)则由其超级块操作函数取得 inode 内容.
+	if (sb->s_op) {
+		sb->s_op->read_inode(inode);
+	} else {
+		block = 2 + sb->s_imap_blocks + sb->s_zmap_blocks + ((inode->i_num - 1) / INODES_PER_BLOCK);
+		// 将 inode 信息所在的逻辑块读取到高速缓存中.
+		if (!(bh = bread(inode->i_dev, block))) {
+			panic("unable to read i-node block");
+		}
+		// 复制磁盘上相应的 inode 信息到内存中(只复制指定的那个 inode 信息).
+		*(struct d_inode *)inode = ((struct d_inode *)bh->b_data)[(inode->i_num - 1) % INODES_PER_BLOCK]; 	// 求余得到在该页面内的下标.
+		// 最后释放读入的缓冲块, 并解锁该 inode. 
+		brelse(bh);
 	}
-	// 复制磁盘上相应的 inode 信息到内存中(只复制指定的那个 inode 信息).
-	*(struct d_inode *)inode = ((struct d_inode *)bh->b_data)[(inode->i_num - 1) % INODES_PER_BLOCK]; 	// 求余得到在该页面内的下标.
-	// 最后释放读入的缓冲块, 并解锁该 inode. 
-	brelse(bh);
+	inode->i_op = sb->s_iop;								// inode 操作函数表由所在文件系统决定.
 	// 对于块设备文件(比如 /dev/fd0), 还需要设置 inode 的文件最大长度值.
 	if (S_ISBLK(inode->i_mode)) {
 		int i = inode->i_zone[0];							// 对于块设备文件, i_zone[0] 中是设备号.
@@ -513,6 +627,13 @@ static void write_inode(struct m_inode * inode) {
 	if (!(sb = get_super(inode->i_dev))) {
 		panic("trying to write inode without device");
 	}
+	// tmpfs 的 inode 由其超级块操作函数保存, 不经过高速缓冲.
+	if (sb->s_op) {
+		sb->s_op->write_inode(inode);
+		inode->i_dirt = 0;
+		unlock_inode(inode);
+		return;
+	}
 	// 该 inode 所在的设备逻辑号 = (启动块 + 超级块) + inode 位图占用的块数 + 逻辑块位图占用的块数 + (inode 号 - 1) / 每块含有的 inode 数. 
 	// 我们从设备上读取该i节点所在的逻辑块, 并将该 inode 信息复制到逻辑块对应该 inode 的项位置处.
 	block = 2 + sb->s_imap_blocks + sb->s_zmap_blocks + (inode->i_num - 1) / INODES_PER_BLOCK;
@@ -14,12 +14,15 @@
 extern int tty_ioctl(int dev, int cmd, int arg);
 // fs/pipe.c
 extern int pipe_ioctl(struct m_inode * pino, int cmd, int arg);
+// blk_drv/ramdisk.c
+extern int rd_ioctl(int dev, int cmd, int arg);
 
 // 定义输入输出控制(ioctl)函数指针类型. 
 typedef int (* ioctl_ptr)(int dev, int cmd, int arg);
 
 // 取系统中设备种数的宏. 
 #define NRDEVS ((sizeof(ioctl_table)) / (sizeof(ioctl_ptr)))
+#define NRBLKDEVS ((sizeof(blk_ioctl_table)) / (sizeof(ioctl_ptr)))
 
 // ioctl 操作函数指针表. 
 static ioctl_ptr ioctl_table[] = {
@@ -33,6 +36,15 @@ static ioctl_ptr ioctl_table[] = {
 	NULL		/* named pipes */
 };
 
+// 块设备的 ioctl 操作函数指针表. 块设备与字符设备的主设备号各自编号(块设备 1 号是虚拟盘, 字符设备 1 号是 /dev/mem), 
+// 所以分开成两个表. 
+static ioctl_ptr blk_ioctl_table[] = {
+	NULL,		/* nodev */
+	rd_ioctl,	/* /dev/ram */
+	NULL,		/* /dev/fd */
+	NULL		/* /dev/hd */
+};
+
 // 系统调用函数 - 输入输出控制函数. 
 // 该函数首先判断参数给出的文件描述符是否有效. 然后根据对应 inode 中文件属性判断文件类型, 
 // 并根据具体文件类型调用相关的处理函数. 
@@ -44,7 +56,7 @@ int sys_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg) {
 
 	// 首先判断给出的文件描述符的有效性. 如果文件描述符超出可打开的文件数, 
 	// 或者对应描述符的文件结构指针为空, 则返回出错码退出. 
-	if (fd >= NR_OPEN || !(filp = current->filp[fd])) {
+	if (fd >= current->max_fds || !(filp = current->filp[fd])) {
 		return -EBADF;
 	}
 	// 如果文件结构对应的是管道 inode, 则根据进程是否有权操作该管道确定是否执行管道 IO 控制操作. 
@@ -59,6 +71,16 @@ int sys_ioctl(unsigned int fd, unsigned int cmd, unsigned long arg) {
 		return -EINVAL;
 	}
 	dev = filp->f_inode->i_zone[0];
+	// 块设备文件使用块设备的 IO 控制表. 
+	if (S_ISBLK(mode)) {
+		if (MAJOR(dev) >= NRBLKDEVS) {
+			return -ENODEV;
+		}
+		if (!blk_ioctl_table[MAJOR(dev)]) {
+			return -ENOTTY;
+		}
+		return blk_ioctl_table[MAJOR(dev)](dev, cmd, arg);
+	}
 	if (MAJOR(dev) >= NRDEVS) {
 		return -ENODEV;
 	}
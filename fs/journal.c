@@ -0,0 +1,425 @@
+/*
+ *  linux/fs/journal.c
+ */
+
+/*
+ * journal.c implements an optional write-ahead log for the MINIX file
+ * system metadata (super/bitmap/inode blocks, directory and indirect
+ * blocks). Dirty metadata is first written sequentially to a reserved
+ * area of the partition together with a commit record, and only then to
+ * its home location. A file system that was not unmounted cleanly just
+ * replays the log on the next mount.
+ */
+/*
+ * journal.c 实现了 MINIX 文件系统元数据(超级块/位图/inode 块, 目录块和间接块)的可选预写日志.
+ * 已修改的元数据先连同一个提交记录一起顺序地写入分区上的保留区域(日志区), 然后才写到它们原来的位置上.
+ * 对于没有正常卸载的文件系统, 下次安装时只需重放日志即可.
+ */
+
+/*
+ * 日志区的位置由超级块中的 s_jstart 和 s_jblocks 字段给出(由建立文件系统的程序设置), 它必须位于数据区之后.
+ * s_jblocks 为 0 表示该文件系统不使用日志. 日志区第 1 块是日志头(提交记录), 其后各块依次存放元数据块的副本.
+ *
+ * 一次提交的过程如下:
+ * 1. 把所有已修改的元数据块写到日志区中日志头之后的各块中, 并等待写完成;
+ * 2. 写日志头, 其中记录了这些块原来的块号, 日志头写完即表示提交完成;
+ * 3. 把这些元数据块写回它们原来的位置(检查点), 并等待写完成;
+ * 4. 把日志头中的块数清零并写盘, 表示日志区中已没有需要重放的内容.
+ *
+ * 写入日志和检查点的都是收集时复制到私有页面中的块内容(快照), 而不是缓冲块本身. 因此提交期间(写盘时会睡眠)
+ * 其他进程对缓冲块的修改不会混进本次事务; 这些修改后的缓冲块仍保持已修改状态, 由下一次提交写盘.
+ *
+ * 为了使每次提交的都是完整系统调用的结果, 修改元数据的系统调用在执行期间持有该文件系统的一个事务句柄
+ * (journal_start()/journal_stop()). sys_sync() 提交日志前会等待该文件系统的所有句柄结束, 并在提交期间不允许在该
+ * 文件系统上开始新的句柄, 其他文件系统上的系统调用不受影响. 因此各系统调用的修改被成批地一起提交.
+ * 由于缺少空闲缓冲块而在 getblk() 中引起的提交则不等待句柄结束, 因为等待的进程此时可能正锁着其他进程需要的 inode.
+ *
+ * 限制: 一次事务最多记录 JOURNAL_MAX 块, 并且不能超过日志区的大小(s_jblocks - 1 块). 已修改的元数据块超过这个数目时,
+ * 提交会被分成几个事务依次进行, 这时一组系统调用的修改可能分别落在两个事务中; 若恰好在两个事务之间崩溃, 重放后
+ * 只能得到前一部分修改. 日志区应当足够大(至少 JOURNAL_MAX + 1 块), 使得正常情况下一次提交只需一个事务.
+ * 持有句柄的进程同时修改另一个文件系统时(嵌套调用), 对另一个文件系统的修改不受句柄保护.
+ */
+
+#include <string.h>
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <asm/system.h>
+
+#define JOURNAL_MAGIC	0x4A4E4C31										// 日志头魔数("JNL1").
+#define JOURNAL_MAX		((BLOCK_SIZE - 3 * sizeof(long)) / sizeof(long))	// 一次事务最多可以记录的块数(253).
+#define JOURNAL_IO		16												// 一次同时提交给设备的写请求数.
+#define JOURNAL_PER_PAGE	(PAGE_SIZE / BLOCK_SIZE)						// 每个快照页面存放的块数.
+
+// 日志头结构, 正好占用一个数据块.
+struct journal_header {
+	unsigned long j_magic;						// 日志头魔数, 只有提交完成的日志头才含有正确的魔数.
+	unsigned long j_sequence;					// 事务序号.
+	unsigned long j_count;						// 日志中记录的块数, 0 表示没有需要重放的内容.
+	unsigned long j_blocks[JOURNAL_MAX];		// 日志中各块对应的原来的块号.
+};
+
+// 下面这些提交用的数组为所有文件系统共用, 由 journal_writing 保证同一时刻只有一个进程在写日志.
+static struct journal_header journal_head;					// 正在提交的事务的日志头.
+static struct buffer_head * journal_list[JOURNAL_MAX];		// 正在提交的事务所含的元数据缓冲块.
+static unsigned long journal_copy[(JOURNAL_MAX + JOURNAL_PER_PAGE - 1) / JOURNAL_PER_PAGE];	// 快照页面, 提交时按需分配.
+static struct buffer_head journal_io[JOURNAL_IO];			// 写日志时使用的私有缓冲块头(不在 hash 表和空闲链表中).
+static unsigned long journal_sequence = 0;
+
+static int journal_writing = 0;								// 正在写日志.
+static struct task_struct * journal_wait = NULL;			// 等待日志状态变化的进程队列.
+
+// 事务中第 nr 块的快照地址.
+#define journal_data(nr) ((char *) journal_copy[(nr) / JOURNAL_PER_PAGE] + ((nr) % JOURNAL_PER_PAGE) * BLOCK_SIZE)
+
+static inline void wait_on_buffer(struct buffer_head * bh) {
+	cli();
+	while (bh->b_lock) {
+		sleep_on(&bh->b_wait);
+	}
+	sti();
+}
+
+// 取设备 dev 的超级块(内部函数). 与 get_super() 不同, 这里不会睡眠.
+// 设备号 0 (管道等)没有超级块, 不能让它匹配上空闲的超级块项.
+static struct super_block * journal_super(int dev) {
+	struct super_block * sb;
+
+	if (!dev) {
+		return NULL;
+	}
+	for (sb = super_block; sb < super_block + NR_SUPER; sb++) {
+		if (sb->s_dev == dev) {
+			return sb;
+		}
+	}
+	return NULL;
+}
+
+// 判断缓冲块是否含有文件系统的元数据(内部函数).
+// 数据区之前的块(引导块, 超级块, 位图和 inode 块)都是元数据; 数据区中的目录块和间接块由 b_meta 标志指明.
+static inline int is_meta(struct super_block * sb, struct buffer_head * bh) {
+	return bh->b_meta || bh->b_blocknr < ((unsigned long) sb->s_firstdatazone << sb->s_log_zone_size);
+}
+
+// 判断已修改的缓冲块是否要通过日志写盘.
+// sys_sync() 和 sync_dev() 在直接写缓冲块之前调用本函数, 对于使用日志的设备上的元数据块, 它们不能绕过日志直接写回.
+int journal_owns(struct buffer_head * bh) {
+	struct super_block * sb;
+
+	if (!bh->b_dirt || !(sb = journal_super(bh->b_dev)) || !sb->s_jblocks) {
+		return 0;
+	}
+	return is_meta(sb, bh);
+}
+
+// 在设备 dev 的文件系统上开始一个事务句柄. 修改元数据的系统调用在开始修改前调用本函数, 结束时以其返回值调用 journal_stop().
+// 若当前进程已持有句柄(嵌套调用)或该设备不使用日志, 则返回 0, 否则返回 1. 
+// 如果该文件系统正在提交日志, 则等待提交完成后再开始; 其他文件系统上的提交不影响本函数.
+int journal_start(int dev) {
+	struct super_block * sb;
+
+	if (current->flags & PF_JOURNAL) {
+		return 0;
+	}
+repeat:
+	if (!(sb = journal_super(dev)) || !sb->s_jblocks) {
+		return 0;
+	}
+	if (sb->s_jdraining || sb->s_jcommitting) {
+		sleep_on(&journal_wait);
+		goto repeat;
+	}
+	current->flags |= PF_JOURNAL;
+	current->journal_sb = sb - super_block;
+	sb->s_jhandles++;
+	return 1;
+}
+
+// 结束事务句柄. 参数 started 是对应的 journal_start() 的返回值.
+// 当文件系统上的最后一个句柄结束时, 唤醒等待提交日志的进程.
+void journal_stop(int started) {
+	struct super_block * sb;
+
+	if (!started) {
+		return;
+	}
+	current->flags &= ~PF_JOURNAL;
+	sb = super_block + current->journal_sb;
+	if (!--sb->s_jhandles) {
+		wake_up(&journal_wait);
+	}
+}
+
+// 同步写一批缓冲块并等待完成(内部函数). 若全部写成功则返回 1, 否则返回 0.
+static int write_wait(struct buffer_head ** bh, int nr) {
+	int i, ok = 1;
+
+	for (i = 0; i < nr; i++) {
+		bh[i]->b_dirt = 1;
+		ll_rw_block(WRITE, bh[i]);
+	}
+	for (i = 0; i < nr; i++) {
+		wait_on_buffer(bh[i]);
+		if (!bh[i]->b_uptodate) {
+			ok = 0;
+		}
+	}
+	return ok;
+}
+
+// 设置私有缓冲块头 journal_io[slot], 用来把数据 data 写到设备的第 block 块(内部函数).
+static struct buffer_head * journal_block(struct super_block * sb, int slot, unsigned long block, char * data) {
+	struct buffer_head * bh = journal_io + slot;
+
+	bh->b_data = data;
+	bh->b_dev = sb->s_dev;
+	bh->b_blocknr = block;
+	bh->b_uptodate = 1;
+	bh->b_lock = 0;
+	bh->b_count = 1;
+	bh->b_wait = NULL;
+	return bh;
+}
+
+// 写日志头(内部函数).
+static int write_header(struct super_block * sb) {
+	struct buffer_head * bh = journal_block(sb, 0, sb->s_jstart, (char *) &journal_head);
+
+	return write_wait(&bh, 1);
+}
+
+// 把事务中的 nr 块快照写到日志区或它们原来的位置(内部函数), 每次最多同时提交 JOURNAL_IO 个写请求.
+static int write_copies(struct super_block * sb, int nr, int home) {
+	struct buffer_head * io[JOURNAL_IO];
+	int i, j, ok = 1;
+
+	for (i = 0; i < nr; i += JOURNAL_IO) {
+		for (j = 0; j < JOURNAL_IO && i + j < nr; j++) {
+			io[j] = journal_block(sb, j, home ? journal_head.j_blocks[i + j] : sb->s_jstart + 1 + i + j,
+				journal_data(i + j));
+		}
+		if (!write_wait(io, j)) {
+			ok = 0;
+		}
+	}
+	return ok;
+}
+
+// 提交一个事务(内部函数). journal_list[] 中的 nr 个缓冲块已增加了引用计数, 它们的内容已复制到快照中.
+static void commit_transaction(struct super_block * sb, int nr) {
+	struct buffer_head * bh;
+	int i, ok, done;
+
+	// 首先把各元数据块的快照顺序写到日志区, 然后写入日志头, 日志头写完后事务即提交完成.
+	// 若写日志出错, 则不写日志头, 直接把元数据写回原处.
+	for (i = 0; i < nr; i++) {
+		journal_head.j_blocks[i] = journal_list[i]->b_blocknr;
+	}
+	if (ok = write_copies(sb, nr, 0)) {
+		journal_head.j_magic = JOURNAL_MAGIC;
+		journal_head.j_sequence = ++journal_sequence;
+		journal_head.j_count = nr;
+		ok = write_header(sb);
+	}
+	if (!ok) {
+		printk("journal: write error on dev %04x, writing metadata in place\n\r", sb->s_dev);
+	}
+	// 接着把快照写回原来的位置(检查点). 写成功后, 内容与快照相同(提交期间没有再被修改)的缓冲块才可以清除已修改标志.
+	// 检查点写失败时缓冲块保持已修改状态, 日志头也不清除, 下次安装时重放.
+	if (!(done = write_copies(sb, nr, 1))) {
+		printk("journal: checkpoint error on dev %04x\n\r", sb->s_dev);
+	}
+	for (i = 0; i < nr; i++) {
+		bh = journal_list[i];
+		if (done && bh->b_dirt && !memcmp(bh->b_data, journal_data(i), BLOCK_SIZE)) {
+			bh->b_dirt = 0;
+		}
+		brelse(bh);
+	}
+	// 最后清除日志头中的块数, 此后日志区中没有需要重放的内容.
+	if (ok && done) {
+		journal_head.j_count = 0;
+		write_header(sb);
+	}
+}
+
+// 确保事务中第 nr 块的快照页面已分配(内部函数). 成功返回 1, 内存不足返回 0. 分配页面时可能睡眠.
+static int journal_page(int nr) {
+	unsigned long page;
+
+	if (journal_copy[nr / JOURNAL_PER_PAGE]) {
+		return 1;
+	}
+	if (!(page = get_free_page())) {
+		return 0;
+	}
+	journal_copy[nr / JOURNAL_PER_PAGE] = page;
+	return 1;
+}
+
+// 提交设备 dev 的日志.
+// 把该设备上所有已修改的元数据块经由日志写盘. 参数 barrier 非 0 时, 先等待该文件系统上的所有事务句柄结束,
+// 使得提交的是一组完整的系统调用的结果. 当前进程自己持有句柄时不能等待.
+void journal_commit(int dev, int barrier) {
+	struct super_block * sb;
+	struct buffer_head * bh;
+	int i, nr;
+
+	if (current->flags & PF_JOURNAL) {
+		barrier = 0;
+	}
+	// 同一时刻只能有一个进程写日志. 同一文件系统上等待句柄结束的进程同一时刻也只能有一个.
+	// 睡眠期间文件系统可能已被卸载, 所以每次醒来都要重新取超级块.
+repeat:
+	if (!(sb = journal_super(dev)) || !sb->s_jblocks) {
+		return;
+	}
+	if (journal_writing || (barrier && sb->s_jdraining)) {
+		sleep_on(&journal_wait);
+		goto repeat;
+	}
+	if (barrier) {
+		sb->s_jdraining = 1;
+		while (sb->s_jhandles) {
+			sleep_on(&journal_wait);
+		}
+		// 句柄全部结束后, 先把这些系统调用修改过的内存 inode 写入缓冲块, 再收集已修改的元数据块. 
+		// 否则事务中可能只有目录项和位图, 而没有相应的 inode 块, 重放后文件系统不一致. 
+		// 这期间仍然不允许开始新的句柄.
+		sync_dev_inodes(dev);
+		sb->s_jdraining = 0;
+		if (journal_writing) {
+			goto repeat;
+		}
+	}
+	journal_writing = 1;
+	sb->s_jcommitting = 1;
+	// 收集设备上已修改的元数据块并立即复制到快照中, 每凑满一个事务(或日志区已满)就提交一次.
+	// 在这里分批提交时, 一组系统调用的修改可能被分到两个事务中, 见文件开始处的说明.
+	nr = 0;
+	bh = start_buffer;
+	for (i = 0; i < NR_BUFFERS; i++, bh++) {
+		if (bh->b_dev != dev || !bh->b_dirt || !is_meta(sb, bh)) {
+			continue;
+		}
+		// 快照页面不够时先提交已收集的块, 腾出页面. 连一个页面也没有时只好不经日志直接写回该块.
+		if (!journal_page(nr) && nr) {
+			commit_transaction(sb, nr);
+			nr = 0;
+		}
+		bh->b_count++;
+		wait_on_buffer(bh);
+		if (bh->b_dev != dev || !bh->b_dirt) {
+			bh->b_count--;
+			continue;
+		}
+		if (!journal_copy[0]) {
+			printk("journal: out of memory on dev %04x, writing metadata in place\n\r", dev);
+			write_wait(&bh, 1);
+			brelse(bh);
+			continue;
+		}
+		memcpy(journal_data(nr), bh->b_data, BLOCK_SIZE);
+		journal_list[nr++] = bh;
+		if (nr >= JOURNAL_MAX || nr >= sb->s_jblocks - 1) {
+			commit_transaction(sb, nr);
+			nr = 0;
+		}
+	}
+	if (nr) {
+		commit_transaction(sb, nr);
+	}
+	for (i = 0; i < sizeof(journal_copy) / sizeof(journal_copy[0]); i++) {
+		if (journal_copy[i]) {
+			free_page(journal_copy[i]);
+			journal_copy[i] = 0;
+		}
+	}
+	sb->s_jcommitting = 0;
+	journal_writing = 0;
+	wake_up(&journal_wait);
+}
+
+// 提交所有使用日志的文件系统的日志, 并等待事务句柄结束. 由 sys_sync() 调用.
+void journal_sync(void) {
+	int i;
+
+	for (i = 0; i < NR_SUPER; i++) {
+		if (super_block[i].s_dev && super_block[i].s_jblocks) {
+			journal_commit(super_block[i].s_dev, 1);
+		}
+	}
+}
+
+// 检查日志头中记录的块号是否有效(内部函数). 有效的块号必须在文件系统范围之内, 并且不能落在日志区中.
+// 注意数据区之前的超级块, 位图和 inode 块也是被记录的元数据, 所以下限是 0 而不是 s_firstdatazone.
+static int journal_valid(struct super_block * sb, struct journal_header * head) {
+	unsigned long block;
+	int i;
+
+	for (i = 0; i < head->j_count; i++) {
+		block = head->j_blocks[i];
+		if (block >= ((unsigned long) sb->s_nzones << sb->s_log_zone_size)
+			|| (block >= sb->s_jstart && block < sb->s_jstart + sb->s_jblocks)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// 检查并重放日志.
+// 在安装文件系统时由 read_super() 在读取位图之前调用. 若日志区位置无效, 则不使用日志.
+// 如果日志头表明有已提交但可能还没有写回原处的事务, 就把日志中的各块复制回原来的位置, 然后清除日志头.
+// 日志头中有无效块号时说明日志已损坏, 这时不重放任何块, 并且不再使用日志.
+void journal_replay(struct super_block * sb) {
+	struct buffer_head * hbh, * bh, * home;
+	struct journal_header * head;
+	int i;
+
+	if (!sb->s_jblocks) {
+		return;
+	}
+	if (sb->s_jblocks < 2 || sb->s_jstart < ((unsigned long) sb->s_nzones << sb->s_log_zone_size)) {
+		printk("journal: bad journal area on dev %04x, journal disabled\n\r", sb->s_dev);
+		sb->s_jblocks = 0;
+		return;
+	}
+	if (!(hbh = bread(sb->s_dev, sb->s_jstart))) {
+		printk("journal: unable to read journal on dev %04x, journal disabled\n\r", sb->s_dev);
+		sb->s_jblocks = 0;
+		return;
+	}
+	head = (struct journal_header *) hbh->b_data;
+	if (head->j_magic == JOURNAL_MAGIC && head->j_count && head->j_count <= JOURNAL_MAX
+		&& head->j_count < sb->s_jblocks) {
+		if (!journal_valid(sb, head)) {
+			printk("journal: corrupt journal on dev %04x, journal disabled\n\r", sb->s_dev);
+			sb->s_jblocks = 0;
+			brelse(hbh);
+			return;
+		}
+		printk("journal: replaying %d blocks on dev %04x\n\r", head->j_count, sb->s_dev);
+		for (i = 0; i < head->j_count; i++) {
+			if (!(bh = bread(sb->s_dev, sb->s_jstart + 1 + i))) {
+				panic("journal: unable to read journal block");
+			}
+			home = getblk(sb->s_dev, head->j_blocks[i]);
+			memcpy(home->b_data, bh->b_data, BLOCK_SIZE);
+			home->b_uptodate = 1;
+			home->b_dirt = 1;
+			ll_rw_block(WRITE, home);
+			wait_on_buffer(home);
+			brelse(home);
+			brelse(bh);
+		}
+		head->j_count = 0;
+		hbh->b_dirt = 1;
+		ll_rw_block(WRITE, hbh);
+		wait_on_buffer(hbh);
+	}
+	if (head->j_magic == JOURNAL_MAGIC) {
+		journal_sequence = head->j_sequence;
+	}
+	brelse(hbh);
+}
@@ -167,29 +167,9 @@ static int match(int len, const char * name, struct dir_entry * de) {
 // 并在 *res_dir 处返回的目录项结构指针. 失败则返回空指针 NULL.
 static struct buffer_head * find_entry(struct m_inode ** dir, const char * name, 
 										int namelen, struct dir_entry ** res_dir) {
-	int entries;
-	int block, i;
-	struct buffer_head * bh;
-	struct dir_entry * de; 										// 目录项指针.
 	struct super_block * sb;
 
-	// 同样, 本函数一开始也需要对函数参数的有效性进行判断和验证. 
-	// 如果我们在本文件前面的代码中定义了符号常数 NO_TRUNCATE, 
-	// 那么如果文件名长度超过最大长度 NAME_LEN, 则不予处理. 
-	// 如果没有定义过 NO_TRUNCATE, 那么在文件名长度超过最大长度 NAME_LEN 时截短之.
-#ifdef NO_TRUNCATE
-	if (namelen > NAME_LEN) {
-		return NULL;
-	}
-#else
-	if (namelen > NAME_LEN) {
-		namelen = NAME_LEN;
-	}
-#endif
-	// 首先计算本目录中目录项数 entries. 目录 inode  i_size 字段表示本目录的数据长度, 
-	entries = (*dir)->i_size / (sizeof(struct dir_entry)); 	// 该目录(文件)可以保存多少个目录项(dir_entry).
-	*res_dir = NULL; 											// 先置空目录项指针.
-	// 接下来我们对目录项文件名是 '..' 的情况进行特殊处理. 如果当前进程指定的根 inode 就是函数参数指定的目录, 
+	// 首先对目录项文件名是 '..' 的情况进行特殊处理. 如果当前进程指定的根 inode 就是函数参数指定的目录, 
 	// 则说明对于本进程来说, 这个目录就是它的伪根目录, 即进程只能访问该目录中的项而不能退到其父目录中去. 
 	// 也即对于该进程本目录就如同是文件系统的根目录. 因此我们需要将文件名修改为 '.'.
 	// 否则, 如果该目录的 inode 号等于 ROOT_INO(1 号)的话, 说明确实是文件系统的根 inode. 则取文件系统的超级块. 
@@ -217,14 +197,42 @@ static struct buffer_head * find_entry(struct m_inode ** dir, const char * name,
 			}
 		}
 	}
+	// 然后由目录所在文件系统的查找函数在目录数据中搜索(MINIX 文件系统为 minix_find_entry()).
+	return (*dir)->i_op->lookup(*dir, name, namelen, res_dir);
+}
+
+// MINIX 文件系统的目录项查找函数(inode 操作函数 lookup). 在目录 dir 的数据中搜索名字为 name 的目录项.
+// 返回含有该目录项的缓冲块, 并在 *res_dir 处返回目录项指针. 没有找到则返回 NULL.
+struct buffer_head * minix_find_entry(struct m_inode * dir, const char * name, int namelen, struct dir_entry ** res_dir) {
+	int entries;
+	int block, i;
+	struct buffer_head * bh;
+	struct dir_entry * de; 										// 目录项指针.
+
+	// 同样, 本函数一开始也需要对函数参数的有效性进行判断和验证. 
+	// 如果我们在本文件前面的代码中定义了符号常数 NO_TRUNCATE, 
+	// 那么如果文件名长度超过最大长度 NAME_LEN, 则不予处理. 
+	// 如果没有定义过 NO_TRUNCATE, 那么在文件名长度超过最大长度 NAME_LEN 时截短之.
+#ifdef NO_TRUNCATE
+	if (namelen > NAME_LEN) {
+		return NULL;
+	}
+#else
+	if (namelen > NAME_LEN) {
+		namelen = NAME_LEN;
+	}
+#endif
+	// 首先计算本目录中目录项数 entries. 目录 inode  i_size 字段表示本目录的数据长度, 
+	entries = dir->i_size / (sizeof(struct dir_entry)); 	// 该目录(文件)可以保存多少个目录项(dir_entry).
+	*res_dir = NULL; 											// 先置空目录项指针.
 	// 现在我们开始正常操作, 查找指定名字的目录项在什么地方. 
 	// 我们需要读取当前 inode 的数据区, 即取出当前 inode 在块设备中的数据块(逻辑块)信息. 
 	// 这些逻辑块的块号保存在 inode 结构的 i_zone[] 数组中. 我们先取其中第 1 个块号. 
-	if (!(block = (*dir)->i_zone[0])) {			// 如果第一个逻辑块号为 0, 则表示出错.
+	if (!(block = bmap(dir, 0))) {				// 如果第一个逻辑块号为 0, 则表示出错.
 		return NULL;
 	}
 	// 从设备中读取指定的目录项数据块. 如果不成功, 则返回 NULL 退出.
-	if (!(bh = bread((*dir)->i_dev, block))) {
+	if (!(bh = bread(dir->i_dev, block))) {
 		return NULL;
 	}
 	// 在当前的目录 inode 数据块中搜索匹配指定名字的目录项. 首先让 de 指向缓冲块中的数据块部分, 
@@ -241,13 +249,13 @@ static struct buffer_head * find_entry(struct m_inode ** dir, const char * name,
 			brelse(bh); 										// 则释放该数据块.
 			bh = NULL; 											// 并读取下一个数据块, 如果为空则跳过该块.
 			// 如果块号为 0, 或者从设备中读取这个数据块失败, 则跳过这个数据块并继续搜寻下一个数据块.
-			if (!(block = bmap(*dir, i / DIR_ENTRIES_PER_BLOCK)) || !(bh = bread((*dir)->i_dev, block))) { 
+			if (!(block = bmap(dir, i / DIR_ENTRIES_PER_BLOCK)) || !(bh = bread(dir->i_dev, block))) { 
 				i += DIR_ENTRIES_PER_BLOCK;
 				continue;
 			}
 			de = (struct dir_entry *)bh->b_data;
 		}
-		// 如果找到匹配的目录项的话, 则返回该目录项指针 de 和该目录项 inode 指针 *dir 以及该目录项数据块指针 bh, 
+		// 如果找到匹配的目录项的话, 则返回该目录项指针 de 以及该目录项数据块指针 bh, 
 		// 并退出函数. 否则继续在目录项数据块中比较下一个目录项.
 		if (match(namelen, name, de)) {
 			*res_dir = de; 								// 找到 name 对应的目录项了, 更新这个指针.
@@ -279,10 +287,15 @@ static struct buffer_head * find_entry(struct m_inode ** dir, const char * name,
  * 注意!! 'de'(指定目录项结构指针) 的 inode 部分被设置为 0 - 这表示在调用该函数和往目录项中添加信息之间不能去睡眠, 
  * 因为如果睡眠, 那么其他人(进程)可能会使用该目录项. 
  */
-// 根据指定的目录和文件名添加目录项. 
+// 根据指定的目录和文件名添加目录项. 由目录所在文件系统的函数完成(MINIX 文件系统为 minix_add_entry()).
 // 参数: dir - 指定目录的 inode ; name - 文件名; namelen - 文件名长度; 
 // 返回: 高速缓冲区指针; res_dir - 返回的目录项结构指针. 
-static struct buffer_head * add_entry(struct m_inode * dir, const char * name, int namelen, struct dir_entry ** res_dir) {
+static inline struct buffer_head * add_entry(struct m_inode * dir, const char * name, int namelen, struct dir_entry ** res_dir) {
+	return dir->i_op->create(dir, name, namelen, res_dir);
+}
+
+// MINIX 文件系统的目录项添加函数(inode 操作函数 create). 参数和返回值与 add_entry() 相同.
+struct buffer_head * minix_add_entry(struct m_inode * dir, const char * name, int namelen, struct dir_entry ** res_dir) {
 	int block, i;
 	struct buffer_head * bh;
 	struct dir_entry * de;
@@ -307,7 +320,7 @@ static struct buffer_head * add_entry(struct m_inode * dir, const char * name, i
 	// 另外, 如果参数提供的文件名长度等于 0, 则也返回 NULL 退出. 
 	if (!namelen) return NULL;
 
-	if (!(block = dir->i_zone[0])) {
+	if (!(block = bmap(dir, 0))) {
 		return NULL;
 	}
 	if (!(bh = bread(dir->i_dev, block))) {
@@ -358,6 +371,7 @@ static struct buffer_head * add_entry(struct m_inode * dir, const char * name, i
 				de->name[i] = (i < namelen) ? get_fs_byte(name + i) : 0;
 			}
 			bh->b_dirt = 1;
+			bh->b_meta = 1;
 			*res_dir = de;
 			return bh;
 		}
@@ -399,7 +413,7 @@ static struct m_inode * follow_link(struct m_inode * dir, struct m_inode * inode
 	// 并且文件内容已经在 bh 指向的缓冲块数据区中. 
 	// 实际上, 这个缓冲块数据区中仅包含一个链接指向的文件路径名字符串.
 	__asm__("mov %%fs, %0" : "=r" (fs));
-	if (fs != 0x17 || !inode->i_zone[0] || !(bh = bread(inode->i_dev, inode->i_zone[0]))) {
+	if (fs != 0x17 || !inode->i_zone[0] || !(bh = bread(inode->i_dev, bmap(inode, 0)))) {
 		iput(dir);
 		iput(inode);
 		return NULL;
@@ -650,7 +664,7 @@ struct m_inode * namei(const char * pathname) {
 // 返回: 成功返回 0, 否则返回出错码; 
 int open_namei(const char * pathname, int flag, int mode, struct m_inode ** res_inode) {
 	const char * basename;
-	int inr, dev, namelen;
+	int inr, dev, namelen, started;
 	struct m_inode * dir, * inode;
 	struct buffer_head * bh;
 	struct dir_entry * de;
@@ -703,9 +717,12 @@ int open_namei(const char * pathname, int flag, int mode, struct m_inode ** res_
 		// 若失败则放回目录的 inode, 并返回没有空间出错码. 
 		// 否则使用该新 inode, 对其进行初始设置: 置节点的用户 id; 对应节点访问模式; 置已修改标志. 
 		// 然后并在指定目录 dir 中添加一个新目录项. 
+		// 创建文件要修改位图, inode 和目录, 因此在该文件系统的一个元数据日志事务句柄中进行.
+		started = journal_start(dir->i_dev);
 		inode = new_inode(dir->i_dev); 				// (fs/bitmap.c)
 		if (!inode) {
 			iput(dir);
+			journal_stop(started);
 			return -ENOSPC;
 		}
 		inode->i_uid = current->euid;
@@ -720,12 +737,15 @@ int open_namei(const char * pathname, int flag, int mode, struct m_inode ** res_
 			inode->i_nlinks--;
 			iput(inode);
 			iput(dir);
+			journal_stop(started);
 			return -ENOSPC;
 		}
 		de->inode = inode->i_num; 					// 设置目录项的 inode 编号.
 		bh->b_dirt = 1; 							// 更新 dirt 标志, 因为添加了新的目录项. 需要刷写到硬盘上.
+		bh->b_meta = 1;
 		brelse(bh); 								// 释放这个缓存块, 引用次数 -1.
 		iput(dir); 									// 释放目录 inode.
+		journal_stop(started);
 		*res_inode = inode; 						// 最终得到最深层目录/文件的 inode.
 		return 0;
     }
@@ -753,7 +773,9 @@ int open_namei(const char * pathname, int flag, int mode, struct m_inode ** res_
 	// 最后返回该目录项 inode 的指针. 并返回 0(成功).
 	inode->i_atime = CURRENT_TIME;
 	if (flag & O_TRUNC) {
+		started = journal_start(inode->i_dev);
 		truncate(inode);
+		journal_stop(started);
 	}
 	*res_inode = inode;
 	return 0;
@@ -761,8 +783,9 @@ int open_namei(const char * pathname, int flag, int mode, struct m_inode ** res_
 
 // 创建一个设备特殊文件或普通文件节点(node). 
 // 该函数创建名称为 filename, 由 mode 和 dev 指定的文件系统节点(普通文件, 设备特殊文件或命名管道). 
-// 参数: filename - 路径名; mode - 指定使用许可以及所创建节点的类型; dev - 设备号. 
-int sys_mknod(const char * filename, int mode, int dev) {
+// 参数: filename - 路径名; mode - 指定使用许可以及所创建节点的类型; dev - 设备号; 
+// started - 返回在目录所在文件系统上开始的日志事务句柄, 由调用者以它调用 journal_stop(). 下面几个 do_xxx() 函数也一样.
+static int do_mknod(const char * filename, int mode, int dev, int * started) {
 	const char * basename;
 	int namelen;
 	struct m_inode * dir, * inode;
@@ -778,6 +801,7 @@ int sys_mknod(const char * filename, int mode, int dev) {
 	if (!(dir = dir_namei(filename, &namelen, &basename, NULL))) {
 		return -ENOENT;
 	}
+	*started = journal_start(dir->i_dev);
 	// 如果最顶端的文件名长度为 0, 则说明给出的路径名最后没有指定文件名, 放回该目录 inode, 返回出错码退出. 
 	if (!namelen) {
 		iput(dir);
@@ -825,16 +849,27 @@ int sys_mknod(const char * filename, int mode, int dev) {
 	// 并置高速缓冲区已修改标志, 放回目录和新的 inode, 释放高速缓冲区, 最后返回 0(成功). 
 	de->inode = inode->i_num;
 	bh->b_dirt = 1;
+	bh->b_meta = 1;
 	iput(dir);
 	iput(inode);
 	brelse(bh);
 	return 0;
 }
 
+// 系统调用入口. 修改目录的操作都在一个元数据日志事务句柄中执行(见 fs/journal.c), 下同.
+// 句柄由 do_mknod() 在找到所在目录(从而知道是哪个文件系统)后开始, 这里负责结束它.
+int sys_mknod(const char * filename, int mode, int dev) {
+	int started = 0, retval;
+
+	retval = do_mknod(filename, mode, dev, &started);
+	journal_stop(started);
+	return retval;
+}
+
 // 创建一个目录. 
 // 参数: pathname - 路径名; mode - 目录使用的权限属性. 
 // 返回: 成功则返回 0, 否则返回出错码. 
-int sys_mkdir(const char * pathname, int mode) {
+static int do_mkdir(const char * pathname, int mode, int * started) {
 	const char * basename;
 	int namelen;
 	struct m_inode * dir, * inode;
@@ -845,6 +880,7 @@ int sys_mkdir(const char * pathname, int mode) {
 	if (!(dir = dir_namei(pathname,&namelen,&basename, NULL))) {
 		return -ENOENT;
 	}
+	*started = journal_start(dir->i_dev);
 	// 如果最顶端文件名长度为 0, 则说明给出的路径名最后没有指定文件名, 放回该目录 inode, 返回出错码退出. 
 	if (!namelen) {
 		iput(dir);
@@ -887,7 +923,7 @@ int sys_mkdir(const char * pathname, int mode) {
 	inode->i_dirt = 1;
 	// 从设备上读取新申请的磁盘块(目的是把对应块放到高速缓冲区中). 若出错, 则放回对应目录的 inode; 
 	// 释放申请的磁盘块; 复位新申请的 inode 连接计数; 放回该新的 inode, 返回没有空间出错码退出. 
-	if (!(dir_block = bread(inode->i_dev, inode->i_zone[0]))) {
+	if (!(dir_block = bread(inode->i_dev, bmap(inode, 0)))) {
 		iput(dir);
 		inode->i_nlinks--;
 		iput(inode);
@@ -905,6 +941,7 @@ int sys_mkdir(const char * pathname, int mode) {
 	strcpy(de->name, "..");
 	inode->i_nlinks = 2;
 	dir_block->b_dirt = 1;
+	dir_block->b_meta = 1;
 	brelse(dir_block);
 	inode->i_mode = I_DIRECTORY | (mode & 0777 & ~current->umask);
 	inode->i_dirt = 1;
@@ -922,6 +959,7 @@ int sys_mkdir(const char * pathname, int mode) {
 	// 放回目录和新的 inode, 释放高速缓冲区, 最后返回 0(成功). 
 	de->inode = inode->i_num;
 	bh->b_dirt = 1;
+	bh->b_meta = 1;
 	dir->i_nlinks++;
 	dir->i_dirt = 1;
 	iput(dir);
@@ -930,6 +968,14 @@ int sys_mkdir(const char * pathname, int mode) {
 	return 0;
 }
 
+int sys_mkdir(const char * pathname, int mode) {
+	int started = 0, retval;
+
+	retval = do_mkdir(pathname, mode, &started);
+	journal_stop(started);
+	return retval;
+}
+
 /*
  * routine to check that the specified directory is empty (for rmdir)
  */
@@ -950,7 +996,7 @@ static int empty_dir(struct m_inode * inode) {
 	// 如果目录项个数少于 2 个或者该目录 inode 的第 1 个直接块没有指向任何磁盘块号, 或者该直接块读不出, 
 	// 则显示警告信息 “设备dev上目录错”, 返回 0(失败). 
 	len = inode->i_size / sizeof(struct dir_entry);        		// 目录中目录项个数. 
-	if (len < 2 || !inode->i_zone[0] || !(bh = bread(inode->i_dev, inode->i_zone[0]))) {
+	if (len < 2 || !inode->i_zone[0] || !(bh = bread(inode->i_dev, bmap(inode, 0)))) {
 	    printk("warning - bad directory on dev %04x\n", inode->i_dev);
 		return 0;
 	}
@@ -1004,7 +1050,7 @@ static int empty_dir(struct m_inode * inode) {
 // 删除目录. 
 // 参数: name - 目录名(路径名). 
 // 返回: 返回 0 表示成功, 否则返回出错号. 
-int sys_rmdir(const char * name) {
+static int do_rmdir(const char * name, int * started) {
 	const char * basename;
 	int namelen;
 	struct m_inode * dir, * inode;
@@ -1017,6 +1063,7 @@ int sys_rmdir(const char * name) {
 	if (!(dir = dir_namei(name, &namelen, &basename, NULL))) {
 		return -ENOENT;
 	}
+	*started = journal_start(dir->i_dev);
 	if (!namelen) {
 		iput(dir);
 		return -ENOENT;
@@ -1095,6 +1142,7 @@ int sys_rmdir(const char * name) {
 	}
 	de->inode = 0;
 	bh->b_dirt = 1;
+	bh->b_meta = 1;
 	brelse(bh);
 	inode->i_nlinks = 0;
 	inode->i_dirt = 1;
@@ -1108,11 +1156,19 @@ int sys_rmdir(const char * name) {
 	return 0;
 }
 
+int sys_rmdir(const char * name) {
+	int started = 0, retval;
+
+	retval = do_rmdir(name, &started);
+	journal_stop(started);
+	return retval;
+}
+
 // 删除(释放)文件名对应的目录项. 从文件系统删除一个名字. 
 // 如果是文件的最后一个链接, 并且没有进程正打开该文件, 则该文件也将被删除, 并释放所占用的设备空间. 
 // 参数: name - 文件名(路径名). 
 // 返回: 成功则返回 0, 否则返回出错号. 
-int sys_unlink(const char * name) {
+static int do_unlink(const char * name, int * started) {
 	const char * basename;
 	int namelen;
 	struct m_inode * dir, * inode;
@@ -1125,6 +1181,7 @@ int sys_unlink(const char * name) {
 	if (!(dir = dir_namei(name, &namelen, &basename, NULL))) {
 		return -ENOENT;
 	}
+	*started = journal_start(dir->i_dev);
 	if (!namelen) {
 		iput(dir);
 		return -ENOENT;
@@ -1178,6 +1235,7 @@ int sys_unlink(const char * name) {
 	// 表示释放该目录项, 并设置包含该目录项的缓冲块已修改标志, 释放该高速缓冲块. 
 	de->inode = 0;
 	bh->b_dirt = 1;
+	bh->b_meta = 1;
 	brelse(bh);
 	// 然后把文件名对应 inode 的链接数减 1, 置已修改标志, 更新改变时间为当前时间. 
 	// 最后放回该 inode 和目录的 inode, 返回 0(成功). 
@@ -1191,11 +1249,19 @@ int sys_unlink(const char * name) {
 	return 0;
 }
 
+int sys_unlink(const char * name) {
+	int started = 0, retval;
+
+	retval = do_unlink(name, &started);
+	journal_stop(started);
+	return retval;
+}
+
 // 建立符号链接. 
 // 为一个已存在文件创建一个符号链接(也称为软连接 - hard link). 
 // 参数: oldname - 原路径名; newname - 新的路径名. 
 // 返回: 若成功则返回 0, 否则返回出错号. 
-int sys_symlink(const char * oldname, const char * newname) {
+static int do_symlink(const char * oldname, const char * newname, int * started) {
 	struct dir_entry * de;
 	struct m_inode * dir, * inode;
 	struct buffer_head * bh, * name_block;
@@ -1210,6 +1276,7 @@ int sys_symlink(const char * oldname, const char * newname) {
 	if (!dir) {
 		return -EACCES;
 	}
+	*started = journal_start(dir->i_dev);
 	if (!namelen) {
 		iput(dir);
 		return -EPERM;
@@ -1240,7 +1307,7 @@ int sys_symlink(const char * oldname, const char * newname) {
 	// 然后从设备上读取新申请的磁盘块(目的是把对应块放到高速缓冲区中). 
 	// 若出错, 则放回对应目录的 inode ; 复位新申请的 inode 链接计数; 
 	// 放回该新的 inode, 返回没有空间出错码退出. 
-	if (!(name_block = bread(inode->i_dev, inode->i_zone[0]))) {
+	if (!(name_block = bread(inode->i_dev, bmap(inode, 0)))) {
 		iput(dir);
 		inode->i_nlinks--;
 		iput(inode);
@@ -1257,6 +1324,7 @@ int sys_symlink(const char * oldname, const char * newname) {
 	}
 	name_block->b_data[i] = 0;
 	name_block->b_dirt = 1;
+	name_block->b_meta = 1;
 	brelse(name_block);
 	inode->i_size = i;
 	inode->i_dirt = 1;
@@ -1285,17 +1353,26 @@ int sys_symlink(const char * oldname, const char * newname) {
 	// 释放高速缓冲块, 放回目录和新的 inode, 最后返回 0(成功). 
 	de->inode = inode->i_num;
 	bh->b_dirt = 1;
+	bh->b_meta = 1;
 	brelse(bh);
 	iput(dir);
 	iput(inode);
 	return 0;
 }
 
+int sys_symlink(const char * oldname, const char * newname) {
+	int started = 0, retval;
+
+	retval = do_symlink(oldname, newname, &started);
+	journal_stop(started);
+	return retval;
+}
+
 // 为文件建立一个文件名目录项. 
 // 为一个已存在的文件创建一个新链接(也称为硬连接 - hard link). 
 // 参数: oldname - 原路径名; newname - 新的路径名. 
 // 返回: 若成功则返回 0, 否则返回出错号. 
-int sys_link(const char * oldname, const char * newname) {
+static int do_link(const char * oldname, const char * newname, int * started) {
 	struct dir_entry * de;
 	struct m_inode * oldinode, * dir;
 	struct buffer_head * bh;
@@ -1319,6 +1396,7 @@ int sys_link(const char * oldname, const char * newname) {
 		iput(oldinode);
 		return -EACCES;
 	}
+	*started = journal_start(dir->i_dev);
 	if (!namelen) {
 		iput(oldinode);
 		iput(dir);
@@ -1359,6 +1437,7 @@ int sys_link(const char * oldname, const char * newname) {
 	}
 	de->inode = oldinode->i_num;
 	bh->b_dirt = 1;
+	bh->b_meta = 1;
 	brelse(bh);
 	iput(dir);
 	// 再将原节点的链接计数加 1, 修改其改变时间为当前时间, 并设置 inode 已修改标志. 
@@ -1368,4 +1447,12 @@ int sys_link(const char * oldname, const char * newname) {
 	oldinode->i_dirt = 1;
 	iput(oldinode);
 	return 0;
+}
+
+int sys_link(const char * oldname, const char * newname) {
+	int started = 0, retval;
+
+	retval = do_link(oldname, newname, &started);
+	journal_stop(started);
+	return retval;
 }
\ No newline at end of file
@@ -267,38 +267,27 @@ int sys_open(const char * filename, int flag, int mode) {
 
 	// 首先对参数进行处理. 将用户设置的文件模式和进程模式屏蔽码相与, 产生许可的文件模式.     rwx-rwx-rwx
 	mode &= (0777 & ~current->umask); 	// 如果 umask = 000010010: ~(000-010-010) = 111-101-101 & 111-111-111 = 111-101-101: 即屏蔽掉组成员和其他人的 w 权限.
-	// 为了给打开文件建立一个文件句柄, 需要在进程的文件列表中找到一个空闲项.
-	// 空闲项的索引号 fd 即是句柄值. 若没有找到空闲项, 则返回出错码(参数无效).
-	for (fd = 0; fd < NR_OPEN; fd++) {
-		if (!current->filp[fd]) { 					// 文件指针为空则表示找到空闲项.
-			break;
-		}
-	}
-	if (fd >= NR_OPEN) { 							// 没找到空闲项则返回出错码.
-		return -EINVAL;
+	// 为了给打开文件建立一个文件句柄, 需要在进程的描述符表中找到一个空闲项.
+	// get_unused_fd() 通过已分配位图找出最小的空闲描述符(必要时扩展描述符表), 并复位它的 close_on_exec 位标志, 
+	// close_on_exec 中的每个位(置位)代表系统调用 execve() 时需要关闭的文件句柄. 
+	// 当打开一个文件时, 默认情况下文件句柄要处于打开的状态, 因此要复位对应位. 
+	if ((fd = get_unused_fd(0)) < 0) {
+		return fd;
 	}
-	// 复位 fd 对应的 close_on_exec 位标志, close_on_exec 中的每个位(置位)代表系统调用 execve() 时需要关闭的文件句柄. 
-	// 当程序使用 fork() 函数创建一个子进程时, 通常会在该子进程中调用 execve() 函数加载执行另一个新程序. 
-	// 此时子进程中开始执行新程序, 如果 close_on_exec 中的有被置位的文件句柄, 则会关闭这个文件.
-	// 当打开一个文件时, 默认情况下文件句柄要处于打开的状态, 因此这里要复位对应位, 
-	// 然后为打开的文件在系统文件表 file_table 中寻找一个空闲结构项. 
-	current->close_on_exec &= ~(1 << fd);           // 复位对应文件打开位, 不让其在执行 execve 时关闭.
-	// 令 f 指向系统的文件列表开始处, 搜索空闲文件项(引用计数为 0 的项), 若已经没有空闲文件表结构项, 则返回出错码. 
-	// 另外, 下面的指针赋值 "f = 0 + file_table" 等同于 "f = file_table" 和 "f = &file_table[0]". 
-	f = 0 + file_table; 							// (fs/file_table.c)
-	for (i = 0; i < NR_FILE; i++, f++) {
-		if (!f->f_count) break;         			// 在系统文件表中找到空闲项(没有被引用的文件项). 
+	// 然后为打开的文件在系统文件表中取一个空闲文件结构(引用计数已置为 1), 若已经没有空闲文件结构, 则返回出错码. 
+	if (!(f = get_empty_filp())) {
+		put_unused_fd(fd);
+		return -ENFILE;
 	}
-	if (i >= NR_FILE) {
-		return -EINVAL;
-	}
-	// 让进程文件指针列表中 fd 项指向系统的文件列表中的空闲项, 并令文件引用计数递增 1. 
-	(current->filp[fd] = f)->f_count++;
+	// 让进程文件指针列表中 fd 项指向取得的文件结构. 
+	current->filp[fd] = f;
 	// Log(LOG_INFO_TYPE, "<<<<< sys_open: fd = %d >>>>>\n", fd);
 	// 调用函数 open_namei() 执行打开 inode 操作, 若返回值小于 0, 则说明出错, 于是释放刚申请到的文件结构, 返回出错码 i.
 	// 所谓打开 inode 是指从硬盘中读取或新建这个文件名对应的 inode 信息, 将其指针放到 inode 变量中(打开成功的情况下).
-	if ((i = open_namei(filename, flag, mode, &inode)) < 0) { 		// 如果出错则进行相应处理后返回出错码.
-		current->filp[fd] = NULL;
+	// 打开时可能创建或截断文件, open_namei() 会在这两种情况下开始元数据日志事务句柄.
+	i = open_namei(filename, flag, mode, &inode);
+	if (i < 0) { 									// 如果出错则进行相应处理后返回出错码.
+		put_unused_fd(fd);
 		f->f_count = 0;
 		return i;
 	}
@@ -309,7 +298,7 @@ int sys_open(const char * filename, int flag, int mode) {
 	if (S_ISCHR(inode->i_mode)) { 					// 如果是字符设备文件(比如 /dev/tty1 等: 终端设备, 内存设备, 网络设备).
 		if (check_char_dev(inode, inode->i_zone[0], flag)) { 	// 设备文件的 zone[0] 中存放的是设备号.
 			iput(inode);
-			current->filp[fd] = NULL;
+			put_unused_fd(fd);
 			f->f_count = 0;
 			return -EAGAIN;         							// 出错号: 资源暂不可用.
 		}
@@ -342,27 +331,22 @@ int sys_creat(const char * pathname, int mode) {
 int sys_close(unsigned int fd) {
 	struct file * filp;
 
-	// 首先检查参数有效性. 若给出的文件句柄值大于进程的最大打开文件数 NR_OPEN, 则返回出错码(参数无效).
-	if (fd >= NR_OPEN) {
-		return -EINVAL;
-	}
-	// 然后复位该句柄对应的 close_on_exec 位. 
-	current->close_on_exec &= ~(1 << fd);
-	// 若该文件句柄对应的文件指针是 NULL, 则返回出错码.
-	if (!(filp = current->filp[fd])) {
+	// 首先检查参数有效性. 若给出的文件句柄值超出进程描述符表的容量, 或该文件句柄对应的文件指针是 NULL, 则返回出错码.
+	if (fd >= current->max_fds || !(filp = current->filp[fd])) {
 		return -EINVAL;
 	}
-	// 将文件句柄对应的文件指针置为 NULL(sys_close() 最关键的一步).
+	// 将文件句柄对应的文件指针置为 NULL, 并复位其已分配位和 close_on_exec 位(sys_close() 最关键的一步).
 	// 若在关闭文件之前, 对应文件结构中的句柄引用计数已经为 0, 则说明内核出错, 停机. 
 	// 否则将对应文件的引用计数减 1. 此时如果它还不为 0, 则说明有其它进程正在使用该文件, 直接返回 0(成功).
 	// 如果引用计数已等于 0, 说明该文件已经没有进程引用, 该文件已变为空闲. 则释放该文件对应的 inode, 然后返回 0.
-	current->filp[fd] = NULL;
+	put_unused_fd(fd);
 	if (filp->f_count == 0) {
 		panic("Close: file count is 0");
 	}
 	if (--filp->f_count) {
 		return (0);
 	}
+	ep_forget(filp);								// 文件已无人使用, 将其从所有 epoll 兴趣集中删除.
 	iput(filp->f_inode);
 	return (0);
 }
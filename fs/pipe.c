@@ -4,14 +4,58 @@
  *  (C) 1991  Linus Torvalds
  */
 // #include <signal.h>
+#include <string.h>
 #include <errno.h>
 #include <termios.h>
+#include <sys/stat.h>
 
 #include <linux/sched.h>
 // #include <linux/mm.h>	/* for get_free_page */
 #include <asm/segment.h>
 #include <linux/kernel.h>
 
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+// 写文件操作函数. fs/file_dev.c
+extern int file_write(struct m_inode * inode, struct file * filp, char * buf, int count, off_t * pos);
+
+// 管道缓冲区页面表. 每个内存 inode 对应一行, 其中存放该管道缓冲区各页面的地址, 0 表示该页还未分配.
+unsigned long pipe_pages[NR_INODE][PIPE_MAX_PAGES];
+// 等待管道缓冲区空闲(PIPE_BUSY 复位)的进程队列, 下标与 pipe_pages[] 相同.
+struct task_struct * pipe_busy_wait[NR_INODE];
+
+// 独占管道缓冲区(内部函数). 若其他进程正在复制数据或调整缓冲区, 则睡眠等待.
+// 持有期间管道头尾指针, 数据长度和缓冲区页面都不会被其他进程改变, 因此复制时即使睡眠也是安全的.
+static inline void lock_pipe(struct m_inode * inode) {
+	while (PIPE_BUSY(*inode)) {
+		sleep_on(&PIPE_BUSY_WAIT(*inode));
+	}
+	PIPE_BUSY(*inode) = 1;
+}
+
+// 释放管道缓冲区, 并唤醒等待它的进程(内部函数).
+static inline void unlock_pipe(struct m_inode * inode) {
+	PIPE_BUSY(*inode) = 0;
+	wake_up(&PIPE_BUSY_WAIT(*inode));
+}
+
+// 取管道缓冲区中偏移 pos 处的内核地址(内部函数). 该位置所在的页面必须已分配.
+static inline char * pipe_addr(struct m_inode * inode, int pos) {
+	return (char *) PIPE_PAGE(*inode, pos / PAGE_SIZE) + (pos & (PAGE_SIZE - 1));
+}
+
+// 释放管道缓冲区的所有页面. 在管道 inode 的最后一个引用被放回时由 iput() 调用.
+void free_pipe_pages(struct m_inode * inode) {
+	int i;
+
+	for (i = 0; i < PIPE_MAX_PAGES; i++) {
+		if (PIPE_PAGE(*inode, i)) {
+			free_page(PIPE_PAGE(*inode, i));
+			PIPE_PAGE(*inode, i) = 0;
+		}
+	}
+}
+
 // 读管道操作函数。
 // 参数 inode 是管道对应的 inode, buf 是用户数据缓冲区指针, count 是读取的字节数. 
 int read_pipe(struct m_inode * inode, char * buf, int count) {
@@ -35,9 +79,15 @@ int read_pipe(struct m_inode * inode, char * buf, int count) {
 			// 当前进程没有数据可读则进入睡眠等待
 			interruptible_sleep_on(&PIPE_READ_WAIT(*inode));
 		}
-		// 此时说明管道(缓冲区)中有数据. 于是我们取管道尾指针到缓冲区末端的字节数 chars. 如果其大于还需要读取的字节数 count, 则令其等于 count. 
+		// 此时说明管道(缓冲区)中有数据. 先独占管道缓冲区; 等待期间数据可能已被其他读进程取走, 则重新等待.
+		lock_pipe(inode);
+		if (!(size = PIPE_SIZE(*inode))) {
+			unlock_pipe(inode);
+			continue;
+		}
+		// 于是我们取管道尾指针到所在页面末端的字节数 chars. 如果其大于还需要读取的字节数 count, 则令其等于 count. 
 		// 如果 chars 大于当前管道中含有数据的长度 size, 则令其等于 size. 然后把需读字节数 count 减去可读的字节数 chars, 并累加已读字节数 read. 
-		chars = PAGE_SIZE - PIPE_TAIL(*inode);
+		chars = PAGE_SIZE - (PIPE_TAIL(*inode) & (PAGE_SIZE - 1));
 		if (chars > count) {
 			chars = count;
 		}
@@ -46,14 +96,14 @@ int read_pipe(struct m_inode * inode, char * buf, int count) {
 		}
 		count -= chars;
 		read += chars;
-		// 再令 size 指向管道尾指针处, 并调整当前管道尾指针(前移 chars 字节). 若尾指针超过管道末端则绕回. 
-		// 然后将管道中的数据复制到用户缓冲区中. 对于管道 inode , 其 i_size 字段中是管道缓冲块指针. 
-		size = PIPE_TAIL(*inode);
-		PIPE_TAIL(*inode) += chars;
-		PIPE_TAIL(*inode) &= (PAGE_SIZE - 1);
-		while (chars-- > 0) {
-			put_fs_byte(((char *)inode->i_size)[size++], buf++);
-		}
+		// 然后将管道中的数据复制到用户缓冲区中, 复制完后再调整当前管道尾指针(前移 chars 字节)和数据长度. 若尾指针到达缓冲区末端则绕回. 
+		// 复制时可能因缺页而睡眠, 但此时管道缓冲区由本进程独占, 这段数据不会被其他读进程重复读出, 也不会被写管道进程覆盖. 
+		copy_to_user(buf, pipe_addr(inode, PIPE_TAIL(*inode)), chars);
+		buf += chars;
+		size = PIPE_TAIL(*inode) + chars;
+		PIPE_TAIL(*inode) = (size < PIPE_BUF_SIZE(*inode)) ? size : 0;
+		PIPE_SIZE(*inode) -= chars;
+		unlock_pipe(inode);
 	}
 	// 当此次读管道操作结束, 则唤醒等待该管道的进程, 并返回读取的字节数. 
 	wake_up(&PIPE_WRITE_WAIT(*inode));
@@ -71,7 +121,7 @@ int write_pipe(struct m_inode * inode, char * buf, int count) {
 	// 若写入0字节, 则返回-1. 否则让当前进程在该管道上睡眠, 以等待读管道进程来读取数据, 从而让管道腾出空间. 
 	// 宏 PIPE_SIZE(), PIPE_HEAD() 等定义在文件 include/linux/fs.h 中. 
 	while (count > 0) {
-		while (!(size = (PAGE_SIZE - 1) - PIPE_SIZE(*inode))) {
+		while (!(size = PIPE_BUF_SIZE(*inode) - PIPE_SIZE(*inode))) {
 			wake_up(& PIPE_READ_WAIT(*inode));
 			if (inode->i_count != 2) { 								/* no readers */
 				current->signal |= (1 << (SIGPIPE - 1));
@@ -79,28 +129,44 @@ int write_pipe(struct m_inode * inode, char * buf, int count) {
 			}
 			sleep_on(& PIPE_WRITE_WAIT(*inode));
 		}
-		// 程序执行到这里表示管道缓冲区中有可写空间 size. 于是我们取管道头指针到缓冲区末端空间字节数 chars. 
+		// 程序执行到这里表示管道缓冲区中有可写空间. 先独占管道缓冲区, 然后重新取空闲空间长度 size, 
+		// 因为等待期间其他写进程可能已经写满了管道. 
+		lock_pipe(inode);
+		if (!(size = PIPE_BUF_SIZE(*inode) - PIPE_SIZE(*inode))) {
+			unlock_pipe(inode);
+			continue;
+		}
+		// 管道缓冲区中有可写空间 size. 于是我们取管道头指针到所在页面末端空间字节数 chars. 
 		// 写管道操作是从管道头指针处开始写的. 如果 chars 大于还需要写入的字节数 count, 则令其等于 count. 
 		// 如果 chars 大于当前管道中空闲空间长度 size 则令其等于 size. 
-		// 然后把需要写入字节数 count 减去此次可写入的字节数 chars, 并把写入字节数累加到 written 中. 
-		chars = PAGE_SIZE - PIPE_HEAD(*inode);
+		chars = PAGE_SIZE - (PIPE_HEAD(*inode) & (PAGE_SIZE - 1));
 		if (chars > count) {
 			chars = count;
 		}
 		if (chars > size) {
 			chars = size;
 		}
+		// 如果头指针所在的页面还没有分配, 就先为它申请一页内存. 若已没有空闲内存, 则返回已写入的字节数, 
+		// 若一个字节也没有写入则返回出错码. 
+		if (!PIPE_PAGE(*inode, PIPE_HEAD(*inode) / PAGE_SIZE) &&
+			!(PIPE_PAGE(*inode, PIPE_HEAD(*inode) / PAGE_SIZE) = get_free_page())) {
+			unlock_pipe(inode);
+			if (!written) {
+				written = -ENOMEM;
+			}
+			break;
+		}
+		// 然后把需要写入字节数 count 减去此次可写入的字节数 chars, 并把写入字节数累加到 written 中. 
+		// 从用户缓冲区复制 chars 个字节到管道头指针开始处, 复制完后再调整管道头指针(前移 chars 字节)和数据长度. 
+		// 若头指针到达缓冲区末端则绕回. 复制时可能因缺页或写时复制而睡眠, 管道缓冲区由本进程独占, 其他写进程不会写到同一位置. 
 		count -= chars;
 		written += chars;
-		// 再令 size 指向管道数据头指针处, 并调整当前管道数据头部指针(前移 chars 字节). 
-		// 若头指针超过管道末端则绕回. 然后从用户缓冲区复制 chars 个字节到管道头指针开始处.  
-		// 对于管道 inode , 其 i_size 字段中是管道缓冲块指针. 
-		size = PIPE_HEAD(*inode);
-		PIPE_HEAD(*inode) += chars;
-		PIPE_HEAD(*inode) &= (PAGE_SIZE - 1);
-		while (chars-- > 0) {
-			((char *)inode->i_size)[size++] = get_fs_byte(buf++);
-		}
+		copy_from_user(pipe_addr(inode, PIPE_HEAD(*inode)), buf, chars);
+		buf += chars;
+		size = PIPE_HEAD(*inode) + chars;
+		PIPE_HEAD(*inode) = (size < PIPE_BUF_SIZE(*inode)) ? size : 0;
+		PIPE_SIZE(*inode) += chars;
+		unlock_pipe(inode);
 	}
 	// 当此次写管道操作结束, 则唤醒等待管道的进程, 返回已写入的字节数, 退出. 
 	wake_up(&PIPE_READ_WAIT(*inode));
@@ -115,43 +181,36 @@ int sys_pipe(unsigned long * fildes) {
 	struct m_inode * inode;
 	struct file * f[2];             						// 文件结构数组. 
 	int fd[2];                      						// 文件句柄数组. 
-	int i, j;
 
-	// 首先从系统文件表中取两个空闲项(引用计数字段为 0 的项), 并分别设置引用计数为 1.
-	// 若只有 1 个空闲项, 则释放该项(引用计数复位). 若没有找到两个空闲项, 则返回 -1. 
-	j = 0;
-	for(i = 0; j < 2 && i < NR_FILE; i++) {
-		if (!file_table[i].f_count) {
-			(f[j++] = i + file_table)->f_count++;
-		}
+	// 首先从系统文件表中取两个空闲文件结构(get_empty_filp() 已将其引用计数设置为 1).
+	// 若只取得 1 个, 则释放该项(引用计数复位). 若没有取得两个空闲项, 则返回 -1. 
+	if (!(f[0] = get_empty_filp())) {
+		return -1;
 	}
-	if (j == 1) {
+	if (!(f[1] = get_empty_filp())) {
 		f[0]->f_count = 0;
-	}
-	if (j < 2) {
 		return -1;
 	}
-	// 针对上面取得的两个文件表结构项, 分别分配一文件句柄号, 并使进程文件结构指针数组的两项分别指向这两个文件结构. 
-	// 而文件句柄即是该数组的索引号. 类似地, 如果只有一个空闲文件句柄, 则释放该句柄(置空相应数组项). 
+	// 针对上面取得的两个文件结构, 分别分配一文件句柄号(最小的空闲描述符), 并使进程文件结构指针数组的两项分别指向这两个文件结构. 
+	// 而文件句柄即是该数组的索引号. 类似地, 如果只有一个空闲文件句柄, 则释放该句柄. 
 	// 如果没有找到两个空闲句柄, 则释放上面获取的两个文件结构项(复位引用计数值), 并返回 -1. 
-	j = 0;
-	for (i = 0; j < 2 && i < NR_OPEN; i++) {
-		if (!current->filp[i]) {
-			current->filp[fd[j] = i] = f[j];
-			j++;
+	if ((fd[0] = get_unused_fd(0)) >= 0) {
+		current->filp[fd[0]] = f[0];
+		if ((fd[1] = get_unused_fd(0)) >= 0) {
+			current->filp[fd[1]] = f[1];
+		} else {
+			put_unused_fd(fd[0]);
 		}
 	}
-	if (j == 1) {
-		current->filp[fd[0]] = NULL;
-	}
-	if (j < 2) {
+	if (fd[0] < 0 || fd[1] < 0) {
 		f[0]->f_count = f[1]->f_count = 0;
 		return -1;
 	}
 	// 然后利用函数 get_pipe_inode() 申请一个管道使用的 inode , 并为管道分配一页内存作为缓冲区. 
 	// 如果不成功, 则相应释放两个文件句柄和文件结构项, 并返回 -1.
 	if (!(inode = get_pipe_inode())) {                		// fs/inode.c. 
-		current->filp[fd[0]] = current->filp[fd[1]] = NULL;
+		put_unused_fd(fd[0]);
+		put_unused_fd(fd[1]);
 		f[0]->f_count = f[1]->f_count = 0;
 		return -1;
 	}
@@ -167,6 +226,83 @@ int sys_pipe(unsigned long * fildes) {
 	return 0;
 }
 
+// 调整管道缓冲区大小. 由 fcntl(F_SETPIPE_SZ) 调用.
+// 参数 size 是新的缓冲区字节数, 向上取整为整页, 至少 1 页, 最多 PIPE_MAX_PAGES 页. 
+// 若管道中现有数据多于新缓冲区的容量, 则返回 -EBUSY. 成功则返回调整后的缓冲区字节数.
+int pipe_resize(struct m_inode * inode, int size) {
+	unsigned long pages[PIPE_MAX_PAGES];
+	int i, nr, len, pos, chars;
+
+	if (size < 0) {
+		return -EINVAL;
+	}
+	nr = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+	if (!nr) {
+		nr = 1;
+	}
+	if (nr > PIPE_MAX_PAGES) {
+		return -EINVAL;
+	}
+	// 独占管道缓冲区, 此后读写管道和 splice 的进程都要等到调整完成. 申请页面时可能睡眠, 但管道中的数据不会变化. 
+	lock_pipe(inode);
+	len = PIPE_SIZE(*inode);
+	if (len > nr * PAGE_SIZE) {
+		unlock_pipe(inode);
+		return -EBUSY;
+	}
+	// 管道为空时只需复位头尾指针, 并释放新缓冲区以外的页面.
+	if (!len) {
+		for (i = nr; i < PIPE_MAX_PAGES; i++) {
+			if (PIPE_PAGE(*inode, i)) {
+				free_page(PIPE_PAGE(*inode, i));
+				PIPE_PAGE(*inode, i) = 0;
+			}
+		}
+		PIPE_HEAD(*inode) = PIPE_TAIL(*inode) = 0;
+		PIPE_PAGES(*inode) = nr;
+		unlock_pipe(inode);
+		wake_up(&PIPE_WRITE_WAIT(*inode));
+		return nr * PAGE_SIZE;
+	}
+	// 否则先申请存放现有数据所需的全部新页面, 再把管道中的数据按顺序复制过去, 新缓冲区从偏移 0 处开始存放数据. 
+	// 每次复制的数据不跨越新旧缓冲区的页面边界.
+	for (i = 0; i < PIPE_MAX_PAGES; i++) {
+		pages[i] = 0;
+	}
+	for (i = 0; i < (len + PAGE_SIZE - 1) / PAGE_SIZE; i++) {
+		if (!(pages[i] = get_free_page())) {
+			for (i = 0; i < PIPE_MAX_PAGES; i++) {
+				if (pages[i]) {
+					free_page(pages[i]);
+				}
+			}
+			unlock_pipe(inode);
+			return -ENOMEM;
+		}
+	}
+	for (i = 0; i < len; i += chars) {
+		pos = (PIPE_TAIL(*inode) + i) % PIPE_BUF_SIZE(*inode);
+		chars = PAGE_SIZE - (pos & (PAGE_SIZE - 1));
+		if (chars > PAGE_SIZE - (i & (PAGE_SIZE - 1))) {
+			chars = PAGE_SIZE - (i & (PAGE_SIZE - 1));
+		}
+		if (chars > len - i) {
+			chars = len - i;
+		}
+		memcpy((char *) pages[i / PAGE_SIZE] + (i & (PAGE_SIZE - 1)), pipe_addr(inode, pos), chars);
+	}
+	free_pipe_pages(inode);
+	for (i = 0; i < PIPE_MAX_PAGES; i++) {
+		PIPE_PAGE(*inode, i) = pages[i];
+	}
+	PIPE_PAGES(*inode) = nr;
+	PIPE_TAIL(*inode) = 0;
+	PIPE_HEAD(*inode) = (len < nr * PAGE_SIZE) ? len : 0;
+	unlock_pipe(inode);
+	wake_up(&PIPE_WRITE_WAIT(*inode));
+	return nr * PAGE_SIZE;
+}
+
 // 管道 io 控制函数. 
 // 参数: pino - 管道 inode 指针; cmd - 控制命令; arg - 参数. 
 // 函数返回 0 表示执行成功, 否则返回出错码. 
@@ -182,3 +318,133 @@ int pipe_ioctl(struct m_inode * pino, int cmd, int arg) {
 			return -EINVAL;
 	}
 }
+
+
+static char zero_block[BLOCK_SIZE];							// 用于把文件中的空洞(未分配的块)作为 0 送入管道.
+
+// 从普通文件 filp 的当前位置把最多 count 个字节送入管道 pipe(内部函数). 返回送入的字节数或出错码.
+// 文件数据块读入高速缓冲后, 临时令 fs 指向内核数据段, 再由 write_pipe() 直接从缓冲块复制到管道缓冲区中, 
+// 这样数据只复制一次, 而且不经过用户空间.
+static int splice_to_pipe(struct file * filp, struct m_inode * pipe, int count) {
+	struct m_inode * inode = filp->f_inode;
+	struct buffer_head * bh;
+	unsigned long old_fs;
+	int nr, chars, n, done = 0;
+	char * p;
+
+	if (count > inode->i_size - filp->f_pos) {
+		count = inode->i_size - filp->f_pos;
+	}
+	while (count > 0) {
+		nr = filp->f_pos % BLOCK_SIZE;
+		chars = MIN(BLOCK_SIZE - nr, count);
+		if (n = bmap(inode, filp->f_pos / BLOCK_SIZE)) {
+			if (!(bh = bread(inode->i_dev, n))) {
+				break;
+			}
+			p = bh->b_data + nr;
+		} else {
+			bh = NULL;
+			p = zero_block;
+		}
+		old_fs = get_fs();
+		set_fs(get_ds());
+		n = write_pipe(pipe, p, chars);
+		set_fs(old_fs);
+		brelse(bh);
+		if (n <= 0) {
+			if (!done) {
+				done = n;
+			}
+			break;
+		}
+		filp->f_pos += n;
+		done += n;
+		count -= n;
+		if (n < chars) {
+			break;
+		}
+	}
+	inode->i_atime = CURRENT_TIME;
+	return done;
+}
+
+// 把管道 pipe 中最多 count 个字节写入普通文件 filp 的当前位置(内部函数). 返回写入的字节数或出错码.
+// 等待数据的方式与 read_pipe() 相同. 管道缓冲区中的数据由 file_write() 直接复制到文件的缓冲块中, 写完后才移动管道尾指针. 
+// file_write() 期间一直独占管道缓冲区, 因此它睡眠时这段数据不会被其他读进程重复取走, 所在页面也不会被 pipe_resize() 释放.
+static int splice_from_pipe(struct m_inode * pipe, struct file * filp, int count) {
+	unsigned long old_fs;
+	int size, chars, n, started, done = 0;
+
+	while (count > 0) {
+		while (!(size = PIPE_SIZE(*pipe))) {
+			wake_up(&PIPE_WRITE_WAIT(*pipe));
+			if (pipe->i_count != 2) {								/* are there any writers? */
+				return done;
+			}
+			if (current->signal & ~current->blocked) {
+				return done ? done : -ERESTARTSYS;
+			}
+			interruptible_sleep_on(&PIPE_READ_WAIT(*pipe));
+		}
+		lock_pipe(pipe);
+		if (!(size = PIPE_SIZE(*pipe))) {
+			unlock_pipe(pipe);
+			continue;
+		}
+		chars = PAGE_SIZE - (PIPE_TAIL(*pipe) & (PAGE_SIZE - 1));
+		if (chars > count) {
+			chars = count;
+		}
+		if (chars > size) {
+			chars = size;
+		}
+		started = journal_start(filp->f_inode->i_dev);
+		old_fs = get_fs();
+		set_fs(get_ds());
+		n = file_write(filp->f_inode, filp, pipe_addr(pipe, PIPE_TAIL(*pipe)), chars, &filp->f_pos);
+		set_fs(old_fs);
+		journal_stop(started);
+		if (n <= 0) {
+			unlock_pipe(pipe);
+			if (!done) {
+				done = n;
+			}
+			break;
+		}
+		size = PIPE_TAIL(*pipe) + n;
+		PIPE_TAIL(*pipe) = (size < PIPE_BUF_SIZE(*pipe)) ? size : 0;
+		PIPE_SIZE(*pipe) -= n;
+		unlock_pipe(pipe);
+		done += n;
+		count -= n;
+		wake_up(&PIPE_WRITE_WAIT(*pipe));
+	}
+	return done;
+}
+
+// 在管道和普通文件之间传送数据的系统调用.
+// 把文件句柄 fd_in 中最多 count 个字节送到文件句柄 fd_out 中, 两个句柄中必须一个是普通文件, 另一个是管道. 
+// 普通文件从其当前读写位置开始读写, 并相应地移动读写位置. 数据全部在内核中传送, 不经过用户空间. 
+// 返回传送的字节数, 出错则返回出错码.
+int sys_splice(unsigned int fd_in, unsigned int fd_out, int count) {
+	struct file * in, * out;
+
+	if (fd_in >= current->max_fds || fd_out >= current->max_fds || count < 0 ||
+		!(in = current->filp[fd_in]) || !(out = current->filp[fd_out])) {
+		return -EBADF;
+	}
+	if (!(in->f_mode & 1) || !(out->f_mode & 2)) {
+		return -EBADF;
+	}
+	if (!count) {
+		return 0;
+	}
+	if (S_ISREG(in->f_inode->i_mode) && out->f_inode->i_pipe) {
+		return splice_to_pipe(in, out->f_inode, count);
+	}
+	if (in->f_inode->i_pipe && S_ISREG(out->f_inode->i_mode)) {
+		return splice_from_pipe(in->f_inode, out, count);
+	}
+	return -EINVAL;
+}
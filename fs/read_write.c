@@ -7,6 +7,7 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include <linux/kernel.h>
 #include <linux/sched.h>
@@ -23,9 +24,9 @@ extern int block_read(int dev, off_t * pos, char * buf, int count);
 // 块设备写操作函数. fs/block_dev.c
 extern int block_write(int dev, off_t * pos, char * buf, int count);
 // 读文件操作函数. fs/file_dev.c
-extern int file_read(struct m_inode * inode, struct file * filp, char * buf, int count);
+extern int file_read(struct m_inode * inode, struct file * filp, char * buf, int count, off_t * pos);
 // 写文件操作函数. fs/file_dev.c
-extern int file_write(struct m_inode * inode, struct file * filp, char * buf, int count);
+extern int file_write(struct m_inode * inode, struct file * filp, char * buf, int count, off_t * pos);
 
 // 重定位文件读写指针系统调用. 
 // 参数 fd 是文件句柄, offset 是新的文件读写指针偏移值, origin 是偏移的起始位置, 
@@ -34,10 +35,10 @@ int sys_lseek(unsigned int fd, off_t offset, int origin) {
 	struct file * file;
 	int tmp;
 
-	// 首先判断函数提供的参数有效性. 如果文件句柄大于程序最多打开文件数 NR_OPEN(20), 或者该句柄的文件结构指针为空, 
+	// 首先判断函数提供的参数有效性. 如果文件句柄超出进程描述符表的容量, 或者该句柄的文件结构指针为空, 
 	// 或者对应文件结构的 i 节点字段为空, 或者指定设备文件指针是不可定位的, 则返回出错码并退出. 
 	// 如果文件对应 i 节点是管道节点, 则返回出错码退出. 因为管道头尾指针不可随意移动！
-	if (fd >= NR_OPEN || !(file = current->filp[fd]) || !(file->f_inode) || !IS_SEEKABLE(MAJOR(file->f_inode->i_dev))) {
+	if (fd >= current->max_fds || !(file = current->filp[fd]) || !(file->f_inode) || !IS_SEEKABLE(MAJOR(file->f_inode->i_dev))) {
 		return -EBADF;
 	}
 	if (file->f_inode->i_pipe) {
@@ -72,22 +73,14 @@ int sys_lseek(unsigned int fd, off_t offset, int origin) {
 	return file->f_pos;             					// 最后返回重定位后的文件读写指针值. 
 }
 
-// 读文件系统调用. 
-// 参数 fd 是文件句柄, buf 是缓冲区, count 是欲读字节数. 
-int sys_read(unsigned int fd, char * buf, int count) {
-	struct file * file;
+// 根据文件 i 节点的属性分别调用相应的读操作函数(内部函数). 
+// 参数 file 是已验证过的文件结构, buf 是用户缓冲区, count(大于 0) 是欲读字节数, 
+// pos 指向读写位置: read()/readv() 使用文件的 &file->f_pos, pread() 使用一个临时变量, 因此不改变文件读写指针. 
+// 返回读取的字节数或出错码.
+static int do_read(struct file * file, char * buf, int count, off_t * pos) {
 	struct m_inode * inode;
 
-	// 同样地, 我们首先判断函数参数的有效性. 如果进程文件句柄值大于程序最多打开文件数 NR_OPEN, 
-	// 或者需要写入的字节计数小于 0, 或者该句柄的文件结构指针为空, 则返回出错码并退出. 
-	// 如果需读取的字节数 count 等于 0, 则返回 0 退出.
-	if (fd >= NR_OPEN || count < 0 || !(file = current->filp[fd])) {
-		return -EINVAL;
-	}
-	if (!count) {
-		return 0;
-	}
-	// 然后验证存放数据的缓冲区内存限制. 并取文件的 i 节点. 用于根据该 i 节点的属性, 分别调用相应的读操作函数. 
+	// 首先验证存放数据的缓冲区内存限制. 并取文件的 i 节点. 用于根据该 i 节点的属性, 分别调用相应的读操作函数. 
 	// 若是管道操作, 并且是读管道文件模式, 则进行读管道操作, 若成功则返回读取的字节数, 否则返回出错码, 退出. 
 	// 如果是字符型文件, 则进行读字符设备操作, 并返回读取的字符数. 如果是块设备文件, 则执行块设备读操作, 并返回读取的字节数. 
 	verify_area(buf, count);
@@ -98,46 +91,37 @@ int sys_read(unsigned int fd, char * buf, int count) {
 	}
 	// 字符设备的读操作.
 	if (S_ISCHR(inode->i_mode)) {
-		return rw_char(READ, inode->i_zone[0], buf, count, &file->f_pos);
+		return rw_char(READ, inode->i_zone[0], buf, count, pos);
 	}
 	// 块设备的读操作.
 	if (S_ISBLK(inode->i_mode)) {
-		return block_read(inode->i_zone[0], &file->f_pos, buf, count);
+		return block_read(inode->i_zone[0], pos, buf, count);
 	}
 	// 如果是目录文件或者是常规文件, 
-	// 则首先验证读取字节数 count 的有效性并进行调整(若读取字节数加上文件当前读写指针值大于文件长度, 
-	// 则重新设置读取字节数为文件长度 - 当前读写指针值, 若读取数等于 0, 则返回 0 退出), 
+	// 则首先验证读取字节数 count 的有效性并进行调整(若读取字节数加上读写位置值大于文件长度, 
+	// 则重新设置读取字节数为文件长度 - 读写位置值, 若读取数等于 0, 则返回 0 退出), 
 	// 然后执行文件读操作, 返回读取的字节数并退出. 
 	if (S_ISDIR(inode->i_mode) || S_ISREG(inode->i_mode)) {
-		if (count + file->f_pos > inode->i_size) {
-			count = inode->i_size - file->f_pos;
+		if (count + *pos > inode->i_size) {
+			count = inode->i_size - *pos;
 		}
 		if (count <= 0) {
 			return 0;
 		}
-		return file_read(inode, file, buf, count);
+		return file_read(inode, file, buf, count, pos);
 	}
 	// 执行到这里, 说明我们无法判断文件的属性. 则打印节点文件的属性, 并返回出错码退出. 
 	printk("(Read)inode->i_mode=%06o\n\r", inode->i_mode);
 	return -EINVAL;
 }
 
-// 写文件系统调用.
-// 参数 fd 是文件句柄, buf 是用户缓冲区, count 是欲写字节数.
-int sys_write(unsigned int fd, char * buf, int count) {
-	struct file * file;
+// 根据文件 i 节点的属性分别调用相应的写操作函数(内部函数). 参数与 do_read() 相同.
+// 返回写入的字节数或出错码.
+static int do_write(struct file * file, char * buf, int count, off_t * pos) {
 	struct m_inode * inode;
+	int started, retval;
 
-	// 同样地, 我们首先判断函数参数的有效性. 如果进程文件句柄值大于程序最多打开文件数 NR_OPEN, 
-	// 或者需要写入的字节计数小于 0, 或者该句柄的文件结构指针为空,
-	// 则返回出错码并退出. 如果需读取的字节数 count 等于 0, 则返回 0 退出.
-	if (fd >= NR_OPEN || count < 0 || !(file = current->filp[fd])) {
-		return -EINVAL;
-	}
-	if (!count) {
-		return 0;
-	}
-	// 然后验证存放数据的缓冲区内存限制. 并取文件的 i 节点. 根据该 i 节点的属性, 分别调用相应的写操作函数. 
+	// 取文件的 i 节点. 根据该 i 节点的属性, 分别调用相应的写操作函数. 
 	// 若是管道文件, 并且是写管道文件模式, 则进行写管道操作, 若成功则返回写入的字节数, 否则返回出错码退出. 
 	// 如果是字符设备文件, 则进行写字符设备操作, 返回写入的字符数退出. 
 	// 如果是块设备文件, 则进行块设备写操作, 并返回写入的字节数退出. 
@@ -149,17 +133,201 @@ int sys_write(unsigned int fd, char * buf, int count) {
 	}
 	// 字符设备的写操作.
 	if (S_ISCHR(inode->i_mode)) {
-		return rw_char(WRITE, inode->i_zone[0], buf, count, &file->f_pos);
+		return rw_char(WRITE, inode->i_zone[0], buf, count, pos);
 	}
 	// 块设备的写操作.
 	if (S_ISBLK(inode->i_mode)) {
-		return block_write(inode->i_zone[0], &file->f_pos, buf, count);
+		return block_write(inode->i_zone[0], pos, buf, count);
 	}
-	// 文件的写操作.
+	// 文件的写操作. 写普通文件可能分配新的逻辑块, 因此在一个元数据日志事务句柄中进行.
+	// (writev() 已经为整批写操作开始了一个句柄时, 这里的 journal_start() 不会再开始新的句柄.)
 	if (S_ISREG(inode->i_mode)) {
-		return file_write(inode, file, buf, count);
+		started = journal_start(inode->i_dev);
+		retval = file_write(inode, file, buf, count, pos);
+		journal_stop(started);
+		return retval;
 	}
 	// 执行到这里, 说明我们无法判断文件的属性. 则打印节点文件属性, 并返回出错码退出.
 	printk("(Write)inode->i_mode=%06o\n\r", inode->i_mode);
 	return -EINVAL;
 }
+
+// 读文件系统调用. 
+// 参数 fd 是文件句柄, buf 是缓冲区, count 是欲读字节数. 
+int sys_read(unsigned int fd, char * buf, int count) {
+	struct file * file;
+
+	// 同样地, 我们首先判断函数参数的有效性. 如果进程文件句柄值超出进程描述符表的容量, 
+	// 或者需要写入的字节计数小于 0, 或者该句柄的文件结构指针为空, 则返回出错码并退出. 
+	// 如果需读取的字节数 count 等于 0, 则返回 0 退出.
+	if (fd >= current->max_fds || count < 0 || !(file = current->filp[fd])) {
+		return -EINVAL;
+	}
+	if (!count) {
+		return 0;
+	}
+	return do_read(file, buf, count, &file->f_pos);
+}
+
+// 写文件系统调用.
+// 参数 fd 是文件句柄, buf 是用户缓冲区, count 是欲写字节数.
+int sys_write(unsigned int fd, char * buf, int count) {
+	struct file * file;
+
+	// 同样地, 我们首先判断函数参数的有效性. 如果进程文件句柄值超出进程描述符表的容量, 
+	// 或者需要写入的字节计数小于 0, 或者该句柄的文件结构指针为空,
+	// 则返回出错码并退出. 如果需读取的字节数 count 等于 0, 则返回 0 退出.
+	if (fd >= current->max_fds || count < 0 || !(file = current->filp[fd])) {
+		return -EINVAL;
+	}
+	if (!count) {
+		return 0;
+	}
+	return do_write(file, buf, count, &file->f_pos);
+}
+
+// 检查用户空间中 iovcnt 个缓冲区描述结构的长度(内部函数). 
+// 某个长度超出 int 范围(即为负值), 或者长度总和溢出时返回 -EINVAL, 否则返回 0. 在开始读写之前检查, 出错时不读写任何数据.
+static int check_iov(struct iovec * iov, int iovcnt) {
+	int len, total = 0;
+
+	for (; iovcnt--; iov++) {
+		len = get_fs_long((unsigned long *) &iov->iov_len);
+		if (len < 0 || (total += len) < 0) {
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+// 分散读系统调用. 
+// 从文件句柄 fd 的当前读写位置依次读数据到 iovcnt 个用户缓冲区 iov[] 中, 一次系统调用完成整批读操作. 
+// 某个缓冲区没有读满(例如到达文件尾, 或终端只读到一行)就结束. 
+// 返回读取的总字节数. 若第 1 个缓冲区就出错则返回出错码.
+int sys_readv(unsigned int fd, struct iovec * iov, int iovcnt) {
+	struct file * file;
+	char * base;
+	int len, n, total = 0;
+
+	if (fd >= current->max_fds || !(file = current->filp[fd])) {
+		return -EBADF;
+	}
+	if (iovcnt <= 0 || iovcnt > UIO_MAXIOV || check_iov(iov, iovcnt)) {
+		return -EINVAL;
+	}
+	for (; iovcnt--; iov++) {
+		base = (char *) get_fs_long((unsigned long *) &iov->iov_base);
+		if (!(len = get_fs_long((unsigned long *) &iov->iov_len))) {
+			continue;
+		}
+		if ((n = do_read(file, base, len, &file->f_pos)) < 0) {
+			return total ? total : n;
+		}
+		total += n;
+		if (n < len) {
+			break;
+		}
+	}
+	return total;
+}
+
+// 集中写系统调用. 
+// 把 iovcnt 个用户缓冲区 iov[] 中的数据依次写到文件句柄 fd 中, 一次系统调用完成整批写操作. 
+// 写普通文件时整批数据只使用一个元数据日志事务句柄(其他类型的文件不持有句柄). 某个缓冲区没有全部写出就结束. 
+// 返回写入的总字节数. 若第 1 个缓冲区就出错则返回出错码.
+int sys_writev(unsigned int fd, struct iovec * iov, int iovcnt) {
+	struct file * file;
+	char * base;
+	int len, n, total = 0, started;
+
+	if (fd >= current->max_fds || !(file = current->filp[fd])) {
+		return -EBADF;
+	}
+	if (iovcnt <= 0 || iovcnt > UIO_MAXIOV || check_iov(iov, iovcnt)) {
+		return -EINVAL;
+	}
+	// 只有写普通文件时才为整批写操作开始句柄. 写终端或管道可能无限期地睡眠(例如 ^S, 没有读者的 FIFO),
+	// 若这时持有句柄, 该文件系统上的日志提交就会一直等下去.
+	started = 0;
+	if (!file->f_inode->i_pipe && S_ISREG(file->f_inode->i_mode)) {
+		started = journal_start(file->f_inode->i_dev);
+	}
+	for (; iovcnt--; iov++) {
+		base = (char *) get_fs_long((unsigned long *) &iov->iov_base);
+		if (!(len = get_fs_long((unsigned long *) &iov->iov_len))) {
+			continue;
+		}
+		if ((n = do_write(file, base, len, &file->f_pos)) < 0) {
+			if (!total) {
+				total = n;
+			}
+			break;
+		}
+		total += n;
+		if (n < len) {
+			break;
+		}
+	}
+	journal_stop(started);
+	return total;
+}
+
+// 定位读系统调用. 
+// pread(fd, buf, count, offset) 有 4 个参数, 超过了系统调用寄存器参数的个数, 
+// 因此与 select() 一样, 参数 buffer 指向用户空间中这 4 个参数(库函数把指向第 1 个参数的指针传入). 
+// 从文件中 offset 处读数据, 不使用也不改变文件的读写指针, 因此多个进程可以共享一个文件句柄同时读. 
+// 管道没有读写位置, 返回 -ESPIPE. 返回读取的字节数或出错码.
+int sys_pread(unsigned long * buffer) {
+	struct file * file;
+	unsigned int fd;
+	char * buf;
+	int count;
+	off_t pos;
+
+	fd = get_fs_long(buffer++);
+	buf = (char *) get_fs_long(buffer++);
+	count = get_fs_long(buffer++);
+	pos = get_fs_long(buffer);
+	if (fd >= current->max_fds || !(file = current->filp[fd])) {
+		return -EBADF;
+	}
+	if (file->f_inode->i_pipe) {
+		return -ESPIPE;
+	}
+	if (count < 0 || pos < 0) {
+		return -EINVAL;
+	}
+	if (!count) {
+		return 0;
+	}
+	return do_read(file, buf, count, &pos);
+}
+
+// 定位写系统调用. 参数 buffer 指向用户空间中 pwrite(fd, buf, count, offset) 的 4 个参数. 
+// 在文件中 offset 处写数据, 不使用也不改变文件的读写指针(以 O_APPEND 方式打开的文件仍在文件尾添加). 
+// 返回写入的字节数或出错码.
+int sys_pwrite(unsigned long * buffer) {
+	struct file * file;
+	unsigned int fd;
+	char * buf;
+	int count;
+	off_t pos;
+
+	fd = get_fs_long(buffer++);
+	buf = (char *) get_fs_long(buffer++);
+	count = get_fs_long(buffer++);
+	pos = get_fs_long(buffer);
+	if (fd >= current->max_fds || !(file = current->filp[fd])) {
+		return -EBADF;
+	}
+	if (file->f_inode->i_pipe) {
+		return -ESPIPE;
+	}
+	if (count < 0 || pos < 0) {
+		return -EINVAL;
+	}
+	if (!count) {
+		return 0;
+	}
+	return do_write(file, buf, count, &pos);
+}
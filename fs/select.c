@@ -13,6 +13,7 @@
 #include <linux/kernel.h>
 #include <linux/tty.h>
 #include <linux/sched.h>
+#include <linux/slab.h>
 
 #include <asm/segment.h>
 #include <asm/system.h>
@@ -21,6 +22,7 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
 
 /*
  * Ok, Peter made a complicated, but straightforward multiple_wait() function.
@@ -50,9 +52,22 @@ typedef struct {
 
 typedef struct {
 	int nr;
-	wait_entry entry[NR_OPEN * 3];
+	wait_entry entry[NR_OPEN_DEFAULT * 3];
 } select_table;
 
+// 等待表有近 800 字节, 放在只有一页(且与任务结构共用)的内核栈上太大, 因此每次 select() 从这个缓存中分配.
+static struct kmem_cache * select_cachep;
+
+static void ep_init(void);
+
+// 建立等待表缓存和 epoll 使用的缓存(init/main.c 调用).
+void select_init(void) {
+	if (!(select_cachep = kmem_cache_create("select_table", sizeof(select_table), NULL))) {
+		panic("Unable to create select_table cache");
+	}
+	ep_init();
+}
+
 // 把未准备好描述符的等待队列指针加入等待表 wait_table 中. 参数 *wait_address 是与描述符相关的等待队列头指针. 
 // 例如 tty 读缓冲队列 secondary 的等待队列头指针是 proc_list. 参数 p 是 do_select() 中定义的等待表结构指针. 
 static void add_wait(struct task_struct ** wait_address, select_table * p) {
@@ -60,7 +75,8 @@ static void add_wait(struct task_struct ** wait_address, select_table * p) {
 
 	// 首先判断描述符是否有对应的等待队列, 若无则返回. 然后在等待表中搜索参数指定的等待队列指针是否已经在等待表中设置过, 
 	// 若设置过也立刻返回. 这个判断主要是针对管道文件描述符. 例如若一个管道在等待可以进行读操作, 那么其必定可以立刻进行写操作. 
-	if (!wait_address)
+	// epoll 只检查描述符状态而不需要等待表, 此时 p 为 NULL. 
+	if (!wait_address || !p)
 		return;
 	for (i = 0 ; i < p->nr ; i++)
 		if (p->entry[i].wait_address == wait_address)
@@ -199,10 +215,10 @@ static int check_ex(select_table * wait, struct m_inode * inode) {
 // 然后分别调用相关描述符集描述符检查函数 check_XX() 对每个描述符进行检查, 同时统计描述符集中当前已经准备好的描述符个数. 
 // 若有任何一个描述符已经准备好, 本函数就会立刻返回, 否则进程就会在本函数中进入睡眠状态, 
 // 并在过了超时时间或者由于某个描述符所在等待队列上的进程被唤醒而使本进程继续运行. 
-int do_select(fd_set in, fd_set out, fd_set ex,
+// 参数 wait_table 是调用者分配的等待表. 
+int do_select(select_table * wait_table, fd_set in, fd_set out, fd_set ex,
 	fd_set *inp, fd_set *outp, fd_set *exp) {
 	int count;
-	select_table wait_table;
 	int i;
 	fd_set mask;
 
@@ -210,7 +226,7 @@ int do_select(fd_set in, fd_set out, fd_set ex,
 	// 在循环中, 每判断完一个描述符就会把 mask 右移 1 位, 因此根据 mask 的最低有效位我们就可以判断相应描述符是否在用户给定的描述符集中. 
 	// 有效的描述符应该是一个管道文件描述符, 或者是一个字符设备文件描述符, 或者是一个 FIFO 描述符, 其余类型的都作为无效描述符而返回 EBADF 错误. 
 	mask = in | out | ex;
-	for (i = 0 ; i < NR_OPEN ; i++, mask >>= 1) {
+	for (i = 0 ; i < NR_OPEN_DEFAULT ; i++, mask >>= 1) {
 		if (!(mask & 1))                                        // 若不在描述符集中则继续判断下一个. 
 			continue;
 		if (!current->filp[i])                                  // 若文件未打开, 则返回描述符值. 
@@ -230,29 +246,29 @@ int do_select(fd_set in, fd_set out, fd_set ex,
 	// 若一个描述符已经准备好, 则在相关描述符集中设置对应位, 并且把已准备好描述符个数计数值 count 增 1. 
 	// 第 186 行 for 循环语句中的 mask += mask 行将于 mask << 1. 
 repeat:
-	wait_table.nr = 0;
+	wait_table->nr = 0;
 	*inp = *outp = *exp = 0;
 	count = 0;
 	mask = 1;
-	for (i = 0 ; i < NR_OPEN ; i++, mask += mask) {
+	for (i = 0 ; i < NR_OPEN_DEFAULT ; i++, mask += mask) {
 		// 如果此时判断的描述符在读操作描述符集中, 并且该描述符已经准备好可以进行读操作, 
 		// 则把该描述符在描述符集 in 中对应位置为 1, 同时把已准备好描述符个数计数值 count 增 1. 
 		if (mask & in)
-			if (check_in(&wait_table, current->filp[i]->f_inode)) {
+			if (check_in(wait_table, current->filp[i]->f_inode)) {
 				*inp |= mask;   								// 描述符集中设置对应位. 
 				count++;        								// 已准备好描述符个数计数. 
 			}
 		// 如果此时判断的描述符在写操作描述符集中, 并且该描述符已经准备好可以进行写操作, 
 		// 则把该描述符在描述符集 out 中对应位置为 1, 同时把已准备好描述符个数计数值 count 增 1. 
 		if (mask & out)
-			if (check_out(&wait_table, current->filp[i]->f_inode)) {
+			if (check_out(wait_table, current->filp[i]->f_inode)) {
 				*outp |= mask;
 				count++;
 			}
 		// 如果此时判断的描述符在异常描述符集中, 并且该描述符已经有异常出现, 
 		// 则把该描述符在描述符集 ex 中对应位置为 1, 同时把已准备好描述符个数计数值 count 增 1. 
 		if (mask & ex)
-			if (check_ex(&wait_table, current->filp[i]->f_inode)) {
+			if (check_ex(wait_table, current->filp[i]->f_inode)) {
 				*exp |= mask;
 				count++;
 			}
@@ -262,15 +278,15 @@ repeat:
 	// 当内核又一次调度执行本任务时就调用 free_wait() 唤醒相关等待队列上本任务前后的任务, 
 	// 然后跳转到 repeat 标号处再次重新检测是否有我们关心的(描述符集中的)描述符已准备好. 
 	if (!(current->signal & ~current->blocked) &&
-	    (wait_table.nr || current->timeout) && !count) {
+	    (wait_table->nr || current->timeout) && !count) {
 		current->state = TASK_INTERRUPTIBLE;
 		schedule();
-		free_wait(&wait_table);         						// 本任务被唤醒返回后从这里开始执行. 
+		free_wait(wait_table);         							// 本任务被唤醒返回后从这里开始执行. 
 		goto repeat;
 	}
 	// 如果此时 count 不等于 0, 或者接收到了信号, 或者等待时间到并且没有需要等待的描述符, 
 	// 那么我们就调用 free_wait() 唤醒等待队列上的任务, 然后返回已准备好的描述符个数. 
-	free_wait(&wait_table);
+	free_wait(wait_table);
 	return count;
 }
 
@@ -300,6 +316,7 @@ int sys_select( unsigned long *buffer ) {
 	fd_set mask;                            						// 处理的描述符数值范围(nd)屏蔽码. 
 	struct timeval * tvp;                    						// 等待时间结构指针. 
 	unsigned long timeout;
+	select_table * wait_table;
 
 	// 然后从用户数据区把参数分别隔离复制到局部指针变量中, 并根据描述符集指针是否有效分别取得 3 个描述符集 in(读), out(写) 和 ex(异常). 
 	// 其中 mask 也是一个描述符集变量, 根据 3 个描述符集中最大描述符值 +1(即第 1 个参数 nd 的值), 
@@ -336,14 +353,20 @@ int sys_select( unsigned long *buffer ) {
 	// 如果在 do_select() 返回之后进程的等待延时字段 timeout 还大于当前系统计时嘀嗒值 jiffies, 说明在超时之前已经有描述准备好, 
 	//于是这里我们先记下到超时还剩余的时间值, 随后我们会把这个值返回给用户. 如果进程的等待延时字段 timeout 已经小于或等于当前系统 jiffies, 
 	// 表示 do_select() 可能是由于超时而返回, 因此把剩余时间值设置为 0. 
+	// 等待表在关中断之前分配(缓存中没有空闲对象时要分配 slab 页面, 可能睡眠), 并在开中断之后释放.
+	if (!(wait_table = (select_table *) kmem_cache_alloc(select_cachep))) {
+		current->timeout = 0;
+		return -ENOMEM;
+	}
 	cli();                  										// 禁止响应中断. 
-	i = do_select(in, out, ex, &res_in, &res_out, &res_ex);
+	i = do_select(wait_table, in, out, ex, &res_in, &res_out, &res_ex);
 	if (current->timeout > jiffies) {
 		timeout = current->timeout - jiffies;
 	} else {
 		timeout = 0;
 	}
 	sti();                  										// 开启中断响应. 
+	kmem_cache_free(select_cachep, wait_table);
 	// 接下来我们把进程的超时字段清零. 如果 do_select() 返回的已准备好描述符个数小于 0, 表示执行出错, 于是返回这个错误号. 
 	// 然后我们把处理过的描述符集内容和延迟时间结构内容写回到用户数据缓冲空间. 在时间结构内容时还需要先将嘀嗒时间单位表示的剩余延迟时间转换成秒和微秒值. 
 	current->timeout = 0;
@@ -375,3 +398,422 @@ int sys_select( unsigned long *buffer ) {
 	}
 	return i;
 }
+
+
+/*
+ * epoll: 持久的兴趣集.
+ *
+ * select() 每次调用都要检查描述符集中的所有描述符, 并重新建立等待表. epoll 对象则把兴趣集保存在内核中, 
+ * 每个兴趣项记录其描述符对应的读写等待队列. wake_up() 唤醒某个等待队列时调用 ep_notify(), 
+ * 后者通过 hash 表找到监视该队列的兴趣项, 把它们挂到所属 epoll 对象的就绪链表上. 
+ * epoll_wait() 只检查就绪链表上的兴趣项, 因此其开销只与就绪的描述符个数有关. 
+ * 兴趣项是水平触发的: 报告过的项仍留在就绪链表上, 直到检查时发现它已不再就绪.
+ */
+
+#define EP_HASH		31					// 等待队列 hash 表项数.
+#define EP_MAXEVENTS	32				// 一次 epoll_wait() 最多返回的事件数.
+
+struct ep_item;
+
+// 兴趣项对一个等待队列的监视.
+struct ep_watch {
+	struct task_struct ** key;			// 被监视的等待队列头指针地址.
+	struct ep_watch * next;				// hash 链表上的下一项.
+	struct ep_item * item;				// 所属兴趣项.
+};
+
+// 兴趣项.
+struct ep_item {
+	struct eventpoll * ep;				// 所属 epoll 对象.
+	struct ep_item * next;				// 所属 epoll 对象兴趣集链表上的下一项.
+	struct file * filp;					// 被监视的文件.
+	unsigned long events;				// 关心的事件.
+	unsigned long data;					// 用户数据.
+	struct ep_watch watch[2];			// 对读等待队列和写等待队列的监视.
+	struct ep_item * rdnext;			// 就绪链表上的下一项.
+	int ready;							// 是否在就绪链表上.
+};
+
+// epoll 对象.
+struct eventpoll {
+	struct ep_item * items;				// 兴趣集链表.
+	struct ep_item * rdlist;			// 就绪链表.
+	struct task_struct * wait;			// 在 epoll_wait() 中等待的进程.
+	struct eventpoll * next;			// 系统中 epoll 对象链表上的下一项.
+};
+
+// epoll 对象和兴趣项都从各自的缓存中按需分配, 因此其个数只受内存限制. 
+// 系统中的 epoll 对象链接在 ep_list 上, 以便关闭文件时找出所有监视它的兴趣项.
+static struct kmem_cache * ep_cachep;
+static struct kmem_cache * epitem_cachep;
+static struct eventpoll * ep_list = NULL;
+static struct ep_watch * ep_hash[EP_HASH];
+static int ep_nr_items = 0;
+
+// 建立 epoll 对象和兴趣项的缓存(内部函数). 由 select_init() 调用.
+static void ep_init(void) {
+	if (!(ep_cachep = kmem_cache_create("eventpoll", sizeof(struct eventpoll), NULL))) {
+		panic("Unable to create eventpoll cache");
+	}
+	if (!(epitem_cachep = kmem_cache_create("ep_item", sizeof(struct ep_item), NULL))) {
+		panic("Unable to create ep_item cache");
+	}
+}
+
+#define ep_hashfn(key) ((((unsigned long) (key)) >> 2) % EP_HASH)
+
+// 关中断并返回原来的标志寄存器, 以及恢复标志寄存器. ep_notify() 既可能在中断中也可能在进程上下文中被调用.
+#define ep_save_cli(flags) __asm__ __volatile__ ("pushfl; popl %0; cli" : "=r" (flags) : : "memory")
+#define ep_restore(flags) __asm__ __volatile__ ("pushl %0; popfl" : : "r" (flags) : "memory")
+
+// 把兴趣项放到所属 epoll 对象的就绪链表上, 并唤醒在该对象上等待的进程(内部函数). 调用时中断已关闭.
+static void ep_queue(struct ep_item * item) {
+	if (!item->ready) {
+		item->ready = 1;
+		item->rdnext = item->ep->rdlist;
+		item->ep->rdlist = item;
+	}
+	// 这里不能调用 wake_up(), 因为本函数可能正由 wake_up() 调用.
+	if (item->ep->wait) {
+		item->ep->wait->state = TASK_RUNNING;
+	}
+}
+
+// 等待队列 p 上有事件发生. 由 wake_up() 调用.
+// 若没有任何兴趣项则立刻返回, 否则在 hash 表中找出监视该队列的兴趣项, 把它们放到就绪链表上.
+void ep_notify(struct task_struct ** p) {
+	struct ep_watch * w;
+	unsigned long flags;
+
+	if (!ep_nr_items || !p) {
+		return;
+	}
+	ep_save_cli(flags);
+	for (w = ep_hash[ep_hashfn(p)]; w; w = w->next) {
+		if (w->key == p) {
+			ep_queue(w->item);
+		}
+	}
+	ep_restore(flags);
+}
+
+// 取文件 i 节点对应的读等待队列和写等待队列(内部函数). 只支持终端和管道, 其余返回 0.
+static int ep_keys(struct m_inode * inode, struct task_struct *** keys) {
+	struct tty_struct * tty;
+
+	if (tty = get_tty(inode)) {
+		keys[0] = &tty->secondary->proc_list;
+		keys[1] = &tty->write_q->proc_list;
+		return 1;
+	}
+	if (inode->i_pipe) {
+		keys[0] = &PIPE_READ_WAIT(*inode);
+		keys[1] = &PIPE_WRITE_WAIT(*inode);
+		return 1;
+	}
+	return 0;
+}
+
+// 检查兴趣项当前的状态, 返回已发生的事件(内部函数).
+static unsigned long ep_poll(struct ep_item * item) {
+	struct m_inode * inode = item->filp->f_inode;
+	unsigned long mask = 0;
+
+	if (check_in(NULL, inode)) {
+		mask |= EPOLLIN;
+	}
+	if (check_out(NULL, inode)) {
+		mask |= EPOLLOUT;
+	}
+	if (check_ex(NULL, inode)) {
+		mask |= EPOLLHUP;
+	}
+	return mask & (item->events | EPOLLERR | EPOLLHUP);
+}
+
+// 把兴趣项从 hash 表, 兴趣集链表和就绪链表中取下并释放(内部函数). 调用时中断已关闭.
+static void ep_remove(struct ep_item * item) {
+	struct ep_watch ** wp;
+	struct ep_item ** ip;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		for (wp = &ep_hash[ep_hashfn(item->watch[i].key)]; *wp; wp = &(*wp)->next) {
+			if (*wp == &item->watch[i]) {
+				*wp = item->watch[i].next;
+				break;
+			}
+		}
+	}
+	for (ip = &item->ep->items; *ip; ip = &(*ip)->next) {
+		if (*ip == item) {
+			*ip = item->next;
+			break;
+		}
+	}
+	if (item->ready) {
+		for (ip = &item->ep->rdlist; *ip; ip = &(*ip)->rdnext) {
+			if (*ip == item) {
+				*ip = item->rdnext;
+				break;
+			}
+		}
+	}
+	ep_nr_items--;
+	kmem_cache_free(epitem_cachep, item);
+}
+
+// 在 epoll 对象 ep 的兴趣集中查找文件 filp 对应的兴趣项(内部函数). 没有则返回 NULL.
+static struct ep_item * ep_find(struct eventpoll * ep, struct file * filp) {
+	struct ep_item * item;
+
+	for (item = ep->items; item; item = item->next) {
+		if (item->filp == filp) {
+			break;
+		}
+	}
+	return item;
+}
+
+// 文件 filp 的最后一个引用被关闭, 把监视它的兴趣项全部删除. 由 sys_close() 调用.
+// 一个文件在每个 epoll 对象中最多只有一个兴趣项.
+void ep_forget(struct file * filp) {
+	struct eventpoll * ep;
+	struct ep_item * item;
+
+	if (!ep_nr_items) {
+		return;
+	}
+	cli();
+	for (ep = ep_list; ep; ep = ep->next) {
+		if (item = ep_find(ep, filp)) {
+			ep_remove(item);
+		}
+	}
+	sti();
+}
+
+// 释放 epoll 对象. 在其 i 节点的最后一个引用被放回时由 iput() 调用.
+void ep_release(struct m_inode * inode) {
+	struct eventpoll * ep = (struct eventpoll *) inode->i_size;
+	struct eventpoll ** pp;
+
+	cli();
+	while (ep->items) {
+		ep_remove(ep->items);
+	}
+	for (pp = &ep_list; *pp; pp = &(*pp)->next) {
+		if (*pp == ep) {
+			*pp = ep->next;
+			break;
+		}
+	}
+	sti();
+	inode->i_size = 0;
+	kmem_cache_free(ep_cachep, ep);
+}
+
+// 取文件句柄 fd 对应的 epoll 对象(内部函数). 若 fd 不是 epoll 对象则返回 NULL.
+static struct eventpoll * ep_get(unsigned int fd) {
+	struct file * filp;
+
+	if (fd >= current->max_fds || !(filp = current->filp[fd]) || !filp->f_inode->i_epoll) {
+		return NULL;
+	}
+	return (struct eventpoll *) filp->f_inode->i_size;
+}
+
+// 创建 epoll 对象的系统调用. 返回其文件句柄, 出错返回出错码.
+// 与 sys_pipe() 类似, 需要一个 epoll 对象, 一个空闲文件句柄, 一个空闲文件结构和一个 i 节点.
+// 参数 size 只用于兼容, 兴趣集的大小没有限制.
+int sys_epoll_create(int size) {
+	struct eventpoll * ep;
+	struct m_inode * inode;
+	struct file * f;
+	int fd;
+
+	if (size <= 0) {
+		return -EINVAL;
+	}
+	if (!(ep = (struct eventpoll *) kmem_cache_alloc(ep_cachep))) {
+		return -ENOMEM;
+	}
+	if ((fd = get_unused_fd(0)) < 0) {
+		kmem_cache_free(ep_cachep, ep);
+		return fd;
+	}
+	if (!(f = get_empty_filp())) {
+		put_unused_fd(fd);
+		kmem_cache_free(ep_cachep, ep);
+		return -ENFILE;
+	}
+	if (!(inode = get_empty_inode())) {
+		put_unused_fd(fd);
+		f->f_count = 0;
+		kmem_cache_free(ep_cachep, ep);
+		return -ENFILE;
+	}
+	ep->items = NULL;
+	ep->rdlist = NULL;
+	ep->wait = NULL;
+	cli();
+	ep->next = ep_list;
+	ep_list = ep;
+	sti();
+	inode->i_epoll = 1;
+	inode->i_size = (unsigned long) ep;
+	f->f_inode = inode;
+	f->f_mode = 1;
+	current->filp[fd] = f;
+	return fd;
+}
+
+// 修改 epoll 对象兴趣集的系统调用. 参数 buffer 指向用户空间中 epoll_ctl(epfd, op, fd, event) 的参数.
+int sys_epoll_ctl(unsigned long * buffer) {
+	struct task_struct ** keys[2];
+	struct eventpoll * ep;
+	struct ep_item * item, * new_item = NULL;
+	struct file * filp;
+	struct epoll_event * evp;
+	unsigned long events = 0, data = 0;
+	int op, fd, i;
+
+	ep = ep_get(get_fs_long(buffer++));
+	op = get_fs_long(buffer++);
+	fd = get_fs_long(buffer++);
+	evp = (struct epoll_event *) get_fs_long(buffer);
+	if (!ep || fd < 0 || fd >= current->max_fds || !(filp = current->filp[fd])) {
+		return -EBADF;
+	}
+	if (op != EPOLL_CTL_DEL) {
+		if (!evp) {
+			return -EFAULT;
+		}
+		events = get_fs_long(&evp->events);
+		data = get_fs_long(&evp->data);
+	}
+	// 新兴趣项要在查找之前分配, 因为分配时可能睡眠, 醒来后兴趣集可能已被改变.
+	if (op == EPOLL_CTL_ADD && !(new_item = (struct ep_item *) kmem_cache_alloc(epitem_cachep))) {
+		return -ENOMEM;
+	}
+	// 在兴趣集中查找该文件对应的兴趣项.
+	item = ep_find(ep, filp);
+	switch (op) {
+		case EPOLL_CTL_ADD:
+			if (item) {
+				kmem_cache_free(epitem_cachep, new_item);
+				return -EEXIST;
+			}
+			if (filp->f_inode->i_epoll || !ep_keys(filp->f_inode, keys)) {
+				kmem_cache_free(epitem_cachep, new_item);
+				return -EPERM;
+			}
+			// 把兴趣项的两个监视挂到 hash 表中, 把它链入兴趣集, 并把它放到就绪链表上, 以便下次 epoll_wait() 检查其当前状态.
+			item = new_item;
+			cli();
+			item->ep = ep;
+			item->next = ep->items;
+			ep->items = item;
+			item->filp = filp;
+			item->events = events;
+			item->data = data;
+			item->ready = 0;
+			for (i = 0; i < 2; i++) {
+				item->watch[i].key = keys[i];
+				item->watch[i].item = item;
+				item->watch[i].next = ep_hash[ep_hashfn(keys[i])];
+				ep_hash[ep_hashfn(keys[i])] = &item->watch[i];
+			}
+			ep_nr_items++;
+			ep_queue(item);
+			sti();
+			return 0;
+		case EPOLL_CTL_MOD:
+			if (!item) {
+				return -ENOENT;
+			}
+			cli();
+			item->events = events;
+			item->data = data;
+			ep_queue(item);
+			sti();
+			return 0;
+		case EPOLL_CTL_DEL:
+			if (!item) {
+				return -ENOENT;
+			}
+			cli();
+			ep_remove(item);
+			sti();
+			return 0;
+	}
+	return -EINVAL;
+}
+
+// 等待 epoll 对象上事件的系统调用. 参数 buffer 指向用户空间中 epoll_wait(epfd, events, maxevents, timeout) 的参数.
+// 返回就绪的描述符个数, 超时返回 0.
+int sys_epoll_wait(unsigned long * buffer) {
+	struct epoll_event ev[EP_MAXEVENTS];
+	struct eventpoll * ep;
+	struct ep_item * item, ** ip;
+	struct epoll_event * events;
+	unsigned long mask;
+	int maxevents, timeout, n, i;
+
+	ep = ep_get(get_fs_long(buffer++));
+	events = (struct epoll_event *) get_fs_long(buffer++);
+	maxevents = get_fs_long(buffer++);
+	timeout = get_fs_long(buffer);
+	if (!ep) {
+		return -EBADF;
+	}
+	if (maxevents <= 0) {
+		return -EINVAL;
+	}
+	if (maxevents > EP_MAXEVENTS) {
+		maxevents = EP_MAXEVENTS;
+	}
+	// 超时值 timeout 以毫秒计, 转换成嘀嗒数后设置到进程的 timeout 字段, 由调度程序负责超时唤醒.
+	if (timeout > 0) {
+		current->timeout = jiffies + (timeout * HZ + 999) / 1000;
+	}
+	cli();
+	for (;;) {
+		// 检查就绪链表上的兴趣项. 仍就绪的项留在链表上(水平触发), 已不就绪的项从链表上取下.
+		n = 0;
+		ip = &ep->rdlist;
+		while (item = *ip) {
+			if (n < maxevents && (mask = ep_poll(item))) {
+				ev[n].events = mask;
+				ev[n].data = item->data;
+				n++;
+				ip = &item->rdnext;
+			} else if (n < maxevents) {
+				*ip = item->rdnext;
+				item->ready = 0;
+			} else {
+				break;
+			}
+		}
+		if (n || !timeout || (current->signal & ~current->blocked)) {
+			break;
+		}
+		if (timeout > 0 && !current->timeout) {
+			break;
+		}
+		interruptible_sleep_on(&ep->wait);
+	}
+	sti();
+	current->timeout = 0;
+	if (n) {
+		verify_area(events, n * sizeof(struct epoll_event));
+		for (i = 0; i < n; i++) {
+			put_fs_long(ev[i].events, &events[i].events);
+			put_fs_long(ev[i].data, &events[i].data);
+		}
+	}
+	if (!n && (current->signal & ~current->blocked)) {
+		return -EINTR;
+	}
+	return n;
+}
@@ -77,9 +77,9 @@ int sys_fstat(unsigned int fd, struct stat * statbuf) {
 	struct m_inode * inode;
 
 	// 首先取文件句柄对应的文件结构, 然后从中得到文件的 inode. 然后将 inode 上的文件状态信息复制到用户缓冲区中. 
-	// 如果文件句柄值大于一个程序最多打开文件数 NR_OPEN, 或者该句柄的文件结构指针为空, 或者对应文件结构的 inode 字段为空, 
+	// 如果文件句柄值超出进程描述符表的容量, 或者该句柄的文件结构指针为空, 或者对应文件结构的 inode 字段为空, 
 	// 则出错, 返回出错码并退出. 
-	if (fd >= NR_OPEN || !(f = current->filp[fd]) || !(inode = f->f_inode)) {
+	if (fd >= current->max_fds || !(f = current->filp[fd]) || !(inode = f->f_inode)) {
 		return -EBADF;
 	}
 	cp_stat(inode, statbuf);
@@ -110,7 +110,7 @@ int sys_readlink(const char * path, char * buf, int bufsiz) {
 		return -ENOENT;
 	}
 	if (inode->i_zone[0]) {
-		bh = bread(inode->i_dev, inode->i_zone[0]);
+		bh = bread(inode->i_dev, bmap(inode, 0));
 	} else {
 		bh = NULL;
 	}
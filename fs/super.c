@@ -14,8 +14,10 @@
 #include <linux/sched.h>
 #include <linux/kernel.h>
 #include <asm/system.h>
+#include <asm/segment.h>
 
 #include <errno.h>
+#include <string.h>
 #include <sys/stat.h>
 
 int sync_dev(int dev);                  		// 对指定设备执行高速缓冲与设备上数据同步操作(fs/buffer.c).
@@ -36,6 +38,34 @@ void wait_for_keypress(void);           		// 等待击键(kernel/chr_drv/tty_io.
 	__res; \
 })
 
+// 文件系统类型. read_super 从设备上读取(或在内存中建立)文件系统, 设置超级块中的文件系统信息, 成功返回 0. 
+// requires_dev 为 0 的类型不需要设备: 安装时用类型名代替设备文件名, 并分配一个无名设备号(主设备号 0).
+struct file_system_type {
+	char * name;
+	int (* read_super)(struct super_block * s);
+	int requires_dev;
+};
+
+static int minix_read_super(struct super_block * s);
+
+// MINIX 格式的 inode 操作函数表. tmpfs 也使用 MINIX 的目录和间接块格式, 因此也使用它.
+struct inode_operations minix_inode_operations = {
+	minix_find_entry,
+	minix_add_entry,
+	minix_file_read,
+	minix_file_write,
+	minix_bmap,
+	minix_truncate
+};
+
+// 第 1 项是 MINIX 文件系统, 用块设备文件安装的都是这一类型.
+static struct file_system_type file_systems[] = {
+	{"minix", minix_read_super, 1},
+	{"tmpfs", tmpfs_read_super, 0}
+};
+
+#define NR_FS_TYPES (sizeof(file_systems) / sizeof(struct file_system_type))
+
 struct super_block super_block[NR_SUPER];					// 超级块结构表数组(NR_SUPER = 8)
 /* this is initialized in init/main.c */
 /* ROOT_DEV 已在 init/main.c 中被初始化. */
@@ -132,32 +162,37 @@ void put_super(int dev) {
 	// 即释放该设备上文件系统 i 节点位图和逻辑位图在缓冲区中所占用的缓冲块. 
 	// 下面常数符号 I_MAP_SLOTS 和 Z_MAP_SLOTS 均等于 8, 用于分别指明 i 节点位图和逻辑块位图占用的磁盘逻辑块数. 
 	// 注意, 若这些缓冲块内容被修改过, 则需要作同步操作才能把缓冲块中的数据写入设备中. 函数最后对该超级块, 并返回.
+	// 有超级块操作函数表的文件系统(tmpfs)没有位图缓冲块, 由其 put_super 释放占用的内存. 它要用到设备号, 因此在置 s_dev = 0 之前调用.
 	lock_super(sb);
-	sb->s_dev = 0;                          		// 置超级块空闲.
-	for(i = 0; i < I_MAP_SLOTS; i++) {
-		brelse(sb->s_imap[i]);
-	}
-	for(i = 0; i < Z_MAP_SLOTS; i++) {
-		brelse(sb->s_zmap[i]);
+	if (sb->s_op) {
+		sb->s_op->put_super(sb);
+		sb->s_op = NULL;
+	} else {
+		for(i = 0; i < I_MAP_SLOTS; i++) {
+			brelse(sb->s_imap[i]);
+		}
+		for(i = 0; i < Z_MAP_SLOTS; i++) {
+			brelse(sb->s_zmap[i]);
+		}
 	}
+	sb->s_dev = 0;                          		// 置超级块空闲.
 	free_super(sb);
 	return;
 }
 
 // 读取指定设备的超级块.
 // 如果指定设备 dev 上的文件系统超级块已经在超级块表中, 则直接返回该超级块项的指针. 
-// 否则就从设备 dev 上读取超级块到缓冲块中, 并复制到超级块表中, 并返回超级块指针.
-// 硬盘中的信息分布:  |引导块|    分区 1    |    分区 2    |    分区 3    |
-// 各个分区中的信息分布: |超级块|i节点位图|逻辑块位图|   i节点   |           数据区             |
-static struct super_block * read_super(int dev) {			// dev = 769 = 0x301 即第一个硬盘的第一个分区.
+// 否则就在超级块表中取一个空闲项, 由文件系统类型 type 的 read_super 函数填写, 并返回超级块指针.
+static struct super_block * read_super(int dev, struct file_system_type * type) {	// dev = 769 = 0x301 即第一个硬盘的第一个分区.
 	struct super_block * s;
-	struct buffer_head * bh;
-	int i, block;
 
 	// 首先判断参数的有效性. 如果没有指明设备, 则返回空指针. 否则检查该设备是否更换过盘片(也即是否是软盘设备). 
-	// 如果更换过盘, 则高速缓冲区有关该设备的所有缓冲块均失效, 需要进行失效处理, 即释放原来加载的文件系统.
+	// 如果更换过盘, 则高速缓冲区有关该设备的所有缓冲块均失效, 需要进行失效处理, 即释放原来加载的文件系统. 
+	// 无名设备没有盘片, 不用检查.
 	if (!dev) return NULL;
-	check_disk_change(dev);
+	if (type->requires_dev) {
+		check_disk_change(dev);
+	}
 	// 如果设备的超级块已经在超级块表中, 则直接返回该超级块的指针. 
 	// 否则, 首先在超级块数组中找出一个空项(也即字段 s_dev = 0 的项). 如果数组已经占满则返回空指针.
 	if (s = get_super(dev)) {
@@ -177,29 +212,50 @@ static struct super_block * read_super(int dev) {			// dev = 769 = 0x301 即第
 	s->s_time = 0;
 	s->s_rd_only = 0; 									// 只读标志.
 	s->s_dirt = 0; 										// 已修改(脏)标志.
-	// 然后锁定该超级块, 并从设备上读取设备上的超级块信息到 bh 指向的缓冲块中. 
-	// 超级块位于块设备的第 1 个逻辑块中, (第 0 个是引导块). (每个块大小为 1KB).
-	// 如果读超级块操作失败, 则释放上面选定的超级块数组中的项(即置 s_dev = 0), 并解锁该项, 返回空指针退出. 
-	// 否则就将设备上读取的超级块信息从缓冲块数据区复制到超级块数组相应项结构中. 并释放存放读取信息的高速缓冲块.
+	s->s_jhandles = 0;									// 日志事务句柄数和提交状态(fs/journal.c).
+	s->s_jdraining = 0;
+	s->s_jcommitting = 0;
+	s->s_op = NULL;										// 超级块操作函数表(由 tmpfs 这类文件系统设置).
+	s->s_iop = NULL;									// inode 操作函数表(由文件系统类型的 read_super 函数设置).
+	// 然后锁定该超级块, 并由文件系统类型的 read_super 函数读取文件系统. 
+	// 如果失败, 则释放上面选定的超级块数组中的项(即置 s_dev = 0), 并解锁该项, 返回空指针退出.
 	lock_super(s); 										// 上锁, 其它进程此时不能访问这个超级块.
-	if (!(bh = bread(dev, 1))) { 						// 从设备中读取超级块(1).
+	if (type->read_super(s)) {
 		s->s_dev = 0;
+		s->s_op = NULL;
 		free_super(s);
 		return NULL;
 	}
+	free_super(s);   									// 解锁该超级块, 让其它任务可以访问该超级块.
+	return s;
+}
+
+// 读取 MINIX 文件系统的超级块和位图(read_super() 调用, 此时超级块 s 已上锁, s_dev 已设置). 成功返回 0, 失败返回 -1.
+// 从设备上读取超级块信息到 bh 指向的缓冲块中. 
+// 超级块位于块设备的第 1 个逻辑块中, (第 0 个是引导块). (每个块大小为 1KB).
+// 如果读超级块操作失败则返回 -1. 否则就将设备上读取的超级块信息从缓冲块数据区复制到超级块数组相应项结构中. 并释放存放读取信息的高速缓冲块.
+// 硬盘中的信息分布:  |引导块|    分区 1    |    分区 2    |    分区 3    |
+// 各个分区中的信息分布: |超级块|i节点位图|逻辑块位图|   i节点   |           数据区             |
+static int minix_read_super(struct super_block * s) {
+	struct buffer_head * bh;
+	int i, block, dev = s->s_dev;
+
+	if (!(bh = bread(dev, 1))) { 						// 从设备中读取超级块(1).
+		return -1;
+	}
 	// 把从硬盘中读取的超级块信息复制到超级块列表的对应项中.
 	*((struct d_super_block *)s) = *((struct d_super_block *)bh->b_data);
 	brelse(bh);
 	// 现在我们从设备 dev 上得到了文件系统的超级块, 
 	// 于是开始检查这个超级块的有效性并从设备上读取 i 节点位图和逻辑块位图等信息. 
-	// 如果所读取的超级块的文件系统魔数字段不对, 说明设备上不是正确的文件系统, 因此向上面一样, 
-	// 释放上面选定的超级块数组中的项, 并解锁该项, 返回空指针退出. 
+	// 如果所读取的超级块的文件系统魔数字段不对, 说明设备上不是正确的文件系统, 因此向上面一样返回 -1. 
 	// 对于该版 Linux 内核, 只支持 MINIX 文件系统 1.0 版本, 其魔数是 0x137f.
-	if (s->s_magic != SUPER_MAGIC) {
-		s->s_dev = 0;
-		free_super(s);
-		return NULL;
+	// 区段(逻辑块)长度可以是 1KB, 2KB 或 4KB(s_log_zone_size = 0, 1, 2), 超过一页的区段不予支持.
+	if (s->s_magic != SUPER_MAGIC || s->s_log_zone_size > MAX_LOG_ZONE_SIZE) {
+		return -1;
 	}
+	// 如果该文件系统使用日志, 则在读取位图之前先重放日志中已提交的事务, 使位图和 inode 等元数据恢复一致.
+	journal_replay(s);
 	// 下面开始读取设备上 i 节点位图和逻辑块位图数据. 首先初始化内存超级块结构中位图空间. 
 	// 然后从设备上读取 i 节点位图和逻辑块位图信息, 并存放在超级块对应字段中. 
 	// i 节点位图保存在设备的 2 号(第 3 个)逻辑块中, 共占用 s_imap_blocks(保存在超级块中) 个块. 
@@ -229,7 +285,7 @@ static struct super_block * read_super(int dev) {			// dev = 769 = 0x301 即第
 		}
 	}
 	// 如果读出的位图个数不等于位图应该占有的逻辑块数, 说明文件系统位图信息有问题, 超级块初始化失败. 
-	// 因此要释放刚才申请占用的所有资源: 释放 i 节点位图和逻辑块位图占用的缓冲块, 解锁这个超级块, 并返回空指针.
+	// 因此要释放刚才申请占用的所有资源: 释放 i 节点位图和逻辑块位图占用的缓冲块, 并返回 -1.
 	if (block != 2 + s->s_imap_blocks + s->s_zmap_blocks) {
 		// 释放两个位图占用的高速缓冲块.
 		for(i = 0; i < I_MAP_SLOTS; i++) {
@@ -238,18 +294,50 @@ static struct super_block * read_super(int dev) {			// dev = 769 = 0x301 即第
 		for(i = 0; i < Z_MAP_SLOTS; i++) {
 			brelse(s->s_zmap[i]);
 		}
-		s->s_dev = 0;
-		free_super(s);									// 解锁该超级块.
-		return NULL;
+		return -1;
 	}
 	// 否则一切成功. 另外, 对于申请空闲 i 节点的函数来讲, 如果设备所有的 i 节点都已经被使用, 查找函数会返回 0 值.
 	// 因此要保证 0 号 i 节点是不能被使用(位图值为 1 表示已被占用)的, 所以这里将位图中第 1 块的最低位设置为 1, 
 	// 这样去使用这个 0 号节点时会发现已经被使用了, 以此来达到出错的目的(没有空闲 i 节点可用).
-	// 同样地道理, 将逻辑块位图的最低位也设置为 1. 最后函数解锁该超级块, 并返回超级块指针.
+	// 同样地道理, 将逻辑块位图的最低位也设置为 1. 最后返回 0.
 	s->s_imap[0]->b_data[0] |= 1;
 	s->s_zmap[0]->b_data[0] |= 1;
-	free_super(s);   									// 解锁该超级块, 让其它任务可以访问该超级块.
-	return s;
+	s->s_iop = &minix_inode_operations;
+	return 0;
+}
+
+// 按类型名取不需要设备的文件系统类型. 参数 name 是用户空间中的字符串(安装时的设备文件名参数). 不是这类类型名则返回 NULL.
+static struct file_system_type * get_fs_type(char * name) {
+	char buf[16];
+	int i;
+
+	for (i = 0; i < sizeof(buf) - 1 && (buf[i] = get_fs_byte(name + i)); i++) ;
+	buf[i] = 0;
+	for (i = 0; i < NR_FS_TYPES; i++) {
+		if (!file_systems[i].requires_dev && !strcmp(buf, file_systems[i].name)) {
+			return file_systems + i;
+		}
+	}
+	return NULL;
+}
+
+// 取一个未被任何超级块使用的无名设备号(主设备号 0, 次设备号 1 - 255). 都已使用则返回 0. 
+// 这里不会睡眠, 因此只要随后立即调用 read_super(), 就不会有其他进程取得同一设备号.
+static int get_unnamed_dev(void) {
+	struct super_block * s;
+	int dev;
+
+	for (dev = 1; dev < 256; dev++) {
+		for (s = super_block; s < super_block + NR_SUPER; s++) {
+			if (s->s_dev == dev) {
+				break;
+			}
+		}
+		if (s >= super_block + NR_SUPER) {
+			return dev;
+		}
+	}
+	return 0;
 }
 
 // 卸载文件系统(系统调用).
@@ -267,8 +355,11 @@ int sys_umount(char * dev_name) {
 	if (!(inode = namei(dev_name))) {
 		return -ENOENT;
 	}
+	// 不需要设备的文件系统(tmpfs)没有设备文件, 用安装点目录名指定, 这时取得的是该文件系统的根 i 节点.
 	dev = inode->i_zone[0];
-	if (!S_ISBLK(inode->i_mode)) {
+	if (S_ISDIR(inode->i_mode) && !MAJOR(inode->i_dev) && inode->i_num == ROOT_INO) {
+		dev = inode->i_dev;
+	} else if (!S_ISBLK(inode->i_mode)) {
 		iput(inode);                    				// fs/inode.c 
 		return -ENOTBLK;
 	}
@@ -287,8 +378,12 @@ int sys_umount(char * dev_name) {
 	if (!sb->s_imount->i_mount) {
 		printk("Mounted inode has i_mount=0\n");
 	}
+	// 文件系统的根 i 节点总被超级块的 s_isup 引用着, 只有这一个引用时不算忙.
 	for (inode = inode_table + 0; inode < inode_table + NR_INODE; inode++) {
 		if (inode->i_dev == dev && inode->i_count) {
+			if (inode == sb->s_isup && inode->i_count == 1) {
+				continue;
+			}
 			return -EBUSY;
 		}
 	}
@@ -301,7 +396,8 @@ int sys_umount(char * dev_name) {
 	iput(sb->s_isup);
 	sb->s_isup = NULL;
 	// 最后我们释放该设备上的超级块以及位图占用的高速缓冲块, 并对该设备执行高速缓冲与设备上数据的同步操作. 
-	// 然后返回 0(卸载成功).
+	// 然后返回 0(卸载成功). 若该文件系统使用日志, 则要在释放超级块之前先同步一次, 让元数据经由日志写盘.
+	sync_dev(dev);
 	put_super(dev);
 	sync_dev(dev);
 	return 0;
@@ -309,28 +405,33 @@ int sys_umount(char * dev_name) {
 
 // 安装文件系统(系统调用).
 // 参数 dev_name 是设备文件名, dir_name 是安装到的目录名, rw_flag 被安装文件系统的可读写标志. 
-// 将被加载的地方必须是一个目录名, 并且对应的 i 节点没有被其他程序占用. 若操作成功则返回 0, 否则返回出错号.
+// 将被加载的地方必须是一个目录名, 并且对应的 i 节点没有被其他程序占用. 若操作成功则返回 0, 否则返回出错号. 
+// 若 dev_name 是不需要设备的文件系统类型名(如 "tmpfs"), 则为它分配一个无名设备号并建立新的文件系统.
 int sys_mount(char * dev_name, char * dir_name, int rw_flag) {
 	struct m_inode * dev_i, * dir_i;
 	struct super_block * sb;
-	int dev;
+	struct file_system_type * type;
+	int dev = 0;
 
 	// 首先根据设备文件名找到对应的 i 节点, 以取得其中的设备号. 对于块特殊设备文件, 设备号在其 i 节点的 i_zone[0] 中. 
 	// 另外, 由于文件系统必须在块设备中, 因此如果不是块设备文件, 则放回刚得的 i 节点 dev_i, 返回出错码.
-	if (!(dev_i = namei(dev_name))) {
-		return -ENOENT;
-	}
-	dev = dev_i->i_zone[0];
-	if (!S_ISBLK(dev_i->i_mode)) {
+	if (!(type = get_fs_type(dev_name))) {
+		type = file_systems;
+		if (!(dev_i = namei(dev_name))) {
+			return -ENOENT;
+		}
+		dev = dev_i->i_zone[0];
+		if (!S_ISBLK(dev_i->i_mode)) {
+			iput(dev_i);
+			return -EPERM;
+		}
 		iput(dev_i);
-		return -EPERM;
 	}
 	// OK, 现在上面为了得到设备号而取得的 i 节点 dev_i 已经完成了它的使命, 因此这里放回该设备文件的 i 节点. 
 	// 接着我们来检查一下文件系统安装到的目录名是否有效. 于是根据给定的目录文件名找到对应的 i 节点 dir_i. 
 	// 如果该 i 节点的引用计数不为 1(仅在这里引用), 或者该 i 节点的节点号是根文件系统的节点号 1, 
 	// 则放回该 i 节点返回出错码. 
 	// 另外, 如果该节点不是一个目录文件节点, 则也放回该 i 节点, 返回出错码. 因为文件系统只能安装在一个目录名上.
-	iput(dev_i);
 	if (!(dir_i = namei(dir_name))) {
 		return -ENOENT;
 	}
@@ -344,8 +445,12 @@ int sys_mount(char * dev_name, char * dir_name, int rw_flag) {
 	}
 	// 现在安装点也检查完毕, 我们开始读取要安装文件系统的超级块信息. 
 	// 如果读超级块操作失败, 则放回该安装点 i 节点 dir_i 并返回出错码. 
-	// 一个文件系统的超级块会首先从超级块表中进行搜索, 如果不在超级块表中就从设备上读取.
-	if (!(sb = read_super(dev))) {
+	// 一个文件系统的超级块会首先从超级块表中进行搜索, 如果不在超级块表中就从设备上读取. 无名设备号在这里才分配.
+	if (!type->requires_dev && !(dev = get_unnamed_dev())) {
+		iput(dir_i);
+		return -EBUSY;
+	}
+	if (!(sb = read_super(dev, type))) {
 		iput(dir_i);
 		return -EBUSY;
 	}
@@ -357,6 +462,9 @@ int sys_mount(char * dev_name, char * dir_name, int rw_flag) {
 		return -EBUSY;
 	}
 	if (dir_i->i_mount) {
+		if (!type->requires_dev) {					// 刚建立的 tmpfs 没有安装成功, 释放它.
+			put_super(dev);
+		}
 		iput(dir_i);
 		return -EPERM;
 	}
@@ -369,7 +477,7 @@ int sys_mount(char * dev_name, char * dir_name, int rw_flag) {
 }
 
 // 安装根文件系统. 该函数属于系统初始化操作的一部分. 
-// 函数首先初始化文件表列表 file_table[](fs/file_table.c) 和超级块列表( super_block[]), 
+// 函数首先初始化超级块列表( super_block[])(系统文件表由 fs/file_table.c 按需分配, 不需要初始化), 
 // 然后读取根文件系统超级块, 并取得该文件系统根 i 节点, 存放在 i 节点列表 inode[] 中. 
 // 最后统计并显示出根文件系统上的可用资源(空闲逻辑块数和空闲 i 节点数). 
 // 该函数会在系统开机进行初始化设置时(sys_setup())调用(kernel/blk_drv/hd.c).
@@ -382,12 +490,8 @@ void mount_root(void) {
 	if (32 != sizeof(struct d_inode)) {
 		panic("bad i-node size");
 	}
-	// 首先初始化打开的文件表数组(共 64 项, 即系统只能同时打开 64 个文件)和超级块表. 
-	// 这里将所有文件结构中的引用计数设置为 0(表示空闲), 并把超级块表中各项结构的设备字段初始化为 0(也表示空闲). 
+	// 首先初始化超级块表, 把超级块表中各项结构的设备字段初始化为 0(表示空闲). 
 	// 如果根文件系统所在设备是软盘的话, 就提示 "插入根文件系统盘, 并按回车键", 并等待按键.
-	for (i = 0; i < NR_FILE; i++) {					// 初始化文件表.
-		file_table[i].f_count = 0; 					// (fs/file_table.c)
-	}
 	if (MAJOR(ROOT_DEV) == 2) {						// 如果是 ROOT_DEV(根文件设备)是软盘, 则提示插入根文件系统盘.
 		printk("Insert root floppy and press ENTER\r\n");
 		wait_for_keypress();
@@ -401,7 +505,7 @@ void mount_root(void) {
 	// 做好以上 "分外" 的初始化工作之后, 我们开始安装根文件系统. 
 	// 于是从根设备上读取文件系统超级块, 并取得文件系统的根 i 节点(1 号节点)在内存 i 节点表中的指针.
 	// 如果读根设备上超级块失败或取根节点失败, 则显示错误信息并停机.
-	if (!(p = read_super(ROOT_DEV))) { 						// ROOT_DEV = 0x301. (硬盘的第一个分区)
+	if (!(p = read_super(ROOT_DEV, file_systems))) { 						// ROOT_DEV = 0x301. (硬盘的第一个分区)
 		panic("Unable to mount root");
 	}
 	if (!(mi = iget(ROOT_DEV, ROOT_INO))) {					// 在 include/linux/fs.h 中 ROOT_INO 定义为 1.
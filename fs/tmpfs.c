@@ -0,0 +1,325 @@
+/*
+ *  linux/fs/tmpfs.c
+ */
+
+/*
+ * tmpfs.c implements a filesystem that lives entirely in memory. It is
+ * mounted with mount("tmpfs", dir, flags) and its contents disappear at
+ * umount.
+ */
+/*
+ * 内存文件系统 tmpfs.
+ *
+ * 编译过程中产生又很快删除的临时文件也要经过 MINIX 文件系统的位图, 盘上 inode 块和高速缓冲的写盘.
+ * tmpfs 的 inode 和数据块都存放在内存页面中, 卸载时全部丢弃:
+ *  - inode 以盘上 inode 结构(d_inode)的格式存放在 inode 页中, 每页 128 个, read_inode()/write_inode() 只是在内存中复制;
+ *  - 数据块存放在数据页中, 每页 4 块, 数据页地址记录在一个索引页中, 页面在其中有块被分配时才分配, 其中的块都释放后即释放;
+ *  - inode 和逻辑块的分配由一页内存中的两个位图完成, 不使用 bitmap.c 中基于缓冲块的位图, 也没有需要写盘的位图.
+ * 文件系统的其余部分(目录, 间接块, 截断等)沿用 MINIX 的格式和代码: 区段长度为 1 块, 逻辑块号就是数据块在索引中的序号.
+ * 访问数据块的缓冲块直接指向数据页中的块(fs/buffer.c 中 getblk()), 写缓冲块只是清除已修改标志(tmpfs_rw_block()),
+ * 因此读写数据既不复制也不会产生磁盘 I/O, 缓冲块只起到在使用期间固定住该块的作用.
+ *
+ * tmpfs 的超级块使用一个无名设备号(主设备号 0, 由 fs/super.c 分配), 超级块操作函数表见 include/linux/fs.h.
+ */
+
+#include <string.h>
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <sys/stat.h>
+
+#define TMPFS_BLOCKS_PER_PAGE	(PAGE_SIZE / BLOCK_SIZE)							// 每个数据页中的块数(4).
+#define TMPFS_MAX_BLOCKS		(PAGE_SIZE / 4 * TMPFS_BLOCKS_PER_PAGE)				// 一个索引页所能容纳的块数(4096 块, 即 4MB).
+#define TMPFS_INODES_PER_PAGE	(PAGE_SIZE / sizeof(struct d_inode))				// 每个 inode 页中的 inode 数(128).
+#define TMPFS_INODE_PAGES		4													// inode 页数.
+#define TMPFS_MAX_INODES		(TMPFS_INODE_PAGES * TMPFS_INODES_PER_PAGE - 1)		// inode 总数(0 号不用).
+
+// 位图页中两个位图的位置(以长字计): 前面是逻辑块位图, 紧接着是 inode 位图.
+#define TMPFS_ZMAP(info)		((info)->map)
+#define TMPFS_IMAP(info)		((info)->map + TMPFS_MAX_BLOCKS / 32)
+
+// 每个 tmpfs 文件系统的内存页面. 与超级块表一一对应(用超级块在 super_block[] 中的下标索引).
+struct tmpfs_info {
+	unsigned long * blocks;							// 索引页: 各数据页的地址, 0 表示该页还没有分配.
+	unsigned long * map;							// 位图页: 逻辑块位图和 inode 位图.
+	unsigned long inodes[TMPFS_INODE_PAGES];		// 各 inode 页的地址, 用到时才分配.
+};
+
+static struct tmpfs_info tmpfs_info[NR_SUPER];
+
+#define TMPFS_INFO(sb) (tmpfs_info + ((sb) - super_block))
+
+// 取长字 word 中第 1 个 0 值位的位偏移值. word 中必须有 0 值位.
+#define ffz(word) ({ \
+	unsigned long __res; \
+	__asm__("bsfl %1, %0" : "=r" (__res) : "r" (~(word))); \
+	__res; \
+})
+
+static struct super_operations tmpfs_sops;
+
+// 在位图 map 的前 nbits 位(32 的倍数)中找一个 0 值位并置位, 返回其位偏移值. 
+// 已没有 0 值位则返回 0(两个位图的第 0 位都在建立文件系统时置位, 保留不用).
+static int alloc_bit(unsigned long * map, int nbits) {
+	unsigned long bit;
+	int i;
+
+	for (i = 0; i < nbits / 32; i++) {
+		if (~map[i]) {
+			bit = ffz(map[i]);
+			map[i] |= 1UL << bit;
+			return i * 32 + bit;
+		}
+	}
+	return 0;
+}
+
+// 复位位图 map 中的第 nr 位.
+static inline void free_bit(unsigned long * map, int nr) {
+	map[nr >> 5] &= ~(1UL << (nr & 31));
+}
+
+// 取无名设备 dev 上 tmpfs 的内存页面信息. 与 get_super() 不同, 这里不会睡眠. 不是 tmpfs 则返回 NULL.
+static struct tmpfs_info * tmpfs_find(int dev) {
+	struct super_block * sb;
+
+	for (sb = super_block; sb < super_block + NR_SUPER; sb++) {
+		if (sb->s_dev == dev && sb->s_op == &tmpfs_sops) {
+			return TMPFS_INFO(sb);
+		}
+	}
+	return NULL;
+}
+
+// 取逻辑块 block 在数据页中的地址. 块号无效或所在数据页还没有分配则返回 NULL.
+static char * tmpfs_addr(struct tmpfs_info * info, int block) {
+	unsigned long page;
+
+	if (block <= 0 || block >= TMPFS_MAX_BLOCKS || !(page = info->blocks[block / TMPFS_BLOCKS_PER_PAGE])) {
+		return NULL;
+	}
+	return (char *) page + (block % TMPFS_BLOCKS_PER_PAGE) * BLOCK_SIZE;
+}
+
+// 取 inode 号 nr 的 inode 在 inode 页中的位置. 所在 inode 页还没有分配则返回 NULL.
+static struct d_inode * tmpfs_inode(struct tmpfs_info * info, int nr) {
+	unsigned long page;
+
+	if (!(page = info->inodes[nr / TMPFS_INODES_PER_PAGE])) {
+		return NULL;
+	}
+	return (struct d_inode *) page + nr % TMPFS_INODES_PER_PAGE;
+}
+
+// 取无名设备 dev 上 tmpfs 逻辑块 block 在内存中的地址. 由 getblk() 调用, 让缓冲块直接指向该块. 
+// 不是 tmpfs 或块还没有分配则返回 NULL.
+char * tmpfs_block(int dev, int block) {
+	struct tmpfs_info * info;
+
+	if (!(info = tmpfs_find(dev))) {
+		return NULL;
+	}
+	return tmpfs_addr(info, block);
+}
+
+// tmpfs 缓冲块的读写(由 ll_rw_block() 调用). 
+// 缓冲块通常已经直接指向数据页中的块, 这时写只需清除已修改标志. 缓冲块还在使用自己的数据块时(该块曾被释放后又重新分配), 
+// 写操作先把数据复制到数据页中, 然后读写操作都让缓冲块改为直接指向数据页并置有效. 块不存在时读操作不置有效标志, bread() 返回 NULL.
+void tmpfs_rw_block(int rw, struct buffer_head * bh) {
+	char * p;
+
+	if (rw == READA) {
+		rw = READ;
+	} else if (rw == WRITEA) {
+		rw = WRITE;
+	}
+	if ((rw == WRITE && !bh->b_dirt) || (rw == READ && bh->b_uptodate)) {
+		return;
+	}
+	if (!(p = tmpfs_block(bh->b_dev, bh->b_blocknr))) {
+		bh->b_dirt = 0;
+		return;
+	}
+	if (bh->b_data != p) {
+		if (rw == WRITE) {
+			memcpy(p, bh->b_data, BLOCK_SIZE);
+		}
+		bh->b_data = p;
+	}
+	bh->b_uptodate = 1;
+	bh->b_dirt = 0;
+}
+
+// 读 inode: 从 inode 页中复制 inode 内容.
+static void tmpfs_read_inode(struct m_inode * inode) {
+	struct tmpfs_info * info;
+	struct d_inode * d;
+
+	if ((info = tmpfs_find(inode->i_dev)) && (d = tmpfs_inode(info, inode->i_num))) {
+		*(struct d_inode *) inode = *d;
+	}
+}
+
+// 写 inode: 把 inode 内容复制到 inode 页中.
+static void tmpfs_write_inode(struct m_inode * inode) {
+	struct tmpfs_info * info;
+	struct d_inode * d;
+
+	if ((info = tmpfs_find(inode->i_dev)) && (d = tmpfs_inode(info, inode->i_num))) {
+		*d = *(struct d_inode *) inode;
+	}
+}
+
+// 分配一个 inode 号. 所在 inode 页还没有分配就分配一页. 
+// get_free_page() 在内存不够时可能睡眠, 因此分到页面后要再检查一次是否已有其他进程分配了该页. 失败返回 0.
+static int tmpfs_new_inode(struct super_block * sb) {
+	struct tmpfs_info * info = TMPFS_INFO(sb);
+	unsigned long page;
+	int nr;
+
+	if (!(nr = alloc_bit(TMPFS_IMAP(info), TMPFS_MAX_INODES + 1))) {
+		return 0;
+	}
+	if (!info->inodes[nr / TMPFS_INODES_PER_PAGE]) {
+		if (!(page = get_free_page())) {
+			free_bit(TMPFS_IMAP(info), nr);
+			return 0;
+		}
+		if (info->inodes[nr / TMPFS_INODES_PER_PAGE]) {
+			free_page(page);
+		} else {
+			info->inodes[nr / TMPFS_INODES_PER_PAGE] = page;
+		}
+	}
+	memset(tmpfs_inode(info, nr), 0, sizeof(struct d_inode));
+	return nr;
+}
+
+// 释放 inode 号 nr. inode 页不释放.
+static void tmpfs_free_inode(struct super_block * sb, int nr) {
+	free_bit(TMPFS_IMAP(TMPFS_INFO(sb)), nr);
+}
+
+// 分配一个逻辑块, 并把它清零. 所在数据页还没有分配就分配一页(与 tmpfs_new_inode() 一样要防止重复分配). 失败返回 0.
+static int tmpfs_new_block(struct super_block * sb) {
+	struct tmpfs_info * info = TMPFS_INFO(sb);
+	unsigned long page;
+	int block;
+
+	if (!(block = alloc_bit(TMPFS_ZMAP(info), TMPFS_MAX_BLOCKS))) {
+		return 0;
+	}
+	if (!info->blocks[block / TMPFS_BLOCKS_PER_PAGE]) {
+		if (!(page = get_free_page())) {
+			free_bit(TMPFS_ZMAP(info), block);
+			return 0;
+		}
+		if (info->blocks[block / TMPFS_BLOCKS_PER_PAGE]) {
+			free_page(page);
+		} else {
+			info->blocks[block / TMPFS_BLOCKS_PER_PAGE] = page;
+		}
+	}
+	memset(tmpfs_addr(info, block), 0, BLOCK_SIZE);
+	return block;
+}
+
+// 释放逻辑块 block. 若它所在数据页中的块都已释放, 则释放该数据页. 
+// 调用者(free_block())已经让指向该块的缓冲块恢复使用自己的数据块.
+static void tmpfs_free_block(struct super_block * sb, int block) {
+	struct tmpfs_info * info = TMPFS_INFO(sb);
+	int first = block - block % TMPFS_BLOCKS_PER_PAGE;
+
+	free_bit(TMPFS_ZMAP(info), block);
+	if (!((TMPFS_ZMAP(info)[first >> 5] >> (first & 31)) & ((1 << TMPFS_BLOCKS_PER_PAGE) - 1))) {
+		free_page(info->blocks[block / TMPFS_BLOCKS_PER_PAGE]);
+		info->blocks[block / TMPFS_BLOCKS_PER_PAGE] = 0;
+	}
+}
+
+// 释放 tmpfs 的全部页面(卸载时). 先丢弃内存 inode 表和高速缓冲中属于该设备的 inode 和缓冲块, 
+// 因为设备号以后会分配给别的 tmpfs, 而缓冲块可能还指向即将释放的数据页.
+static void tmpfs_put_super(struct super_block * sb) {
+	struct tmpfs_info * info = TMPFS_INFO(sb);
+	int i;
+
+	invalidate_inodes(sb->s_dev);
+	invalidate_buffers(sb->s_dev);
+	for (i = 0; i < PAGE_SIZE / 4; i++) {
+		if (info->blocks[i]) {
+			free_page(info->blocks[i]);
+		}
+	}
+	for (i = 0; i < TMPFS_INODE_PAGES; i++) {
+		if (info->inodes[i]) {
+			free_page(info->inodes[i]);
+		}
+	}
+	free_page((unsigned long) info->blocks);
+	free_page((unsigned long) info->map);
+	memset(info, 0, sizeof(*info));
+}
+
+static struct super_operations tmpfs_sops = {
+	tmpfs_read_inode,
+	tmpfs_write_inode,
+	tmpfs_new_inode,
+	tmpfs_free_inode,
+	tmpfs_new_block,
+	tmpfs_free_block,
+	tmpfs_put_super
+};
+
+// 建立一个空的 tmpfs 文件系统(fs/super.c 中 read_super() 调用). 超级块的 s_dev 已经设置为分配到的无名设备号. 
+// 分配索引页, 位图页和第 1 个 inode 页, 然后建立根目录: 根 inode(1 号)和含有 "." 和 ".." 两个目录项的第 1 个数据块. 
+// 根目录与 /tmp 一样所有人可写, 并设置受限删除标志. 成功返回 0, 内存不够返回 -1.
+int tmpfs_read_super(struct super_block * sb) {
+	struct tmpfs_info * info = TMPFS_INFO(sb);
+	struct dir_entry * de;
+	struct d_inode * root;
+	int block;
+
+	memset(info, 0, sizeof(*info));
+	info->blocks = (unsigned long *) get_free_page();
+	info->map = (unsigned long *) get_free_page();
+	info->inodes[0] = get_free_page();
+	if (!info->blocks || !info->map || !info->inodes[0]) {
+		free_page((unsigned long) info->blocks);
+		free_page((unsigned long) info->map);
+		free_page(info->inodes[0]);
+		memset(info, 0, sizeof(*info));
+		return -1;
+	}
+	sb->s_ninodes = TMPFS_MAX_INODES;
+	sb->s_nzones = TMPFS_MAX_BLOCKS;
+	sb->s_imap_blocks = sb->s_zmap_blocks = 0;
+	sb->s_firstdatazone = 1;
+	sb->s_log_zone_size = 0;
+	sb->s_max_size = TMPFS_MAX_BLOCKS * BLOCK_SIZE;
+	sb->s_magic = TMPFS_MAGIC;
+	sb->s_jstart = sb->s_jblocks = 0;
+	sb->s_op = &tmpfs_sops;
+	sb->s_iop = &minix_inode_operations;
+	// 0 号块和 0, 1 号 inode 保留.
+	TMPFS_ZMAP(info)[0] = 1;
+	TMPFS_IMAP(info)[0] = 3;
+	if (!(block = tmpfs_new_block(sb))) {
+		tmpfs_put_super(sb);
+		sb->s_op = NULL;
+		return -1;
+	}
+	de = (struct dir_entry *) tmpfs_addr(info, block);
+	de[0].inode = de[1].inode = ROOT_INO;
+	strcpy(de[0].name, ".");
+	strcpy(de[1].name, "..");
+	root = tmpfs_inode(info, ROOT_INO);
+	root->i_mode = S_IFDIR | S_ISVTX | 0777;
+	root->i_uid = current->euid;
+	root->i_gid = current->egid;
+	root->i_size = 2 * sizeof(struct dir_entry);
+	root->i_time = CURRENT_TIME;
+	root->i_nlinks = 2;
+	root->i_zone[0] = block;
+	return 0;
+}
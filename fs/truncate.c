@@ -8,31 +8,25 @@
 #include <sys/stat.h>           								// 文件状态头文件. 含有文件或文件系统状态结构 stat{} 和常量. 
 
 // 释放所有一次间接块. (内部函数)
-// 参数 dev 是文件系统所有设备的设备号; block 是逻辑块号. 成功则返回 1, 否则返回 0. 
-static int free_ind(int dev, int block) {
+// 参数 dev 是文件系统所有设备的设备号; block 是逻辑块号(区段号); shift 是区段长度(以数据块计)的对数. 
+// 间接块中的块号都是区段号, 间接块本身只使用其区段的第一个数据块. 成功则返回 1, 否则返回 0. 
+static int free_ind(int dev, int block, int shift) {
 	struct buffer_head * bh;
-	unsigned short * p;
-	int i;
 	int block_busy;
 
 	// 首先判断参数的有效性. 如果逻辑块号为 0, 则返回. 然后读取一次间接块, 并释放其上表明使用的所有逻辑块, 
-	// 然后释放该一次间接块的缓冲块. 函数 free_block() 用于释放设备上指定逻辑块号的磁盘块(fs/bitmap.c). 
+	// 然后释放该一次间接块的缓冲块. 间接块上的 512 个块号由 free_blocks() 一次成批释放(fs/bitmap.c), 
+	// 释放成功的项会被清零, 因此间接块需置已修改标志. 
 	if (!block) {
 		return 1;
 	}
 	block_busy = 0;
-	if (bh = bread(dev, block)) {
-		p = (unsigned short *) bh->b_data;              		// 指向缓冲块数据区. 
-		for (i = 0; i < 512; i++, p++) {                        // 每个逻辑块上可有 512 个块号. 
-			if (*p) {
-				if (free_block(dev, *p)) {       				// 释放指定的设备逻辑块. 
-					*p = 0;                 					// 清零. 
-					bh->b_dirt = 1;         					// 设置已修改标志. 
-				} else {
-					block_busy = 1;         					// 设置逻辑块没有释放标志. 
-				}
-			}
+	if (bh = bread(dev, block << shift)) {
+		if (free_blocks(dev, (unsigned short *) bh->b_data, 512)) {
+			block_busy = 1;         							// 设置逻辑块没有释放标志. 
 		}
+		bh->b_dirt = 1;         								// 设置已修改标志. 
+		bh->b_meta = 1;
 		brelse(bh);                                     		// 然后释放间接块占用的缓冲块. 
 	}
 	// 最后释放设备上的一次间接块. 但如果其中有逻辑块没有被释放, 则返回 0(失败). 
@@ -44,8 +38,8 @@ static int free_ind(int dev, int block) {
 }
 
 // 释放所有二次间接块. 
-// 参数 dev 是文件系统所在设备的设备号；block 是逻辑块号. 
-static int free_dind(int dev, int block) {
+// 参数 dev 是文件系统所在设备的设备号；block 是逻辑块号(区段号); shift 是区段长度(以数据块计)的对数. 
+static int free_dind(int dev, int block, int shift) {
 	struct buffer_head * bh;
 	unsigned short * p;
 	int i;
@@ -57,13 +51,14 @@ static int free_dind(int dev, int block) {
 		return 1;
 	}
 	block_busy = 0;
-	if (bh = bread(dev, block)) {
+	if (bh = bread(dev, block << shift)) {
 		p = (unsigned short *) bh->b_data;              		// 指向缓冲块数据区. 
 		for (i = 0; i < 512; i++, p++) {                       	// 每个逻辑块上可连接 512 个二级块. 
 			if (*p) {
-				if (free_ind(dev, *p)) {         				// 释放所有一次间接块. 
+				if (free_ind(dev, *p, shift)) {         		// 释放所有一次间接块. 
 					*p = 0;                 					// 清零. 
 					bh->b_dirt = 1;         					// 设置已修改标志. 
+					bh->b_meta = 1;
 				} else {
 					block_busy = 1;         					// 设置逻辑块没有释放标志. 
 				}
@@ -79,36 +74,49 @@ static int free_dind(int dev, int block) {
 	}
 }
 
-// 截断文件数据函数. 
-// 将节点对应的文件长度减 0, 并释放战胜的设备空间. 
+// 截断文件数据函数. 经由 inode 操作函数表调用文件所在文件系统的截断函数(MINIX 文件系统为 minix_truncate()). 
+// 管道等没有文件系统的 inode 没有数据块可释放. 同时清除 inode 中缓存的执行文件头部标志(fs/exec.c), 
+// 截断过程中可能睡眠, 所以截断前后各清除一次.
 void truncate(struct m_inode * inode) {
-	int i;
+	inode->i_exec = 0;
+	if (inode->i_op) {
+		inode->i_op->truncate(inode);
+	}
+	inode->i_exec = 0;
+}
+
+// MINIX 文件系统的截断文件数据函数(inode 操作函数 truncate). 
+// 将节点对应的文件长度减 0, 并释放战胜的设备空间. 
+void minix_truncate(struct m_inode * inode) {
+	int shift;
 	int block_busy;                 							// 有逻辑块没有被释放的标志. 
+	struct super_block * sb;
 
 	// 首先判断指定 i 节点有效性. 如果不是常规文件, 目录文件或链接项, 则返回. 
+	// 然后取得文件系统的区段长度(以数据块计)的对数, 用于读取间接块. 
 	if (!(S_ISREG(inode->i_mode) || S_ISDIR(inode->i_mode) || S_ISLNK(inode->i_mode))) {
 		return;
 	}
+	if (!(sb = get_super(inode->i_dev))) {
+		panic("truncate: trying to truncate inode without super block");
+	}
+	shift = sb->s_log_zone_size;
 	// 然后释放 i 节点的 7 个直接逻辑块, 并将这 7 个逻辑块项全置零. 
-	// 函数 free_block() 用于释放设备上指定逻辑块的磁盘块(fs/bitmap.c). 
+	// 函数 free_blocks() 用于成批释放设备上指定逻辑块的磁盘块(fs/bitmap.c). 
 	// 若有逻辑块忙而没有被释放则置块忙标志 block_busy. 
 repeat:
+	// 缓存的间接块即将被释放, 必须先放弃对它的引用, 否则 free_block() 会因该块正被使用而无法释放它.
+	free_ind_cache(inode);
 	block_busy = 0;
-	for (i = 0; i < 7; i++) {
-		if (inode->i_zone[i]) {                 				// 如果块号不为 0, 则释放之. 
-			if (free_block(inode->i_dev, inode->i_zone[i])) {
-				inode->i_zone[i] = 0;     						// 块指针置 0. 
-			} else {
-				block_busy = 1;         						// 若没有释放掉则置标志. 
-			}
-		}
+	if (free_blocks(inode->i_dev, inode->i_zone, 7)) {			// 释放掉的块指针被置 0. 
+		block_busy = 1;         								// 若没有释放掉则置标志. 
 	}
-	if (free_ind(inode->i_dev, inode->i_zone[7])) {   			// 释放所有一次间接块. 
+	if (free_ind(inode->i_dev, inode->i_zone[7], shift)) {   			// 释放所有一次间接块. 
 		inode->i_zone[7] = 0;                   				// 块指针置 0. 
 	} else {
 		block_busy = 1;                         				// 若没有释放掉则置标志. 
 	}
-	if (free_dind(inode->i_dev, inode->i_zone[8])) {   			// 释放所有二次间接块. 
+	if (free_dind(inode->i_dev, inode->i_zone[8], shift)) {   			// 释放所有二次间接块. 
 		inode->i_zone[8] = 0;                   				// 块指针置 0. 
 	} else {
 		block_busy = 1;                         				// 若没有释放掉则置标志. 
@@ -31,3 +31,15 @@ __asm__ volatile ("inb %%dx, %%al\n" \
 	"1:":"=a" (_v):"d" (port)); \
 _v; \
 })
+
+// 硬件端口长字输出函数. 用于访问 PCI 配置空间和 IDE 总线主控 DMA 寄存器.
+// 参数: value - 欲输出长字; port - 端口.
+#define outl(value, port) \
+__asm__ ("outl %%eax,%%dx"::"a" (value), "d" (port))
+
+// 硬件端口长字输入函数. 参数: port - 端口. 返回读取的长字.
+#define inl(port) ({ \
+unsigned long _v; \
+__asm__ volatile ("inl %%dx, %%eax":"=a" (_v):"d" (port)); \
+_v; \
+})
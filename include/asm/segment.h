@@ -57,6 +57,105 @@ static inline void put_fs_long(unsigned long val, unsigned long * addr)
 	__asm__ ("movl %0, %%fs:%1" : : "q" (val), "m" (*addr));
 }
 
+// 以下三个函数在内核与 fs 段(用户空间)之间成块地传送数据, 用来代替逐字节调用 get_fs_byte()/put_fs_byte() 的循环.
+// 它们先用 movsb 复制几个字节使目的地址按 4 字节对齐, 然后用 rep movsl 每次复制 4 个字节, 最后再复制剩余的 0 - 3 个字节.
+// 与 put_fs_byte() 一样, 调用者必须事先用 verify_area() 验证用户内存区域.
+
+// 从内核空间 from 处复制 n 个字节到 fs 段中的 to 处.
+// movs 指令的目的操作数固定使用 es 段, 因此复制期间临时令 es = fs.
+static inline void copy_to_user(char * to, const char * from, unsigned long n)
+{
+	unsigned long head = (-(unsigned long) to) & 3;
+	int d0, d1, d2;
+
+	if (head > n) {
+		head = n;
+	}
+	__asm__ __volatile__ ("cld\n\t"
+		"push %%es\n\t"
+		"push %%fs\n\t"
+		"pop %%es\n\t"
+		"rep movsb\n\t"
+		"movl %6, %%ecx\n\t"
+		"shrl $2, %%ecx\n\t"
+		"rep movsl\n\t"
+		"movl %6, %%ecx\n\t"
+		"andl $3, %%ecx\n\t"
+		"rep movsb\n\t"
+		"pop %%es"
+		: "=&c" (d0), "=&D" (d1), "=&S" (d2)
+		: "0" (head), "1" (to), "2" (from), "r" (n - head)
+		: "memory");
+}
+
+// 从 fs 段中的 from 处复制 n 个字节到内核空间 to 处.
+// movs 指令的源操作数可以使用段超越前缀, 因此这里直接从 fs:esi 复制到 es:edi.
+static inline void copy_from_user(char * to, const char * from, unsigned long n)
+{
+	unsigned long head = (-(unsigned long) to) & 3;
+	int d0, d1, d2;
+
+	if (head > n) {
+		head = n;
+	}
+	__asm__ __volatile__ ("cld\n\t"
+		"rep movsb %%fs:(%%esi), %%es:(%%edi)\n\t"
+		"movl %6, %%ecx\n\t"
+		"shrl $2, %%ecx\n\t"
+		"rep movsl %%fs:(%%esi), %%es:(%%edi)\n\t"
+		"movl %6, %%ecx\n\t"
+		"andl $3, %%ecx\n\t"
+		"rep movsb %%fs:(%%esi), %%es:(%%edi)"
+		: "=&c" (d0), "=&D" (d1), "=&S" (d2)
+		: "0" (head), "1" (to), "2" (from), "r" (n - head)
+		: "memory");
+}
+
+// 计算 fs 段中字符串 s 的长度, 包括结尾的 NULL 字符. 用 repne scasb 代替逐字节调用 get_fs_byte() 的循环.
+// scas 指令只能使用 es 段, 因此与 copy_to_user() 一样临时令 es = fs. ecx 从 -1 开始每扫描一个字节减 1, 结束时取反即得扫描的字节数.
+static inline unsigned long strlen_fs(const char * s)
+{
+	unsigned long res;
+	int d0, d1;
+
+	__asm__ __volatile__ ("cld\n\t"
+		"push %%es\n\t"
+		"push %%fs\n\t"
+		"pop %%es\n\t"
+		"repne scasb\n\t"
+		"pop %%es"
+		: "=c" (res), "=D" (d0), "=a" (d1)
+		: "0" (0xffffffff), "1" (s), "2" (0)
+		: "memory");
+	return ~res;
+}
+
+// 把 fs 段中 to 处开始的 n 个字节清零.
+static inline void clear_user(char * to, unsigned long n)
+{
+	unsigned long head = (-(unsigned long) to) & 3;
+	int d0, d1;
+
+	if (head > n) {
+		head = n;
+	}
+	__asm__ __volatile__ ("cld\n\t"
+		"push %%es\n\t"
+		"push %%fs\n\t"
+		"pop %%es\n\t"
+		"rep stosb\n\t"
+		"movl %5, %%ecx\n\t"
+		"shrl $2, %%ecx\n\t"
+		"rep stosl\n\t"
+		"movl %5, %%ecx\n\t"
+		"andl $3, %%ecx\n\t"
+		"rep stosb\n\t"
+		"pop %%es"
+		: "=&c" (d0), "=&D" (d1)
+		: "a" (0), "0" (head), "1" (to), "r" (n - head)
+		: "memory");
+}
+
 /*
  * Someone who knows GNU asm better than I should double check the followig.
  * It seems to work, but I don't know if I'm doing something subtly wrong.
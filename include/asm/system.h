@@ -65,6 +65,11 @@ __asm__ (\
 #define cli() __asm__ ("cli"::)				// 关中断.
 #define nop() __asm__ ("nop"::)				// 空操作.
 
+// 保存和恢复标志寄存器(其中含中断允许标志). 用于可能在关中断时被调用的代码: 
+// 用 save_flags(); cli(); ... restore_flags() 代替 cli(); ... sti(), 就不会在调用者关中断期间打开中断.
+#define save_flags(x) __asm__ __volatile__ ("pushfl; popl %0" : "=r" (x) : : "memory")
+#define restore_flags(x) __asm__ __volatile__ ("pushl %0; popfl" : : "r" (x) : "memory")
+
 #define iret() __asm__ ("iret"::)			// 中断返回
 
 // 设置门描述符宏.
@@ -35,6 +35,9 @@
 #define F_GETLK		5	/* not implemented */           	// 返回阻止锁定的 flock 结构.
 #define F_SETLK		6                                       // 设置(F_RDLCK 或 F_WRLCK)或清除(F_UNLCK)锁定.
 #define F_SETLKW	7                                       // 等待设置或清除锁定.
+// 下面两个命令只用于管道, 编号与 Linux 的相同.
+#define F_SETPIPE_SZ	1031                                // 设置管道缓冲区大小(字节数), 返回实际设置的大小.
+#define F_GETPIPE_SZ	1032                                // 取管道缓冲区大小.
 
 /* for F_[GET|SET]FL */
 /* 用于 F_GETFL 或 F_SETFL */
@@ -44,6 +44,7 @@
 void buffer_init(long buffer_end);						// 高速缓冲区初始化函数.
 
 // 主设备号: 1 - 内存, 2 - 磁盘, 3 - 硬盘, 4 - ttyx, 5 - tty, 6 - 并行口, 7 - 非命名管道.
+// 主设备号 0 的设备号(次设备号不为 0)是无名设备, 分配给 tmpfs 这类不需要设备的文件系统(fs/super.c).
 #define MAJOR(a) (((unsigned)(a)) >> 8)					// 取高字节(主设备号); 
 #define MINOR(a) ((a) & 0xff)							// 取低字节(次设备号)
 
@@ -53,15 +54,18 @@ void buffer_init(long buffer_end);						// 高速缓冲区初始化函数.
 #define I_MAP_SLOTS 8									// inode 位图槽数(这个位图最多可以使用 8KB 的数据块).
 #define Z_MAP_SLOTS 8									// 逻辑块位图槽数(这个位图最多可以使用 8KB 的数据块).
 #define SUPER_MAGIC 0x137F								// 文件系统魔数.
+#define TMPFS_MAGIC 0x1994								// 内存文件系统 tmpfs 的魔数(只存在于内存超级块中).
 
-#define NR_OPEN 		20								// 进程能打开的最大文件数.
+#define NR_OPEN 		1024							// 进程能打开的最大文件数(描述符表扩展的上限).
+#define NR_OPEN_DEFAULT	32								// 任务结构中内嵌的描述符表项数, 不够用时再按需扩展.
 #define NR_INODE 		64								// 系统同时能打开(使用)的最大 inode 个数.
-#define NR_FILE 		64								// 系统能同时打开的最大文件个数(文件数组项数).
+#define NR_FILE 		1024							// 系统能同时打开的最大文件个数(文件表按页扩展的上限).
 #define NR_SUPER 		8								// 系统所含超级块个数(超级块数组项数).
 #define NR_HASH 		307								// 高速缓冲区 Hash 表数组项数值.
 #define NR_BUFFERS 		nr_buffers						// 系统所含缓冲个数, 初始化后不再改变.
 #define BLOCK_SIZE 		1024							// 高速缓冲数据块长度(byte).
 #define BLOCK_SIZE_BITS 10								// 数据块长度所占比特位数.
+#define MAX_LOG_ZONE_SIZE 2								// 支持的最大区段长度 log(数据块数/区段), 即区段最大为 4KB(一页).
 #ifndef NULL
 #define NULL ((void *) 0)
 #endif
@@ -70,13 +74,24 @@ void buffer_init(long buffer_end);						// 高速缓冲区初始化函数.
 #define DIR_ENTRIES_PER_BLOCK ((BLOCK_SIZE) / (sizeof(struct dir_entry)))    // 每个逻辑块可存放的目录项数.
 
 // 管道头, 管道尾, 管道大小, 管道空? 管道满? 管道头指针递增.
+// 管道缓冲区由 PIPE_PAGES 个页面组成(默认 1 页, 可用 fcntl(F_SETPIPE_SZ) 调整, 最多 PIPE_MAX_PAGES 页), 
+// 各页面的地址存放在 pipe_pages[][] 表中与该 inode 对应的一行里, 除第 1 页外都在第一次写到该页时才分配. 
+// 管道头尾指针是缓冲区中的字节偏移, 管道中的数据长度放在 i_size 中, 因此缓冲区可以全部写满.
+// 复制数据时可能因缺页或读写文件而睡眠, 因此读写管道, splice 和调整缓冲区大小时都先置 PIPE_BUSY 标志独占管道缓冲区, 
+// 其他进程在 PIPE_BUSY_WAIT 上等待(fs/pipe.c). 等待数据或空闲空间时不持有该标志.
+#define PIPE_MAX_PAGES 16
 #define PIPE_READ_WAIT(inode) ((inode).i_wait)
 #define PIPE_WRITE_WAIT(inode) ((inode).i_wait2)
 #define PIPE_HEAD(inode) ((inode).i_zone[0])
 #define PIPE_TAIL(inode) ((inode).i_zone[1])
-#define PIPE_SIZE(inode) ((PIPE_HEAD(inode) - PIPE_TAIL(inode)) & (PAGE_SIZE - 1))
-#define PIPE_EMPTY(inode) (PIPE_HEAD(inode) == PIPE_TAIL(inode))
-#define PIPE_FULL(inode) (PIPE_SIZE(inode) == (PAGE_SIZE - 1))
+#define PIPE_PAGES(inode) ((inode).i_zone[2])
+#define PIPE_BUSY(inode) ((inode).i_zone[3])
+#define PIPE_PAGE(inode, n) (pipe_pages[&(inode) - inode_table][n])
+#define PIPE_BUSY_WAIT(inode) (pipe_busy_wait[&(inode) - inode_table])
+#define PIPE_BUF_SIZE(inode) (PIPE_PAGES(inode) * PAGE_SIZE)
+#define PIPE_SIZE(inode) ((inode).i_size)
+#define PIPE_EMPTY(inode) (!PIPE_SIZE(inode))
+#define PIPE_FULL(inode) (PIPE_SIZE(inode) == PIPE_BUF_SIZE(inode))
 
 #define NIL_FILP	((struct file *)0)      			// 空文件结构指针。
 #define SEL_IN		1
@@ -99,6 +114,7 @@ struct buffer_head {
 	unsigned char b_count;				/* users using this block */				// 该缓冲块被引用的次数(是否可以被回收).
 	// 互斥锁标志, 防止并发修改带来的数据不一致的问题(比如写入磁盘或从磁盘加载数据). 只要被锁定, 其它进程就不能访问该数据.
 	unsigned char b_lock;				/* 0 - ok, 1 - locked */					// 缓冲区是否被锁定(是否允许被修改).
+	unsigned char b_meta;				// 数据区中的元数据块(目录块或间接块)标志, 这类块需要经由日志写盘.
 	struct task_struct * b_wait;		// 指向等待该缓冲区解锁的进程.
 	// 以下两个字段用于实现哈希槽链表(即 dev + block 哈希后为同一个槽位值的缓冲区组成的链表).
 	struct buffer_head * b_prev;		// hash 队列上前一块(这四个指针用于缓冲区的管理).
@@ -106,6 +122,9 @@ struct buffer_head {
 	// 以下两个字段用于实现空闲缓冲块循环链表
 	struct buffer_head * b_prev_free;	// 空闲链表上前一块.
 	struct buffer_head * b_next_free;	// 空闲链表上后一块.
+	// 缓冲块自己的数据块. 虚拟盘设备的缓冲块不复制数据, b_data 直接指向虚拟盘页面中的对应块, 
+	// 缓冲块被重新分配时 b_data 再恢复为 b_buf(fs/buffer.c 中 getblk()).
+	char * b_buf;
 };
 
 // 磁盘上的索引节点(inode)数据结构.
@@ -153,6 +172,11 @@ struct m_inode {
 	unsigned char i_mount;								// 挂载标志: 该 inode 是否挂载其它文件系统, 只有挂载了其它文件系统会置位, 根 inode 不会置位.
 	unsigned char i_seek;								// 搜索标志(lseek 操作时).
 	unsigned char i_update;								// inode 已更新标志.
+	unsigned char i_epoll;								// inode 用作 epoll 对象标志, 此时 i_size 是 epoll 对象指针(fs/select.c).
+	unsigned char i_exec;								// 执行文件头部已缓存在 exec_headers[] 中(fs/exec.c). 写文件或截断时清除.
+	struct buffer_head * i_ind_bh;						// 最近使用的间接块的缓冲块(持有一个引用计数).
+	unsigned long i_ind_base;							// 该间接块映射的第一个文件区段号.
+	struct inode_operations * i_op;						// inode 操作函数表(读 inode 时取自超级块的 s_iop, 管道等没有文件系统的 inode 为 NULL).
 };
 
 // 文件结构(用于在文件句柄与 inode 之间建立关系).
@@ -162,8 +186,14 @@ struct file {
 	unsigned short f_count;								// 对应文件引用计数值.
 	struct m_inode * f_inode;							// 指向文件对应 inode.
 	off_t f_pos;										// 文件位置(读写偏移值).
+	struct file * f_next, * f_prev;						// 系统文件表双向循环链表指针(fs/file_table.c).
 };
 
+// 描述符位图(任务结构中的 open_fds 和 close_on_exec)的操作宏. 位图以长字为单位存放, 可超过 32 个描述符.
+#define FD_BIT_SET(fd, map)		((map)[(fd) >> 5] |= 1UL << ((fd) & 31))
+#define FD_BIT_CLR(fd, map)		((map)[(fd) >> 5] &= ~(1UL << ((fd) & 31)))
+#define FD_BIT_ISSET(fd, map)	(((map)[(fd) >> 5] >> ((fd) & 31)) & 1)
+
 // 内存中磁盘超级块结构, 用于存放文件系统的结构信息, 并说明各部分的大小.
 struct super_block {
 	unsigned short s_ninodes;							// 该文件系统中的 inode 总数.
@@ -171,9 +201,11 @@ struct super_block {
 	unsigned short s_imap_blocks;						// inode 位图所占用的数据块数.
 	unsigned short s_zmap_blocks;						// 逻辑块位图所占用的数据块数.
 	unsigned short s_firstdatazone;						// 数据区中第一个数据块的逻辑块号.
-	unsigned short s_log_zone_size;						// log(数据块数/逻辑块). (以 2 为底)
+	unsigned short s_log_zone_size;						// log(数据块数/逻辑块). (以 2 为底) 区段(逻辑块)可以是 1KB, 2KB 或 4KB.
 	unsigned long s_max_size;							// 文件的最大长度.
 	unsigned short s_magic;								// 文件系统魔数(0x137f).
+	unsigned long s_jstart;								// 日志区的起始块号.
+	unsigned long s_jblocks;							// 日志区占用的块数, 0 表示不使用日志.
 	/* These are only in memory */
 	struct buffer_head * s_imap[8];			// inode 位图所在的高速缓冲块(每块 1KB)指针数组(占用 8 块, 可表示 64M).
 	struct buffer_head * s_zmap[8];			// 逻辑块位图所在的高速缓冲块指针数组(占用 8 块).
@@ -185,6 +217,24 @@ struct super_block {
 	unsigned char s_lock;					// 锁定标志(0 - 未被锁定, 1 - 被锁定).
 	unsigned char s_rd_only;				// 只读标志.
 	unsigned char s_dirt;					// 已修改(脏)标志.
+	unsigned short s_jhandles;				// 在该文件系统上持有日志事务句柄的进程数.
+	unsigned char s_jdraining;				// 有进程正在等待句柄结束以便提交日志, 此时不能开始新的句柄.
+	unsigned char s_jcommitting;			// 正在提交该文件系统的日志.
+	struct super_operations * s_op;			// 超级块操作函数表. MINIX 文件系统为 NULL, 直接使用 inode.c 和 bitmap.c 中的代码.
+	struct inode_operations * s_iop;		// 该文件系统中 inode 的操作函数表.
+};
+
+// 超级块操作函数表. 不在磁盘上保存 inode 和位图的文件系统类型(目前只有内存文件系统 tmpfs)在 read_super() 时设置 s_op, 
+// inode.c 和 bitmap.c 中读写 inode, 分配和释放 inode 与逻辑块的函数遇到非空的 s_op 就转而调用这里的函数. 
+// 逻辑块的数据则仍然经由 bread()/getblk() 访问(内存中的数据块由缓冲块直接指向, 见 fs/buffer.c 中 getblk()).
+struct super_operations {
+	void (* read_inode)(struct m_inode * inode);				// 把 inode 内容读入内存 inode 结构.
+	void (* write_inode)(struct m_inode * inode);				// 保存内存 inode 结构的内容.
+	int (* new_inode)(struct super_block * sb);					// 分配一个 inode 号, 失败返回 0.
+	void (* free_inode)(struct super_block * sb, int nr);		// 释放 inode 号 nr.
+	int (* new_block)(struct super_block * sb);					// 分配一个已清零的逻辑块, 失败返回 0.
+	void (* free_block)(struct super_block * sb, int block);	// 释放逻辑块 block.
+	void (* put_super)(struct super_block * sb);				// 释放文件系统占用的资源(卸载时).
 };
 
 // 磁盘上超级块结构, 用于存放文件系统的结构信息, 并说明各部分的大小.
@@ -197,6 +247,8 @@ struct d_super_block {
 	unsigned short s_log_zone_size;						// log(数据块数/逻辑块). (以 2 为底)
 	unsigned long s_max_size;							// 文件最大长度.
 	unsigned short s_magic;								// 文件系统魔数.
+	unsigned long s_jstart;								// 日志区的起始块号.
+	unsigned long s_jblocks;							// 日志区占用的块数, 0 表示不使用日志.
 };
 
 // 文件目录项结构.
@@ -205,8 +257,24 @@ struct dir_entry {
 	char name[NAME_LEN];								// 文件名, 长度 NAME_LEN = 14.
 };
 
+// inode 操作函数表. 目录项的查找和添加, 文件读写, 数据块映射和截断经由 inode 的 i_op 调用, 
+// namei.c 中的 find_entry()/add_entry(), file_dev.c 中的 file_read()/file_write(), inode.c 中的 bmap() 等
+// 和 truncate() 只是转发函数, 因此 open.c, read_write.c 等系统调用层不必知道文件系统在盘上的格式. 
+// 目前只有 MINIX 格式的实现 minix_inode_operations(fs/super.c), tmpfs 也使用它.
+struct inode_operations {
+	struct buffer_head * (* lookup)(struct m_inode * dir, const char * name, int namelen, struct dir_entry ** res_dir);	// 查找目录项.
+	struct buffer_head * (* create)(struct m_inode * dir, const char * name, int namelen, struct dir_entry ** res_dir);	// 添加空目录项.
+	int (* read)(struct m_inode * inode, struct file * filp, char * buf, int count, off_t * pos);		// 读文件数据.
+	int (* write)(struct m_inode * inode, struct file * filp, char * buf, int count, off_t * pos);		// 写文件数据.
+	int (* bmap)(struct m_inode * inode, int block, int count, int * zones, int create);				// 映射(或创建)一串文件数据块.
+	void (* truncate)(struct m_inode * inode);															// 释放文件的全部数据块.
+};
+
 extern struct m_inode inode_table[NR_INODE];            // 定义 inode 表数组(64 项).
-extern struct file file_table[NR_FILE];                 // 文件表数组, 用于存放打开的文件(64 项).
+extern unsigned long pipe_pages[NR_INODE][PIPE_MAX_PAGES];	// 管道缓冲区页面表(fs/pipe.c).
+extern struct task_struct * pipe_busy_wait[NR_INODE];		// 等待管道缓冲区空闲的进程队列(fs/pipe.c).
+extern struct file * first_file;						// 系统文件表链表头, 文件结构按页分配(fs/file_table.c).
+extern int nr_files;									// 系统文件表中现有的文件结构数.
 extern struct super_block super_block[NR_SUPER];        // 超级块数组(8 项), 每个文件系统对应一个超级块, 所以可以安装 8 个文件系统.
 extern struct buffer_head * start_buffer;              	// 缓冲区起始内存位置.
 extern int nr_buffers;
@@ -220,9 +288,13 @@ extern void floppy_off(unsigned int dev);                       // 关闭指定
 // 以下是文件系统操作管理用的函数原型。
 extern void truncate(struct m_inode * inode);                   // 将 inode 指定的文件截为 0.
 extern void sync_inodes(void);                                  // 刷新 inode 信息.
+extern void sync_dev_inodes(int dev);							// 刷新设备 dev 上的 inode 信息.
 extern void wait_on(struct m_inode * inode);                    // 等待指定的 inode.
 extern int bmap(struct m_inode * inode, int block);             // 逻辑块(区段, 磁盘块)位图操作. 取数据块 block 在设备上对应的逻辑块号.
 extern int create_block(struct m_inode * inode,int block);      // 创建数据块 block 在设备上对应的逻辑块, 并返回在设备上的逻辑块号.
+extern int bmap_blocks(struct m_inode * inode, int block, int count, int * zones);		// 一次映射连续多个数据块, 返回映射的块数.
+extern int create_blocks(struct m_inode * inode, int block, int count, int * zones);	// 一次映射(必要时创建)连续多个数据块.
+extern void free_ind_cache(struct m_inode * inode);				// 释放 inode 中缓存的间接块.
 
 extern struct m_inode * namei(const char * pathname);           // 获取指定路径名的 inode.
 extern struct m_inode * lnamei(const char * pathname);          // 取指定路径名的 inode, 不跟随符号链接.
@@ -232,16 +304,28 @@ extern void iput(struct m_inode * inode);                       // 释放一个
 extern struct m_inode * iget(int dev,int nr);                   // 从设备读取指定节点号的一个 inode.
 extern struct m_inode * get_empty_inode(void);                  // 从 inode 表(inode_table)中获取一个空闲 inode 项.
 extern struct m_inode * get_pipe_inode(void);                   // 获取(申请一)管道节点. 返回为 inode 指针(如果是 NULL 则失败).
+extern void free_pipe_pages(struct m_inode * inode);			// 释放管道缓冲区的所有页面.
+extern void ep_release(struct m_inode * inode);					// 释放 epoll 对象.
+extern void ep_forget(struct file * filp);						// 从所有 epoll 兴趣集中删除文件 filp.
+extern struct file * get_empty_filp(void);						// 从系统文件表中取一个空闲文件结构(引用计数置 1).
+extern int get_unused_fd(unsigned int start);					// 为当前进程分配不小于 start 的最小空闲描述符.
+extern void put_unused_fd(unsigned int fd);						// 释放当前进程的描述符 fd.
+struct task_struct;
+extern int dup_fdtable(struct task_struct * p);					// fork 时为子进程复制描述符表.
+extern void free_fdtable(struct task_struct * p);				// 释放进程扩展过的描述符表.
+extern void aio_release(void);									// 丢弃当前进程的全部异步 I/O 请求(fs/aio.c).
 extern struct buffer_head * get_hash_table(int dev, int block); // 在哈希表中查找指定的数据块. 返回找到的缓冲头指针.
 extern struct buffer_head * getblk(int dev, int block);         // 从设备读取指定块(首先会在 hash 表中查找).
 extern void ll_rw_block(int rw, struct buffer_head * bh);       // 读/写数据块.
 extern void ll_rw_page(int rw, int dev, int nr, char * buffer); // 读/写数据页面, 即每次 4 块数据块.
 extern void brelse(struct buffer_head * buf);                   // 释放指定缓冲块.
 extern struct buffer_head * bread(int dev, int block);          // 读取指定的数据块.
+extern struct buffer_head * bread_nowait(int dev, int block);   // 不等待地读取数据块, 数据不在高速缓冲中则只提交读请求并返回 NULL.
 extern void bread_page(unsigned long addr, int dev, int b[4]);  // 读取设备上一个页面(4 个缓冲块)的内容到指定内存地址处。
 extern struct buffer_head * breada(int dev, int block, ...);    // 读取头一个指定的数据块, 并标记后续将要读的块.
 extern int new_block(int dev);                                  // 向设备 dev 申请一个磁盘块(区段, 逻辑块). 返回逻辑块号.
 extern int free_block(int dev, int block);                      // 释放设备数据区中的逻辑块(区段, 逻辑块) block.
+extern int free_blocks(int dev, unsigned short * zones, int nr);	// 成批释放设备数据区中的逻辑块, 返回未能释放的块数.
 extern struct m_inode * new_inode(int dev);                     // 为设备 dev 建立一个新 inode, 返回 inode 号.
 extern void free_inode(struct m_inode * inode);                 // 释放一个 inode(删除文件时).
 extern int sync_dev(int dev);                                   // 刷新指定设备缓冲区块.
@@ -249,7 +333,27 @@ extern struct super_block * get_super(int dev);                 // 读取指定
 extern int ROOT_DEV;
 extern void put_super(int dev);									// 释放超级块.
 extern void invalidate_inodes(int dev);							// 释放设备 dev 在内存 inode 表中的所有 inode.
+extern void invalidate_buffers(int dev);						// 使设备 dev 在高速缓冲中的数据无效.
+extern int journal_start(int dev);								// 在设备 dev 上开始一个元数据日志事务句柄.
+extern void journal_stop(int started);							// 结束事务句柄.
+extern int journal_owns(struct buffer_head * bh);				// 判断缓冲块是否必须经由日志写盘.
+extern void journal_commit(int dev, int barrier);				// 提交设备 dev 的日志.
+extern void journal_sync(void);									// 提交所有文件系统的日志.
+extern void journal_replay(struct super_block * sb);			// 安装文件系统时重放日志.
 
 extern void mount_root(void);                                   // 安装根文件系统.
+extern char * rd_block(int dev, int block);						// 取虚拟盘数据块在内存中的地址(kernel/blk_drv/ramdisk.c).
+extern char * tmpfs_block(int dev, int block);					// 取 tmpfs 数据块在内存中的地址(fs/tmpfs.c).
+extern void tmpfs_rw_block(int rw, struct buffer_head * bh);	// tmpfs 缓冲块的"读写"(fs/tmpfs.c).
+extern int tmpfs_read_super(struct super_block * sb);			// 建立一个空的 tmpfs 文件系统(fs/tmpfs.c).
+
+// MINIX 文件系统的 inode 操作函数.
+extern struct inode_operations minix_inode_operations;			// fs/super.c
+extern struct buffer_head * minix_find_entry(struct m_inode * dir, const char * name, int namelen, struct dir_entry ** res_dir);	// fs/namei.c
+extern struct buffer_head * minix_add_entry(struct m_inode * dir, const char * name, int namelen, struct dir_entry ** res_dir);	// fs/namei.c
+extern int minix_file_read(struct m_inode * inode, struct file * filp, char * buf, int count, off_t * pos);		// fs/file_dev.c
+extern int minix_file_write(struct m_inode * inode, struct file * filp, char * buf, int count, off_t * pos);		// fs/file_dev.c
+extern int minix_bmap(struct m_inode * inode, int block, int count, int * zones, int create);					// fs/inode.c
+extern void minix_truncate(struct m_inode * inode);																// fs/truncate.c
 
 #endif
@@ -46,6 +46,36 @@
 #define WIN_SEEK 		0x70		// 寻道.
 #define WIN_DIAGNOSE	0x90		// 控制器诊断.
 #define WIN_SPECIFY		0x91		// 建立驱动器参数.
+#define WIN_READ_EXT	0x24		// 读扇区(LBA48).
+#define WIN_WRITE_EXT	0x34		// 写扇区(LBA48).
+#define WIN_MULTREAD_EXT	0x29	// 多扇区读(LBA48).
+#define WIN_MULTWRITE_EXT	0x39	// 多扇区写(LBA48).
+#define WIN_MULTREAD	0xC4		// 多扇区读: 每次中断传送 WIN_SETMULT 设定的扇区数.
+#define WIN_MULTWRITE	0xC5		// 多扇区写.
+#define WIN_SETMULT		0xC6		// 设置多扇区读写时每块的扇区数.
+#define WIN_IDENTIFY	0xEC		// 取驱动器标识信息(512 字节).
+#define WIN_READDMA		0xC8		// DMA 方式读扇区.
+#define WIN_WRITEDMA	0xCA		// DMA 方式写扇区.
+#define WIN_READDMA_EXT	0x25		// DMA 方式读扇区(LBA48).
+#define WIN_WRITEDMA_EXT	0x35	// DMA 方式写扇区(LBA48).
+#define WIN_SETFEATURES	0xEF		// 设置特性. 特性 0x03 - 设置传送方式(扇区数寄存器给出方式号).
+
+/* Bus-master IDE registers, offsets from PCI BAR4 (primary channel) */
+/* PCI IDE 控制器总线主控 DMA 寄存器(相对 BAR4 的偏移, 第 1 通道) */
+#define BM_COMMAND	0				// 命令寄存器: 位 0 - 启动; 位 3 - 方向(1 表示写内存, 即读硬盘).
+#define BM_STATUS	2				// 状态寄存器: 位 0 - 正在传送; 位 1 - 出错; 位 2 - 中断(后两位写 1 清除).
+#define BM_PRD		4				// PRD(物理区域描述符)表物理地址.
+
+#define BM_CMD_START	0x01
+#define BM_CMD_READ		0x08
+#define BM_STAT_ACTIVE	0x01
+#define BM_STAT_ERR		0x02
+#define BM_STAT_INTR	0x04
+
+/* Bits of HD_CMD */
+/* 控制寄存器各位的定义(HD_CMD) */
+#define CTL_NIEN	0x02			// 禁止驱动器发出中断请求.
+#define CTL_SRST	0x04			// 软件复位.
 
 /* Bits for HD_ERROR */
 /* 错误寄存器各位的含义(HD_ERROR) */
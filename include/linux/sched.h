@@ -41,8 +41,8 @@
 #include <sys/resource.h>
 #include <signal.h>
 
-#if (NR_OPEN > 32)
-#error "Currently the close-on-exec-flags and select masks are in one long, max 32 files/proc"
+#if (NR_OPEN_DEFAULT != 32)
+#error "The inline open/close-on-exec bitmaps and select masks are one long, NR_OPEN_DEFAULT must be 32"
 #endif
 
 // 这里定义了进程运行时可能处于的状态.
@@ -159,6 +159,7 @@ struct tss_struct {
 // struct rlimit rlim[RLIM_NLIMITS]		进程资源使用统计数组.
 // unsigned int flags					各进程的标志.
 // unsigned short used_math				标志: 是否使用了协处理器.
+// unsigned short journal_sb			持有日志事务句柄时句柄所属的超级块索引.
 // ------------------------------------------------------------------------------
 // int tty;								进程使用 tty 终端的子设备号. -1 表示没有使用.
 // unsigned short umask					文件创建属性屏蔽位.
@@ -166,8 +167,11 @@ struct tss_struct {
 // struct m_inode * root				根目录 i 节点结构指针.
 // struct m_inode * executable			执行文件 i 节点结构指针.
 // struct m_inode * library				被加载库文件 i 节点结构指针.
-// unsigned long close_on_exec			执行时关闭文件句柄位图标志.(include/fcntl.h)
-// struct file * filp[NR_OPEN]			文件结构指针表, 最多 32 项. 表项号即是文件描述符的值.
+// int max_fds							描述符表当前的容量.
+// struct file ** filp					文件结构指针表, 表项号即是文件描述符的值.
+// unsigned long * open_fds				已分配描述符位图.
+// unsigned long * close_on_exec		执行时关闭文件句柄位图标志.(include/fcntl.h)
+// struct file * fd_array[NR_OPEN_DEFAULT]	内嵌的初始文件结构指针表, 32 项.
 // struct desc_struct ldt[3]			局部描述符表, 0 - 空, 1 - 代码段 cs, 2 - 数据和堆栈段 ds 和 ss.
 // struct tss_struct tss				进程的任务状态段信息结构.
 // ==============================================================================
@@ -221,6 +225,7 @@ struct task_struct {
 	/* per process flags, defined below */
 	unsigned int flags;					// 各进程的标志.
 	unsigned short used_math;			// 标志: 是否使用了协处理器.
+	unsigned short journal_sb;			// 持有日志事务句柄(PF_JOURNAL)时, 句柄所属超级块在 super_block[] 中的索引.
 
 	/* file system info */
 	/* -1 if no tty, so it must be signed */
@@ -230,8 +235,15 @@ struct task_struct {
 	struct m_inode * root;				// 根目录 i 节点结构指针.
 	struct m_inode * executable;		// 当前进程对应的执行文件的 i 节点结构指针.
 	struct m_inode * library;			// 被加载库文件 i 节点结构指针.
-	unsigned long close_on_exec;		// 调用 execve 函数时要关闭文件句柄位图标志(文件 fd 与位图下标对应). (include/fcntl.h) 见下面注释.
-	struct file * filp[NR_OPEN];		// 进程打开的文件结构指针表, 最多 20 项. 表项号(索引值)即是文件描述符的值.
+	// 描述符表开始时使用任务结构中内嵌的 fd_array[] 和两个位图长字, 描述符用完时由 get_unused_fd() 
+	// 按 2 倍扩展到 malloc() 分配的表中, 最多扩展到 NR_OPEN 项, 并受 rlim[RLIMIT_NOFILE] 限制(fs/file_table.c).
+	int max_fds;						// 描述符表当前的容量(filp[] 项数, 32 的倍数).
+	struct file ** filp;				// 进程打开的文件结构指针表. 表项号(索引值)即是文件描述符的值.
+	unsigned long * open_fds;			// 已分配描述符位图, 用于快速找到最小的空闲描述符.
+	unsigned long * close_on_exec;		// 调用 execve 函数时要关闭文件句柄位图标志(文件 fd 与位图下标对应). (include/fcntl.h) 见下面注释.
+	struct file * fd_array[NR_OPEN_DEFAULT];	// 内嵌的初始文件结构指针表.
+	unsigned long open_fds_init;		// 内嵌的初始已分配描述符位图.
+	unsigned long close_on_exec_init;	// 内嵌的初始执行时关闭位图.
 	/* ldt for this task 0 - zero 1 - cs 2 - ds&ss */
 	struct desc_struct ldt[3];			// 局部描述符表, 0 - 空, 1 - 代码段 cs, 2 - 数据和堆栈段 ds 和 ss.
 	/* tss for this task */
@@ -251,6 +263,7 @@ struct task_struct {
 /* 每个进程的标志 */    /* 打印对齐警告信息. 还未实现, 仅用于 486 */
 #define PF_ALIGNWARN	0x00000001	/* Print alignment warning msgs */
 					/* Not implemented yet, only for 486*/
+#define PF_JOURNAL		0x00000002	/* 进程持有元数据日志的事务句柄, 见 fs/journal.c */
 
 /*
  *  INIT_TASK is used to set up the first task table, touch at
@@ -281,14 +294,18 @@ struct task_struct {
 					/* rlim[]: 进程资源使用统计数据 */ \
 	                { {0x7fffffff, 0x7fffffff}, {0x7fffffff, 0x7fffffff}, \
 		  			{0x7fffffff, 0x7fffffff}, {0x7fffffff, 0x7fffffff}, \
-		  			{0x7fffffff, 0x7fffffff}, {0x7fffffff, 0x7fffffff}}, \
-					/* flags, used_math */ \
-	             	0, 			0, \
+		  			{0x7fffffff, 0x7fffffff}, {0x7fffffff, 0x7fffffff}, \
+		  			{NR_OPEN, NR_OPEN}}, \
+					/* flags, used_math, journal_sb */ \
+	             	0, 			0, 			0, \
 					/* 以下是文件系统信息 */ \
-					/* tty, umask, pwd, root, executable, library, close_on_exec */ \
-	              	-1, 	0022, NULL, NULL, 	NULL, 		NULL, 		0, \
-					/* filp[] */ \
-	            	{NULL,}, \
+					/* tty, umask, pwd, root, executable, library */ \
+	              	-1, 	0022, NULL, NULL, 	NULL, 		NULL, \
+					/* max_fds, filp, open_fds, close_on_exec */ \
+	            	NR_OPEN_DEFAULT, init_task.task.fd_array, \
+	            	&init_task.task.open_fds_init, &init_task.task.close_on_exec_init, \
+					/* fd_array[], open_fds_init, close_on_exec_init */ \
+	            	{NULL,}, 	0, 		0, \
 	/* ldt */ \
 					{ \
 						{0, 0}, \
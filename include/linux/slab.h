@@ -0,0 +1,17 @@
+// slab.h 是内核对象缓存(slab 分配器)的头文件. 实现见 lib/slab.c.
+#ifndef _SLAB_H
+#define _SLAB_H
+
+struct kmem_cache;
+
+// 建立一个对象长度为 size 的缓存. name 用于显示统计信息; ctor 若不为 NULL, 则在 slab 建立时对其中每个对象调用一次.
+// 失败(长度超过一页可容纳的大小)返回 NULL.
+extern struct kmem_cache * kmem_cache_create(const char * name, int size, void (* ctor)(void * obj));
+// 从缓存中分配一个对象. 没有空闲对象时分配新的 slab 页面(可能睡眠), 内存不够返回 NULL.
+extern void * kmem_cache_alloc(struct kmem_cache * cachep);
+// 把对象 obj 放回其所属的缓存 cachep.
+extern void kmem_cache_free(struct kmem_cache * cachep, void * obj);
+// 显示各缓存的分配统计信息.
+extern void kmem_cache_stats(void);
+
+#endif
@@ -94,6 +94,16 @@ extern int sys_symlink();       // 83 - 建立符号链接.           (fs/namei.
 extern int sys_lstat();         // 84 - 取符号链接文件状态.      (fs/stat.c)
 extern int sys_readlink();      // 85 - 读取符号链接文件信息.     (fs/stat.c)
 extern int sys_uselib();        // 86 - 选择共享库.             (fs/exec.c)
+extern int sys_splice();        // 87 - 在管道与文件之间传送数据. (fs/pipe.c)
+extern int sys_epoll_create();  // 88 - 创建 epoll 对象.         (fs/select.c)
+extern int sys_epoll_ctl();     // 89 - 修改 epoll 兴趣集.        (fs/select.c)
+extern int sys_epoll_wait();    // 90 - 等待 epoll 事件.          (fs/select.c)
+extern int sys_aio_submit();    // 91 - 提交异步 I/O 请求.        (fs/aio.c)
+extern int sys_aio_getevents(); // 92 - 取异步 I/O 完成事件.      (fs/aio.c)
+extern int sys_readv();         // 93 - 分散读.                  (fs/read_write.c)
+extern int sys_writev();        // 94 - 集中写.                  (fs/read_write.c)
+extern int sys_pread();         // 95 - 在指定位置读.            (fs/read_write.c)
+extern int sys_pwrite();        // 96 - 在指定位置写.            (fs/read_write.c)
 
 // 系统调用函数指针表. 用于系统调用中断处理程序(int 0x80), 作为跳转表.
 fn_ptr sys_call_table[] = { 
@@ -114,7 +124,9 @@ fn_ptr sys_call_table[] = {
     sys_setreuid, sys_setregid, sys_sigsuspend, sys_sigpending, sys_sethostname,
     sys_setrlimit, sys_getrlimit, sys_getrusage, sys_gettimeofday, sys_settimeofday,    // 80
     sys_getgroups, sys_setgroups, sys_select, sys_symlink, sys_lstat, 
-    sys_readlink, sys_uselib 
+    sys_readlink, sys_uselib, sys_splice, sys_epoll_create, sys_epoll_ctl,             // 90
+    sys_epoll_wait, sys_aio_submit, sys_aio_getevents, sys_readv, sys_writev,         // 95
+    sys_pread, sys_pwrite
 };
 
 /* So we don't have to do any more manual updating.... */
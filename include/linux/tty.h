@@ -23,15 +23,21 @@ extern int NR_CONSOLES;
 
 #include <termios.h>
 
-#define TTY_BUF_SIZE 1024								// tty 缓冲区(缓冲队列)大小.
+// 各类终端缓冲队列的大小. 每个值都必须是 2 的次方, 并且不能超过一页(PAGE_SIZE).
+// 串行终端和伪终端的数据量大, 使用较大的队列以减少进程睡眠和唤醒的次数.
+#define CON_QUEUE_SIZE	1024							// 控制台缓冲队列大小.
+#define RS_QUEUE_SIZE	4096							// 串行终端缓冲队列大小.
+#define PTY_QUEUE_SIZE	4096							// 伪终端缓冲队列大小.
 
 // tty 字符缓冲队列数据结构. 用作为 tty_struct 结构中的读/写和辅助(规范)缓冲队列.
+// 缓冲区不再内嵌在结构中, 而是在 tty_init() 中按各类终端设定的大小分配. rs_io.s 和 keyboard.S 中使用了各字段的偏移值.
 struct tty_queue {
 	unsigned long data;					// 队列缓冲区中含有字符行数值(不是当前字符数). 对于串口终端, 则存放串行端口地址.
 	unsigned long head;					// 缓冲区中数据头指针.
 	unsigned long tail;					// 缓冲区中数据尾指针.
 	struct task_struct * proc_list;		// 等待本队列的进程列表.
-	char buf[TTY_BUF_SIZE];				// 队列的缓冲区.
+	unsigned long size;					// 缓冲区长度(2 的次方).
+	char * buf;							// 队列的缓冲区.
 };
 
 #define IS_A_CONSOLE(min)			(((min) & 0xC0) == 0x00)	// 是一个控制终端.
@@ -42,19 +48,20 @@ struct tty_queue {
 #define PTY_OTHER(min)				((min) ^ 0x40)				// 其他伪终端.
 
 // 以下定义了 tty 等待队列中缓冲区操作宏函数. (tail 在前, head 在后)
-#define INC(a) ((a) = ((a) + 1) & (TTY_BUF_SIZE - 1))           				// a 缓冲区指针前移 1 字节, 若已超出缓冲区右侧, 则指针循环.
-#define DEC(a) ((a) = ((a) - 1) & (TTY_BUF_SIZE - 1))           				// a 缓冲区指针后退 1 字节, 并循环.
+#define INC(q, a) ((a) = ((a) + 1) & ((q)->size - 1))           				// 队列 q 的缓冲区指针 a 前移 1 字节, 若已超出缓冲区右侧, 则指针循环.
+#define DEC(q, a) ((a) = ((a) - 1) & ((q)->size - 1))           				// 队列 q 的缓冲区指针 a 后退 1 字节, 并循环.
 #define EMPTY(a) ((a)->head == (a)->tail)                       				// 缓冲区是否为空.
-#define LEFT(a) (((a)->tail - (a)->head - 1) & (TTY_BUF_SIZE - 1))      		// 缓冲区还可存放字符的长度(空闲区长度).
-#define LAST(a) ((a)->buf[(TTY_BUF_SIZE - 1) & ((a)->head - 1)])      			// 缓冲区中最后一个位置.
+#define LEFT(a) (((a)->tail - (a)->head - 1) & ((a)->size - 1))      			// 缓冲区还可存放字符的长度(空闲区长度).
+#define LAST(a) ((a)->buf[((a)->size - 1) & ((a)->head - 1)])      				// 缓冲区中最后一个位置.
 #define FULL(a) (!LEFT(a))                                      				// 缓冲区满(如果为1的话).
-#define CHARS(a) (((a)->head - (a)->tail) & (TTY_BUF_SIZE - 1))       			// 缓冲区中已存放字符的长度(字符数).
+#define CHARS(a) (((a)->head - (a)->tail) & ((a)->size - 1))       				// 缓冲区中已存放字符的长度(字符数).
+#define WAKEUP_CHARS(a) ((a)->size / 4)											// 写队列中字符数降到这么多时唤醒等待写的进程(rs_io.s 中同样按 size 计算).
 // 从 queue 队列项缓冲区中取一字符(从 tail 处, 并且 tail += 1).
 #define GETCH(queue, c) \
-(void)({c = (queue)->buf[(queue)->tail]; INC((queue)->tail);})
+(void)({c = (queue)->buf[(queue)->tail]; INC((queue), (queue)->tail);})
 // 往 queue 队列项缓冲区中放置一字符(在 head 处, 并且 head += 1).
 #define PUTCH(c, queue) \
-(void)({(queue)->buf[(queue)->head] = (c); INC((queue)->head);})
+(void)({(queue)->buf[(queue)->head] = (c); INC((queue), (queue)->head);})
 
 // 判断终端键盘字符类型
 #define INTR_CHAR(tty) ((tty)->termios.c_cc[VINTR])             			// 中断符. 发中断信号 SIGINT.
@@ -118,11 +125,13 @@ int tty_write(unsigned c, char * buf, int n);   // (kernel/chr_drv/tty_io.c)
 
 void con_write(struct tty_struct * tty);		// (kernel/chr_drv/console.c)
 void rs_write(struct tty_struct * tty);         //(kernel/chr_drv/serial.c)
+void rs_set_termios(struct tty_struct * tty);   //(kernel/chr_drv/serial.c)
 void mpty_write(struct tty_struct * tty);       //(kernel/chr_drv/pty.c)
 void spty_write(struct tty_struct * tty);       //(kernel/chr_drv/pty.c)
 
 void copy_to_cooked(struct tty_struct * tty);   //(kernel/chr_drv/tty_io.c)
 
 void update_screen(void);						// (kernel/chr_drv/console.c)
+void console_scrollback(int dir);				// (kernel/chr_drv/console.c)
 
 #endif
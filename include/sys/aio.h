@@ -0,0 +1,34 @@
+#ifndef _SYS_AIO_H
+#define _SYS_AIO_H
+
+#include <sys/types.h>
+
+// 异步 I/O 操作码.
+#define LIO_READ	0		// 读.
+#define LIO_WRITE	1		// 写.
+
+// 异步 I/O 控制块. 一次 aio_submit() 可提交一组控制块, 每个对应一个普通文件的读或写请求.
+// 请求在 aio_offset 处读写, 不使用也不改变文件的读写指针(写以 O_APPEND 打开的文件时在文件尾添加).
+// 读请求的缓冲区在请求完成(被 aio_getevents() 取走)之前必须保持有效; 写请求的数据在提交时就已复制.
+struct aiocb {
+	int aio_fildes;				// 文件句柄.
+	int aio_lio_opcode;			// 操作码 LIO_READ 或 LIO_WRITE.
+	off_t aio_offset;			// 文件中的读写位置.
+	void * aio_buf;				// 用户缓冲区.
+	size_t aio_nbytes;			// 读写字节数. 一个请求最多 16KB, 更长的请求会被截短.
+	unsigned long aio_data;		// 用户数据, 完成时在 aio_event 中原样返回.
+};
+
+// 完成事件.
+struct aio_event {
+	unsigned long data;			// 对应控制块的 aio_data.
+	long res;					// 实际读写的字节数, 或出错码(负值).
+};
+
+// 提交 nr 个异步请求, 返回成功提交的个数. 若第 1 个请求就出错, 则返回 -1 并设置 errno.
+int aio_submit(int nr, struct aiocb * list);
+// 取已完成的请求, 最多 nr 个. 若已完成的不足 min_nr 个, 则等待(可被信号中断). min_nr 为 0 表示只查询不等待.
+// 返回取得的事件个数.
+int aio_getevents(int min_nr, int nr, struct aio_event * events);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _SYS_EPOLL_H
+#define _SYS_EPOLL_H
+
+// epoll 事件标志. 数值与 Linux 的相同.
+#define EPOLLIN		0x001		// 描述符可读.
+#define EPOLLOUT	0x004		// 描述符可写.
+#define EPOLLERR	0x008		// 描述符出错(总是报告, 不需要设置).
+#define EPOLLHUP	0x010		// 对端已关闭(总是报告, 不需要设置).
+
+// epoll_ctl() 的操作码.
+#define EPOLL_CTL_ADD	1		// 把描述符加入兴趣集.
+#define EPOLL_CTL_DEL	2		// 从兴趣集中删除描述符.
+#define EPOLL_CTL_MOD	3		// 修改描述符关心的事件.
+
+// 事件结构. events 是关心的(或已发生的)事件, data 由用户设置, epoll_wait() 原样返回.
+struct epoll_event {
+	unsigned long events;
+	unsigned long data;
+};
+
+// 创建一个 epoll 对象, 返回其文件描述符. 参数 size 只需大于 0.
+int epoll_create(int size);
+// 在 epoll 对象 epfd 的兴趣集中加入, 删除或修改描述符 fd. 只支持管道和终端描述符.
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event * event);
+// 等待兴趣集中的描述符就绪, 最多返回 maxevents 个事件. timeout 是毫秒数, -1 表示一直等待.
+int epoll_wait(int epfd, struct epoll_event * events, int maxevents, int timeout);
+
+// 与 select() 一样, epoll_ctl() 和 epoll_wait() 的参数超过 3 个, 因此库函数应把指向第 1 个参数的指针作为系统调用的唯一参数.
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _SYS_RAMDISK_H
+#define _SYS_RAMDISK_H
+
+// 虚拟盘(主设备号 1)的 ioctl 命令码. 参数单位都是 KB(即盘块数), 最大 4096.
+#define RDSETSIZE	0x5201		// 设置虚拟盘大小为 arg KB. 只有超级用户可以设置; 缩小时虚拟盘不能被安装或正在使用.
+#define RDGETSIZE	0x5202		// 取虚拟盘大小, 存放到 arg 所指的 long 中.
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef _SYS_UIO_H
+#define _SYS_UIO_H
+
+#include <sys/types.h>
+
+#define UIO_MAXIOV	16		// readv()/writev() 一次最多处理的缓冲区个数.
+
+// 分散读/集中写使用的缓冲区描述结构.
+struct iovec {
+	void * iov_base;		// 缓冲区起始地址.
+	size_t iov_len;			// 缓冲区长度(字节数).
+};
+
+// 从文件句柄 fd 依次读数据到 iovcnt 个缓冲区中, 返回读取的总字节数.
+int readv(int fd, const struct iovec * iov, int iovcnt);
+// 把 iovcnt 个缓冲区中的数据依次写到文件句柄 fd 中, 返回写入的总字节数.
+int writev(int fd, const struct iovec * iov, int iovcnt);
+
+#endif
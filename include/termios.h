@@ -3,8 +3,6 @@
 
 #include <sys/types.h>
 
-#define TTY_BUF_SIZE 1024               // tty中的缓冲区长度. 
-
 /* 0x54 is just a magic number to make these relatively uniqe ('T') */
 /* 0x54 只是一个魔数, 目的是为了使这些常数唯一('T')*/
 
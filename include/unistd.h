@@ -161,6 +161,16 @@
 #define __NR_lstat	84
 #define __NR_readlink	85
 #define __NR_uselib	86
+#define __NR_splice	87
+#define __NR_epoll_create	88
+#define __NR_epoll_ctl	89
+#define __NR_epoll_wait	90
+#define __NR_aio_submit	91
+#define __NR_aio_getevents	92
+#define __NR_readv	93
+#define __NR_writev	94
+#define __NR_pread	95
+#define __NR_pwrite	96
 
 // 以下定义系统调用嵌入式汇编宏函数.
 // 不带参数的系统调用宏函数, type_name(void).
@@ -307,5 +317,9 @@ int getgroups(int gidsetlen, gid_t *gidset);
 int setgroups(int gidsetlen, gid_t *gidset);
 int select(int width, fd_set * readfds, fd_set * writefds,
 	fd_set * exceptfds, struct timeval * timeout);
+int splice(int fd_in, int fd_out, int count);
+// 与 select() 一样, pread() 和 pwrite() 的参数超过 3 个, 库函数把指向第 1 个参数的指针作为系统调用的唯一参数.
+int pread(int fildes, void * buf, size_t count, off_t offset);
+int pwrite(int fildes, const void * buf, size_t count, off_t offset);
 
 #endif
@@ -92,7 +92,8 @@ extern void chr_dev_init(void);						// 字符设备初始化(kernel/chr_drv/tty
 extern void hd_init(void);							// 硬盘初始化程序(kernel/blk_drv/hd.c).
 extern void floppy_init(void);						// 软驱初始化程序(kernel/blk_drv/floppy.c).
 extern void mem_init(long start, long end);			// 内存管理初始化(mm/memory.c).
-extern long rd_init(long mem_start, int length);	// 虚拟盘初始化(kernel/blk_drv/ramdisk.c).
+extern void rd_init(int length);					// 虚拟盘初始化(kernel/blk_drv/ramdisk.c).
+extern void select_init(void);						// select() 等待表缓存初始化(fs/select.c).
 extern long kernel_mktime(struct tm * tm);			// 计算系统开机启动时间(秒).
 
 // fork 系统调用函数, 该函数作为 static inline 表示内联函数, 主要用来在 TASK-0 里面创建 TASK-1 的时候内联, 
@@ -197,6 +198,87 @@ static char * argv[] = { "-/bin/sh", NULL };		// 字符 "-" 是传递给 shell 
 													// sh 程序会作为登录 shell 执行. 其执行过程与 shell 提示符下执行 sh 不一样.
 static char * envp[] = { "HOME=/usr/root", NULL, NULL };
 
+#ifdef MALLOC_TEST
+/*
+ * 内核 malloc() 的开机自检(在 Makefile 中定义 MALLOC_TEST 时编译, 在开中断之前运行).
+ * 在 MT_SLOTS 个槽中随机地分配和释放 16 ~ 4096 字节的对象, 每个对象用其槽号填满, 释放前检查内容是否被别的对象覆盖.
+ * 共进行两遍, 每遍结束时释放全部对象. 桶描述符页面分配后不再释放, 因此只比较两遍结束时的空闲页面数, 不等说明有页面泄漏.
+ */
+#define MT_SLOTS	256
+#define MT_ROUNDS	20000
+
+static unsigned char * mt_ptr[MT_SLOTS];
+static int mt_size[MT_SLOTS];
+static unsigned long mt_seed = 1;
+
+// 线性同余伪随机数.
+static unsigned long mt_rand(void) {
+	mt_seed = mt_seed * 1103515245 + 12345;
+	return mt_seed >> 8;
+}
+
+// 统计主内存区的空闲页面数.
+static int mt_free_pages(void) {
+	int i, n = 0;
+
+	for (i = 0; i < PAGING_PAGES; i++) {
+		if (!mem_map[i]) {
+			n++;
+		}
+	}
+	return n;
+}
+
+// 检查槽 i 中对象的内容并释放它.
+static void mt_free(int i) {
+	int j;
+
+	for (j = 0; j < mt_size[i]; j++) {
+		if (mt_ptr[i][j] != (unsigned char) i) {
+			printk("object %d (%d bytes at %x) byte %d\n\r", i, mt_size[i], mt_ptr[i], j);
+			panic("malloc_test: object overwritten");
+		}
+	}
+	free_s(mt_ptr[i], mt_size[i]);
+	mt_ptr[i] = NULL;
+}
+
+static void malloc_test(void) {
+	int pass, round, i, k, free_pages = 0;
+
+	for (pass = 0; pass < 2; pass++) {
+		for (round = 0; round < MT_ROUNDS; round++) {
+			i = mt_rand() % MT_SLOTS;
+			if (mt_ptr[i]) {
+				mt_free(i);
+				continue;
+			}
+			// 大小先按 2 的幂在 16 ~ 4096 之间选取, 再减去其一半以内的随机值, 使每个桶都收到不满一个桶的请求.
+			k = mt_rand() % 9;
+			mt_size[i] = 16 << k;
+			if (k) {
+				mt_size[i] -= mt_rand() % (mt_size[i] / 2);
+			}
+			if (!(mt_ptr[i] = (unsigned char *) malloc(mt_size[i]))) {
+				panic("malloc_test: out of memory");
+			}
+			memset(mt_ptr[i], i, mt_size[i]);
+		}
+		for (i = 0; i < MT_SLOTS; i++) {
+			if (mt_ptr[i]) {
+				mt_free(i);
+			}
+		}
+		if (pass && mt_free_pages() != free_pages) {
+			printk("free pages: %d after pass 1, %d after pass 2\n\r", free_pages, mt_free_pages());
+			panic("malloc_test: pages leaked");
+		}
+		free_pages = mt_free_pages();
+	}
+	printk("malloc_test: %d allocations and frees ok\n\r", 2 * MT_ROUNDS);
+}
+#endif
+
 struct drive_info { char dummy[32]; } drive_info;	// 用于存放硬盘参数表信息.
 
 // 分页机制已经在 head.s 的 setup_paging 中开启.  (main 函数的起始地址大约是 0x67ff)
@@ -247,11 +329,6 @@ int main(void) {									/* This really IS void, no error here. */
 	}
 	// 根据高速缓冲区的末端大小设置主内存区的起始地址, 两者相同, 即高速缓冲区末端为主内存起始端.
 	main_memory_start = buffer_memory_end;							// 主内存起始位置 == 高速缓冲区末端.
-	// 如果在 Makefile 文件中定义了内存虚拟盘符号 RAMDISK, 则初始化虚拟盘. 此时主内存将减少.
-	// 参见 kernel/blk_drv/ramdisk.c
-#ifdef RAMDISK
-	main_memory_start += rd_init(main_memory_start, RAMDISK * 1024);
-#endif
 	// 进行内核的所有初始化操作.
 	mem_init(main_memory_start, memory_end);		// 主内存区初始化. (mm/memory.c) 初始化 mem_map[], 主内存区为 4MB - mem_end. 一页大小为 4KB.
 	trap_init();                              		// 陷阱门(硬件中断向量)初始化. (kernel/traps.c)
@@ -263,8 +340,19 @@ int main(void) {									/* This really IS void, no error here. */
  	sched_init();									// 调度程序初始化(加载任务 0 的 tr, ldtr). (kernel/sched.c)
 	// 高速缓冲区用于缓冲读/写块设备(比如硬盘)中的数据.
 	buffer_init(buffer_memory_end);					// 高速缓冲区管理初始化, 建立内存缓冲区链表等. 一页大小为 1KB. (fs/buffer.c)
+	select_init();									// 建立 select() 等待表的对象缓存. (fs/select.c)
 	hd_init();										// 硬盘初始化: 设置硬盘读写请求处理函数并设置硬盘中断. (blk_drv/hd.c)
 	floppy_init();									// 软盘初始化. (blk_drv/floppy.c)
+	// 虚拟盘初始化. 虚拟盘的内存用到时才按页分配, 不再从主内存中预留. 如果在 Makefile 文件中定义了内存虚拟盘符号 RAMDISK, 
+	// 则以它作为根文件系统虚拟盘的大小, 否则虚拟盘大小为 0, 可以在运行时用 ioctl(RDSETSIZE) 设置. 参见 kernel/blk_drv/ramdisk.c
+#ifdef RAMDISK
+	rd_init(RAMDISK * 1024);
+#else
+	rd_init(0);
+#endif
+#ifdef MALLOC_TEST
+	malloc_test();									// 内核 malloc() 自检. 其中 free_s() 会开中断, 因此放在初始化的最后.
+#endif
 	sti();											// 所有初始化工作都完了, 于是开启中断(注意, 只能屏蔽硬件中断而不能屏蔽软件中断).
 	// 下面通过在堆栈中构建 IRET 指令的返回参数, 利用中断返回指令切换到任务 0 中执行(在用户特权级下执行).
 	// NOTE: 并不是通过任务切换来实现的, 只是通过 iret 来自动加载用户态下的各个段描述符来实现特权级的切换.
@@ -185,6 +185,25 @@ static unsigned char command = 0;							// 读/写命令.
 unsigned char selected = 0;									// 软驱已选定标志.在处理请求项之前要首先选定软驱.
 struct task_struct * wait_on_floppy_select = NULL;			// 等待选定软驱的任务队列.
 
+// 磁道缓存. 
+// 读请求在缓存不命中时一次读入整个磁道(一个磁头面上的全部扇区)放到该软驱的磁道缓存中, 同一磁道上以后的读请求直接从缓存复制, 
+// 不必再等软盘转一圈. 写请求照常写盘(写直达), 并使涉及磁道的缓存失效. 检测到换盘时缓存也失效. 
+// 跨越两个磁道的数据块(每磁道扇区数为奇数时才会出现)不经过缓存. 
+// 缓存区必须能被 DMA 访问: 位于内核数据区(1MB 以下), 且每个缓存区不能跨越 64KB 边界, 因此由 floppy_init() 从 fd_cache_area 中切分. 
+// 只为前 2 个软驱设置缓存, 其余软驱按原来的方式逐块读写.
+#define NR_FD_CACHE		2
+#define FD_TRACK_SIZE	(18 * 512)							// 最大的磁道长度(1.44MB 软盘每磁道 18 扇区).
+
+static char fd_cache_area[(NR_FD_CACHE + 1) * FD_TRACK_SIZE];	// 多出的一个磁道长度用于跳过 64KB 边界.
+
+static struct fd_cache {
+	char * buf;												// 缓存区.
+	struct floppy_struct * type;							// 所缓存磁道的软盘类型, NULL 表示缓存无效.
+	unsigned int track;										// 所缓存磁道的序号(磁道号 * 磁头数 + 磁头号).
+} fd_cache[NR_FD_CACHE];
+
+static int track_read = 0;									// 标志: 1 表示当前命令是读整个磁道到缓存中.
+
 // 取消选定软驱.
 // 如果函数参数指定的软驱 nr 当前并没有被选定, 则显示警告信息. 然后复位软驱已选定标志 selected, 并唤醒等待选择该软驱的任务. 
 // 数字输出寄存器(DOR)的低 2 位用于指定选择的软驱(0-3 对应 A-D).
@@ -230,6 +249,9 @@ repeat:
 	// 现在软盘控制器已经选定我们指定的软驱 nr. 于是取数字输入寄存器 DIR 的值, 
 	// 如果其最高位(位 7)置位, 则表示软盘已更换, 此时即可关闭马达并返回 1 退出. 否则关闭马达返回 0 退出. 表示磁盘没有被更换.
 	if (inb(FD_DIR) & 0x80) {
+		if (nr < NR_FD_CACHE) {
+			fd_cache[nr].type = NULL;						// 换盘后磁道缓存失效.
+		}
 		floppy_off(nr);
 		return 1;
 	}
@@ -247,11 +269,16 @@ __asm__("cld; rep; movsl" \
 // 软盘中数据读写操作是使用 DMA 进行的. 因此在每次进行数据传输之前需要设置 DMA 芯片专门上用于软驱的通道 2.
 static void setup_DMA(void) {
 	long addr = (long) CURRENT->buffer;				// 当前请求项缓冲区所处内存地址.
+	long count = BLOCK_SIZE;						// 传输字节数.
 
-	// 首先检测请求项的缓冲区所在位置. 如果缓冲区处于内存 1MB 以上的某个地方, 则需要将 DMA 缓冲区设在临时缓冲区域(tmp_floppy_area)处. 
+	// 首先检测请求项的缓冲区所在位置. 若是读整个磁道, 则 DMA 缓冲区就是该软驱的磁道缓存, 传输字节数是一个磁道的长度. 
+	// 否则如果缓冲区处于内存 1MB 以上的某个地方, 则需要将 DMA 缓冲区设在临时缓冲区域(tmp_floppy_area)处. 
 	// 因为 8237A 芯片只能在 1MB 地址范围内寻址. 如果是写盘命令, 则还需要把数据从请求项缓冲区复制到该临时区域.
 	cli();
-	if (addr >= 0x100000) {
+	if (track_read) {
+		addr = (long) fd_cache[current_drive].buf;
+		count = floppy->sect * 512;
+	} else if (addr >= 0x100000) {
 		addr = (long) tmp_floppy_area;
 		if (command == FD_WRITE) {
 			copy_buffer(CURRENT->buffer,tmp_floppy_area);
@@ -283,12 +310,12 @@ static void setup_DMA(void) {
 	/* bits 16-19 of addr */	/* 地址 16-19 位 */
 	// DMA 只可以在 1MB 内存空间内寻址, 基高 16-19 位地址需放入页面寄存器(端口 0x81).
 	immoutb_p(addr, 0x81);
-	/* low 8 bits of count-1 (1024-1=0x3ff) */	/* 计数器低 8 位(1024-1 = 0x3ff) */
+	/* low 8 bits of count-1 */	/* 计数器低 8 位(count - 1) */
 	// 向 DMA 通道 2 写入基/当前字节计数值(端口 5).
-	immoutb_p(0xff, 5);
+	immoutb_p(count - 1, 5);
 	/* high 8 bits of count-1 */	/* 计数器高 8 位 */
-	// 一次共传输 1024 字节(两个扇区).
-	immoutb_p(3, 5);
+	// 一次共传输 count 字节(一个数据块是两个扇区, 或者整个磁道).
+	immoutb_p((count - 1) >> 8, 5);
 	/* activate DMA 2 */	/* 开启 DMA 通道 2 的请求 */
 	immoutb_p(0 | 2, 10);
 	sti();
@@ -394,7 +421,12 @@ static void rw_interrupt(void) {
 	// 需要复制到当前请求项的缓冲区中(因为 DMA 只能在 1MB 地址范围寻址). 
 	// 最后释放当前软驱(取消选定), 执行当前请求项结束处理: 唤醒等待该请求项的进程, 
 	// 唤醒等待空闲请求项的进程(若有的话), 从软驱设备请求项链表中删除本请求项. 再继续执行其他软盘请求项操作.
-	if (command == FD_READ && (unsigned long)(CURRENT->buffer) >= 0x100000) {
+	// 若读的是整个磁道, 则设置磁道缓存的标识, 并从缓存中复制请求的数据块.
+	if (track_read) {
+		fd_cache[current_drive].type = floppy;
+		fd_cache[current_drive].track = CURRENT->sector / floppy->sect;
+		copy_buffer(fd_cache[current_drive].buf + (CURRENT->sector % floppy->sect) * 512, CURRENT->buffer);
+	} else if (command == FD_READ && (unsigned long)(CURRENT->buffer) >= 0x100000) {
 		copy_buffer(tmp_floppy_area,CURRENT->buffer);
 	}
 	floppy_deselect(current_drive);
@@ -610,6 +642,7 @@ static void floppy_on_interrupt(void) {
 // 1 处理有复位标志或重新校正标志置位情况; 2 利用请求项中的设备号计算取得请求项指定软驱的参数块; 3 利用内核定时器启动软盘读/写操作.
 void do_fd_request(void) {
 	unsigned int block;
+	struct fd_cache * c;
 
 	// 首先检查是否有复位标志或重校正标志置位, 若有则本函数仅执行相关标志的处理功能后就返回. 如果复位标志已置位, 则执行软盘复位操作并返回.
 	// 如果重新校正标志已置位, 则执行软盘重新校正操作并返回.
@@ -627,6 +660,29 @@ void do_fd_request(void) {
 	// 请求项设备号中的软盘类型(MINOR(CURRENT->dev)>>2)被用作磁盘类型数组 floppy_type[] 的索引值来取得指定软驱的参数块.
 	INIT_REQUEST;
 	floppy = (MINOR(CURRENT->dev) >> 2) + floppy_type;
+	// 对有磁道缓存的软驱, 先查看缓存. 若读请求的数据块整个位于缓存的磁道中, 则直接复制数据并结束该请求项, 不必启动软驱.
+	// 写请求则使涉及磁道(数据块首, 尾扇区所在磁道)的缓存失效. 这一步不改变 current_drive 等当前驱动器状态.
+	track_read = 0;
+	block = CURRENT->sector;
+	if (CURRENT_DEV < NR_FD_CACHE && floppy->sect && block + 2 <= floppy->size) {
+		c = fd_cache + CURRENT_DEV;
+		if (CURRENT->cmd == WRITE) {
+			if (c->track == block / floppy->sect || c->track == (block + 1) / floppy->sect) {
+				c->type = NULL;
+			}
+		} else if (block % floppy->sect + 2 <= floppy->sect) {
+			if (c->type == floppy && c->track == block / floppy->sect) {
+				copy_buffer(c->buf + (block % floppy->sect) * 512, CURRENT->buffer);
+				end_request(1);
+				goto repeat;
+			}
+			// 不命中则读整个磁道. 但若该请求项已经出过错(磁道上可能有坏扇区), 就只读请求的数据块.
+			if (!CURRENT->errors) {
+				c->type = NULL;
+				track_read = 1;
+			}
+		}
+	}
 	// 下面开始设置全局变量值. 如果当前驱动器号 current_drive 不是请求项中指定的驱动器号, 则置标志 seek, 
 	// 表示在执行读/写操作之前需要先让驱动器执行寻道处理. 然后把当前驱动器号设置为请求项中指定的驱动器号.
 	if (current_drive != CURRENT_DEV) {				// CURRENT_DEV 是请求项中指定的软驱号.
@@ -652,6 +708,9 @@ void do_fd_request(void) {
 		seek = 1;
 	}
 	sector++;										// 磁盘上实际扇区计数是从 1 算起.
+	if (track_read) {								// 读整个磁道时从磁道的第 1 个扇区开始.
+		sector = 1;
+	}
 	if (CURRENT->cmd == READ) {						// 如果请求项是读操作, 则置读命令码.
 		command = FD_READ;
 	} else if (CURRENT->cmd == WRITE) {				// 如果请求项是写操作, 则置写命令码.
@@ -682,6 +741,17 @@ static int floppy_sizes[] ={
 // 然后取消对该中断信号的屏蔽, 以允许软盘控制器 FDC 发送中断请求信号. 
 // 中断描述符表 IDT 中陷阱门描述符设置宏 set_trap_gate() 定义在头文件 include/asm/system.h 中.
 void floppy_init(void) {
+	char * p = fd_cache_area;
+	int i;
+
+	// 从 fd_cache_area 中为各软驱切分出磁道缓存区, 跳过会跨越 64KB 边界的位置.
+	for (i = 0; i < NR_FD_CACHE; i++) {
+		if (((unsigned long) p & 0xffff) + FD_TRACK_SIZE > 0x10000) {
+			p = (char *) (((unsigned long) p + 0xffff) & ~0xffff);
+		}
+		fd_cache[i].buf = p;
+		p += FD_TRACK_SIZE;
+	}
 	// 设置软盘中断门描述符. floppy_interrup(kernel/sys_call.s) 是其中断处理过程. 
 	blk_size[MAJOR_NR] = floppy_sizes;
 	blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;  						// = do_fd_request(). 
@@ -41,6 +41,8 @@
 	inb_p(0x71); \
 })
 
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+
 /* Max read/write errors/sector */
 /* 每扇区读/写操作允许的最多出错次数 */
 #define MAX_ERRORS	7							// 读/写一个扇区时允许的最多出错次数.
@@ -63,7 +65,9 @@ static int reset = 0;
  */
 /* 下面结构定义了硬盘参数及类型 */
 // 硬盘信息结构(Harddisk information struct).
-// 各字段分别是磁头数, 每磁道扇区数, 柱面数, 写前预补偿柱面号, 磁头着陆区柱面号, 控制字节.
+// 各字段分别是磁头数, 每磁道扇区数, 柱面数, 写前预补偿柱面号, 磁头着陆区柱面号, 控制字节. 
+// 后 3 个字段由 IDENTIFY 命令的结果设置(hd_identify()). 对支持 LBA 的硬盘, 读写时按绝对扇区号寻址, 
+// 上面的几何参数只用于 "建立驱动器参数" 命令, 硬盘容量也不再受柱面数 * 磁头数 * 扇区数的限制.
 struct hd_i_struct {
 	int head;						// 磁头数
 	int sect;						// 每磁道扇区数
@@ -71,6 +75,10 @@ struct hd_i_struct {
 	int wpcom;						// 写前预补偿磁道(柱面)号
 	int lzone;						// 磁头着陆区磁道(柱面)号
 	int ctl;						// 控制字节
+	int lba;						// 寻址方式: 0 - CHS; 1 - LBA28; 2 - 还支持 LBA48.
+	int mult;						// 多扇区读写时每块的扇区数, 小于 2 表示不使用多扇区命令.
+	long nr_sects;					// 硬盘总扇区数.
+	int dma;						// 是否使用总线主控 DMA 方式读写.
 };
 
 // 如果已经在 include/linux/config.h 配置文件中定义了符号常数 HD_TYPE, 
@@ -93,6 +101,30 @@ static struct hd_struct {
 // 硬盘每个分区数据块总数(扇区数 / 2)数组.
 static int hd_sizes[5 * MAX_HD] = {0, };
 
+// 当前读写命令每次中断传送的扇区数(块大小). 单扇区读写命令为 1, 多扇区读写命令为硬盘的 mult 值. 
+// 请求项最后一块可能不足这么多扇区.
+static unsigned int xfer_sects = 1;
+
+// 读写命令表. 下标依次为: 是否写, 是否多扇区读写, 是否 LBA48 寻址.
+static unsigned char rw_cmds[2][2][2] = {
+	{{WIN_READ, WIN_READ_EXT}, {WIN_MULTREAD, WIN_MULTREAD_EXT}},
+	{{WIN_WRITE, WIN_WRITE_EXT}, {WIN_MULTWRITE, WIN_MULTWRITE_EXT}}
+};
+
+// DMA 读写命令表. 下标依次为: 是否写, 是否 LBA48 寻址.
+static unsigned char dma_cmds[2][2] = {
+	{WIN_READDMA, WIN_READDMA_EXT},
+	{WIN_WRITEDMA, WIN_WRITEDMA_EXT}
+};
+
+// PCI IDE 控制器第 1 通道总线主控寄存器的 I/O 基地址. 为 0 表示没有可用的总线主控 DMA, 所有硬盘都用 PIO 方式读写.
+static unsigned short hd_dma_base = 0;
+
+// PRD(物理区域描述符)表. 每项 2 个长字: 内存物理地址; 字节数(低 16 位, 0 表示 64KB), 最后一项的位 31 置位. 
+// 表本身要长字对齐且不能跨越 64KB 边界, 按表长对齐即可保证. 一个请求项最多 8 个扇区, 4 项已足够.
+#define NR_PRD	4
+static unsigned long hd_prd[2 * NR_PRD] __attribute__ ((aligned (8 * NR_PRD)));
+
 // 读端口嵌入汇编宏. 读端口 port, 共读 nr 字, 保存在 buf 中.
 #define port_read(port, buf, nr) \
 __asm__("cld; rep; insw" : : "d" (port), "D" (buf), "c" (nr))
@@ -104,6 +136,154 @@ __asm__("cld; rep; outsw" : : "d" (port), "S" (buf), "c" (nr))
 extern void hd_interrupt(void);		// 硬盘中断过程(sys_call.s)
 extern void rd_load(void);			// 虚拟盘创建加载函数(ramdik.c)
 
+// 读 PCI 配置空间中的一个长字(配置机制 1). bus, dev, fn 指定设备, reg 是长字对齐的寄存器偏移.
+static unsigned long pci_read_config(int bus, int dev, int fn, int reg) {
+	outl(0x80000000 | (bus << 16) | (dev << 11) | (fn << 8) | reg, 0xCF8);
+	return inl(0xCFC);
+}
+
+// 写 PCI 配置空间中的一个长字.
+static void pci_write_config(int bus, int dev, int fn, int reg, unsigned long value) {
+	outl(0x80000000 | (bus << 16) | (dev << 11) | (fn << 8) | reg, 0xCF8);
+	outl(value, 0xCFC);
+}
+
+// 在 PCI 总线 0 上查找支持总线主控 DMA 的 IDE 控制器(类代码 0x0101, 编程接口位 7 置位), 只在 hd_init() 中调用. 
+// 第 1 通道必须工作在兼容方式(编程接口位 0 为 0), 即仍使用 0x1f0 等端口和 IRQ14, 这样本驱动的其他部分不用改变. 
+// 找到后打开控制器的 I/O 访问和总线主控位, 并从 BAR4 取得总线主控寄存器基地址. 没有 PCI 总线或找不到则保持 PIO 方式.
+static void hd_dma_probe(void) {
+	unsigned long class, bar;
+	int dev, fn;
+
+	outl(0x80000000, 0xCF8);
+	if (inl(0xCF8) != 0x80000000) {						// 不支持配置机制 1.
+		return;
+	}
+	for (dev = 0; dev < 32; dev++) {
+		for (fn = 0; fn < 8; fn++) {
+			if ((pci_read_config(0, dev, fn, 0) & 0xffff) == 0xffff) {
+				continue;
+			}
+			class = pci_read_config(0, dev, fn, 0x08);
+			if ((class >> 16) != 0x0101 || !(class & 0x8000) || (class & 0x0100)) {
+				continue;
+			}
+			bar = pci_read_config(0, dev, fn, 0x20);
+			if (!(bar & 1) || !(bar & 0xfffc)) {
+				continue;
+			}
+			pci_write_config(0, dev, fn, 0x04, (pci_read_config(0, dev, fn, 0x04) & 0xffff) | 0x05);
+			hd_dma_base = bar & 0xfffc;
+			return;
+		}
+	}
+}
+
+// 为从物理地址 addr 开始的 len 字节内存建立 PRD 表. 每项描述一段不跨越 64KB 边界的内存. 
+// 内核数据区的线性地址就是物理地址, 请求项的缓冲区(缓冲块或页面)是物理上连续的. 表项不够用则返回 0, 此时请求改用 PIO 方式.
+static int hd_build_prd(unsigned long addr, unsigned long len) {
+	unsigned long n;
+	int i;
+
+	for (i = 0; len; i++) {
+		if (i >= NR_PRD) {
+			return 0;
+		}
+		n = 0x10000 - (addr & 0xffff);
+		if (n > len) {
+			n = len;
+		}
+		hd_prd[2 * i] = addr;
+		hd_prd[2 * i + 1] = n & 0xffff;
+		addr += n;
+		len -= n;
+	}
+	hd_prd[2 * i - 1] |= 0x80000000;					// 最后一项.
+	return 1;
+}
+
+// 以查询方式等待硬盘控制器忙位复位, 返回最后读到的状态字节. 超时则返回的状态中忙位仍然置位.
+static unsigned char hd_wait_busy(void) {
+	unsigned char c;
+	int i;
+
+	for (i = 0; i < 100000 && ((c = inb_p(HD_STATUS)) & BUSY_STAT); i++) {
+		/* nothing */ ;
+	}
+	return c;
+}
+
+// 用 IDENTIFY 命令探测硬盘 drive(0 或 1), 只在 sys_setup() 中调用. 
+// 探测期间设置控制寄存器的 nIEN 位禁止硬盘中断, 以查询方式等待命令完成. 
+// 若硬盘应答, 则用标识信息中的几何参数, 容量和寻址能力设置 hd_info[drive], 
+// 并用 "设置多扇区" 命令开启多扇区读写(每块最多 16 扇区, 且为 2 的次方). 
+// 成功返回 1; 硬盘不存在或不支持 IDENTIFY 命令(很老的硬盘)返回 0, 此时继续使用 BIOS 参数表中的参数.
+static int hd_identify(int drive) {
+	unsigned short * id;
+	unsigned char c;
+	int mult;
+
+	if (!(id = (unsigned short *) get_free_page())) {
+		return 0;
+	}
+	outb_p(CTL_NIEN, HD_CMD);
+	outb_p(0xA0 | (drive << 4), HD_CURRENT);
+	c = inb_p(HD_STATUS);
+	if (c == 0 || c == 0xff) {								// 不存在的驱动器(或没有控制器)状态为 0 或 0xff.
+		free_page((unsigned long) id);
+		return 0;
+	}
+	outb(WIN_IDENTIFY, HD_COMMAND);
+	c = hd_wait_busy();
+	if ((c & (BUSY_STAT | WRERR_STAT | ERR_STAT)) || !(c & DRQ_STAT)) {
+		free_page((unsigned long) id);
+		return 0;
+	}
+	port_read(HD_DATA, id, 256);
+	// 标识信息: 字 1 - 柱面数; 字 3 - 磁头数; 字 6 - 每磁道扇区数; 字 47 低字节 - 多扇区读写每块最多扇区数;
+	// 字 49 位 9 - 支持 LBA; 字 60-61 - LBA28 总扇区数; 字 83 位 10 - 支持 LBA48; 字 100-103 - LBA48 总扇区数.
+	hd_info[drive].cyl = id[1];
+	hd_info[drive].head = id[3];
+	hd_info[drive].sect = id[6];
+	if (hd_info[drive].head > 8) {
+		hd_info[drive].ctl |= 8;							// 控制字节位 3: 磁头数大于 8.
+	}
+	hd_info[drive].lba = 0;
+	hd_info[drive].nr_sects = hd_info[drive].head * hd_info[drive].cyl * hd_info[drive].sect;
+	if (id[49] & 0x200) {
+		hd_info[drive].lba = 1;
+		hd_info[drive].nr_sects = id[60] | (id[61] << 16);
+		if ((id[83] & 0x400) && (id[101] || id[102] || id[103] || id[100] > hd_info[drive].nr_sects)) {
+			hd_info[drive].lba = 2;
+			// 分区结构中扇区数是 long 型, 更大的硬盘只使用前 2^31 个扇区.
+			hd_info[drive].nr_sects = (id[102] || id[103] || (id[101] & 0x8000)) ? 0x7fffffff : id[100] | (id[101] << 16);
+		}
+	}
+	for (mult = 16; mult > (id[47] & 0xff); mult >>= 1) {
+		/* nothing */ ;
+	}
+	hd_info[drive].mult = 0;
+	if (mult > 1) {
+		outb_p(mult, HD_NSECTOR);
+		outb_p(0xA0 | (drive << 4), HD_CURRENT);
+		outb(WIN_SETMULT, HD_COMMAND);
+		if (!(hd_wait_busy() & (BUSY_STAT | ERR_STAT))) {
+			hd_info[drive].mult = mult;
+		}
+	}
+	// 字 49 位 8 - 支持 DMA; 字 63 - 多字 DMA 方式(低字节支持的方式, 高字节已选定的方式); 字 88 - Ultra DMA 方式(字 53 位 2 置位时有效). 
+	// 只有 BIOS 已经为硬盘选定了某种 DMA 方式时才使用总线主控 DMA 方式读写. 选定方式时 BIOS 同时按该方式设置了 IDE 控制器的
+	// 时序寄存器, 而这些寄存器因芯片组而异, 这里无法自行设置; 若只用 "设置特性" 命令让硬盘进入 DMA 方式而控制器仍是
+	// 上电时的时序, 传送可能出错. 因此 BIOS 没有选定 DMA 方式时就使用 PIO 方式. 最后在总线主控状态寄存器中标明该硬盘可以 DMA(位 5, 6).
+	hd_info[drive].dma = 0;
+	if (hd_dma_base && (id[49] & 0x100) && ((id[63] & 0x0700) || ((id[53] & 4) && (id[88] & 0x7f00)))) {
+		hd_info[drive].dma = 1;
+		outb(inb(hd_dma_base + BM_STATUS) | (0x20 << drive), hd_dma_base + BM_STATUS);
+	}
+	free_page((unsigned long) id);
+	return 1;
+}
+
 /* This may be used only once, enforced by 'static int callable' */
 /* 下面该函数只在初始化时被调用一次. 用静态变量 callable 作为可调用标志. */
 // 系统设备函数.
@@ -143,12 +323,10 @@ int sys_setup(void * BIOS) {
 		NR_HD = 1;
 	}
 #endif
-	// 到这里, 硬盘信息数组 hd_info[] 已经设置好, 并且确定了系统含有的硬盘数 NR_HD. 现在开始设置硬盘分区结构数组 hd[]. 
-	// 该数组的项 0 和项 5 分别表示两个硬盘的整体参数, 而项 1-4 和 6-9 分别表示两个硬盘的 4 个分区参数. 
-	// 因此这里仅设置硬盘整体信息的两项(项 0 和 5).
+	// 先按 BIOS 参数表计算各硬盘的总扇区数 = 磁头数 * 磁道(柱面)数 * 磁道扇区数. 
+	// 下面若 IDENTIFY 命令探测成功, 会用硬盘报告的参数和容量替换这些值.
 	for (i = 0; i < NR_HD; i++) {
-		hd[i * 5].start_sect = 0;													// 硬盘起始扇区号.
-		hd[i * 5].nr_sects = hd_info[i].head * hd_info[i].cyl * hd_info[i].sect;	// 硬盘总扇区数 = 磁头数 * 磁道(柱面)数 * 磁道扇区数.
+		hd_info[i].nr_sects = hd_info[i].head * hd_info[i].cyl * hd_info[i].sect;
 	}
 
 	/*
@@ -193,11 +371,26 @@ int sys_setup(void * BIOS) {
 	} else {
 		NR_HD = 0;
 	}
-	// 若 NR_HD = 0, 则两个硬盘都不是 AT 控制器兼容的, 两个硬盘数据结构全清零. 
-	// 若 NR_HD = 1, 则将第 2 个硬盘的参数清零.
-	for (i = NR_HD; i < 2; i++) {
-		hd[i * 5].start_sect = 0;
-		hd[i * 5].nr_sects = 0;
+	// 然后用 IDENTIFY 命令直接询问各硬盘. 能应答该命令的硬盘一定是寄存器兼容的, 因此即使 CMOS 中没有记录也可以使用. 
+	// 若在配置文件中定义了 HD_TYPE, 则硬盘数已经固定, 只探测这些硬盘.
+#ifdef HD_TYPE
+	for (drive = 0; drive < NR_HD; drive++) {
+		hd_identify(drive);
+	}
+#else
+	for (drive = 0; drive < MAX_HD && hd_identify(drive); drive++) {
+		if (drive >= NR_HD) {
+			NR_HD = drive + 1;
+		}
+	}
+#endif
+	outb_p(hd_info[0].ctl & 0x0f, HD_CMD);				// 重新允许硬盘中断.
+	// 到这里, 硬盘信息数组 hd_info[] 已经设置好, 并且确定了系统含有的硬盘数 NR_HD. 现在开始设置硬盘分区结构数组 hd[]. 
+	// 该数组的项 0 和项 5 分别表示两个硬盘的整体参数, 而项 1-4 和 6-9 分别表示两个硬盘的 4 个分区参数. 
+	// 因此这里仅设置硬盘整体信息的两项(项 0 和 5). 不存在的硬盘其整体参数清零.
+	for (i = 0; i < MAX_HD; i++) {
+		hd[i * 5].start_sect = 0;						// 硬盘起始扇区号.
+		hd[i * 5].nr_sects = (i < NR_HD) ? hd_info[i].nr_sects : 0;
 	}
 	// 好, 到此为止我们已经真正确定了系统中所含的硬盘个数 NR_HD. 现在我们来读取每个硬盘上 0 号扇区中的分区表信息, 
 	// 用来设置分区结构数组 hd[] 中硬盘各分区的信息. 首先利用读函数 bread() 读取硬盘第 0 号数据块(fs/buffer.c), 
@@ -248,7 +441,8 @@ int sys_setup(void * BIOS) {
 		Log(LOG_INFO_TYPE, "<<<<< Partition table%s ok. >>>>>\n\r", (NR_HD > 1) ? "s" : "");
 	}
 	for (i = 0; i < NR_HD; i++) {
-		Log(LOG_INFO_TYPE, "<<<<< HD[%d] Info: cyl = %d, head = %d, sect = %d, ctl = %x >>>>>\n", i, hd_info[i].cyl, hd_info[i].head, hd_info[i].sect, hd_info[i].ctl);
+		Log(LOG_INFO_TYPE, "<<<<< HD[%d] Info: cyl = %d, head = %d, sect = %d, ctl = %x, lba = %d, mult = %d, nr_sects = %d >>>>>\n",
+			i, hd_info[i].cyl, hd_info[i].head, hd_info[i].sect, hd_info[i].ctl, hd_info[i].lba, hd_info[i].mult, hd_info[i].nr_sects);
 	}
 	rd_load();						// 尝试在虚拟盘中加载根文件系统. (kernel/blk_drv/ramdisk.c)
 	// 初始化交换设备使用位图, 如果存在交换设备, 则在主内存中申请一页物理内存(4KB)生成交换内存位图信息 swap_bitmap. 
@@ -325,6 +519,40 @@ static void hd_out(unsigned int drive, unsigned int nsect, unsigned int sect, un
 	outb(cmd, ++port);									// 命令: 硬盘控制命令.
 }
 
+// 以 LBA 方式向硬盘控制器发送命令块. 
+// 参数: drive - 硬盘号(0-1); nsect - 读写扇区数; block - 起始绝对扇区号; ext - 是否使用 LBA48 寻址; 
+//     cmd - 命令码; intr_addr() - 硬盘中断处理中将调用的 C 处理函数指针.
+// LBA28 方式下扇区号的位 0-23 依次写入扇区号寄存器和柱面号寄存器, 位 24-27 放在驱动器/磁头寄存器的低 4 位, 
+// 并置位该寄存器的 LBA 位(位 6). LBA48 方式下扇区数和扇区号寄存器都是两字节深的 FIFO, 要先写高位字节再写低位字节.
+static void hd_out_lba(unsigned int drive, unsigned int nsect, unsigned long block, int ext, unsigned int cmd, void (*intr_addr)(void)) {
+	if (drive > 1) {
+		panic("Trying to write bad sector");
+	}
+	if (!controller_ready()) {
+		panic("HD controller not ready");
+	}
+	SET_INTR(intr_addr);
+	outb_p(hd_info[drive].ctl, HD_CMD);
+	if (ext) {
+		outb_p(nsect >> 8, HD_NSECTOR);					// 扇区数高字节.
+		outb_p(block >> 24, HD_SECTOR);					// 扇区号位 24-31.
+		outb_p(0, HD_LCYL);								// 扇区号位 32-39.
+		outb_p(0, HD_HCYL);								// 扇区号位 40-47.
+		outb_p(nsect, HD_NSECTOR);
+		outb_p(block, HD_SECTOR);						// 扇区号位 0-7.
+		outb_p(block >> 8, HD_LCYL);					// 扇区号位 8-15.
+		outb_p(block >> 16, HD_HCYL);					// 扇区号位 16-23.
+		outb_p(0xE0 | (drive << 4), HD_CURRENT);
+	} else {
+		outb_p(nsect, HD_NSECTOR);
+		outb_p(block, HD_SECTOR);
+		outb_p(block >> 8, HD_LCYL);
+		outb_p(block >> 16, HD_HCYL);
+		outb_p(0xE0 | (drive << 4) | ((block >> 24) & 0x0f), HD_CURRENT);
+	}
+	outb(cmd, HD_COMMAND);
+}
+
 // 等待硬盘就绪.
 // 该函数循环等待主状态控制器忙标志复位. 若仅有就绪或寻道结束标志置位, 则表示就绪, 成功返回 0. 
 // 若经过一段时间仍为忙, 则返回 1.
@@ -352,6 +580,9 @@ static int drive_busy(void) {
 static void reset_controller(void) {
 	int	i;
 
+	if (hd_dma_base) {
+		outb(0, hd_dma_base + BM_COMMAND);				// 停止可能还在进行的总线主控传送.
+	}
 	outb(4, HD_CMD);									// 向控制寄存器端口发送复位控制字节.
 	for(i = 0; i < 1000; i++) {							// 等待一段时间.
 		nop();
@@ -390,9 +621,15 @@ repeat:
 			goto repeat;
 		}
 	}
-	i++;												// 处理下一个硬盘(第 1 个是 0).
-	if (i < NR_HD) {
-		hd_out(i, hd_info[i].sect, hd_info[i].sect,hd_info[i].head - 1, hd_info[i].cyl, WIN_SPECIFY, &reset_hd);
+	// i 的偶数步骤对硬盘 i / 2 发送 "建立驱动器参数" 命令, 奇数步骤对使用多扇区读写的硬盘重新发送 "设置多扇区" 命令, 
+	// 因为复位后驱动器可能已恢复为单扇区方式. 不使用多扇区读写的硬盘跳过奇数步骤.
+	do {
+		i++;
+	} while (i < 2 * NR_HD && (i & 1) && hd_info[i >> 1].mult < 2);
+	if (i < 2 * NR_HD && !(i & 1)) {
+		hd_out(i >> 1, hd_info[i >> 1].sect, hd_info[i >> 1].sect, hd_info[i >> 1].head - 1, hd_info[i >> 1].cyl, WIN_SPECIFY, &reset_hd);
+	} else if (i < 2 * NR_HD) {
+		hd_out(i >> 1, hd_info[i >> 1].mult, 0, 0, 0, WIN_SETMULT, &reset_hd);
 	} else {
 		do_hd_request();								// 执行请求项处理.
 	}
@@ -425,6 +662,8 @@ static void bad_rw_intr(void) {
 // 此时在硬盘中断处理程序调用的 C 函数指针 do_hd 已经指向 read_intr(), 
 // 因此会在一次读扇区操作完成(或出错)后就会执行该函数.
 static void read_intr(void) {
+	int n;
+
 	// 首先判断此次读请求操作是否出错. 若命令结束后控制器还处于忙状态, 或者命令执行错误, 则处理硬盘操作失败的问题, 
 	// 接着再次请求硬盘作复位处理并执行其他请求项. 然后返回. 
 	// 每次读操作出错都会对当前请求项作出错次数累计, 若出错次数不到最大允许出错次数一半, 
@@ -435,13 +674,15 @@ static void read_intr(void) {
 		do_hd_request();								// 再次请求硬盘作相应(复位)处理.
 		return;
 	}
-	// 如果读命令没有出错, 则从数据寄存器端口把 1 扇区的数据(512B)读到请求项的缓冲区中, 并且递减请求项所需读取的扇区数值. 
+	// 如果读命令没有出错, 则从数据寄存器端口把 1 块数据(单扇区命令是 1 个扇区, 多扇区命令最多 xfer_sects 个扇区)
+	// 读到请求项的缓冲区中, 并且递减请求项所需读取的扇区数值. 
 	// 再次设置 do_hd 指针指向 read_intr(), 因为硬盘中断处理程序每次都会将函数指针 do_hd 置空.
-	port_read(HD_DATA, CURRENT->buffer, 256);			// 每次从硬盘中读取一个扇区的数据(512B)到缓冲块中.
+	n = MIN(xfer_sects, CURRENT->nr_sectors);
+	port_read(HD_DATA, CURRENT->buffer, 256 * n);		// 从硬盘中读取 n 个扇区的数据到缓冲块中.
 	CURRENT->errors = 0;								// 清出错次数.
-	CURRENT->buffer += 512;								// 数据缓冲区指针, 指向新的待读入数据缓冲区.
-	CURRENT->sector++;									// 起始扇区号加 1.
-	if (--CURRENT->nr_sectors) {						// 如果所需数据还没读完, 则再次设置硬盘中断调用函数为 read_intr().
+	CURRENT->buffer += 512 * n;							// 数据缓冲区指针, 指向新的待读入数据缓冲区.
+	CURRENT->sector += n;								// 起始扇区号加 n.
+	if (CURRENT->nr_sectors -= n) {						// 如果所需数据还没读完, 则再次设置硬盘中断调用函数为 read_intr().
 		SET_INTR(&read_intr);
 		return; 										// 直接返回等待下次硬盘中断时再次读取数据.
 	}
@@ -457,6 +698,8 @@ static void read_intr(void) {
 // 此时在硬盘中断处理程序中调用的 C 函数指针 do_hd 已经指向 write_intr(), 
 // 因此会在一次写扇区操作完成(或出错)后就会执行该函数.
 static void write_intr(void) {
+	int n;
+
 	// 该函数首先判断此次写命令操作是否出错. 若命令结束后控制器还处于忙状态, 或者命令执行错误, 则处理硬盘操作失败问题, 
 	// 接着再次请求硬盘作复位处理并执行其他请求项. 然后返回. 
 	// 在 bad_rw_intr() 函数中, 每次操作出错都会对当前请求项作出错次数累计, 
@@ -468,15 +711,16 @@ static void write_intr(void) {
 		do_hd_request();
 		return;
 	}
-	// 此时说明本次写一扇区操作成功, 因为将欲写扇区数减 1. 若其不为 0, 则说明还有扇区要写, 
-	// 于是把当前请求起始扇区号 + 1, 并调整请求项数据缓冲区指针指向下一块欲写的数据. 
+	// 此时说明本次写一块(n 个扇区)操作成功, 因为将欲写扇区数减 n. 若其不为 0, 则说明还有扇区要写, 
+	// 于是把当前请求起始扇区号 + n, 并调整请求项数据缓冲区指针指向下一块欲写的数据. 
 	// 然后再重置硬盘中断处理程序中调用的 C 函数指针 do_hd(指向本函数).
-	// 接着向控制器数据端口写入 512 字节数据, 然后函数返回去等待控制器把些数据写入硬盘后产生的中断.
-	if (--CURRENT->nr_sectors) {						// 若还有扇区要写, 则
-		CURRENT->sector++;								// 当前请求起始扇区号 + 1,
-		CURRENT->buffer += 512;							// 调整请求缓冲区指针,
+	// 接着向控制器数据端口写入下一块数据, 然后函数返回去等待控制器把些数据写入硬盘后产生的中断.
+	n = MIN(xfer_sects, CURRENT->nr_sectors);
+	if (CURRENT->nr_sectors -= n) {						// 若还有扇区要写, 则
+		CURRENT->sector += n;							// 当前请求起始扇区号 + n,
+		CURRENT->buffer += 512 * n;						// 调整请求缓冲区指针,
 		SET_INTR(&write_intr);							// do_hd 置函数指针为 write_intr().
-		port_write(HD_DATA, CURRENT->buffer, 256);		// 向数据端口写 256 字.
+		port_write(HD_DATA, CURRENT->buffer, 256 * MIN(xfer_sects, CURRENT->nr_sectors));
 		return;
 	}
 	// 若本次请求项的全部扇区数据已经写完, 则调用 end_request() 函数去处理请求项结束事宜. 
@@ -485,6 +729,29 @@ static void write_intr(void) {
 	do_hd_request();									// 执行其他硬盘请求操作.
 }
 
+// DMA 读写中断调用函数.
+// DMA 方式下整个请求项的数据由总线主控传送, 传送完毕后硬盘只产生一次中断. 
+// 先停止总线主控传送并清除其状态寄存器中的出错和中断位, 再检查硬盘命令执行结果. 
+// 若总线主控报告出错(例如访问内存失败), 则该硬盘以后改用 PIO 方式. 出错处理与 read_intr() 相同.
+static void dma_intr(void) {
+	unsigned char stat;
+
+	outb(0, hd_dma_base + BM_COMMAND);
+	stat = inb(hd_dma_base + BM_STATUS);
+	outb(stat | BM_STAT_ERR | BM_STAT_INTR, hd_dma_base + BM_STATUS);
+	if (win_result() || (stat & BM_STAT_ERR)) {
+		if (stat & BM_STAT_ERR) {
+			hd_info[CURRENT_DEV].dma = 0;
+			printk("HD%d: DMA error, using PIO\n\r", CURRENT_DEV);
+		}
+		bad_rw_intr();
+		do_hd_request();
+		return;
+	}
+	end_request(1);
+	do_hd_request();
+}
+
 // 硬盘重新校正(复位)中断调用函数.
 // 该函数会在硬盘执行重新校正操作而引发的硬盘中断中被调用.
 // 如果硬盘控制器返回错误信息, 则函数首先进行硬盘读写失败处理, 然后请求硬盘作相应(复位)处理. 
@@ -532,7 +799,9 @@ void hd_times_out(void) {
 // 并会立刻调用本函数执行读写操作. 
 // 否则在一个读写操作完成而引发的硬盘中断过程, 若还有请求项需要处理, 则也会在硬盘中断过程中调用本函数
 void do_hd_request(void) {
-	int i, r;
+	int i, r, write, mult, ext, dma;
+	unsigned int cmd;
+	void (*intr)(void);
 	unsigned int block, dev;
 	unsigned int sec, head, cyl;
 	unsigned int nsect;
@@ -540,39 +809,19 @@ void do_hd_request(void) {
 	// 函数首先检测请求项的合法性. 若请求队列中已没有请求项则退出(参见 kernel/blk_drv/blk.h)
 	// 然后取设备号中的子设备号以及设备当前请求项中的起始扇区号. 
 	// 子设备号即对应硬盘上各分区(0 - 整个硬盘; 1 - 第一分区; 2 - 第二分区... 5 - 第二个硬盘, 6 - 第二个硬盘第一个分区...). 
-	// 如果子设备号不存在或者起始扇区大于该分区扇区数 - 2, 则结束该请求项, 并跳转到标号 repeat 处(定义在 INIT_REQUEST 开始处).
-	// 因为一次请求要读写一个缓冲块数据(2 个扇区, 即 1024 字节), 所以请求的扇区号不能大于分区中最后倒数第二个扇区号. 
+	// 如果子设备号不存在或者请求的扇区超出了该分区, 则结束该请求项, 并跳转到标号 repeat 处(定义在 INIT_REQUEST 开始处).
 	// 然后通过加上子设备号对应分区的起始扇区号, 就把需要读写的块对应到整个硬盘的绝对扇区号 block 上. 
 	// 而子设备号除以 5 即可得到对应的硬盘号(0x305 / 5 ==> 5 / 5 = 1 ==> 第 1(从 0 开始)个硬盘).
 	INIT_REQUEST; 									// 校验请求参数是否正确.
  	dev = MINOR(CURRENT->dev); 						// 取当前请求项的子设备号.
 	block = CURRENT->sector;						// 当前请求的起始扇区号.
-	if (dev >= 5 * NR_HD || block + 2 > hd[dev].nr_sects) { // 如果参数不对, 则结束请求.
+	nsect = CURRENT->nr_sectors;					// 要读/写的扇区数.
+	if (dev >= 5 * NR_HD || block + nsect > hd[dev].nr_sects) { // 如果参数不对, 则结束请求.
 		end_request(0);
 		goto repeat;								// 该标号在 INIT_REQUEST(kernel/blk_drv/blk.h) 开始处.
 	}
 	block += hd[dev].start_sect; 					// 得到绝对扇区号(整个磁盘中的扇区号).
 	dev /= 5;										// 此时 dev 代表硬盘号(硬盘 0 还是硬盘 1).
-	// 然后根据绝对扇区号 block 和硬盘号 dev, 计算出对应硬盘中的磁道中扇区号(sec), 所在磁道(柱面)号(cyl)和磁头号(head).
-	// 计算方法为: 初始时 eax 是扇区号 block, edx 中置 0. 
-	// 			 divl 指令把 edx:eax 组成的扇区号除以每磁道扇区数(hd_info[dev].sect),
-	// 			 所得整数商值在 eax 中, 余数在 edx 中. 
-	// 			 其中 eax 中是到指定位置的对应总磁道数(所有磁头面) block, edx 中是当前磁道上的扇区号(sec). 
-	__asm__("divl %4"                   \
-	     	: "=a" (block), "=d" (sec) 	\
-			: "0" (block), "1" (0), "r" (hd_info[dev].sect));
-	// 代码初始时 eax 是上面计算出的对应总磁道数, edx 中置 0. 
-	// divl 指令把 edx:eax 的对应总磁道数除以硬盘总磁头数(hd_info[dev].head),
-	// 在 eax 中得到的整除值是柱面号(cyl), edx 得到的余数就是对应得当前磁头号(head).
-	// 对应总磁道数 * 每磁道扇区数 + 当前磁道上的扇区号 = 绝对扇区号.
-	// 总磁头数 * 柱面号 + 磁头号 = 对应总磁道数.
-	__asm__("divl %4" 					\
-	 		: "=a" (cyl), "=d" (head) 	\
-			: "0" (block), "1" (0), "r" (hd_info[dev].head));
-	sec++;											// 对计算所得当前磁道扇区号进行调整.
-	nsect = CURRENT->nr_sectors;					// 要读/写的扇区数.
-	// 此时我们得到了要读写的硬盘起始扇区 block 对应的硬盘上磁道号(cyl), 
-	// 在当前磁道上的扇区号(sec), 磁头号(head)以及要读写的总扇区数(nsect). 
 	// 查看是否硬盘控制器中是否有复位控制器状态和重新校正硬盘的标志, 通常在复位操作之后都需要重新校正硬盘磁头位置. 
 	// 若这些标志已被置位, 则说明前面的硬盘操作可能出现了一些问题或者现在是系统第一次硬盘读写操作等情况. 
 	// 于是我们就需要重新复位硬盘或控制器并重新校正硬盘. 如果此时复位标志 reset 是置位的, 则需要执行复位操作. 
@@ -590,14 +839,61 @@ void do_hd_request(void) {
 		hd_out(dev, hd_info[CURRENT_DEV].sect, 0, 0, 0, WIN_RESTORE, &recal_intr);
 		return;
 	}
+	if (CURRENT->cmd != READ && CURRENT->cmd != WRITE) {
+		panic("unknown hd-command");
+	}
 	// 如果以上两个标志都没有置位, 那么我们就可以开始向硬盘控制器发送真正的数据读/写操作命令了. 
-	// 如果当前请求是写扇区操作, 则发送命令, 循环读取状态寄存器信息并判断请求服务标志 DRQ_STAT 是否置位. 
+	// 硬盘可以使用 DMA 时, 先设置总线主控的 PRD 表地址和传送方向并清除其状态, 发送 DMA 读写命令后再启动总线主控, 
+	// 整个请求项传送完毕后才产生一次中断. 否则使用 PIO 方式: 硬盘开启了多扇区读写时使用多扇区命令, 
+	// 每次中断传送 xfer_sects 个扇区, 否则每次中断传送 1 个扇区. 
+	// 支持 LBA 的硬盘直接用绝对扇区号寻址. 只有请求超出 LBA28 能表示的范围(2^28 个扇区)时才使用 LBA48 命令.
+	write = (CURRENT->cmd == WRITE);
+	ext = (hd_info[dev].lba > 1 && block + nsect > 0x10000000);
+	dma = (hd_info[dev].dma && hd_build_prd((unsigned long) CURRENT->buffer, nsect << 9));
+	if (dma) {
+		outl((unsigned long) hd_prd, hd_dma_base + BM_PRD);
+		outb(write ? 0 : BM_CMD_READ, hd_dma_base + BM_COMMAND);
+		outb(inb(hd_dma_base + BM_STATUS) | BM_STAT_ERR | BM_STAT_INTR, hd_dma_base + BM_STATUS);
+		cmd = dma_cmds[write][ext];
+		intr = &dma_intr;
+	} else {
+		mult = (hd_info[dev].mult > 1);
+		xfer_sects = mult ? hd_info[dev].mult : 1;
+		cmd = rw_cmds[write][mult][ext];
+		intr = write ? &write_intr : &read_intr;
+	}
+	if (hd_info[dev].lba) {
+		hd_out_lba(dev, nsect, block, ext, cmd, intr);
+	} else {
+		// 否则根据绝对扇区号 block 和硬盘号 dev, 计算出对应硬盘中的磁道中扇区号(sec), 所在磁道(柱面)号(cyl)和磁头号(head).
+		// 计算方法为: 初始时 eax 是扇区号 block, edx 中置 0. 
+		// 			 divl 指令把 edx:eax 组成的扇区号除以每磁道扇区数(hd_info[dev].sect),
+		// 			 所得整数商值在 eax 中, 余数在 edx 中. 
+		// 			 其中 eax 中是到指定位置的对应总磁道数(所有磁头面) block, edx 中是当前磁道上的扇区号(sec). 
+		__asm__("divl %4"                   \
+		     	: "=a" (block), "=d" (sec) 	\
+				: "0" (block), "1" (0), "r" (hd_info[dev].sect));
+		// 代码初始时 eax 是上面计算出的对应总磁道数, edx 中置 0. 
+		// divl 指令把 edx:eax 的对应总磁道数除以硬盘总磁头数(hd_info[dev].head),
+		// 在 eax 中得到的整除值是柱面号(cyl), edx 得到的余数就是对应得当前磁头号(head).
+		// 对应总磁道数 * 每磁道扇区数 + 当前磁道上的扇区号 = 绝对扇区号.
+		// 总磁头数 * 柱面号 + 磁头号 = 对应总磁道数.
+		__asm__("divl %4" 					\
+		 		: "=a" (cyl), "=d" (head) 	\
+				: "0" (block), "1" (0), "r" (hd_info[dev].head));
+		sec++;										// 对计算所得当前磁道扇区号进行调整.
+		hd_out(dev, nsect, sec, head, cyl, cmd, intr);
+	}
+	if (dma) {
+		outb(inb(hd_dma_base + BM_COMMAND) | BM_CMD_START, hd_dma_base + BM_COMMAND);
+		return;
+	}
+	// 如果当前请求是写扇区操作, 则在发送命令后循环读取状态寄存器信息并判断请求服务标志 DRQ_STAT 是否置位. 
 	// DRQ_STAT 是硬盘状态寄存器的请求服务位, 表示驱动器已经准备好在主机和数据端口之间传输一个字或一个字节的数据.
 	// 如果请求服务 DRQ 置位则退出循环. 若等到循环结束也没有置位, 则表示发送的要求写硬盘命令失败. 
 	// 于是跳转去处理出现的问题或继续执行下一个硬盘请求, 
-	// 否则我们可以向硬盘控制器数据寄存器端口 HD_DATA 写入 1 个扇区的数据.
-	if (CURRENT->cmd == WRITE) {
-		hd_out(dev, nsect, sec, head, cyl, WIN_WRITE, &write_intr);  // 如果是写操作, 则将中断处理函数设置为 write_intr(). 
+	// 否则我们可以向硬盘控制器数据寄存器端口 HD_DATA 写入第 1 块数据. 读操作则等待硬盘中断.
+	if (write) {
 		for(i = 0; i < 10000 && !(r = inb_p(HD_STATUS) & DRQ_STAT); i++) {
 			/* nothing */ ;
 		}
@@ -605,12 +901,7 @@ void do_hd_request(void) {
 			bad_rw_intr();
 			goto repeat;							// 该标号在 blk.h 文件最后面.
 		}
-		port_write(HD_DATA, CURRENT->buffer, 256);
-	// 如果当前请求是读硬盘数据, 则向硬盘控制器发送读扇区命令. 若命令无效则停机.
-	} else if (CURRENT->cmd == READ) {
-		hd_out(dev, nsect, sec, head, cyl, WIN_READ, &read_intr); 	// 如果是读操作, 则将中断处理函数设置为 read_intr().
-	} else {
-		panic("unknown hd-command");
+		port_write(HD_DATA, CURRENT->buffer, 256 * MIN(xfer_sects, nsect));
 	}
 }
 
@@ -625,6 +916,7 @@ void do_hd_request(void) {
 void hd_init(void)
 {
 	blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;		// do_hd_request().
+	hd_dma_probe();										// 查找 PCI 总线主控 IDE 控制器.
 	set_intr_gate(0x2E, &hd_interrupt);					// 设置中断门描述符: 对应处理函数指针(kernel/sys_call.s 中)
 	outb_p(inb_p(0x21) & 0xfb, 0x21);					// 复位接联的主 8259A int 2 的屏蔽位
 	outb(inb_p(0xA1) & 0xbf, 0xA1);						// 复位硬盘中断请求屏蔽位(在从片上).
@@ -298,8 +298,13 @@ repeat:
 void ll_rw_block(int rw, struct buffer_head * bh) {
 	unsigned int major;									// 主设备号(对于硬盘是 3).
 
+	// 无名设备(主设备号 0)上是 tmpfs 这类内存文件系统, 其数据块就在内存页面中, 不需要建立请求项, 由 tmpfs_rw_block() 直接完成. 
 	// 如果请求的块设备主设备号不对或者该块设备的请求操作函数不存在, 则显示出错信息, 并返回. 否则创建请求项并插入请求队列.
-	if ((major = MAJOR(bh->b_dev)) >= NR_BLK_DEV || !(blk_dev[major].request_fn)) {
+	if (!(major = MAJOR(bh->b_dev))) {
+		tmpfs_rw_block(rw, bh);
+		return;
+	}
+	if (major >= NR_BLK_DEV || !(blk_dev[major].request_fn)) {
 		printk("Trying to read nonexistent block-device\n\r");
 		return;
 	}
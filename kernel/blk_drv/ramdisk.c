@@ -14,15 +14,18 @@
 // 作为对他的推崇, 第 97 期(2002 年 5 月)的 LinuxJournal 期弄将他作为了封面人物, 并对他行了采访. 
 // 目前他为 IMBLinux 技术中心工作, 并从事着有关 LSB(Linux Standard Base) 等方面的工作. 
 // (他的个人主页是: http://thunk.org/tytso/)
+#include <errno.h>								// 错误号头文件. 包含系统中各种出错号.
 #include <string.h>								// 字符串头文件.主要定义了一些有关字符串操作的嵌入函数.
+#include <sys/ramdisk.h>						// 虚拟盘 ioctl 命令码.
 
 // #include <linux/config.h>					// 内核配置头文件. 定义键盘语言和硬盘类型(HD_TYPE)可选项.
-// #include <linux/sched.h>						// 调试程序头文件, 定义了任务结构 task_struct, 任务 0 的数据, 
+#include <linux/sched.h>						// 调试程序头文件, 定义了任务结构 task_struct, 任务 0 的数据, 
 												// 还有一些有关描述符参数设置和获取的嵌入式汇编宏语句.
 #include <linux/fs.h>							// 文件系统头文件. 定义文件表结构(file, m_inode)等.
-// #include <linux/kernel.h>					// 内核头文件. 含有一些内核常用函数的原型定义.
+#include <linux/kernel.h>						// 内核头文件. 含有一些内核常用函数的原型定义.
+#include <linux/mm.h>							// 内存管理头文件. 含有 get_free_page() 和 free_page() 的原型.
 // #include <asm/system.h>						// 系统头文件. 定义了设置或修改描述符/中断门等嵌入式汇编宏.
-// #include <asm/segment.h>						// 段操作头文件. 定义了有关段寄存器操作的嵌入式汇编函数.
+#include <asm/segment.h>						// 段操作头文件. 定义了有关段寄存器操作的嵌入式汇编函数.
 // #include <asm/memory.h>						// 内存拷贝头文件. 含有 memcpy() 嵌入式汇编宏函数.
 
 // 定义 RAM 盘主设备号符号常数. 在驱动程序中主设备号必须包含 blk.h 文件之前被定义.
@@ -30,74 +33,190 @@
 #define MAJOR_NR 1
 #include "blk.h"
 
-// 虚拟盘在内存中的起始位置. 该位置会在第 52 行上初始化函数 rd_init() 中确定. 
-// 参见内核初始化程序 init/main.c. 'rd' 是 'ramdisk' 的缩写.
-char * rd_start;								// 虚拟盘在内存中的开始地址.
-int	rd_length = 0;								// 虚拟盘所占内存大小(字节).
+// 虚拟盘不再占用启动时划出的一段连续内存, 而是按页组织: 每个虚拟盘有一个索引页, 其中 1024 项依次是各 4KB 数据页的地址, 
+// 数据页在第一次用到时才用 get_free_page() 分配(取得的页面已清零, 正好是未写过的盘块内容). 
+// 虚拟盘的盘块本来就在内存中, 因此高速缓冲中虚拟盘的缓冲块直接指向数据页中的盘块(见 rd_block() 和 fs/buffer.c 中 getblk()), 
+// 读写都不再在缓冲块与虚拟盘之间复制数据. 虚拟盘大小可以在运行时用 ioctl(RDSETSIZE) 修改.
+// 子设备 1 - 3 可用, 其中 1 号(设备号 0x0101)用作根文件系统虚拟盘. 'rd' 是 'ramdisk' 的缩写.
+#define NR_RD			4											// 子设备号数(0 号不用).
+#define RD_BLOCKS_PER_PAGE	(PAGE_SIZE / BLOCK_SIZE)				// 每页盘块数(4).
+#define RD_MAX_SIZE		(PAGE_SIZE / 4 * RD_BLOCKS_PER_PAGE)		// 一个索引页所能容纳的最大盘块数(4096 块, 即 4MB).
+
+static int rd_sizes[NR_RD] = {0, };								// 各虚拟盘的大小(盘块数, 即 KB 数). 由 blk_size[1] 指向.
+static unsigned long rd_index[NR_RD] = {0, };					// 各虚拟盘索引页的地址, 0 表示还没有分配.
+
+// 取虚拟盘 nr 上盘块 block 在内存中的地址. create 不为 0 时数据页(以及索引页)还没有分配就分配一页. 
+// 盘块超出虚拟盘大小, 数据页没有分配(且不要求分配)或内存不够时返回 NULL. 
+// 注意 get_free_page() 在内存不够时会执行交换操作, 可能睡眠. 睡眠期间其他进程可能已经为同一位置分配了页面, 
+// 或者用 ioctl(RDSETSIZE) 缩小了虚拟盘(释放了索引页). 因此取得页面后若该位置已被填上或索引页已变, 就释放自己申请的页面, 
+// 然后从头重新检查.
+static char * rd_addr(int nr, int block, int create) {
+	unsigned long * index;
+	unsigned long page;
+
+repeat:
+	if (nr <= 0 || nr >= NR_RD || block < 0 || block >= rd_sizes[nr]) {
+		return NULL;
+	}
+	if (!rd_index[nr]) {
+		if (!create || !(page = get_free_page())) {
+			return NULL;
+		}
+		if (rd_index[nr] || block >= rd_sizes[nr]) {
+			free_page(page);
+		} else {
+			rd_index[nr] = page;
+		}
+		goto repeat;
+	}
+	index = (unsigned long *) rd_index[nr];
+	if (!(page = index[block / RD_BLOCKS_PER_PAGE])) {
+		if (!create || !(page = get_free_page())) {
+			return NULL;
+		}
+		if (rd_index[nr] != (unsigned long) index || block >= rd_sizes[nr] || index[block / RD_BLOCKS_PER_PAGE]) {
+			free_page(page);
+		} else {
+			index[block / RD_BLOCKS_PER_PAGE] = page;
+		}
+		goto repeat;
+	}
+	return (char *) page + (block % RD_BLOCKS_PER_PAGE) * BLOCK_SIZE;
+}
+
+// 取虚拟盘设备 dev 上盘块 block 在内存中的地址, 数据页还没有分配就分配一页. 
+// 由 getblk() 调用, 让虚拟盘的缓冲块直接使用这里返回的内存. 盘块超出虚拟盘大小或内存不够时返回 NULL, 
+// 此时缓冲块仍使用自己的数据块, 读写由 do_rd_request() 复制数据.
+char * rd_block(int dev, int block) {
+	return rd_addr(MINOR(dev), block, 1);
+}
 
 // 虚拟盘当前请求项操作函数.
 // 该函数的程序结构与硬盘的 do_hd_request() 函数类似. 
 // 在低级块设备接口函数 ll_rw_block() 建立起虚拟盘(rd)的请求项并添加到 rd 的链表中之后, 
 // 就会调用该函数对 rd 当前请求项进行处理.
-// 该函数首先计算当前请求项中指定起始扇区对应虚拟盘所处内存的起始位置 addr 和要求的扇区数对应的字节长度值 len, 
-// 然后根据请求项中的命令进行操作. 若是写命令 WRITE, 就把请求项所指缓冲区中的数据直接复制到内存位置 addr 处. 
-// 若是读操作作反之. 数据复制完成后即可直接调用 end_request() 对本次请求项作结束处理. 
+// 请求项中的数据按盘块逐块处理(读写页面的请求一次有 4 块, 而各块所在的数据页不一定相邻). 
+// 缓冲块直接指向虚拟盘内存时, 请求项缓冲区就是盘块本身, 不需要复制. 
+// 否则写命令把请求项缓冲区中的数据复制到盘块中, 读命令反之; 读还没有分配的盘块得到全 0. 
+// 这里不分配内存(请求处理函数不能睡眠), 写还没有分配的盘块按出错处理. 
+// 数据复制完成后即可直接调用 end_request() 对本次请求项作结束处理. 
 // 然后跳转到函数开始处再去处理下一个请求项. 若已没有请求项则退出.
 void do_rd_request(void) {
-	int	len;
-	char * addr;
+	int	block, nr, i;
+	char * addr, * buf;
 
 	// 首先检测请求项的合法性, 若已没有请求项则退出(参见 blk.h). 
-	// 然后计算请求项处理的虚拟盘中起始扇区在物理内存中对应的地址 addr 和占用的内存字节长度值 len. 
-	// 下句用于取得请求项中的起始扇区对应的内存起始位置和内存长度. 其中 sector<<9 表示 sector * 512, 换算成字节值. 
 	// CURRENT 被定义为(blk_dev[MAJOR_NR].current_request).
-	INIT_REQUEST;
-	addr = rd_start + (CURRENT->sector << 9);
-	len = CURRENT->nr_sectors << 9;
-	// 如果当前请求项中子设备号不为 1 或者对应内存起始位置大于虚拟盘末尾, 则结束该请求项, 
-	// 并跳转到 repeat 处去处理下一个虚拟盘请求项. 
 	// 标号 repeat 定义在宏 INIT_REQUEST 内, 位于宏的开始处, 参见 blk.h 文件. 
-	if ((MINOR(CURRENT->dev) != 1) || (addr + len > rd_start + rd_length)) {
-		end_request(0);
-		goto repeat;
-	}
-	// 然后进行实际的读写操作. 如果是写命令(WRITE), 则将请求项中缓冲区的内容复制到地址 addr 处, 长度为 len 字节. 
-	// 如果是读命令(READ), 则将 addr 开始的内存内容复制到请求项缓冲区中, 长度为 len 字节. 否则显示命令不存在, 死机. 
-	if (CURRENT-> cmd == WRITE) {
-		(void)memcpy(addr, CURRENT->buffer, len);
-	} else if (CURRENT->cmd == READ) {
-		(void)memcpy(CURRENT->buffer, addr, len);
-	} else {
+	INIT_REQUEST;
+	if (CURRENT->cmd != WRITE && CURRENT->cmd != READ) {
 		panic("unknown ramdisk-command");
 	}
-	// 然后在请求项成功后处理, 置更新标志. 并继续处理本设备的下一请求项. 
-	end_request(1);
+	block = CURRENT->sector >> 1;
+	nr = CURRENT->nr_sectors >> 1;
+	buf = CURRENT->buffer;
+	for (i = 0; i < nr; i++, block++, buf += BLOCK_SIZE) {
+		// 如果盘块超出虚拟盘末尾(包括子设备号无效), 则结束该请求项, 并跳转到 repeat 处去处理下一个虚拟盘请求项. 
+		if (MINOR(CURRENT->dev) <= 0 || MINOR(CURRENT->dev) >= NR_RD || block >= rd_sizes[MINOR(CURRENT->dev)]) {
+			break;
+		}
+		addr = rd_addr(MINOR(CURRENT->dev), block, 0);
+		if (addr == buf) {					// 缓冲块直接指向虚拟盘, 数据已经在盘上.
+			continue;
+		}
+		if (CURRENT->cmd == WRITE) {
+			if (!addr) {
+				break;
+			}
+			(void)memcpy(addr, buf, BLOCK_SIZE);
+		} else if (addr) {
+			(void)memcpy(buf, addr, BLOCK_SIZE);
+		} else {
+			(void)memset(buf, 0, BLOCK_SIZE);
+		}
+	}
+	// 然后在请求项处理后置更新标志. 并继续处理本设备的下一请求项. 
+	end_request(i == nr);
 	goto repeat;
 }
 
-/*
- * Returns amount of memory which needs to be reserved.
- */
-/* 返回内存虚拟盘 ramdisk 所需的内存量 */
 // 虚拟盘初始化函数.
-// 该函数首先设置虚拟盘设备的请求项处理函数指针指向 do_rd_request(), 
-// 然后确定虚拟盘在物理内存中的起始地址, 占用字节长度值. 并对整个虚拟盘区清零. 最后返回盘区长度. 
-// 当 linux/Makefile 文件中设置过 RAMDISK 值不为零时, 表示系统中会创建 RAM 虚拟盘设备. 
-// 在这种情况下的内核初始化过程中, 本函数就会被调用(init/main.c). 
-// 该函数在第 2 个参数 length 会被赋值成 RAMDISK * 1024, 单位为字节.
-long rd_init(long mem_start, int length) {
-	int	i;
-	char * cp;
-
+// 该函数设置虚拟盘设备的请求项处理函数指针指向 do_rd_request(), 以及各子设备的大小数组. 
+// 虚拟盘的内存在用到时才按页分配, 所以这里不再预留任何内存. 
+// 当 linux/Makefile 文件中设置过 RAMDISK 值不为零时, 参数 length 会被赋值成 RAMDISK * 1024(单位为字节), 
+// 作为根文件系统虚拟盘(子设备 1)的初始大小; 否则为 0, 需要时可以用 ioctl(RDSETSIZE) 设置(init/main.c).
+void rd_init(int length) {
 	blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;
-	rd_start = (char *)mem_start;
-	rd_length = length;
-	cp = rd_start;
-	// 将内存空间清零
-	for (i = 0; i < length; i++) {
-		*cp++ = '\0';
+	blk_size[MAJOR_NR] = rd_sizes;
+	rd_sizes[1] = length >> BLOCK_SIZE_BITS;
+	if (rd_sizes[1] > RD_MAX_SIZE) {
+		rd_sizes[1] = RD_MAX_SIZE;
+	}
+}
+
+// 修改虚拟盘 nr 的大小为 size 块. 缩小时先检查虚拟盘没有被安装, 其缓冲块也都没有被使用, 
+// 然后让该设备的缓冲块都恢复使用自己的数据块并作废, 再释放新大小以外的数据页; 大小变为 0 时连索引页一起释放. 
+// 成功返回 0, 虚拟盘正在使用则返回 -EBUSY.
+static int rd_resize(int dev, int size) {
+	struct buffer_head * bh;
+	unsigned long * index;
+	int nr = MINOR(dev), i;
+
+	if (size < rd_sizes[nr]) {
+		if (get_super(dev)) {
+			return -EBUSY;
+		}
+		for (i = 0, bh = start_buffer; i < NR_BUFFERS; i++, bh++) {
+			if (bh->b_dev == dev && (bh->b_count || bh->b_lock)) {
+				return -EBUSY;
+			}
+		}
+		for (i = 0, bh = start_buffer; i < NR_BUFFERS; i++, bh++) {
+			if (bh->b_dev == dev) {
+				bh->b_uptodate = bh->b_dirt = 0;
+				bh->b_data = bh->b_buf;
+			}
+		}
+		if (index = (unsigned long *) rd_index[nr]) {
+			for (i = (size + RD_BLOCKS_PER_PAGE - 1) / RD_BLOCKS_PER_PAGE; i < PAGE_SIZE / 4; i++) {
+				if (index[i]) {
+					free_page(index[i]);
+					index[i] = 0;
+				}
+			}
+			if (!size) {
+				free_page(rd_index[nr]);
+				rd_index[nr] = 0;
+			}
+		}
+	}
+	rd_sizes[nr] = size;
+	return 0;
+}
+
+// 虚拟盘的输入输出控制函数(fs/ioctl.c). 参数 dev 是设备号, cmd 是命令码, arg 是参数. 
+// RDGETSIZE 把虚拟盘大小(KB)存放到用户空间 arg 处; RDSETSIZE 把虚拟盘大小设置为 arg KB, 只有超级用户可以设置. 
+// 成功返回 0, 否则返回出错码.
+int rd_ioctl(int dev, int cmd, int arg) {
+	if (MINOR(dev) <= 0 || MINOR(dev) >= NR_RD) {
+		return -ENODEV;
+	}
+	switch (cmd) {
+		case RDGETSIZE:
+			verify_area((void *) arg, 4);
+			put_fs_long(rd_sizes[MINOR(dev)], (unsigned long *) arg);
+			return 0;
+		case RDSETSIZE:
+			if (!suser()) {
+				return -EPERM;
+			}
+			if (arg < 0 || arg > RD_MAX_SIZE) {
+				return -EINVAL;
+			}
+			return rd_resize(dev, arg);
+		default:
+			return -EINVAL;
 	}
-	return(length);
 }
 
 /*
@@ -119,12 +238,13 @@ void rd_load(void) {
 	int		i = 1;
 	int		nblocks;									// 文件系统盘块总数.
 	char	* cp;										/* Move pointer */
+	unsigned long start;								// 开始加载时的嘀嗒数, 用于显示加载用时.
 
 	// 首先检查虚拟盘的有效性和完整性. 如果 ramdisk 的长度为零, 则退出. 
 	// 否则显示 ramdisk 的大小以及内存起始位置. 如果此时根文件设备不是软盘设备, 则也退出.
-	if (!rd_length) return;
+	if (!rd_sizes[1]) return;
 
-	printk("Ram disk: %d bytes, starting at 0x%x, dev = 0x%x \n", rd_length, (int)rd_start, ROOT_DEV);
+	printk("Ram disk: %d bytes, dev = 0x%x \n", rd_sizes[1] << BLOCK_SIZE_BITS, ROOT_DEV);
 	if (MAJOR(ROOT_DEV) != 2) {
 		return;
 	}
@@ -152,19 +272,20 @@ void rd_load(void) {
 	// 即 nblocks = (s_nzones * 2^s_log_zone_size). 
 	// 如果遇到文件系统中数据块总数大于内存虚拟盘所能容纳的块数的情况, 则不能执行加载操作, 而只能显示出错信息并返回.
 	nblocks = s.s_nzones << s.s_log_zone_size;
-	if (nblocks > (rd_length >> BLOCK_SIZE_BITS)) {
-		printk("Ram disk image too big! (%d blocks, %d avail)\n", nblocks, rd_length >> BLOCK_SIZE_BITS);
+	if (nblocks > rd_sizes[1]) {
+		printk("Ram disk image too big! (%d blocks, %d avail)\n", nblocks, rd_sizes[1]);
 		return;
 	}
-	// 若虚拟盘能容纳得下文件系统总数据块数, 则我们显示加载数据信息, 并让 cp 指向内存虚拟盘起始处, 
+	// 若虚拟盘能容纳得下文件系统总数据块数, 则我们显示加载数据信息, 
 	// 然后开始执行循环操作将磁盘上根文件系统映像加载到虚拟盘上. 
 	// 在操作过程中, 如果一次需要加载的盘块数大于 2 块, 我们就是用超前预读函数 breada(), 
 	// 否则就使用 bread() 函数进行单块读取. 
 	// 若在读盘过程中出现 I/O 操作错误, 就只能放弃加载过程返回. 
-	// 所读取的磁盘块会使用 memcpy() 函数从高速缓冲区中复制到内存虚拟盘相应位置处, 同时显示已加载的块数.
+	// 所读取的磁盘块会使用 memcpy() 函数从高速缓冲区中复制到内存虚拟盘相应盘块处(数据页在此时分配), 同时显示已加载的块数.
+	// 内存不够时也放弃加载.
 	// 显示字符串中的八进制数 '\010' 表示显示一个制表符.
 	printk("Loading %d bytes into ram disk... (0k)", nblocks << BLOCK_SIZE_BITS);
-	cp = rd_start;
+	start = jiffies;
 	while (nblocks) {
 		if (nblocks > 2) { 								// 若读取块数多于 2 块则采用超前预读.
 			bh = breada(ROOT_DEV, block, block + 1, block + 2, -1);
@@ -175,14 +296,19 @@ void rd_load(void) {
 			printk("I/O error on block %d, aborting load\n", block);
 			return;
 		}
+		if (!(cp = rd_block(0x0101, i - 1))) {			// 虚拟盘上对应盘块的地址.
+			brelse(bh);
+			printk("Out of memory on block %d, aborting load\n", block);
+			return;
+		}
 		(void)memcpy(cp, bh->b_data, BLOCK_SIZE);		// 复制到 cp 处.
 		brelse(bh);
-		cp += BLOCK_SIZE;								// 虚拟盘指针前移.
 		block++;
 		nblocks--;
 		i++;
 	}
 	// 当 boot 盘中从 256 盘块开始的整个文件系统加载完毕后, 
-	// 我们显示 "done", 并把目前根文件设备号修改成虚拟盘的设备号 0x0101, 返回.
+	// 我们显示 "done" 和加载用时(用于衡量软盘磁道缓存的效果), 并把目前根文件设备号修改成虚拟盘的设备号 0x0101, 返回.
+	printk(" done in %d ms\n", (jiffies - start) * 1000 / HZ);
 	ROOT_DEV = 0x0101;
 }
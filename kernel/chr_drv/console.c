@@ -114,6 +114,15 @@ static unsigned short	video_port_reg;		/* Video register select port	*/	// 显
 static unsigned short	video_port_val;		/* Video register value port	*/	// 显示控制数据寄存器端口.
 static int 				can_do_colour = 0;										// 标志: 可使用彩色功能.
 
+// EGA/VGA 上前台控制台独占全部显示内存, 后台控制台的屏幕内容保存在各自的内存页中(切换控制台时互相复制).
+// 这样前台控制台整屏滚动时只需移动显示控制器的起始地址, 大约每滚动半个显示内存才需要复制一次屏幕;
+// 而原点 origin 之前的显示内存中保留着滚出屏幕的行, 可用 Shift+PgUp/PgDn 回滚查看.
+static int				hw_scroll = 0;											// 标志: 采用上述前台独占显示内存的方式.
+static int				vga_console = 0;										// 内容位于显示内存中的控制台号.
+static int				scrollback = 0;											// 前台画面向回滚动的行数, 0 表示显示当前画面.
+static volatile int		console_busy = 0;										// 正在写控制台的嵌套层数.
+static volatile int		switch_pending = 0;										// 标志: 推迟了的控制台切换.
+
 // 虚拟控制台结构. 包含一个虚拟控制台的当前所有信息. 
 // 其中 vc_origin 和 vc_scr_end 是当前正在处理的虚拟控制台执行快速滚屏操作时使用的起始行和末行对应的显示内存位置. 
 // vc_video_mem_start 和 vc_video_meme_end 是当前虚拟控制台使用的显示内存区域部分.
@@ -138,6 +147,9 @@ static struct {
 	unsigned int	vc_saved_y;													// 保存的光标行号.
 	unsigned int	vc_iscolor;													// 彩色显示标志.
 	char *			vc_translate;												// 使用的字符集.
+	unsigned long	vc_screenbuf;												// 在后台时保存屏幕内容的内存页.
+	unsigned long	vc_histbuf;													// 在后台时保存滚出屏幕的行的内存页(循环使用).
+	unsigned long	vc_hist_head, vc_hist_lines;								// histbuf 中最早一行的行号; 已保存的行数.
 } vc_cons [MAX_CONSOLES];
 
 // 为了便于引用, 以下定义当前正在处理控制台信息的符号. 含义同上. 
@@ -164,6 +176,11 @@ static struct {
 #define def_attr				(vc_cons[currcons].vc_def_attr) 				// 默认字符属性
 #define video_erase_char  		(vc_cons[currcons].vc_video_erase_char)
 #define iscolor					(vc_cons[currcons].vc_iscolor)
+#define screenbuf				(vc_cons[currcons].vc_screenbuf)
+#define histbuf					(vc_cons[currcons].vc_histbuf)
+#define hist_head				(vc_cons[currcons].vc_hist_head)
+#define hist_lines				(vc_cons[currcons].vc_hist_lines)
+#define HIST_SIZE				(PAGE_SIZE / video_size_row)					// histbuf 能容纳的行数.
 
 int blankinterval = 0;															// 设定的屏幕黑屏间隔时间.
 int blankcount = 0;																// 黑屏时间计数.
@@ -215,158 +232,201 @@ static inline void gotoxy(int currcons, int new_x, unsigned int new_y) {
 	pos = origin + y * video_size_row + (x << 1);	// 1 列用 2 个字节表示, 所以 x<<1.
 }
 
+// 设置显示控制器的显示起始地址(r12, r13). 参数 addr 是显示内存中的地址.
+// 向右移动 9 位, 实际上表示向右移动 8 位再除以 2(因为 1 个字符用 2 字节表示); 向右移动 1 位表示除以 2.
+// 输出值相对于默认显示内存起始位置 video_mem_base 进行操作. 例如对于 EGA/VGA 彩色模式, viedo_mem_base = 物理内存地址 0xb8000.
+static inline void set_start(unsigned long addr) {
+	cli();																// 关闭中断
+	outb_p(12, video_port_reg);											// 选择数据寄存器 r12, 输出滚屏起始位置高字节.
+	outb_p(0xff & ((addr - video_mem_base) >> 9), video_port_val);
+	outb_p(13, video_port_reg);											// 选择数据寄存器 r13, 输出滚屏起始位置低字节.
+	outb_p(0xff & ((addr - video_mem_base) >> 1), video_port_val);
+	sti(); 																// 开中断
+}
+
 // 设置滚屏起始显示内存地址.
 static inline void set_origin(int currcons) {
 	// 首先判断显示卡类型. 对于 EGA/VGA, 我们可以指定屏内范围(区域)进行滚屏操作, 而 MDA 单色显示卡只能进行整屏滚屏操作. 
 	// 因此只有 EGA/VGA 卡才需要设置滚屏起始行显示内存地址(起始行是 origin 对应的行). 
 	// 即显示类型如果不是 EGA/VGA 彩色模式, 也不是 EGA/VGA 单色模式, 那么就直接返回. 
-	// 另外, 我们只对前台控制台进行操作, 因此当前控制台 currocons 必须是前台控制台时, 我们才需要设置其滚屏起始行对应的内存起点位置.
+	// 另外, 我们只对内容位于显示内存中的前台控制台进行操作, 其他控制台直接返回.
+	// 设置原点总是回到当前画面, 因此同时取消回滚.
 	if (video_type != VIDEO_TYPE_EGAC && video_type != VIDEO_TYPE_EGAM) {
 		return;
 	}
-	if (currcons != fg_console) {
+	if (currcons != vga_console) {
 		return;
 	}
-	// 然后向显示寄存器选择端口 video_port_reg 输出 12, 即选择显示控制数据寄存器 r12, 接着写入滚屏起始地址高字节. 
-	// 其中向右移动 9 位, 实际上表示向右移动 8 位再除以 2(因为 1 个字符用 2 字节表示). 
-	// 再选择显示控制数据寄存器 r13, 然后写入滚屏起始地址低字节. 
-	// 向右移动 1 位表示除以 2, 同样代表屏幕上 1 个字符用 2 字节表示. 
-	// 输出值相对于默认显示内存起始位置 video_mem_base 进行操作.
-	// 例如对于 EGA/VGA 彩色模式, viedo_mem_base = 物理内存地址 0xb8000.
-	cli();																// 关闭中断
-	outb_p(12, video_port_reg);											// 选择数据寄存器 r12, 输出滚屏起始位置高字节.
-	outb_p(0xff & ((origin - video_mem_base) >> 9), video_port_val);
-	outb_p(13, video_port_reg);											// 选择数据寄存器 r13, 输出滚屏起始位置低字节.
-	outb_p(0xff & ((origin - video_mem_base) >> 1), video_port_val);
-	sti(); 																// 开中断
+	scrollback = 0;
+	set_start(origin);
+}
+
+// 在显示内存(或保存屏幕的内存页)中复制 count 个字(字符及属性). 源和目的区域可以重叠.
+static inline void scr_copy(unsigned long to, unsigned long from, int count) {
+	int d0, d1, d2;
+
+	if (to <= from) {
+		__asm__ __volatile__("cld\n\t"
+			"rep\n\t"
+			"movsw"
+			: "=c" (d0), "=D" (d1), "=S" (d2)
+			: "0" (count), "1" (to), "2" (from)
+			: "memory"
+		);
+	} else {												// 目的在源之后, 从末尾反向复制.
+		__asm__ __volatile__("std\n\t"
+			"rep\n\t"
+			"movsw\n\t"
+			"cld"
+			: "=c" (d0), "=D" (d1), "=S" (d2)
+			: "0" (count), "1" (to + (count << 1) - 2), "2" (from + (count << 1) - 2)
+			: "memory"
+		);
+	}
+}
+
+// 用擦除字符填写从 to 开始的一行.
+static inline void scr_clear_row(int currcons, unsigned long to) {
+	int d0, d1;
+
+	__asm__ __volatile__("cld\n\t"
+		"rep\n\t"
+		"stosw"
+		: "=c" (d0), "=D" (d1)
+		: "a" (video_erase_char), "0" (video_num_columns), "1" (to)
+		: "memory"
+	);
+}
+
+// 判断能否只移动显示起始地址来滚屏: 必须是 EGA/VGA, 而且控制台占用的显示内存比一屏至少多一行.
+// 前台控制台在 hw_scroll 方式下占用全部显示内存; 保存在内存页中的后台控制台只有一屏, 因此不能.
+static inline int can_hw_scroll(int currcons) {
+	if (video_type != VIDEO_TYPE_EGAC && video_type != VIDEO_TYPE_EGAM) {
+		return 0;
+	}
+	return video_mem_end - video_mem_start >= (video_num_lines + 1) * video_size_row;
+}
+
+// 当屏幕已到达控制台显示内存末端时, 把屏幕连同其上方最多一半空闲区域的已滚出行一起复制到显示内存开始处.
+// 保留的历史行可供回滚查看, 其余一半空间则留给以后的滚屏, 因此平均每滚动 (空闲行数 / 2) 行才复制一次.
+static void scr_rebase(int currcons) {
+	unsigned long keep, delta;
+
+	keep = ((video_mem_end - video_mem_start) / video_size_row - video_num_lines) >> 1;
+	if (keep > (origin - video_mem_start) / video_size_row) {
+		keep = (origin - video_mem_start) / video_size_row;
+	}
+	delta = origin - keep * video_size_row - video_mem_start;
+	if (!delta) {
+		return;
+	}
+	scr_copy(video_mem_start, origin - keep * video_size_row, (keep + video_num_lines) * video_num_columns);
+	origin -= delta;
+	scr_end -= delta;
+	pos -= delta;
+}
+
+// 把保存在内存页中的后台控制台即将滚出屏幕顶端的一行(origin 处)存入其历史行缓冲 histbuf 中.
+// histbuf 循环使用, 存满后覆盖最早的一行.
+static void hist_push(int currcons) {
+	unsigned long n;
+
+	n = (hist_head + hist_lines) % HIST_SIZE;
+	scr_copy(histbuf + n * video_size_row, origin, video_num_columns);
+	if (hist_lines < HIST_SIZE) {
+		hist_lines++;
+	} else {
+		hist_head = (hist_head + 1) % HIST_SIZE;
+	}
 }
 
 // 显示内容向上滚动一行
 // 将屏幕滚动窗口向上移动一行, 并在屏幕滚动区域底出现的新行上添加空格字符. 滚屏区域必须大于 1 行.
 static void scrup(int currcons) {
 	// 滚屏区域必须至少有 2 行. 如果滚屏区域顶行号大于等于区域底行号, 则不满足进行滚行操作的条件. 
-	// 另外, 对于 EGA/VGA 卡, 我们可以指定屏内行范围(区域)进行滚屏操作, 而 MDA 单色显示卡只能进行整屏操作. 
-	// 该函数对 EGA 和 MDA 显示类型进行分别处理. 
-	// 如果显示类型是 EGA, 则还分为整屏窗口移动和区域内窗口移动这里首先处理显示卡是 EGA/VGA 显示类型的情况.
 	if (bottom <= top) {
 		return;
 	}
-	if (video_type == VIDEO_TYPE_EGAC || video_type == VIDEO_TYPE_EGAM) {
-		// 如果移动起始行 top = 0, 移动最底行 bottom = video_num_lines = 25, 则表示整屏窗口向上移动, 
-		// 于是把整个屏幕窗口左上角对应的起始内存位置 origin 调整为向下移动一行对应的内存位置, 
-		// 同时也跟踪调整当前光标对应的内存位置以及屏幕末行末端字符指针 scr_end 的位置. 
-		// 最后把新屏幕窗口内存起始位置值 origin 写入显示控制器中
-		if (!top && bottom == video_num_lines) { 		// == 优先级大于 &&
-			origin += video_size_row; 				// 指向下一行
-			pos += video_size_row;
-			scr_end += video_size_row;
-			// 如果屏幕窗口末端所对应的显示内存指针 scr_end 超出了实际显示内存末端, 
-			// 则将屏幕内容除第一行以外所有行对应的内存数据移动到显示内存的起始位置 video_mem_start 处, 
-			// 并在整屏窗口向下移动出现的新行上填入空格字符. 
-			// 然后根据屏幕内存数据移动后的情况, 重新调整当前屏幕对应内存的起始指针, 光标位置指针和屏幕末端对应内存指针 scr_end.
-			if (scr_end > video_mem_end) {
-				// 这段嵌入汇编程序首先将(屏幕字符行数 - 1)行对应的内存数据移动到显示内存起始位置 video_mem_start 处, 
-				// 然后在随后的内存位置处添加一行空格(擦除)字符数据.
-				// %0 - eax(擦除字符 + 属性); %1 - ecx((屏幕字符行数 - 1) * 所对应的字符数 / 2, 以长字移动);
-				// %2 - edi(显示内存起始位置 video_mem_start); %3 - esi(屏幕窗口内存起始位置 origin).
-				// 移动方向: [edi] -> [esi], 移动 ecx 个长字.
-				__asm__("cld\n\t"								// 清方向位
-					"rep\n\t"									// 重复操作, 将当前屏幕内存数据移动到显示内存起始处
-					"movsl\n\t"
-					"movl video_num_columns, %1\n\t"
-					"rep\n\t"									// 在新行上填入空格字符
-					"stosw"
-					: : "a" (video_erase_char), "c" ((video_num_lines - 1) * video_num_columns >> 1),
-						"D" (video_mem_start), "S" (origin)
-				);
-				// 重新设置快速滚屏的末端位置
-				scr_end -= origin - video_mem_start;
-				// 设置当前显示位置
-				pos -= origin - video_mem_start;
-				// 重新设置快速滚屏的起始位置
-				origin = video_mem_start;
-			// 如果调整后的屏幕末端对应的内存指针 scr_end 没有超出显示内存的末端 video_mem_end, 
-			// 则只需在新行上填入擦除字符(空格字符).
-			// %0 - eax(擦除字符+属性); %1 - ecx(屏幕行数); %2 - edi(最后 1 行开始处对应内存位置);
-			} else {
-				__asm__("cld\n\t"
-					"rep\n\t"									// 重复操作, 在新出现现上填入擦除字符(空格字符).
-					"stosw"
-					: : "a" (video_erase_char), "c" (video_num_columns), "D" (scr_end - video_size_row)
-				);
-			}
-			// 然后把新屏幕滚动窗口内存起始位置值 origin 写入显示控制器中.
-			set_origin(currcons);
-		// 否则表示不是整屏移动. 即表示从指定行 top 开始到 bottom 区域中的所有行向上移动 1 行, 指定行 top 被删除. 
-		// 此时直接将屏幕从指定行 top 到屏幕末端所有行对应的显示内存数据向上移动 1 行, 并在最下面新出现的行上填入擦除字符.
-		// %0 - eax(擦除字符 + 属性); %1 - ecx(top 行下 1 行开始到 bottom 行所对应的内存长字数);
-		// %2 - edi(top 行所处的内存位置); %3 - esi(top + 1 行所处的内存位置).
-		} else {
-			__asm__("cld\n\t"
-				"rep\n\t"										// 循环操作, 将 top + 1 到 bottom 行所对应的内存块移到 top 行开始处.
-				"movsl\n\t"
-				"movl video_num_columns, %%ecx\n\t"
-				"rep\n\t"										// 在新行上填入擦除字符.
-				"stosw"
-				: : "a" (video_erase_char), "c" ((bottom - top - 1) * video_num_columns >> 1),
-					"D" (origin + video_size_row * top), "S" (origin + video_size_row * (top + 1))
-			);
+	// 对于 EGA/VGA, 若控制台有空余的显示内存, 则把显示起始地址 origin 下移一行来滚屏. 
+	// 对于区域内滚动, 这样做相当于整屏上移一行, 因此还要把区域之外不动的顶部 top 行和底部 (video_num_lines - bottom) 行
+	// 各自下移一行复原. 只有在这些不动的行比区域内需要移动的行(bottom - top - 1 行)少时才这样做, 整屏滚动时则总是这样做.
+	// 若屏幕末端已经到达显示内存末端, 先把屏幕(连同部分历史行)移回显示内存开始处.
+	if (can_hw_scroll(currcons) && top + video_num_lines - bottom < bottom - top - 1) {
+		if (scr_end + video_size_row > video_mem_end) {
+			scr_rebase(currcons);
 		}
-	// 如果显示类型不是 EGA(而是 MDA), 则执行下面移动操作. 
-	// 因为 MDA 显示控制卡只能整屏滚动, 并且会自动调整超出显示范围的情况, 即会自动翻巻指针, 
-	// 所以这里不对与屏幕内容相对应内存超出显示内存的情况单独处理处理方法与 EGA 非整屏移动情况完全一样.
-	} else {		/* Not EGA/VGA */
-		__asm__("cld\n\t"
-			"rep\n\t"
-			"movsl\n\t"
-			"movl video_num_columns, %%ecx\n\t"
-			"rep\n\t"
-			"stosw"
-			: : "a" (video_erase_char), "c" ((bottom - top - 1) * video_num_columns >> 1),
-				"D" (origin + video_size_row * top), "S" (origin + video_size_row * (top + 1))
-		);
+		if (bottom < video_num_lines) {
+			scr_copy(origin + (bottom + 1) * video_size_row, origin + bottom * video_size_row,
+				(video_num_lines - bottom) * video_num_columns);
+		}
+		if (top) {
+			scr_copy(origin + video_size_row, origin, top * video_num_columns);
+		}
+		origin += video_size_row; 					// 指向下一行
+		pos += video_size_row;
+		scr_end += video_size_row;
+		scr_clear_row(currcons, origin + (bottom - 1) * video_size_row);	// 在区域底部新出现的行上填入擦除字符.
+		// 然后把新屏幕滚动窗口内存起始位置值 origin 写入显示控制器中.
+		set_origin(currcons);
+		return;
+	}
+	// 否则直接将屏幕从指定行 top + 1 到 bottom - 1 所有行对应的显示内存数据向上移动 1 行, 指定行 top 被删除, 并在最下面新出现的行上填入擦除字符.
+	// MDA 和 CGA 显示卡, 以及保存在内存页中的后台控制台都采用这种方法. 后台控制台整屏滚动时, 先把滚出屏幕的行存入历史行缓冲.
+	// %0 - eax(擦除字符 + 属性); %1 - ecx(top 行下 1 行开始到 bottom 行所对应的内存长字数);
+	// %2 - edi(top 行所处的内存位置); %3 - esi(top + 1 行所处的内存位置).
+	if (!top && histbuf && video_mem_start == screenbuf) {
+		hist_push(currcons);
 	}
+	__asm__("cld\n\t"
+		"rep\n\t"										// 循环操作, 将 top + 1 到 bottom 行所对应的内存块移到 top 行开始处.
+		"movsl\n\t"
+		"movl video_num_columns, %%ecx\n\t"
+		"rep\n\t"										// 在新行上填入擦除字符.
+		"stosw"
+		: : "a" (video_erase_char), "c" ((bottom - top - 1) * video_num_columns >> 1),
+			"D" (origin + video_size_row * top), "S" (origin + video_size_row * (top + 1))
+	);
 }
 
 // 向下卷动一行
 // 将屏幕滚动窗口向上移动一行, 相应屏幕滚动区域内容向下移动 1 行. 并在移动开始行的上方出现一新行. 
-// 处理方法与 scrup() 相似, 只是为了在移动显示内存数据时不会出现数据覆盖的问题, 复制操作是以逆向进行的, 
+// 与 scrup() 相似, 若控制台有空余的显示内存, 并且原点之上还有空间, 则把显示起始地址 origin 上移一行, 
+// 再把区域之外不动的行各自上移一行复原. 被覆盖的是原点之上最近的一行历史行.
+// 否则移动显示内存数据. 为了在移动时不会出现数据覆盖的问题, 复制操作是以逆向进行的, 
 // 即先从屏幕倒数第 2 行的最后一个字符开始复制到最后一行, 再将倒数第 3 行复制到倒数第 2 行, 等等. 
-// 因为此时对 EGA/VGA 显示类型和 MDA 类型的处理过程完全一样, 所以该函数实际上没有必要写两段相同的代码. 
-// 即这里 if 和 else 语句块中的操作完全一样.
 static void scrdown(int currcons) {
 	// 同样, 滚屏区域必须至少有 2 行. 如果滚屏区域顶行号大于等于区域底行号, 则不满足进行滚行操作的条件. 
-	// 另外, 对于 EGA/VGA 卡, 我们可以指定屏内行范围(区域)进行滚屏操作, 而 MDA 单色显示卡只能进行整屏操作. 
-	// 由于窗口向上移动最多移动以当前控制台实际显示内存末端的情况, 所以这里只需要处理普通的内存数据移动情况.
 	if (bottom <= top) {
 		return;
 	}
-	if (video_type == VIDEO_TYPE_EGAC || video_type == VIDEO_TYPE_EGAM) {
-		// %0 - eax(擦除字符 + 属性); %1 - ecx(top 行到 bottom - 1 行所对应的内存长字数);
-		// %2 - edi(窗口右下角最后一个字长位置); %3 - esi(窗口倒数第 2 行最后一个长字位置).
-		__asm__("std\n\t"							// 置方向位!!
-			"rep\n\t"								// 重复操作, 向下移动从 top 行到 bottom - 1 行对应的内存数据
-			"movsl\n\t"
-			"addl $2, %%edi\n\t"					/* %edi has been decremented by 4 */ /* %edi 已减 4, 因也是反向填擦除字符 */
-			"movl video_num_columns, %%ecx\n\t"
-			"rep\n\t"								// 将擦除字符填入上方新行中.
-			"stosw"
-			: : "a" (video_erase_char), "c" ((bottom - top - 1) * video_num_columns >> 1),
-				"D" (origin + video_size_row * bottom - 4), "S" (origin + video_size_row * (bottom - 1) - 4)
-		);
-	// 如果不是 EGA 显示类型, 则执行以下操作(与上面完成一样).
-	} else {													/* Not EGA/VGA */
-		__asm__("std\n\t"
-			"rep\n\t"
-			"movsl\n\t"
-			"addl $2, %%edi\n\t"								/* %edi has been decremented by 4 */
-			"movl video_num_columns, %%ecx\n\t"
-			"rep\n\t"
-			"stosw"
-			: : "a" (video_erase_char), "c" ((bottom - top - 1) * video_num_columns >> 1),
-				"D" (origin + video_size_row * bottom - 4), "S" (origin + video_size_row * (bottom - 1) - 4)
-		);
+	if (can_hw_scroll(currcons) && origin >= video_mem_start + video_size_row
+		&& top + video_num_lines - bottom < bottom - top - 1) {
+		if (top) {
+			scr_copy(origin - video_size_row, origin, top * video_num_columns);
+		}
+		if (bottom < video_num_lines) {
+			scr_copy(origin + (bottom - 1) * video_size_row, origin + bottom * video_size_row,
+				(video_num_lines - bottom) * video_num_columns);
+		}
+		origin -= video_size_row;
+		pos -= video_size_row;
+		scr_end -= video_size_row;
+		scr_clear_row(currcons, origin + top * video_size_row);		// 在区域顶部新出现的行上填入擦除字符.
+		set_origin(currcons);
+		return;
 	}
+	// %0 - eax(擦除字符 + 属性); %1 - ecx(top 行到 bottom - 1 行所对应的内存长字数);
+	// %2 - edi(窗口右下角最后一个字长位置); %3 - esi(窗口倒数第 2 行最后一个长字位置).
+	__asm__("std\n\t"							// 置方向位!!
+		"rep\n\t"								// 重复操作, 向下移动从 top 行到 bottom - 1 行对应的内存数据
+		"movsl\n\t"
+		"addl $2, %%edi\n\t"					/* %edi has been decremented by 4 */ /* %edi 已减 4, 因也是反向填擦除字符 */
+		"movl video_num_columns, %%ecx\n\t"
+		"rep\n\t"								// 将擦除字符填入上方新行中.
+		"stosw"
+		: : "a" (video_erase_char), "c" ((bottom - top - 1) * video_num_columns >> 1),
+			"D" (origin + video_size_row * bottom - 4), "S" (origin + video_size_row * (bottom - 1) - 4)
+	);
 }
 
 // 实现换行操作, 光标在同列位置下移一行.
@@ -563,9 +623,9 @@ void csi_m(int currcons) {
 // 根据光标对应显示内存位置 pos, 设置显示控制器光标的显示位置.
 static inline void set_cursor(int currcons) {
 	// 既然我们需要设置显示光标, 说明有键盘操作, 因此需要恢复进行黑屏操作的延时计数值.
-	// 另外, 显示光标的控制台必须是当前控制台, 因此若当前处理的台号 currcons 不是前台控制台就立刻返回.
+	// 另外, 显示光标的控制台必须是当前控制台, 因此若当前处理的台号 currcons 不是内容位于显示内存中的前台控制台就立刻返回.
 	blankcount = blankinterval;						// 复位黑屏操作的计数值.
-	if (currcons != fg_console) {
+	if (currcons != vga_console) {
 		return;
 	}
 	// 然后使用索引寄存器端口选择显示控制数据寄存器 r14(光标当前显示位置高字节), 
@@ -776,12 +836,55 @@ static void restore_cur(int currcons) {
 //             若收到的字符是 'B', 这选择普通 ASCII 字符集作为 G0 和 G1 的字符集.
 enum { ESnormal, ESesc, ESsquare, ESgetpars, ESgotpars, ESfunckey, ESsetterm, ESsetgraph };
 
+// 批量显示写队列中连续的普通显示字符(32 <= c < 127).
+// 从队列尾部开始, 在不超出当前行末尾的范围内逐个扫描字符, 直接把 "属性:字符" 字写入显示内存,
+// 遇到控制字符, 扩展字符, 或已取 count 个字符时停止. 然后一次性更新队列尾指针, 光标列号 x 和显示内存位置 pos.
+// 这样一串普通字符不必每个都经过 GETCH() 和状态机的分支. 行末折行仍由 con_write() 中的逐字符路径处理.
+// 返回已显示的字符数. 当前光标已在行末或第 1 个字符就不是普通显示字符时返回 0.
+static int con_write_run(int currcons, struct tty_queue * queue, int count) {
+	unsigned short * p = (unsigned short *) pos;
+	unsigned long t = queue->tail;
+	unsigned short a = attr << 8;
+	int n = 0;
+	unsigned char c;
+
+	if (x >= video_num_columns) {
+		return 0;
+	}
+	if (count > video_num_columns - x) {
+		count = video_num_columns - x;
+	}
+	while (n < count) {
+		c = queue->buf[t];
+		if (c < 32 || c >= 127) {
+			break;
+		}
+		*p++ = a | (unsigned char) translate[c - 32];
+		t = (t + 1) & (queue->size - 1);
+		n++;
+	}
+	queue->tail = t;
+	pos += n << 1;
+	x += n;
+	return n;
+}
+
+// 写控制台结束时调用. 有新的输出时让回滚中的前台画面回到当前画面; 然后执行写控制台期间被推迟的控制台切换.
+static void con_write_done(int currcons) {
+	if (scrollback && currcons == vga_console) {
+		set_origin(currcons);
+	}
+	if (!--console_busy && switch_pending) {
+		update_screen();
+	}
+}
+
 // 控制台写函数
 // 从终端对应的 tty 写缓冲队列(write_q)中取字符针对每个字符进行分析. 
 // 若是控制字符或转义或控制序列, 则进行光标定位, 字符删除等的控制处理; 对于普通字符就直接在光标处显示.
 // 参数: tty 是当前控制台使用的 tty 结构指针.
 void con_write(struct tty_struct * tty) {
-	int nr;
+	int nr, n;
 	char c;
 	int currcons;
 
@@ -797,11 +900,17 @@ void con_write(struct tty_struct * tty) {
 		panic("con_write: illegal tty");
 	}
 
+	console_busy++;													// 写控制台期间推迟控制台切换, 见 update_screen().
 	nr = CHARS(tty->write_q);										// 取写队列中字符数, 在 tty.h 文件中
 	while (nr--) {
 		if (tty->stopped) {
 			break;
 		}
+		// 处于正常状态时, 先把队列头部连续的普通显示字符成批写入显示内存(已取走的字符从 nr 中扣除).
+		if (state == ESnormal && (n = con_write_run(currcons, tty->write_q, nr + 1))) {
+			nr -= n - 1;
+			continue;
+		}
 		GETCH(tty->write_q, c);										// 取 1 字符到 c 中
 		if (c == 24 || c == 26)	{									// 控制字符 CAN, SUB - 取消, 替换
 			state = ESnormal;
@@ -1122,6 +1231,7 @@ void con_write(struct tty_struct * tty) {
         }
     }
 	set_cursor(currcons);									// 最后根据上面设置的光标位置, 设置显示控制器中光标位置.
+	con_write_done(currcons);
 }
 
 /*
@@ -1265,6 +1375,39 @@ void con_init(void) {
 		video_mem_end = (term += video_memory); 							// 设置该控制台的显存结束地址.
 		gotoxy(currcons, 0, 0);                           					// 光标都初始化在屏幕左上角位置(0, 0).
 	}
+	// 对于 EGA/VGA, 若一屏内容不超过一页内存, 并且显示内存除了一屏和一页历史行之外还有空余, 
+	// 就为每个控制台分配保存屏幕内容和历史行的两页内存, 改用前台控制台独占全部显示内存的 hw_scroll 方式. 
+	// 0 号控制台在前台, 改为占用全部显示内存; 其余控制台改到各自的内存页中, 并清屏.
+	// 只要有一页内存分配不到, 就释放已分配的页面, 仍按上面的方式分割显示内存.
+	if ((video_type == VIDEO_TYPE_EGAC || video_type == VIDEO_TYPE_EGAM)
+		&& video_num_lines * video_size_row <= PAGE_SIZE
+		&& video_mem_term - video_mem_base >= (HIST_SIZE + video_num_lines + 1) * video_size_row) {
+		for (currcons = 0; currcons < NR_CONSOLES; currcons++) {
+			if (!(screenbuf = get_free_page()) || !(histbuf = get_free_page())) {
+				break;
+			}
+		}
+		if (currcons < NR_CONSOLES) {
+			for (currcons = 0; currcons < NR_CONSOLES; currcons++) {
+				if (screenbuf) {
+					free_page(screenbuf);
+				}
+				if (histbuf) {
+					free_page(histbuf);
+				}
+				screenbuf = histbuf = 0;
+			}
+		} else {
+			hw_scroll = 1;
+			vc_cons[0].vc_video_mem_end = video_mem_term;
+			for (currcons = 1; currcons < NR_CONSOLES; currcons++) {
+				origin = video_mem_start = screenbuf;
+				scr_end = video_mem_end = screenbuf + video_num_lines * video_size_row;
+				gotoxy(currcons, 0, 0);
+				csi_J(currcons, 2);
+			}
+		}
+	}
 	// 最后设置当前前台控制台的屏幕原点(左上角)位置和显示控制器中光标显示位置, 
 	// 并设置键盘中断 0x21 陷阱门描述符(&keyboard_inierrupt 是键盘中断处理过程地址). 
 	// 然后取消中断控制芯片 8259A 中对键盘中断的屏蔽, 允许响应键盘发出的 IRQ1 请求信号. 
@@ -1277,14 +1420,92 @@ void con_init(void) {
 	outb_p(a, 0x61);														// 再允许键盘工作, 用以复位键盘.
 }
 
+// 把控制台 currcons 的内容从显示内存移到它的内存页中: 屏幕内容存入 screenbuf, 原点之上最近的历史行存入 histbuf.
+// 然后把该控制台的各个显示内存位置变量改为指向 screenbuf.
+static void save_screen(int currcons) {
+	unsigned long n;
+
+	n = (origin - video_mem_start) / video_size_row;
+	if (n > HIST_SIZE) {
+		n = HIST_SIZE;
+	}
+	scr_copy(histbuf, origin - n * video_size_row, n * video_num_columns);
+	hist_head = 0;
+	hist_lines = n;
+	scr_copy(screenbuf, origin, video_num_lines * video_num_columns);
+	pos = screenbuf + (pos - origin);
+	origin = video_mem_start = screenbuf;
+	scr_end = video_mem_end = screenbuf + video_num_lines * video_size_row;
+}
+
+// 把控制台 currcons 的内容从它的内存页移到显示内存中: 先按从早到晚的顺序复制历史行, 紧接着复制屏幕内容.
+// 该控制台随后占用全部显示内存.
+static void restore_screen(int currcons) {
+	unsigned long n, to = video_mem_base;
+
+	n = HIST_SIZE - hist_head;
+	if (n > hist_lines) {
+		n = hist_lines;
+	}
+	scr_copy(to, histbuf + hist_head * video_size_row, n * video_num_columns);
+	to += n * video_size_row;
+	scr_copy(to, histbuf, (hist_lines - n) * video_num_columns);
+	to += (hist_lines - n) * video_size_row;
+	scr_copy(to, screenbuf, video_num_lines * video_num_columns);
+	pos = to + (pos - origin);
+	origin = to;
+	scr_end = to + video_num_lines * video_size_row;
+	video_mem_start = video_mem_base;
+	video_mem_end = video_mem_term;
+	hist_lines = 0;
+}
+
 // 更新当前控制台.
 // 把前台控制台转换为 fg_console 指定的虚拟控制台. fg_console 是设置的前台虚拟控制台号.
 // fg_console 变量在 tty.h 头文件中定义, 用来启动后默认使用的显示终端
+// 在 hw_scroll 方式下还要交换原前台控制台和新前台控制台的内容. 由于内容交换会改变控制台的显示内存位置变量,
+// 因此若此时(在键盘中断中)正有控制台写操作在进行, 则只设置推迟标志, 由写操作结束时再调用本函数.
 void update_screen(void) {
+	if (console_busy) {
+		switch_pending = 1;
+		return;
+	}
+	switch_pending = 0;
+	if (hw_scroll && vga_console != fg_console) {
+		cli();
+		save_screen(vga_console);
+		restore_screen(fg_console);
+		sti();
+	}
+	vga_console = fg_console;
 	set_origin(fg_console);													// 设置滚屏起始显示内存地址.
 	set_cursor(fg_console);													// 设置显示控制器中光标显示内存位置.
 }
 
+// 回滚前台控制台画面. 由键盘中断处理程序在按下 Shift+PgUp(dir = 1) 或 Shift+PgDn(dir = -1) 时调用.
+// 每次滚动半屏, 最多回滚到前台控制台显示内存的开始处. 这里只改变显示控制器的起始地址, 不改变控制台的状态,
+// 光标所在行滚出画面后显示控制器自然不再显示光标. 控制台再有输出或滚屏时画面回到当前画面.
+void console_scrollback(int dir) {
+	int currcons = vga_console;
+	int max;
+
+	if (video_type != VIDEO_TYPE_EGAC && video_type != VIDEO_TYPE_EGAM) {
+		return;
+	}
+	if (currcons != fg_console) {
+		return;
+	}
+	max = (origin - video_mem_start) / video_size_row;
+	scrollback += dir * (int) (video_num_lines >> 1);
+	if (scrollback > max) {
+		scrollback = max;
+	}
+	if (scrollback < 0) {
+		scrollback = 0;
+	}
+	set_start(origin - scrollback * video_size_row);
+}
+
 /* from bsd-net-2: */
 
 // 停止蜂鸣
@@ -1359,6 +1580,7 @@ void console_print(const char * b) {
 	int currcons = fg_console;
 	char c;
 
+	console_busy++;
 	// 循环读取缓冲区 b 中的字符. 
 	while (c = *(b++)) {
 		// 如果当前字符 c 是换行符, 则对光标执行回车换行操作
@@ -1390,6 +1612,7 @@ void console_print(const char * b) {
 		x++; 													// 列号自增
 	}
 	set_cursor(currcons);           							// 最后设置的光标内存位置, 设置显示控制器中光标位置. 
+	con_write_done(currcons);
 }
 
 
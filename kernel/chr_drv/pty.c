@@ -25,7 +25,8 @@
 // 伪终端写函数. 
 // 参数: from - 源伪终端结构; to - 目的伪终端结构. 
 static inline void pty_copy(struct tty_struct * from, struct tty_struct * to) {
-	char c;
+	struct tty_queue * q = from->write_q, * r = to->read_q;
+	unsigned long n, i;
 
 	// 判断源终端是否停止或源终端写队列是否为空. 如果源终端未停止, 并且源终端写队列不为空, 则循环处理之. 
 	while (!from->stopped && !EMPTY(from->write_q)) {
@@ -38,8 +39,23 @@ static inline void pty_copy(struct tty_struct * from, struct tty_struct * to) {
 			copy_to_cooked(to);     						// 把读队列中的字符处理成成规范模式字符序列放入辅助队列. 
 			continue;
 		}
-		GETCH(from->write_q, c);         					// 从源终端写队列中取一个字符, 放入 c, 
-		PUTCH(c, to->read_q);            					// 然后把 c 中的字符放入目的终端读队列中. 
+		// 把源终端写队列中的字符成块复制到目的终端读队列中. 每块的长度受源队列字符数, 目的队列空闲空间,
+		// 以及两个缓冲区末端的限制.
+		n = CHARS(q);
+		if (n > LEFT(r)) {
+			n = LEFT(r);
+		}
+		if (n > q->size - q->tail) {
+			n = q->size - q->tail;
+		}
+		if (n > r->size - r->head) {
+			n = r->size - r->head;
+		}
+		for (i = 0; i < n; i++) {
+			r->buf[r->head + i] = q->buf[q->tail + i];
+		}
+		q->tail = (q->tail + n) & (q->size - 1);
+		r->head = (r->head + n) & (r->size - 1);
 		// 判断当前进程是否有信号需要处理, 如果有, 则退出循环. 
 		if (current->signal & ~current->blocked) {
 			break;
@@ -16,23 +16,19 @@
 .text
 .globl rs1_interrupt,rs2_interrupt
 
-# size 是读写队列缓冲区的字节长度. 该值必须是 2 的次方, 并且必须与 tty_io.c 中的匹配. 
-size	= 1024				/* must be power of two !
-							   and must match the value
-							   in tty_io.c!!! */
-
 /* these are the offsets into the read/write buffer structures */
-/* 以下这些是读写缓冲队列结构中的偏移量 */
+/* 以下这些是读写缓冲队列结构中的偏移量(include/linux/tty.h) */
+# 缓冲区长度由队列的 size 字段给出(2 的次方), 缓冲区地址由 buf 字段给出. 
 rs_addr = 0             										# 串行端口号字段偏移(端口是 0x3f8 或 0x2f8). 
 head = 4                										# 缓冲区中头指针字段偏移. 
 tail = 8                										# 缓冲区中尾指针字段偏移. 
 proc_list = 12          										# 等待该缓冲的进程字段偏移. 
-buf = 16                										# 缓冲区字段偏移. 
+size = 16               										# 缓冲区长度字段偏移. 
+buf = 20                										# 缓冲区地址字段偏移. 
 
 # 当一个写缓冲队列满后, 内核就会把要往写队列填字符的进程设置为等待状态. 
-# 当写缓冲队列中还剩余最多 256 个字符时, 中断处理程序就可以唤醒这些等待进程继续往写队列中放字符. 
-startup	= 256													/* chars left in write queue when we restart it */
-                        										/* 当我们重新开始写时, 队列里最多还剩余字符个数.  */
+# 当写缓冲队列中还剩余最多 size / 4 个字符时(即 include/linux/tty.h 中的 WAKEUP_CHARS), 
+# 中断处理程序就可以唤醒这些等待进程继续往写队列中放字符. 
 /*
  * These are the actual interrupt routines. They look where
  * the interrupt is coming from, and take appropriate action.
@@ -62,13 +58,15 @@ rs_int:
 	pushl %ecx
 	pushl %ebx
 	pushl %eax
+	pushl %esi
+	pushl %edi
 	push %es
 	push %ds													/* as this is an interrupt, we cannot */
 	pushl $0x10													/* know that bs is ok. Load it */
 	pop %ds                 									/* 由于这是一个中断程序, 我们不知道 ds 是否正确,  */
 	pushl $0x10             									/* 所以加载它们(让 ds, es 指向内核数据段) */
 	pop %es
-	movl 24(%esp), %edx      									# 取上面 35 或 39 行入栈的相应串口缓冲队列指针地址. 
+	movl 32(%esp), %edx      									# 取上面 35 或 39 行入栈的相应串口缓冲队列指针地址. 
 	movl (%edx), %edx        									# 取读缓冲队列结构指针(地址) -> edx. 
 	movl rs_addr(%edx), %edx 									# 取串口 1(或串口 2) 端口基地址 -> edx. 
 	addl $2, %edx												/* interrupt ident. reg */  /* 指向中断标识寄存器 */
@@ -78,9 +76,8 @@ rep_int:
 	inb %dx, %al             									# 取中断标识字节, 以判断中断来源(有 4 种中断情况). 
 	testb $1, %al            									# 首先判断有无待处理中断(位 0 = 0 有中断). 
 	jne end                 									# 若无待处理中断, 则跳转至退出处理处 end. 
-	cmpb $6, %al												/* this shouldn't happen, but ... */    /* 这不会发生, 但... */
-	ja end                  									# al 值大于 6, 则跳转至 end(没有这种状态). 
-	movl 24(%esp), %ecx      									# 调用子程序之前所缓冲队列指针地址放入 ecx. 
+	andb $0x0e, %al												# 去掉 FIFO 开启时置位的位 7, 6, 只留中断类型(位 3 - 1). 
+	movl 32(%esp), %ecx      									# 调用子程序之前所缓冲队列指针地址放入 ecx. 
 	pushl %edx              									# 临时保存中断标识寄存器端口地址. 
 	subl $2, %edx            									# edx 中恢复串口基地址值 0x3f8(0x2f8). 
 	call *jmp_table(, %eax, 2)									/* NOTE! not *4, bit0 is 0 already */
@@ -96,6 +93,8 @@ end:
 	outb %al, $0x20												/* EOI */
 	pop %ds
 	pop %es
+	popl %edi
+	popl %esi
 	popl %eax
 	popl %ebx
 	popl %ecx
@@ -103,10 +102,13 @@ end:
 	addl $4, %esp												# jump over _table_list entry   # 丢弃队列指针地址. 
 	iret
 
-# 各中断类型处理子程序地址跳转表, 共有 4 种中断来源:
-# modem 状态变化中断, 写字符中断, 读字符中断, 线路状态有问题中断. 
+# 各中断类型处理子程序地址跳转表, 共有 5 种中断来源:
+# modem 状态变化中断, 写字符中断, 读字符中断, 线路状态有问题中断, 以及开启 FIFO 后的接收超时中断(类型 6, 
+# 接收 FIFO 中有字符但未达到触发字节数, 并且一段时间内没有新字符到达). 接收超时也由 read_char 处理. 
+# 其余类型不会出现, 为保险起见让它们读线路状态寄存器. 
 jmp_table:
 	.long modem_status, write_char, read_char, line_status
+	.long line_status, line_status, read_char, line_status
 
 # 由于 mode 状态发生变化而引发此次中断. 通过读 modem 状态寄存器 MSR 对其进行复位操作. 
 .align 4
@@ -122,54 +124,90 @@ line_status:
 	inb %dx, %al             									/* 通过读线路状态寄存器进行复位(0x3fd) */
 	ret
 
-# 由于 UART 芯片接收到字符而引起这次中断. 对接收缓冲寄存器执行读操作可复位该中断源. 
-# 这个子程序将接收到的字符放到读缓冲队列 read_q 头指针(head)处, 并且让该指针前移一个字符位置. 
-# 若 head 指针已经到达缓冲区末端, 则让其折返到缓冲区开始处. 最后调用 C 函数 do_tty_interrupt()(即 copy_to_cooked()), 
+# 由于 UART 芯片接收到字符(或接收超时)而引起这次中断. 对接收缓冲寄存器执行读操作可复位该中断源. 
+# 这个子程序循环读取接收缓冲寄存器 RBR, 直到线路状态寄存器 LSR 的数据就绪位(位 0)复位, 从而一次取空接收 FIFO. 
+# 每个字符放到读缓冲队列 read_q 头指针(head)处, 并且让该指针前移一个字符位置, 若已到达缓冲区末端, 则折返到缓冲区开始处. 
+# 若队列已满, 则丢弃该字符(但仍要读出它). 最后只调用一次 C 函数 do_tty_interrupt()(即 copy_to_cooked()), 
 # 把读入的字符经过处理放入规范模式缓冲队列(辅助缓冲队列 secondary)中. 
 .align 4
 read_char:
-	inb %dx, %al                     							# 读取接收缓冲寄存器 RBR 中字符 -> al. 
-	movl %ecx, %edx                  							# 当前串口缓冲队列指针地址 -> edx. 
-	subl $table_list, %edx           							# 当前串口队列指针地址 - 缓冲队列指针表首址 ->edx, 
-	shrl $3, %edx                    							# 差值 / 8, 得串口号. 对于串口 1 是 1, 对于串口 2 是 2. 
+	movl %ecx, %eax                  							# 当前串口缓冲队列指针地址 -> eax. 
+	subl $table_list, %eax           							# 当前串口队列指针地址 - 缓冲队列指针表首址 -> eax, 
+	shrl $3, %eax                    							# 差值 / 8, 得串口号. 对于串口 1 是 1, 对于串口 2 是 2. 
+	addl $63, %eax                   							# 串口号转换成 tty 号(64 或 65)并作为参数入栈. 
+	pushl %eax
 	movl (%ecx), %ecx											# read-queue    # 取读缓冲队列结构地址 -> ecx. 
 	movl head(%ecx), %ebx            							# 取读队列中缓冲头指针 -> ebx. 
-	movb %al, buf(%ecx, %ebx)         							# 将字符放在缓冲区中头指针所指位置处. 
-	incl %ebx                       							# 将头指针前移(右移)一字节. 
-	andl $size - 1, %ebx               							# 用缓冲区长度对头指针取模操作. 
-	cmpl tail(%ecx), %ebx            							# 缓冲区头指针与尾指针比较. 
-	je 1f                           							# 若指针移动后相等, 表示缓冲区满, 不保存头指针, 跳转. 
+	movl buf(%ecx), %esi             							# 取缓冲区地址 -> esi. 
+1:	inb %dx, %al                     							# 读取接收缓冲寄存器 RBR 中字符 -> al. 
+	movb %al, (%esi, %ebx)         								# 将字符放在缓冲区中头指针所指位置处. 
+	leal 1(%ebx), %edi              							# 头指针前移(右移)一字节 -> edi. 
+	cmpl size(%ecx), %edi            							# 头指针超出缓冲区末端则折回. 
+	jb 2f
+	xorl %edi, %edi
+2:	cmpl tail(%ecx), %edi            							# 缓冲区头指针与尾指针比较. 
+	je 3f                           							# 若相等, 表示缓冲区满, 头指针不动(丢弃该字符). 
+	movl %edi, %ebx
+3:	addl $5, %edx                    							# 指向线路状态寄存器 LSR(0x3fd 或 0x2fd). 
+	inb %dx, %al
+	subl $5, %edx
+	testb $1, %al                    							# 还有接收到的字符吗(数据就绪位)? 
+	jne 1b                          							# 有则继续读取. 
 	movl %ebx, head(%ecx)            							# 保存修改过的头指针. 
-1:	addl $63, %edx                   							# 串口号转换成 tty 号(63 或 64)并作为参数入栈. 
-	pushl %edx
 	call do_tty_interrupt           							# 调用 tty 中断处理 C 函数(tty_io.c). 
 	addl $4, %esp                    							# 丢弃入栈参数, 并返回. 
 	ret
 
 # 由设置了发送保持寄存器允许中断标志而引起此次中断. 说明对应串行终端的写字符缓冲队列中有字符需要发送. 
-# 于是计算出写队列中当前所含字符数, 若字符数已小于 256 个, 则唤醒等待写操作进程. 
-# 然后从写缓冲队列尾部取出一个字符发送, 并调整和保存尾指针. 如果写缓冲队列已空, 则跳转到 write_buffer_empty 处处理写缓冲队列空的情况. 
+# 于是计算出写队列中当前所含字符数, 若字符数已不超过队列长度的 1/4, 则唤醒等待写操作进程. 
+# 然后从写缓冲队列尾部连续取出最多 rs_fifo_size[] 个字符发送(开启了 FIFO 的 16550A 为 16 个, 否则为 1 个), 
+# 并调整和保存尾指针. 如果写缓冲队列已空, 则跳转到 write_buffer_empty 处处理写缓冲队列空的情况. 
 .align 4
 write_char:
+	movl %ecx, %edi                  							# 由串口队列指针地址计算串口在 rs_fifo_size[] 中的偏移: 
+	subl $table_list + 8, %edi       							# (地址 - table_list - 8) / 8 * 4. 
+	shrl $1, %edi
+	movl rs_fifo_size(%edi), %edi    							# 本次最多发送的字符数 -> edi. 
 	movl 4(%ecx), %ecx											# write-queue       # 取写缓冲队列结构地址 -> ecx. 
 	movl head(%ecx), %ebx            							# 队写队列头指针 -> ebx. 
 	subl tail(%ecx), %ebx            							# 头指针 - 尾指针 = 队列中字符数. 
-	andl $size - 1, %ebx										# nr chars in queue
 	je write_buffer_empty           							# 若头指针 = 尾指针, 说明写队列空, 跳转处理. 
-	cmpl $startup, %ebx              							# 队列中字符数还超过 256 个?
+	jns 2f														# nr chars in queue     # 差为负则加上缓冲区长度. 
+	addl size(%ecx), %ebx
+2:	movl size(%ecx), %eax            							# 唤醒阈值 WAKEUP_CHARS = size / 4 -> eax. 
+	shrl $2, %eax
+	cmpl %eax, %ebx                  							# 队列中字符数还超过阈值?
 	ja 1f                           							# 超过则跳转处理. 
-	movl proc_list(%ecx), %ebx									# wake up sleeping process  # 唤醒等待的进程. 
-	testl %ebx, %ebx											# is there any?     		# 有等待写的进程吗？
-	je 1f                           							# 是空的, 则向前跳转到标号 1 处. 
-	movl $0, (%ebx)                  							# 否则将进程置为可运行状态(唤醒进程). 
+	call wake_write_q											# wake up sleeping process  # 唤醒等待的进程. 
 1:	movl tail(%ecx), %ebx            							# 取尾指针. 
-	movb buf(%ecx, %ebx), %al         							# 从缓冲中尾指针处取一字符 -> al. 
-	outb %al, %dx                    							# 向端口 0x3f8(0x2f8) 写到发送保持寄存器中. 
+	movl buf(%ecx), %esi             							# 取缓冲区地址 -> esi. 
+2:	movb (%esi, %ebx), %al         								# 从缓冲中尾指针处取一字符 -> al. 
+	outb %al, %dx                    							# 向端口 0x3f8(0x2f8) 写到发送保持寄存器(或发送 FIFO)中. 
 	incl %ebx                       							# 尾指针前移. 
-	andl $size - 1, %ebx               							# 尾指针若到缓冲区末端, 则折回. 
+	cmpl size(%ecx), %ebx             							# 尾指针若到缓冲区末端, 则折回. 
+	jb 3f
+	xorl %ebx, %ebx
+3:	cmpl head(%ecx), %ebx            							# 尾指针与头指针相比较, 
+	je 4f                           							# 若相等, 表示队列已空, 则跳转. 
+	decl %edi                       							# 本次还能发送字符吗? 
+	jne 2b
 	movl %ebx, tail(%ecx)            							# 保存已修改的尾指针. 
-	cmpl head(%ecx), %ebx            							# 尾指针与头指针相比较, 
-	je write_buffer_empty           							# 若相等, 表示队列已空, 则跳转. 
+	ret
+4:	movl %ebx, tail(%ecx)
+	jmp write_buffer_empty
+
+# 唤醒等待写队列(ecx 指向写队列)的进程. 这里调用 wake_up() 而不是直接修改进程状态, 
+# 以便 wake_up() 同时通知 epoll. 调用前后保存 C 函数可能改变的寄存器 ecx 和 edx. 
+.align 4
+wake_write_q:
+	pushl %ecx
+	pushl %edx
+	leal proc_list(%ecx), %ebx
+	pushl %ebx
+	call wake_up
+	addl $4, %esp
+	popl %edx
+	popl %ecx
 	ret
 
 # 处理写缓冲队列 write_q 已空的情况. 若有等待写该串行终端的进程则唤醒之, 然后屏蔽发送保持寄存器中断, 
@@ -180,12 +218,8 @@ write_char:
 # 因此 UART 就又会 "自动" 地来取写缓冲队列中的字符, 并发送出去. 
 .align 4
 write_buffer_empty:
-	movl proc_list(%ecx), %ebx									# wake up sleeping process  # 唤醒等待的进程. 
-                                        						# 取等待该队列的进程的指针, 并判断是否为空. 
-	testl %ebx, %ebx											# is there any?     		# 有等待的进程码？
-	je 1f                           							# 无, 则向前跳转到标号1处. 
-	movl $0, (%ebx)                  							# 否则将进程置为可运行状态(唤醒进程). 
-1:	incl %edx                       							# 指向端口 0x3f9(0x2f9). 
+	call wake_write_q											# wake up sleeping process  # 唤醒等待的进程. 
+	incl %edx                       							# 指向端口 0x3f9(0x2f9). 
 	inb %dx, %al                     							# 读取中断允许寄存器 IER. 
 	jmp 1f                          							# 稍作延迟. 
 1:	jmp 1f                  									/* 屏蔽发送保持寄存器空中断(位 1) */
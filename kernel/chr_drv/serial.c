@@ -20,26 +20,76 @@
  * 以及与串行 IO 有关系的所有中断处理程序. 
  */
 
+#include <termios.h>
+
 #include <linux/tty.h>
 #include <linux/sched.h>
 #include <asm/system.h>
 #include <asm/io.h>
 
-#define WAKEUP_CHARS (TTY_BUF_SIZE / 4)   						// 当写队列中含有 WAKEUP_CHARS 个字符时就开始发送. 
-
 extern void rs1_interrupt(void);        						// 串行口 1 的中断处理程序(rs_io.s). 
 extern void rs2_interrupt(void);        						// 串行口 2 的中断处理程序(rs_io.s). 
 
+// 各串口每次发送保持寄存器空中断时最多可写入的字符数. 检测到 16550A 并开启了 FIFO 时为 16, 否则为 1. 
+// rs_io.s 中的 write_char 按串口号取用该值. 
+int rs_fifo_size[2] = {1, 1};
+
+// 这是波特率因子数组(或称为除数数组). 波特率与波特率因子的对应关系参见列表后说明. 
+// 例如波特率是 2400bit/s 时, 对应的因子是 48(0x30); 9600bit/s 的因子是 12(0x0c). 
+static unsigned short quotient[] = {
+	0, 2304, 1536, 1047, 857,
+	768, 576, 384, 192, 96,
+	64, 48, 24, 12, 6, 3
+};
+
+// 按终端 termios 结构的控制模式标志设置串口的波特率和线路参数. 
+// 在除数锁存标志 DLAB 置位情况下, 通过端口 0x3f8 和 0x3f9 向 UART 分别写入波特率因子低字节和高字节. 
+// 然后按数据位数 CSIZE, 停止位 CSTOPB 和校验方式 PARENB/PARODD 写线路控制寄存器 LCR, 同时复位 DLAB 位. 
+// 对于串口 2, 这两个端口分别是 0x2f8 和 0x2f9. 非串行终端(read_q->data 为 0)则直接返回. 
+void rs_set_termios(struct tty_struct * tty) {
+	unsigned short port, quot;
+	unsigned long cflag = tty->termios.c_cflag;
+	unsigned char lcr;
+
+	if (!(port = tty->read_q->data)) {
+		return;
+	}
+	quot = quotient[cflag & CBAUD];
+	lcr = (cflag & CSIZE) >> 4;									// CS5 - CS8 正好对应 LCR 位 1-0 的 0 - 3. 
+	if (cflag & CSTOPB) {
+		lcr |= 0x04;											// 2 个停止位. 
+	}
+	if (cflag & PARENB) {
+		lcr |= 0x08;											// 允许校验. 
+		if (!(cflag & PARODD)) {
+			lcr |= 0x10;										// 偶校验. 
+		}
+	}
+	cli();
+	if (quot) {													// B0 表示挂断, 不修改波特率. 
+		outb_p(0x80, port + 3);									/* set DLAB */
+		outb_p(quot & 0xff, port);								/* LS of divisor */
+		outb_p(quot >> 8, port + 1);							/* MS of divisor */
+	}
+	outb(lcr, port + 3);										/* reset DLAB */
+	sti();
+}
+
 // 初始化串行端口. 
-// 设置指定串行端口的传输波特率(2400bps)并允许除了写保持寄存器空以外所有中断源. 
-// 另外, 在输出 2 字节的波特率因子时, 须
-// 首先设置线路控制寄存器的 DLAB 位(位 7). 
-// 参数: port 是串行端口基地址, 串口 1 - 0x3F8; 串口 2 - 0x2F8. 
-static void init(int port) {
-	outb_p(0x80, port + 3);										/* set DLAB of line control reg */
-	outb_p(0x30, port);											/* LS of divisor (48 -> 2400 bps */
-	outb_p(0x00, port + 1);										/* MS of divisor */
-	outb_p(0x03, port + 3);										/* reset DLAB */
+// 首先尝试开启 FIFO: 向 FIFO 控制寄存器 FCR 写入 0x87(允许 FIFO, 清空收发 FIFO, 接收触发字节数为 8), 
+// 再读中断标识寄存器 IIR, 若位 7, 6 都为 1 则是 FIFO 可用的 16550A, 每次中断可发送 16 个字符. 
+// 否则(8250, 16450 或 FIFO 有缺陷的 16550)关闭 FIFO, 仍然每次发送 1 个字符. 
+// 然后按终端 termios 设置波特率和线路参数, 并允许除了写保持寄存器空以外所有中断源. 
+// 参数: port 是串行端口基地址, 串口 1 - 0x3F8; 串口 2 - 0x2F8; line 是串口号(0 或 1); tty 是对应的终端. 
+static void init(int port, int line, struct tty_struct * tty) {
+	outb_p(0x87, port + 2);										/* enable and clear FIFOs, trigger at 8 */
+	if ((inb_p(port + 2) & 0xc0) == 0xc0) {
+		rs_fifo_size[line] = 16;
+	} else {
+		outb_p(0x00, port + 2);									/* no (usable) FIFO */
+		rs_fifo_size[line] = 1;
+	}
+	rs_set_termios(tty);
 	outb_p(0x0b, port + 4);										/* set DTR,RTS, OUT_2 */
 	outb_p(0x0d, port + 1);										/* enable all intrs but writes */
 	(void)inb(port);											/* read data port to reset things (?) */
@@ -52,8 +102,8 @@ void rs_init(void) {
 	// 串口 1 使用的中断是 int 0x24, 串口 2 的是 int 0x23. 
 	set_intr_gate(0x24, rs1_interrupt);      					// 设置串行口 1 的中断向量(IRQ4 信号). 
 	set_intr_gate(0x23, rs2_interrupt);      					// 设置串行口 2 的中断向量(IRQ3 信号). 
-	init(tty_table[64].read_q->data);       					// 初始化串行口 1(.data 是端口基地址). 
-	init(tty_table[65].read_q->data);       					// 初始化串行口 2.
+	init(tty_table[64].read_q->data, 0, tty_table + 64);		// 初始化串行口 1(.data 是端口基地址). 
+	init(tty_table[65].read_q->data, 1, tty_table + 65);		// 初始化串行口 2.
 	outb(inb_p(0x21) & 0xE7, 0x21);            					// 允许主 8259A 响应 IRQ3、IRQ4 中断请求. 
 }
 
@@ -71,15 +121,19 @@ void rs_init(void) {
 // 串行数据发送输出. 
 // 该函数实际上只是开启发送保持寄存器已空中断标志. 此后当发送保持寄存器空时, UART 就会产生中断请求. 
 // 而在该串行中断处理过程中, 程序会取出写队列尾指针处的字符, 并输出到发送保持寄存器中. 
-// 一旦 UART 把该字符发送出去, 发送保持寄存器中断允许标志复位掉, 从而再次禁止发送保持寄存器空引发中断请求. 
+// 一旦写队列为空, 发送保持寄存器中断允许标志复位掉, 从而再次禁止发送保持寄存器空引发中断请求. 
 // 此次 "循环" 发送操作也随之结束. 
 void rs_write(struct tty_struct * tty) {
-	// 如果写队列不空, 则首先从 0x3f9(或 0x2f9) 读取中断允许寄存器内容, 添上发送保持寄存器中断允许标志(位 1)后, 
-	// 再写回该寄存器. 这样, 当发送保持寄存器空时 UART 就能够因期望获得欲发送的字符而引发中断. 
+	unsigned short port = tty->write_q->data;
+	unsigned char ier;
+
+	// 如果写队列不空, 则首先从 0x3f9(或 0x2f9) 读取中断允许寄存器内容, 若发送保持寄存器中断允许标志(位 1)尚未设置, 
+	// 则添上该标志后再写回该寄存器. 这样, 当发送保持寄存器空时 UART 就能够因期望获得欲发送的字符而引发中断. 
+	// 发送正在进行时标志已经设置, 中断处理程序会继续取走新放入写队列的字符, 不必再写寄存器. 
 	// write_q.data 中是串行端口基地址. 
 	cli();
-	if (!EMPTY(tty->write_q)) {
-		outb(inb_p(tty->write_q->data + 1) | 0x02, tty->write_q->data + 1);
+	if (!EMPTY(tty->write_q) && !((ier = inb_p(port + 1)) & 0x02)) {
+		outb(ier | 0x02, port + 1);
 	}
 	sti();
 }
@@ -53,6 +53,9 @@ int is_orphaned_pgrp(int pgrp);                 		// 判断是否孤儿进程.
 #define I_NOCR(tty)		_I_FLAG((tty), IGNCR)			// 取忽略回车符 CR 标志.
 #define I_IXON(tty)		_I_FLAG((tty), IXON)			// 取输入控制流标志 XON.
 
+// 判断输入字符是否不需要任何处理: 没有设置任何输入转换, 流控制, 规范模式, 信号和回显标志.
+#define I_RAW(tty)		(!_I_FLAG((tty), (ICRNL | INLCR | IGNCR | IUCLC | IXON)) && !_L_FLAG((tty), (ICANON | ISIG | ECHO)))
+
 // 取 termios 结构输出模式标志集中的一个标志.
 #define O_POST(tty)		_O_FLAG((tty), OPOST)			// 取执行输出处理标志.
 #define O_NLCR(tty)		_O_FLAG((tty), ONLCR)			// 取换行符 NL 转回车换行符 CR-NL 标志.
@@ -164,6 +167,31 @@ void wait_for_keypress(void) {
 	sleep_if_empty(tty_table[fg_console].secondary);
 }
 
+// 原始输入的快速路径. 字符不需要任何处理时, 把读队列中的字符按连续的块原样复制到辅助队列中, 
+// 直到读队列取空或辅助队列放满. 每块的长度受两个队列中可用字符数, 空闲空间以及各自缓冲区末端的限制.
+// 复制时仍要统计换行符和文件结束符, 因为 tty_read() 取走它们时会递减辅助队列的行数 secondary->data.
+static void copy_raw(struct tty_struct * tty) {
+	struct tty_queue * from = tty->read_q, * to = tty->secondary;
+	unsigned long n, i;
+	char c, * src, * dst;
+
+	while (!EMPTY(from) && !FULL(to)) {
+		n = MIN(CHARS(from), LEFT(to));
+		n = MIN(n, from->size - from->tail);
+		n = MIN(n, to->size - to->head);
+		src = from->buf + from->tail;
+		dst = to->buf + to->head;
+		for (i = 0; i < n; i++) {
+			c = dst[i] = src[i];
+			if (c == 10 || (EOF_CHAR(tty) != _POSIX_VDISABLE && c == EOF_CHAR(tty))) {
+				to->data++;
+			}
+		}
+		from->tail = (from->tail + n) & (from->size - 1);
+		to->head = (to->head + n) & (to->size - 1);
+	}
+}
+
 // 复制成规范模式字符序列
 // 根据终端 termios 结构中设置的各种标志, 
 // 将指定 tty 同读队列缓冲区中的字符复制转换成规范模式(熟模式)字符并存放在辅助队列(规范模式队列)中.
@@ -176,6 +204,12 @@ void copy_to_cooked(struct tty_struct * tty) {
 		printk("copy_to_cooked: missing queues\n\r");
 		return;
 	}
+	// 原始模式下不需要逐个检查字符, 直接成块复制.
+	if (I_RAW(tty)) {
+		copy_raw(tty);
+		wake_up(&tty->secondary->proc_list);
+		return;
+	}
 	// 否则我们根据终端 termios 结构中的输入和本地标志, 
 	// 对从 tty 读队列缓冲区中取出的每个字符进行适当的处理, 然后放入辅助队列 secondary 中. 
 	// 在下面循环体中, 如果此时读队列缓冲区已经取空或都辅助队列缓冲区已经放满字符, 就退出循环体. 
@@ -225,7 +259,7 @@ void copy_to_cooked(struct tty_struct * tty) {
 						PUTCH(127, tty->write_q);
 						tty->write(tty);
 					}
-					DEC(tty->secondary->head);
+					DEC(tty->secondary, tty->secondary->head);
 				}
 				continue;									// 继续读取读队列中字符进行处理.
 			}
@@ -245,7 +279,7 @@ void copy_to_cooked(struct tty_struct * tty) {
 					PUTCH(127, tty->write_q);
 					tty->write(tty);
 				}
-				DEC(tty->secondary->head);
+				DEC(tty->secondary, tty->secondary->head);
 				continue;
 			}
         }
@@ -379,7 +413,8 @@ int tty_read(unsigned channel, char * buf, int nr) {
 	struct tty_struct * tty;
 	struct tty_struct * other_tty = NULL;
 	char c, * b = buf;
-	int minimum, time;
+	char tmp[64];										// 暂存取出的字符, 攒够一批再复制到用户缓冲区.
+	int minimum, time, n;
 
 	// 首先判断参数有效性并取终端的 tty 结构指针. 
 	// 如果 tty 终端的三个缓冲队列指针都是 NULL, 则返回 EIO 出错信息. 
@@ -469,6 +504,8 @@ int tty_read(unsigned channel, char * buf, int nr) {
 		// 此时如果欲读字符数已为 0 则中断循环. 
 		// 另外, 如果终端处于规范模式并且读取的字符是换行符 NL(10), 则也退出循环. 
 		// 除此之外, 只要还没有取完欲读字符数 nr 并且辅助队列不为空, 就继续取队列中的字符. 
+		// 取出的字符先放在 tmp[] 中, 每满 64 个或退出循环时用 copy_to_user() 一次复制到用户缓冲区. 
+		n = 0;
 		do {
 			GETCH(tty->secondary, c);
 			if ((EOF_CHAR(tty) != _POSIX_VDISABLE && c == EOF_CHAR(tty)) || c == 10) {
@@ -477,11 +514,18 @@ int tty_read(unsigned channel, char * buf, int nr) {
 			if ((EOF_CHAR(tty) != _POSIX_VDISABLE && c == EOF_CHAR(tty)) && L_CANON(tty)) {
 				break;
 			} else {
-				put_fs_byte(c, b++);
+				tmp[n++] = c;
 				if (!--nr) break;
+				if (n == sizeof(tmp)) {
+					copy_to_user(b, tmp, n);
+					b += n;
+					n = 0;
+				}
 			}
 			if (c == 10 && L_CANON(tty)) break;
 		} while (nr > 0 && !EMPTY(tty->secondary));
+		copy_to_user(b, tmp, n);
+		b += n;
 		// 执行到此, 那么如果 tty 终端处于规范模式下, 说明我们可能读到了换行符或者遇到了文件结束符. 
 		// 如果是处于非规范模式下, 那么说明我们已经读取了 nr 个字符, 或者辅助队列已经被取空了. 
 		// 于是我们首先唤醒等待队列的进程, 然后看看是否设置过超时定时值 time. 
@@ -512,6 +556,7 @@ int tty_write(unsigned channel, char * buf, int nr) {
 	static int cr_flag = 0;
 	struct tty_struct * tty;
 	char c, * b = buf;
+	int n;
 
 	// 首先判断参数有效性并取终端的 tty 结构指针. 
 	// 如果 tty 终端的三个缓冲队列指针都是 NULL, 则返回 EIO 出错信息.
@@ -537,6 +582,29 @@ int tty_write(unsigned channel, char * buf, int nr) {
 		sleep_if_full(tty->write_q);
 		if (current->signal & ~current->blocked) break;
 
+		// 若没有设置输出后处理标志 OPOST, 字符不需要逐个转换, 于是直接把用户数据成块地复制到写队列中. 
+		// 每次复制写队列头指针到缓冲区末端和队列空闲空间中的较小者, 复制完后再移动头指针.
+		if (!O_POST(tty)) {
+			while (nr > 0 && !FULL(tty->write_q)) {
+				n = tty->write_q->size - tty->write_q->head;
+				if (n > LEFT(tty->write_q)) {
+					n = LEFT(tty->write_q);
+				}
+				if (n > nr) {
+					n = nr;
+				}
+				copy_from_user(tty->write_q->buf + tty->write_q->head, b, n);
+				tty->write_q->head = (tty->write_q->head + n) & (tty->write_q->size - 1);
+				b += n; nr -= n;
+			}
+			cr_flag = 0;
+			tty->write(tty);
+			if (nr > 0) {
+				schedule();
+			}
+			continue;
+		}
+
 		// 当要写的字符数 nr 还大于 0 并且 tty 写队列缓冲区不满, 则循环执行以下操作. 首先从用户缓冲区中取 1 字节.
 		while (nr > 0 && !FULL(tty->write_q)) {
 			c = get_fs_byte(b);
@@ -613,22 +681,41 @@ void do_tty_interrupt(int tty) {
 void chr_dev_init(void) {
 }
 
+// 初始化缓冲队列 q, 并为它分配 size 字节的缓冲区. data 是 data 字段的初值.
+// 缓冲区从按页分配的内存中依次切分, 当前页剩余空间不够时再取一页. 
+// 调用时按队列大小从小到大的顺序进行, 因此切分时基本上不会浪费空间.
+static void init_queue(struct tty_queue * q, unsigned long data, unsigned long size) {
+	static unsigned long page = 0, left = 0;
+
+	if (left < size) {
+		if (!(page = get_free_page())) {
+			panic("tty_init: no memory for tty queues");
+		}
+		left = PAGE_SIZE;
+	}
+	left -= size;
+	*q = (struct tty_queue) {data, 0, 0, NULL, size, (char *) (page + left)};
+}
+
 // tty 终端初始化函数
 // 初始化所有终端缓冲队列, 初始化串口终端和控制台终端.
 void tty_init(void) {
 	int i;
 
-	// 首先初始化所有终端的缓冲队列结构(tty_queue), 设置初值. 
+	// 首先初始化所有终端的缓冲队列结构(tty_queue), 设置初值并按各类终端的队列大小分配缓冲区. 
 	// 对于串行终端(rs_queues)的读/写缓冲队列, 将它们的 data 字段设置为串行端口基地址值. 
 	// 串口 1 是 0x3f8, 串口 2 是 0x2f8. 然后先初步设置所有终端的 tty 结构.
 	// 其中特殊字符数组 c_cc[] 设置的初值定义在 include/linux/tty.h 文件中.
-	for (i = 0; i < QUEUES; i++) { 							// QUEUES = 54
-		tty_queues[i] = (struct tty_queue) {0, 0, 0, 0, ""};
+	for (i = 0; i < 3 * MAX_CONSOLES; i++) {
+		init_queue(con_queues + i, 0, CON_QUEUE_SIZE);
+	}
+	for (i = 0; i < 3 * NR_SERIALS; i++) {
+		init_queue(rs_queues + i, (i % 3 == 2) ? 0 : ((i < 3) ? 0x3f8 : 0x2f8), RS_QUEUE_SIZE);
+	}
+	for (i = 0; i < 3 * NR_PTYS; i++) {
+		init_queue(mpty_queues + i, 0, PTY_QUEUE_SIZE);
+		init_queue(spty_queues + i, 0, PTY_QUEUE_SIZE);
 	}
-	rs_queues[0] = (struct tty_queue) {0x3f8, 0, 0, 0, ""};
-	rs_queues[1] = (struct tty_queue) {0x3f8, 0, 0, 0, ""};
-	rs_queues[3] = (struct tty_queue) {0x2f8, 0, 0, 0, ""};
-	rs_queues[4] = (struct tty_queue) {0x2f8, 0, 0, 0, ""};
 	// 初步设置所有终端的 tty 结构体
 	for (i = 0; i < 256; i++) {
 		tty_table[i] = (struct tty_struct) {
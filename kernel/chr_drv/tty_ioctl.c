@@ -20,38 +20,11 @@ extern int session_of_pgrp(int pgrp);
 // 向使用指定 tty 终端的进程组中所有进程发送信号. 定义在 chr_drv/tty_io.c. 
 extern int tty_signal(int sig, struct tty_struct * tty);
 
-// 这是波特率因子数组(或称为除数数组). 波特率与波特率因子的对应关系参见列表后说明. 
-// 例如波特率是 2400bit/s 时, 对应的因子是 48(0x300); 9600bit/s 的因子是 12(0x1c). 
-static unsigned short quotient[] = {
-	0, 2304, 1536, 1047, 857,
-	768, 576, 384, 192, 96,
-	64, 48, 24, 12, 6, 3
-};
-
-// 修改传输波特率. 
+// 修改传输波特率和线路参数. 
 // 参数: tty - 终端对应的 tty 数据结构. 
-// 在除数锁存标志 DLAB 置位情况下, 通过端口 0x3f8 和 0x3f9 向 UART 分别写入波特率因子低字节和高字节. 
-// 写完后再复位 DLAB 位. 对于串口 2, 这两个端口分别是 0x2f8 和 0x2f9. 
+// 波特率因子和线路控制寄存器的设置由串口驱动 rs_set_termios() 完成(serial.c), 它对非串行终端不做任何事. 
 static void change_speed(struct tty_struct * tty) {
-	unsigned short port,quot;
-
-	// 函数首先检查参数 tty 指定的终端是否是串行终端, 若不是则退出. 对于串口终端的 tty 结构, 
-	// 其读缓冲队列 data 字段存放着串行端口基址(0x3f8 或 0x2f8), 而一般控制台终端的 tty 结构的 read_q. 
-	// data 字段值为 0. 然后从终端 termios 结构的控制模式标志集中取得已设置的波特率索引号, 
-	// 并据此从波特率因子数组 quotient[] 中取得对应的波特率因子值 quot. 
-	// CBAUD 是控制模式标志集中波特率位屏蔽码. 
-	if (!(port = tty->read_q->data)) return;
-	quot = quotient[tty->termios.c_cflag & CBAUD];
-	// 接着把波特率因子 quot 写入串行端口对应 UART 芯片的波特率因子锁存器中. 
-	// 在写之前我们先要把线路控制寄存器 LCR 的除数锁存访问位 DLAB(位 7)置 1. 
-	// 然后把 16 位的波特率因子低, 高字节分别写入端口 0x3f8, 0x3f9(分别对应波特率因子低, 高字节锁存器). 
-	// 最后再复位 LCR 的 DLAB 标志位. 
-	cli();
-	outb_p(0x80, port + 3);									/* set DLAB */          // 首先设置除数锁定标志 DLAB. 
-	outb_p(quot & 0xff, port);								/* LS of divisor */     // 输出因子低字节. 
-	outb_p(quot >> 8, port + 1);							/* MS of divisor */     // 输出因子高字节. 
-	outb(0x03, port + 3);									/* reset DLAB */        // 复位 DLAB. 
-	sti();
+	rs_set_termios(tty);
 }
 
 // 刷新 tty 缓冲队列. 
@@ -392,14 +392,20 @@ void do_exit(long code) {
 	// get_base() 和 get_limit() 宏位于 include/linux/sched.h 头文件. 
 	free_page_tables(get_base(current->ldt[1]), get_limit(0x0f));
 	free_page_tables(get_base(current->ldt[2]), get_limit(0x17));
-	// 然后关闭当前进程打开着的所有文件. 
+	// 如果进程是在持有元数据日志事务句柄时(例如在系统调用中因内存不足)退出的, 则结束该句柄, 否则日志永远无法提交.
+	if (current->flags & PF_JOURNAL) {
+		journal_stop(1);
+	}
+	// 丢弃进程还未取走的异步 I/O 请求. 然后关闭当前进程打开着的所有文件. 
 	// 再对当前进程的工作目录 pwd, 根目录 root, 执行程序文件的 i 节点以及库文件进行同步操作, 
 	// 放回各个 i 节点并分别置空(释放). 接着把当前进程的状态设置为僵死状态(TASK_ZOMBIE), 并设置进程退出码. 
-	for (i = 0; i < NR_OPEN; i++) {
+	aio_release();
+	for (i = 0; i < current->max_fds; i++) {
 		if (current->filp[i]) {
 			sys_close(i);
 		}
 	}
+	free_fdtable(current);						// 释放扩展过的描述符表.
 	iput(current->pwd);
 	current->pwd = NULL;
 	iput(current->root);
@@ -192,16 +192,23 @@ int copy_process(int nr, long ebp, long edi, long esi, long gs,  		// 这几个
 		__asm__("clts; fnsave %0; frstor %0" : : "m" (p->tss.i387));
 	}
 
+	// 为新任务建立自己的描述符表(任务结构中复制来的表指针仍指向父进程的表), 内存不够则放弃创建.
+	if (dup_fdtable(p)) {
+		task[nr] = NULL;
+		free_page((long) p);
+		return -EAGAIN;
+	}
 	// 设置新任务 LDT 代码段和数据段描述符中的段基地址(未设置段限长, 段限长在 do_execve 时设置), 并复制页表. 
-	// 如果出错(返回值不是 0), 则复位任务数组中相应项并释放为该新任务分配的用于任务结构的内存页.
+	// 如果出错(返回值不是 0), 则复位任务数组中相应项并释放为该新任务分配的描述符表和用于任务结构的内存页.
 	if (copy_mem(nr, p)) {					// 返回不为 0 表示出错.
 		task[nr] = NULL;
+		free_fdtable(p);
 		free_page((long) p);
 		return -EAGAIN;
 	}
 	// 如果父进程中有文件是打开的, 则将对应文件的打开次数增 1. 因为这里创建的子进程会与父进程共享这些打开的文件. 
 	// 将当前进程(父进程)的 pwd, root, executable, library 引用次数均增 1. 与上面同样的道理, 子进程也引用了这些 i 节点.
-	for (i = 0; i < NR_OPEN; i++) {
+	for (i = 0; i < p->max_fds; i++) {
 		if (f = p->filp[i]) {
 			f->f_count++;
 		}
@@ -17,6 +17,7 @@
 // 还有一些以宏的形式定义的有关描述符参数设置和获取的嵌入式汇编函数程序.
 #include <linux/sched.h>
 #include <linux/kernel.h>					// 内核头文件. 含有一些内核常用函数的原形定义.
+#include <linux/slab.h>						// 对象缓存头文件. 定时器项由缓存分配.
 #include <linux/sys.h>						// 系统调用头文件. 含有 82 个系统调用 C 函数程序, 以 'sys_' 开头.
 #include <linux/fdreg.h>					// 软驱头文件. 含有软盘控制器参数的一些定义.
 #include <asm/system.h>						// 系统头文件. 定义了设置或修改描述符/中断门等的嵌入式汇编宏.
@@ -71,6 +72,7 @@ extern void mem_use(void);              	// 没有任何地方定义和引用该
 
 extern int timer_interrupt(void);			// 时钟中断处理程序(kernel/sys_call.s)
 extern int system_call(void);				// 系统调用中断处理程序(kernel/sys_call.s)
+extern void ep_notify(struct task_struct ** p);	// 通知 epoll 等待队列上有事件(fs/select.c)
 
 // 每个任务(进程)在内核态运行时都有自己的内核态堆栈. 这里定义了任务的内核态堆栈结构.
 // 这里定义任务联合(任务结构成员和 stack 字符数组成员). 
@@ -320,7 +322,9 @@ void sleep_on(struct task_struct ** p) {
 // 唤醒 *p(任务指针)指向的不可中断等待的任务. *p 是(最后进入等待队列)等待资源的任务指针. 
 // 若该任务已经处于停止或僵死状态, 则显示警告信息.
 // 参数 p 是资源(比如缓存块 buffer_head)结构体中的 wait 成员(比如 bh->b_wait)的地址, 该成员用于保存等待该资源的任务指针.
+// 同时通知 epoll: 监视该等待队列的兴趣项被放到其 epoll 对象的就绪链表上(fs/select.c).
 void wake_up(struct task_struct ** p) {
+	ep_notify(p);
 	if (p && *p) {
 		if ((**p).state == TASK_STOPPED) {						// 处于停止状态.
 			printk("wake_up: TASK_STOPPED");
@@ -437,16 +441,17 @@ void do_floppy_timer(void) {
 	}
 }
 
-// 下面是关于定时器的代码. 最多可有 64 个定时器.
-#define TIME_REQUESTS 64
+// 下面是关于定时器的代码. 定时器项由 timer_cachep 缓存分配, 个数不再有固定上限.
 
-// 定时器链表结构和定时器数组. 该定时器链表专用于供软驱关闭马达和启动马达定时操作. 
+// 定时器链表结构. 该定时器链表专用于供软驱关闭马达和启动马达定时操作. 
 // 这种类型定时器类似现代 Linux 系统中的动态定时器(Dynamic Timer), 仅供内核使用.
 static struct timer_list {
 	long jiffies;										// 定时滴答数.
 	void (*fn)();										// 定时处理程序.
 	struct timer_list * next;							// 链接指向下一个定时器.
-} timer_list[TIME_REQUESTS], * next_timer = NULL;		// next_timer 是定时器队列头指针.
+} * next_timer = NULL;									// next_timer 是定时器队列头指针.
+
+static struct kmem_cache * timer_cachep;				// 定时器项缓存(在 sched_init() 中建立).
 
 // 添加定时器. 输入参数为指定的定时值(滴答数)和相应的处理程序指针.
 // 软盘驱动程序(floppy.c)利用该函数执行启动或关闭马达的延时操作.
@@ -454,21 +459,18 @@ static struct timer_list {
 void add_timer(long jiffies, void (*fn)(void)) {
 	struct timer_list * p;
 
-	// 如果定时处理程序指针为空, 则退出. 否则关中断.
+	// 如果定时处理程序指针为空, 则退出. 
+	// 需要加入链表时先从缓存中分配一个定时器项(缓存中没有空闲对象时要分配 slab 页面, 可能睡眠, 因此在关中断之前分配), 内存不够则系统崩溃. 然后关中断.
 	if (!fn) return;
+	if (jiffies > 0 && !(p = (struct timer_list *) kmem_cache_alloc(timer_cachep))) {
+		panic("No more time requests free");
+	}
 	cli();
 	// 如果定时值 <= 0, 则立刻调用其处理程序. 并且该定时器不加入链表中.
 	if (jiffies <= 0) {
 		(fn)();
 	} else {
-		// 否则从定时器数组中, 找一个空闲项.
-		for (p = timer_list; p < timer_list + TIME_REQUESTS; p++) {
-			if (!p->fn) break;
-		}
-		// 如果已经用完了定时器数组, 则系统崩溃. 否则向定时器数据结构填入就信息, 并链入链表头.
-		if (p >= timer_list + TIME_REQUESTS) {
-			panic("No more time requests free");
-		}
+		// 否则向定时器数据结构填入就信息, 并链入链表头.
 		p->fn = fn;
 		p->jiffies = jiffies;
 		p->next = next_timer;
@@ -539,15 +541,16 @@ void do_timer(long cpl) {
 	} else {										// 被中断时进程在运行内核态代码.
 		current->stime++;
 	}
-	// 如果有定时器存在, 则将链表第 1 个定时器的值减 1. 如果已等于 0, 则调用相应的处理程序, 并将该处理程序指针置空.
-	// 然后去掉该项定时器. next_timer 是定时器链表的头指针.
+	// 如果有定时器存在, 则将链表第 1 个定时器的值减 1. 如果已等于 0, 则取下该项定时器, 把它放回缓存, 然后调用相应的处理程序.
+	// next_timer 是定时器链表的头指针.
 	if (next_timer) {
 		next_timer->jiffies--;
 		while (next_timer && next_timer->jiffies <= 0) {
 			void (*fn)(void);						// 这里插入了一个函数指针定义!!!
-			fn = next_timer->fn;
-			next_timer->fn = NULL;
-			next_timer = next_timer->next;
+			struct timer_list * p = next_timer;
+			fn = p->fn;
+			next_timer = p->next;
+			kmem_cache_free(timer_cachep, p);
 			(fn)();									// 调用定时处理函数.
 		}
 	}
@@ -630,6 +633,12 @@ void sched_init(void) {
 	if (sizeof(struct sigaction) != 16) {						// sigaction 是存放有关信号状态的结构.
 		panic("Struct sigaction MUST be 16 bytes");
 	}
+	// 建立定时器项缓存. add_timer() 也会在中断处理程序中调用, 那时不应为分配 slab 页面而睡眠, 
+	// 因此这里先分配并放回一项, 让缓存预先有一个 slab(缓存的最后一个 slab 不会被释放), 其中的 300 多项足够使用.
+	if (!(timer_cachep = kmem_cache_create("timer_list", sizeof(struct timer_list), NULL))) {
+		panic("Unable to create timer cache");
+	}
+	kmem_cache_free(timer_cachep, kmem_cache_alloc(timer_cachep));
 	// 在全局描述符表中设置任务 0 的任务状态段描述符(TSS)和局部数据表描述符(LDT).
 	// FIRST_TSS_ENTRY 和 FIRST_LDT_ENTRY 的值分别是 4 和 5, 定义在 include/linux/sched.h 中. 
 	// gdt 是一个描述符表数组(include/linux/head.h), 实际上对应程序 head.s 中的全局描述符表基址(gdt). 
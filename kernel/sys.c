@@ -506,7 +506,7 @@ int sys_sethostname(char * name, int len) {
 // 一个说明进程对指定资源的当前限制界限(soft limit, 即软限制), 
 // 另一个说明系统对指定资源的最大限制界限(hard limit, 即硬限制). 
 // rlim[] 数组的每一项对应系统对当前进程一种资源的界限信息. 
-// Linux 0.12 系统共对 6 种资源规定了界限, 即 RLIM_NLIMITS = 6. 
+// 系统共对 7 种资源规定了界限, 即 RLIM_NLIMITS = 7(第 7 种 RLIMIT_NOFILE 是进程可用的描述符数). 
 // 请参考头文件 include/sys/resource.h 说明. 
 // 参数 resource 指定我们咨询的资源名称, 实际上它是任务结构中 rlim[] 数组的索引项值. 
 // 参数 rlim 是指向 rlimit 结构的用户缓冲区指针, 用于存放取得的资源界限信息. 
@@ -544,6 +544,11 @@ int sys_setrlimit(int resource, struct rlimit * rlim) {
 	if (((new.rlim_cur > old->rlim_max) || (new.rlim_max > old->rlim_max)) && !suser()) {
 		return -EPERM;
 	}
+	// 描述符表最多只能扩展到 NR_OPEN 项, 因此即使是超级用户也不能把 RLIMIT_NOFILE 设置得更大. 
+	// 降低 RLIMIT_NOFILE 不影响已打开的描述符, 只限制以后分配的描述符值(fs/file_table.c get_unused_fd()).
+	if (resource == RLIMIT_NOFILE && (new.rlim_cur > NR_OPEN || new.rlim_max > NR_OPEN)) {
+		return -EPERM;
+	}
 	*old = new;
 	return 0;
 }
@@ -21,8 +21,8 @@
  * stored on pages requested from get_free_page().  However, unlike buckets,
  * pages devoted to bucket descriptor pages are never released back to the
  * system.  Fortunately, a system should probably only need 1 or 2 bucket
- * descriptor pages, since a page can hold 256 bucket descriptors (which
- * corresponds to 1 megabyte worth of bucket pages.)  If the kernel is using
+ * descriptor pages, since a page can hold 204 bucket descriptors (which
+ * corresponds to 816k worth of bucket pages.)  If the kernel is using
  * that much allocated memory, it's probably doing something wrong.  :-)
  *
  * Note: malloc() and free() both call get_free_page() and free_page()
@@ -60,7 +60,7 @@
  * 每个存储桶都有一个作为其控制用的存储描述符, 其中记录了页面上有多少个对象正被使用以及该页上空闲内存的列表. 
  * 就像存储桶自身一样, 存储桶描述符也是存储在使用 get_free_page() 申请到的页面上的, 但是与存储桶不同的是, 
  * 桶描述符所占用的页面将不再会释放给系统. 幸运的是一个系统大约只需要 1 到 2 页的桶描述符页面, 
- * 因为一个页面可以存放 256 个桶描述符(对应 1MB 内存的存储页面). 
+ * 因为一个页面可以存放 204 个桶描述符(对应 816KB 内存的存储页面). 
  * 如果系统为桶描述符分配了许多内存, 那么肯定系统什么地方出了问题. 
  *
  * 注意! malloc() 和 free() 两者关闭了中断的代码部分都调用了 get_free_page() 和 free_page() 函数, 
@@ -79,9 +79,11 @@
 #include <asm/system.h>
 
 // 存储桶描述符结构. 
-struct bucket_desc {								/* 16 bytes */
+// 描述符链是双向链表, 释放页面时可以直接把描述符从链中取下.
+struct bucket_desc {								/* 20 bytes */
 	void				*page;          			// 该桶描述符对应的内存页面指针. 
 	struct bucket_desc	*next;          			// 下一个描述符指针. 
+	struct bucket_desc	*prev;          			// 上一个描述符指针(链头描述符为 NULL). 
 	void				*freeptr;       			// 指向本桶中空闲内存位置的指针. 
 	unsigned short		refcnt;         			// 引用计数. 
 	unsigned short		bucket_size;    			// 本描述符对应存储桶的大小. 
@@ -132,6 +134,12 @@ struct _bucket_dir bucket_dir[] = {
  */
 struct bucket_desc *free_bucket_desc = (struct bucket_desc *) 0;
 
+/*
+ * 页面属主表. 与 mem_map[] 一样以 MAP_NR() 为下标, 记录用作存储桶的页面对应的桶描述符(其他页面为 NULL).
+ * free_s() 由对象地址所在的页面直接查到桶描述符, 不再搜索所有桶目录项的描述符链.
+ */
+static struct bucket_desc * page_owner[PAGING_PAGES];
+
 /*
  * This routine initializes a bucket description page.
  */
@@ -245,9 +253,13 @@ void * malloc(unsigned int len) {
 		}
 		// 最后一个对象开始处的指针设置为 0(NULL). 
 		// 然后让该桶描述符的下一描述符指针字段指向对应桶目录项指针 chain 所指的描述符, 而桶目录的 chain 指向该桶描述符, 
-		// 即将该描述符插入到描述符链链头处. 
+		// 即将该描述符插入到描述符链链头处. 同时在页面属主表中登记该页面的桶描述符. 
 		*((char **)cp) = 0;
-		bdesc->next = bdir->chain; 				/* OK, link it in! */        /* OK, 将其链入！ */
+		page_owner[MAP_NR((unsigned long) bdesc->page)] = bdesc;
+		bdesc->prev = 0;
+		if (bdesc->next = bdir->chain) { 		/* OK, link it in! */        /* OK, 将其链入！ */
+			bdesc->next->prev = bdesc;
+		}
 		bdir->chain = bdesc;
     }
 	// 返回指针即等于该描述符对应页面的当前空闲指针. 然后调整该空闲空间指针指向下一个空闲对象, 
@@ -261,80 +273,59 @@ void * malloc(unsigned int len) {
 }
 
 /*
- * Here is the free routine.  If you know the size of the object that you
- * are freeing, then free_s() will use that information to speed up the
- * search for the bucket descriptor.
+ * Here is the free routine.  The bucket descriptor of the object is
+ * found through the page owner table, so the size argument is no longer
+ * needed; it is kept so that callers need not change.
  *
  * We will #define a macro so that "free(x)" is becomes "free_s(x, 0)"
  */
 /*
- * 下面是释放子程序. 如果你知道释放对象的大小, 则 free_s() 将使用该信息加快搜寻对应桶描述符的速度. 
+ * 下面是释放子程序. 对象所在页面的桶描述符直接从页面属主表 page_owner[] 中取得, 因此不再需要对象大小参数 size, 
+ * 保留它只是为了不必修改调用者. 
  *
  * 我们将定义一个宏, 使得 “free(x)” 成为 “free_s(x, 0)”. 
  */
 // 释放存储桶对象. 
-// 参数: obj - 对应对象指针; size - 大小. 
+// 参数: obj - 对应对象指针; size - 大小(不使用). 
 void free_s(void * obj, int size) {
-	void * page;
+	unsigned long page;
 	struct _bucket_dir * bdir;
-	struct bucket_desc * bdesc, * prev;
+	struct bucket_desc * bdesc;
 
 	/* Calculate what page this object lives in */
     /* 计算该对象所在页面 */
-	page = (void *)((unsigned long)obj & 0xfffff000);
-	/* Now search the buckets looking for that page */
-    /* 现在搜索存储桶目录项所链接的桶描述符, 寻找该页面 */
-	for (bdir = bucket_dir; bdir->size; bdir++) {
-		prev = 0;
-		/* If size is zero then this conditional is always false */
-        /* 如果参数 size 是 0, 则下面条件肯定是 false */
-		if (bdir->size < size) {
-			continue;
-		}
-		// 搜索对应目录项中链接的所有描述符, 查找对应页面. 如果某描述符页面指针等于 page 则表示找到了相应的描述符, 跳转到found. 
-		// 如果描述符不含有对应 page, 则让描述符指针 perv 指向该描述. 
-		for (bdesc = bdir->chain; bdesc; bdesc = bdesc->next) {
-			if (bdesc->page == page) {
-				goto found;
-			}
-			prev = bdesc;
-		}
+	page = (unsigned long) obj & 0xfffff000;
+	// 由页面属主表取得该页面的桶描述符. 若页面不在主内存区中, 或者不是存储桶页面, 则显示出错信息, 死机. 
+	if (page < LOW_MEM || page >= HIGH_MEMORY || !(bdesc = page_owner[MAP_NR(page)]) || bdesc->page != (void *) page) {
+		panic("Bad address passed to kernel free_s()");
 	}
-	// 若搜索了对应目录项的所有描述符都有没有找到指定的页面, 则显示出错信息, 死机. 
-	panic("Bad address passed to kernel free_s()");
-found:
-	// 找到对应的桶描述符后, 首先关中断. 然后将该对象内存块链入空闲块对象链表中, 并使该描述符的对象引用计数减 1. 
+	// 首先关中断. 然后将该对象内存块链入空闲块对象链表中, 并使该描述符的对象引用计数减 1. 
 	cli(); 								/* To avoid race conditions */   /* 为了避免竞争条件 */
 	*((void **)obj) = bdesc->freeptr;
 	bdesc->freeptr = obj;
 	bdesc->refcnt--;
 	// 如果引用计数已等于 0, 则我们就要以释放对应的内存页面和该桶描述符. 
+	// 先把描述符从链中删除: 若它是链头描述符, 则按桶大小找到对应的桶目录项, 让 chain 指向下一个描述符. 
 	if (bdesc->refcnt == 0) {
-		/*
-		 * We need to make sure that prev is still accurate.  It
-		 * may not be, if someone rudely interrupted us....
-		 */
-		// 如果 prev 已经不是搜索到的描述符的前一个描述符, 则重新搜索当前描述符的前一个描述符. 
-		if ((prev && (prev->next != bdesc)) || (!prev && (bdir->chain != bdesc))) {
-			for (prev = bdir->chain; prev; prev = prev->next) {
-				if (prev->next == bdesc) {
+		if (bdesc->prev) {
+			bdesc->prev->next = bdesc->next;
+		} else {
+			for (bdir = bucket_dir; bdir->size; bdir++) {
+				if (bdir->size == bdesc->bucket_size) {
 					break;
 				}
 			}
-		}
-		// 如果找到该前一个描述符, 则从描述符链中删除当前描述符. 
-		if (prev) {
-			prev->next = bdesc->next;
-		// 如果 prev == NULL, 则说明当前一个描述符是该目录项第 1 个描述符, 即目录项中 chain 应该直接指向当前描述符 bdesc, 
-		// 否则表示链表有问题, 则显示出错信息, 死机. 因此, 为了将当前描述符从链表中删除, 应该让 chain 指向下一个描述符. 
-		} else {
 			if (bdir->chain != bdesc) {
 				panic("malloc bucket chains corrupted");
 			}
 			bdir->chain = bdesc->next;
 		}
-		// 释放当前描述符所操作的内存页面, 并将该描述符插入空闲描述符表开始处. 
-		free_page((unsigned long) bdesc->page);
+		if (bdesc->next) {
+			bdesc->next->prev = bdesc->prev;
+		}
+		// 释放当前描述符所操作的内存页面, 清除其页面属主表项, 并将该描述符插入空闲描述符表开始处. 
+		page_owner[MAP_NR(page)] = 0;
+		free_page(page);
 		bdesc->next = free_bucket_desc;
 		free_bucket_desc = bdesc;
 	}
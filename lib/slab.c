@@ -0,0 +1,233 @@
+/*
+ * linux/lib/slab.c
+ */
+
+/*
+ * slab.c implements object caches for kernel objects that are allocated
+ * and freed often. Each cache keeps its own slabs, so freeing an object
+ * needs no search at all.
+ */
+/*
+ * 内核对象缓存(slab 分配器).
+ *
+ * malloc() 把请求长度向上取到 2 的幂次, 分配时要沿 bucket_dir 和桶描述符链线性搜索, 而且每个对象都占用一个 2 的幂次大小的块.
+ * 对于频繁分配和释放的同一类对象, 这里为每类对象建立一个缓存(kmem_cache):
+ *  - 每个 slab 是一页内存, 页面开头是 slab 描述符和空闲对象索引表, 其后依次存放对象. 对象长度只按 4 字节对齐;
+ *  - 对象地址按页对齐就是所在 slab 的描述符, 因此释放对象不需要任何搜索;
+ *  - 有空闲对象的 slab 链在缓存的 partial 链表中, 分配时直接取链表头 slab 中的第一个空闲对象;
+ *  - 空闲对象链记录在 slab 头部的索引表中, 不占用对象本身. 因此构造函数 ctor 只在 slab 建立时对每个对象调用一次,
+ *    使用者在释放对象时应让它保持构造后的状态, 再次分配时就不需要重新初始化;
+ *  - 对象全部空闲的 slab 立即释放, 但缓存中最后一个 slab 保留, 以免在一个对象上反复分配和释放页面.
+ * 缓存描述符本身也由一个缓存(cache_cache)分配. 链表操作在关中断时进行, 但用 save_flags()/restore_flags() 恢复原来的中断状态, 
+ * 因此在系统初始化期间和中断处理程序中也可以调用(中断处理程序中使用的缓存应预先有空闲对象, 因为分配 slab 页面可能睡眠).
+ */
+
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <asm/system.h>
+
+#define SLAB_END	0xffff					// 空闲对象链结束标志.
+
+// slab 描述符, 位于 slab 页面开头. bufctl[] 是空闲对象链: bufctl[i] 是对象 i 之后的下一个空闲对象的序号.
+struct slab {
+	struct kmem_cache * cache;				// 所属缓存.
+	struct slab * next, * prev;				// partial 链表指针. 对象全部分配出去的 slab 不在链表中.
+	unsigned short inuse;					// 已分配的对象数.
+	unsigned short free;					// 第一个空闲对象的序号, SLAB_END 表示没有空闲对象.
+	unsigned short bufctl[0];
+};
+
+// 对象缓存.
+struct kmem_cache {
+	const char * name;						// 缓存名称(显示统计信息用).
+	unsigned short size;					// 对象长度(4 字节对齐).
+	unsigned short num;						// 每个 slab 中的对象数.
+	unsigned short offset;					// 第一个对象在 slab 页面中的偏移.
+	void (* ctor)(void * obj);				// 对象构造函数, 可以为 NULL.
+	struct slab * partial;					// 有空闲对象的 slab 链表.
+	struct kmem_cache * next;				// 所有缓存组成的循环链表.
+	unsigned long active;					// 正在使用的对象数.
+	unsigned long slabs;					// slab 页面数.
+	unsigned long allocs;					// 累计分配次数.
+	unsigned long frees;					// 累计释放次数.
+};
+
+// 含有 num 个对象的 slab 中第一个对象的偏移(slab 描述符和索引表之后, 按 4 字节对齐).
+#define SLAB_OFFSET(num) ((sizeof(struct slab) + (num) * sizeof(unsigned short) + 3) & ~3)
+// slab 中序号为 i 的对象的地址.
+#define SLAB_OBJ(cachep, slabp, i) ((void *) ((char *) (slabp) + (cachep)->offset + (i) * (cachep)->size))
+
+// 缓存描述符的缓存. 它同时是所有缓存组成的循环链表的头(next 字段), 在第一次建立缓存时初始化.
+static struct kmem_cache cache_cache;
+
+// 把 slab 放到缓存的 partial 链表头部. 调用时中断已关闭.
+static inline void slab_link(struct kmem_cache * cachep, struct slab * slabp) {
+	slabp->prev = NULL;
+	if (slabp->next = cachep->partial) {
+		slabp->next->prev = slabp;
+	}
+	cachep->partial = slabp;
+}
+
+// 把 slab 从缓存的 partial 链表中取下. 调用时中断已关闭.
+static inline void slab_unlink(struct kmem_cache * cachep, struct slab * slabp) {
+	if (slabp->prev) {
+		slabp->prev->next = slabp->next;
+	} else {
+		cachep->partial = slabp->next;
+	}
+	if (slabp->next) {
+		slabp->next->prev = slabp->prev;
+	}
+	slabp->next = slabp->prev = NULL;
+}
+
+// 初始化缓存描述符. 对象长度向上取 4 的倍数, 然后计算一页中能放下的对象数.
+// 每个对象除本身外还要占用索引表中的 2 字节, 先按此估算, 再减去因对齐而放不下的对象.
+static int slab_init_cache(struct kmem_cache * cachep, const char * name, int size, void (* ctor)(void * obj)) {
+	int num;
+
+	size = (size + 3) & ~3;
+	if (size <= 0 || SLAB_OFFSET(1) + size > PAGE_SIZE) {
+		return 0;
+	}
+	num = (PAGE_SIZE - sizeof(struct slab)) / (size + sizeof(unsigned short));
+	while (SLAB_OFFSET(num) + num * size > PAGE_SIZE) {
+		num--;
+	}
+	cachep->name = name;
+	cachep->size = size;
+	cachep->num = num;
+	cachep->offset = SLAB_OFFSET(num);
+	cachep->ctor = ctor;
+	cachep->partial = NULL;
+	cachep->active = cachep->slabs = cachep->allocs = cachep->frees = 0;
+	return 1;
+}
+
+// 建立对象缓存. 缓存描述符从 cache_cache 中分配, 并加入缓存链表.
+struct kmem_cache * kmem_cache_create(const char * name, int size, void (* ctor)(void * obj)) {
+	struct kmem_cache * cachep;
+	unsigned long flags;
+
+	if (!cache_cache.num) {
+		slab_init_cache(&cache_cache, "kmem_cache", sizeof(struct kmem_cache), NULL);
+		cache_cache.next = &cache_cache;
+	}
+	if (!(cachep = (struct kmem_cache *) kmem_cache_alloc(&cache_cache))) {
+		return NULL;
+	}
+	if (!slab_init_cache(cachep, name, size, ctor)) {
+		kmem_cache_free(&cache_cache, cachep);
+		return NULL;
+	}
+	save_flags(flags);
+	cli();
+	cachep->next = cache_cache.next;
+	cache_cache.next = cachep;
+	restore_flags(flags);
+	return cachep;
+}
+
+// 为缓存分配一个新的 slab 页面: 建立空闲对象链, 对每个对象调用构造函数, 然后放入 partial 链表.
+// get_free_page() 可能睡眠, 因此不能在中断处理程序中调用. 内存不够返回 0.
+static int kmem_cache_grow(struct kmem_cache * cachep) {
+	struct slab * slabp;
+	unsigned long flags;
+	int i;
+
+	if (!(slabp = (struct slab *) get_free_page())) {
+		return 0;
+	}
+	slabp->cache = cachep;
+	slabp->inuse = 0;
+	slabp->free = 0;
+	for (i = 0; i < cachep->num - 1; i++) {
+		slabp->bufctl[i] = i + 1;
+	}
+	slabp->bufctl[i] = SLAB_END;
+	if (cachep->ctor) {
+		for (i = 0; i < cachep->num; i++) {
+			cachep->ctor(SLAB_OBJ(cachep, slabp, i));
+		}
+	}
+	save_flags(flags);
+	cli();
+	slab_link(cachep, slabp);
+	cachep->slabs++;
+	restore_flags(flags);
+	return 1;
+}
+
+// 从缓存中分配一个对象. partial 链表为空时先分配一个新的 slab(在此期间其他进程可能已经放回了对象或建立了 slab, 因此要重新检查).
+void * kmem_cache_alloc(struct kmem_cache * cachep) {
+	struct slab * slabp;
+	unsigned long flags;
+	void * obj;
+
+	save_flags(flags);
+	cli();
+	while (!(slabp = cachep->partial)) {
+		restore_flags(flags);
+		if (!kmem_cache_grow(cachep)) {
+			return NULL;
+		}
+		cli();
+	}
+	obj = SLAB_OBJ(cachep, slabp, slabp->free);
+	slabp->free = slabp->bufctl[slabp->free];
+	slabp->inuse++;
+	if (slabp->free == SLAB_END) {				// slab 已经分配满, 从 partial 链表中取下.
+		slab_unlink(cachep, slabp);
+	}
+	cachep->active++;
+	cachep->allocs++;
+	restore_flags(flags);
+	return obj;
+}
+
+// 把对象放回缓存. 对象所在页面的开头就是它的 slab 描述符.
+// 原来已分配满的 slab 重新放入 partial 链表; 对象全部空闲的 slab 若不是缓存中唯一有空闲对象的 slab, 则释放其页面.
+void kmem_cache_free(struct kmem_cache * cachep, void * obj) {
+	struct slab * slabp;
+	unsigned long flags;
+	int i;
+
+	slabp = (struct slab *) ((unsigned long) obj & ~(PAGE_SIZE - 1));
+	i = ((char *) obj - (char *) slabp - cachep->offset) / cachep->size;
+	if (slabp->cache != cachep || i < 0 || i >= cachep->num || SLAB_OBJ(cachep, slabp, i) != obj) {
+		panic("kmem_cache_free: bad object");
+	}
+	save_flags(flags);
+	cli();
+	if (slabp->free == SLAB_END) {
+		slab_link(cachep, slabp);
+	}
+	slabp->bufctl[i] = slabp->free;
+	slabp->free = i;
+	slabp->inuse--;
+	cachep->active--;
+	cachep->frees++;
+	if (!slabp->inuse && (cachep->partial != slabp || slabp->next)) {
+		slab_unlink(cachep, slabp);
+		cachep->slabs--;
+		free_page((unsigned long) slabp);
+	}
+	restore_flags(flags);
+}
+
+// 显示各缓存的统计信息: 使用中的对象数/对象总数, slab 页面数, 累计分配和释放次数. 由 show_mem() 调用(mm/memory.c).
+void kmem_cache_stats(void) {
+	struct kmem_cache * cachep;
+
+	printk("Slab-info:\n\r");
+	if (!cache_cache.num) {
+		return;
+	}
+	cachep = &cache_cache;
+	do {
+		printk("%s: %d/%d objs, %d slabs, %d allocs, %d frees\n\r", cachep->name, cachep->active,
+			cachep->slabs * cachep->num, cachep->slabs, cachep->allocs, cachep->frees);
+	} while ((cachep = cachep->next) != &cache_cache);
+}
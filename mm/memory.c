@@ -52,6 +52,7 @@
 #include <asm/system.h>
 
 #include <linux/sched.h>						// 调度程序头文件, 定义任务结构 task_struct, 任务 0 的数据.
+#include <linux/slab.h>							// 内核对象缓存头文件.
 //#include <linux/head.h>
 //#include <linux/kernel.h>
 
@@ -800,8 +801,9 @@ void do_no_page(unsigned long error_code, unsigned long address) {
 	/* 记住, (程序文件)头要使用 1 个数据块 */
 	// 根据这个块号和执行文件的 i 节点, 我们就可以从映射位图中找到对应块设备中对应的设备逻辑块号(保存在 nr[] 数组中). 
 	// 利用 bread_page() 即可把这 4 个逻辑块(每个 1KB, 4 个组成一个内存页面 4KB)读入到物理页面 page 中.
-	for (i = 0; i < 4; block++, i++) {
-		nr[i] = bmap(inode, block); 									// 文件的起始块号 + block 可以得到在硬盘中的逻辑块号.
+	// bmap_blocks() 一次取得这 4 个数据块的逻辑块号(文件的起始块号 + block 可以得到在硬盘中的逻辑块号), 无法映射的块号置 0.
+	for (i = bmap_blocks(inode, block, 4, nr); i < 4; i++) {
+		nr[i] = 0;
 	}
 	bread_page(page, inode->i_dev, nr);
 	// 在读设备逻辑块操作时, 可能会出现这样一种情况, 即读取的文件长度大于可执行文件的总长度.
@@ -933,4 +935,5 @@ void show_mem(void) {
 	}
 	// 最后显示系统中正在使用的内存页面和主内存区中总的内存页面数.
 	printk("Memory found: %d (%d)\n\r\n\r", free - shared, total);
+	kmem_cache_stats();									// 显示内核对象缓存的使用情况(lib/slab.c).
 }